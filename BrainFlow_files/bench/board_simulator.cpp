@@ -0,0 +1,738 @@
+/*********************************************************************
+ * board_simulator.cpp - virtual Meower boards for load tests of the BrainFlow driver
+ *
+ * Runs any number of boards on one machine, each speaking the exact firmware protocol
+ * (src/defines.h, src/net_manager.cpp):
+ * - MEOW_MEOW beacon while nobody is subscribed, MEOW_HERE answer to MEOW_PROBE
+ * - WOOF_WOOF subscribes (up to 4 PCs) and keeps alive, 10 s without it and the board forgets the PC
+ * - text "sys" / "usr" commands: start_cnt (answers "OK: start_cnt") / stop_cnt, fec_*, usr set_sampling_freq,
+ *   every other command is answered "OK: <command> (simulated)"
+ * - data datagrams [header | n frames | battery] with 24-bit samples and 8 us timestamps taken
+ *   from a board clock with its own drift, parity datagrams with "sys fec_on"
+ *
+ * Board i lives at IP ip_base + i (127.0.0.2, 127.0.0.3 ... by default, every 127.x address is
+ * loopback on Linux; macOS needs "sudo ifconfig lo0 alias 127.0.0.x" for each one) on control port
+ * ctrl_port + i * port_step and streams to data_port + i * port_step of the PC that subscribed.
+ * - port_step 0: every board on the same ports, as on a real network. Discovery and the aggregate
+ *   session ("boards=N") work, the probe broadcast is caught on 255.255.255.255:ctrl_port.
+ * - port_step 2: one driver session per board with its own ports (ip_address, ip_port, ip_port_aux).
+ *
+ * Network is modelled per board: every frame is "measured" at its exact time, a packet leaves once
+ * its last frame is in, plus an exponential delay of mean jitter ms (packets stay in order, a late
+ * one delays the next ones as a busy Wi-Fi queue would). Every datagram is lost with probability
+ * loss, in bursts of burst datagrams.
+ *
+ * BUILD (Linux, macOS):
+ *   g++ -O2 -std=c++14 board_simulator.cpp -o board_simulator -lpthread
+ *
+ * EXAMPLES:
+ *   ./board_simulator --boards 4 --rate 4000                 4 boards for an aggregate session
+ *   ./board_simulator --boards 8 --port-step 2 --loss 0.01   8 separate sessions, 1 % loss
+ * See driver_benchmark.cpp for the other side.
+ *********************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+// ====================================================================
+//                      PROTOCOL CONSTANTS
+// ====================================================================
+// Same values as src/defines.h of the firmware
+
+constexpr int      PACKET_HEADER_SIZE    = 12;
+constexpr uint8_t  PACKET_FORMAT_VERSION = 1;
+constexpr uint8_t  PACKET_TYPE_FRAMES    = 0;
+constexpr uint8_t  PACKET_TYPE_PARITY    = 2;
+constexpr int      FEC_OVERHEAD          = PACKET_HEADER_SIZE + 2;
+constexpr int      BATTERY_SIZE          = 4;
+constexpr int      TIMESTAMP_SIZE        = 4;
+constexpr int      MAX_UDP_PAYLOAD       = 1460;
+constexpr int      FIRMWARE_VERSION      = 7;
+constexpr int      MAX_PEERS             = 4;                  // WIFI_MAX_PEERS
+constexpr double   PEER_TIMEOUT_SECONDS  = 10.0;               // WIFI_SERVER_TIMEOUT
+constexpr double   BEACON_PERIOD_SECONDS = 1.0;                // WIFI_BEACON_PERIOD
+constexpr double   TICK_SECONDS          = 8e-6;               // Timestamp unit, getTimer8us()
+constexpr uint8_t  CMD_BIN_MAGIC         = 0xB5;               // Binary commands aren't simulated, dropped
+// Firmware default packing, 250 ... 4000 Hz (FRAMES_PER_PACKET_LUT in main.cpp): 40 and 80 frames capped at what one
+// datagram holds, MAX_FRAMES_PER_PACKET = (1460 - 14 - 12 - 4) / frame size - 27 with 16 channels, 51 with 8
+constexpr int      FRAMES_PER_PACKET_LUT[5]    = { 5, 10, 20, 27, 27 };   // 16 channels
+constexpr int      FRAMES_PER_PACKET_LUT_1C[5] = { 5, 10, 20, 40, 51 };   // 8 channels (ADC_NUM_CHIPS 1)
+
+
+// ====================================================================
+//                      SETTINGS
+// ====================================================================
+
+struct SimConfig
+{
+    int boards { 1 };
+    int rate { 250 };                        // ADC sampling rate at start, usr set_sampling_freq changes it
+    int channels { 16 };                     // 16, or 8 (ADC_NUM_CHIPS 1 build)
+    int frames_per_packet { 0 };             // 0 - firmware default for the rate
+    double loss { 0.0 };                     // Probability of a loss event per datagram
+    int burst { 1 };                         // Datagrams lost per event
+    double jitter_ms { 0.0 };                // Mean extra delay of a packet
+    double drift_ppm { 40.0 };               // Board clocks are spread over +-drift_ppm
+    int fec_group { 0 };                     // Parity after every fec_group datagrams from the start, 0 - off until sys fec_on
+    std::string ip_base { "127.0.0.2" };
+    int ctrl_port { 5000 };
+    int data_port { 5001 };
+    int port_step { 0 };
+    double seconds { 0.0 };                  // 0 - until Ctrl+C
+    double report_seconds { 5.0 };
+};
+
+static std::atomic<bool> g_running { true };
+
+static void on_signal (int)
+{
+    g_running = false;
+}
+
+static double now_seconds ()
+{
+    return std::chrono::duration<double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+
+// ====================================================================
+//                      VIRTUAL BOARD
+// ====================================================================
+
+class VirtualBoard
+{
+public:
+    VirtualBoard (int index, const SimConfig &cfg, uint32_t ip);
+    ~VirtualBoard ();
+
+    bool open ();
+    void run ();                                             // Thread body, until g_running goes false
+    void on_datagram (const uint8_t *data, int len, const sockaddr_in &from, bool broadcast);
+
+    // Totals for the report
+    std::atomic<unsigned long> datagrams { 0 };
+    std::atomic<unsigned long> frames { 0 };
+    std::atomic<unsigned long> lost { 0 };
+    std::atomic<unsigned long> parity { 0 };
+    std::atomic<unsigned long> commands { 0 };
+    std::string id;
+    std::string ip_str;
+
+private:
+    struct Peer
+    {
+        uint32_t ip;                         // Network order
+        double last_rx;
+    };
+
+    void reply (const std::string &text, const sockaddr_in &to);
+    void handle_command (const std::string &text, const sockaddr_in &from);
+    std::string probe_reply () const;
+    void send_due_packets (double now);
+    void send_datagram (const uint8_t *data, int len, uint32_t seq);
+    void transmit (const uint8_t *data, int len);
+    int rate_code () const;
+    int default_fpp (int code) const;
+
+    const int index_;
+    const SimConfig cfg_;
+    const uint32_t ip_;
+    int sock_ { -1 };
+    std::mutex mutex_;                       // Control (board thread and broadcast listener) against streaming
+
+    // ----------- Link -----------
+    std::vector<Peer> peers_;
+    double last_beacon_ { 0.0 };
+
+    // ----------- Stream -----------
+    int rate_;
+    int fpp_;
+    bool streaming_ { false };
+    double stream_start_ { 0.0 };            // True time of frame stream_frame0_
+    uint64_t stream_frame0_ { 0 };
+    uint64_t next_frame_ { 0 };              // Frame index since boot, counts on across stop / start
+    double last_send_ { 0.0 };               // Packets leave in order, a delayed one holds back the next
+    uint32_t seq_ { 0 };
+    int lose_left_ { 0 };                    // Datagrams still to drop of the current burst
+    std::vector<uint8_t> packet_;
+
+    // ----------- Board clock -----------
+    const double boot_;                      // True time the board "booted"
+    const double drift_;                     // Relative, board clock runs 1 + drift_ times true time
+    const double tick_offset_;               // Ticks at boot, so timestamps don't all start at 0
+
+    // ----------- FEC -----------
+    int fec_group_;
+    int fec_count_ { 0 };
+    uint32_t fec_first_seq_ { 0 };
+    int fec_max_len_ { 0 };
+    uint16_t fec_len_xor_ { 0 };
+    std::vector<uint8_t> fec_parity_;
+
+    // ----------- Signal -----------
+    std::mt19937 rng_;
+    std::vector<double> phase_step_;         // Per channel, radians per frame at the current rate
+    double battery_ { 3.95 };
+};
+
+VirtualBoard::VirtualBoard (int index, const SimConfig &cfg, uint32_t ip)
+    : index_ (index), cfg_ (cfg), ip_ (ip), rate_ (cfg.rate), boot_ (now_seconds ()),
+      drift_ ((cfg.boards > 1) ? cfg.drift_ppm * 1e-6 * (2.0 * index / (cfg.boards - 1) - 1.0) : cfg.drift_ppm * 1e-6),
+      tick_offset_ (1000.0 * 125000.0 * (index + 1)), fec_group_ (cfg.fec_group), rng_ (1234u + index)
+{
+    char mac[32];
+    snprintf (mac, sizeof (mac), "5E:1A:00:00:%02X:%02X", (index >> 8) & 0xFF, index & 0xFF);
+    id = mac;
+    char ip_text[INET_ADDRSTRLEN];
+    in_addr a;
+    a.s_addr = ip_;
+    inet_ntop (AF_INET, &a, ip_text, sizeof (ip_text));
+    ip_str = ip_text;
+
+    const int code = rate_code ();
+    fpp_ = cfg_.frames_per_packet ? cfg_.frames_per_packet : default_fpp (code);
+    packet_.resize (MAX_UDP_PAYLOAD);
+    fec_parity_.resize (MAX_UDP_PAYLOAD);
+}
+
+VirtualBoard::~VirtualBoard ()
+{
+    if (sock_ >= 0) close (sock_);
+}
+
+int VirtualBoard::rate_code () const
+{
+    int code = 0;
+    while ((code < 4) && ((250 << code) < rate_)) ++code;
+    return code;
+}
+
+int VirtualBoard::default_fpp (int code) const
+{
+    return (cfg_.channels == 8) ? FRAMES_PER_PACKET_LUT_1C[code] : FRAMES_PER_PACKET_LUT[code];
+}
+
+bool VirtualBoard::open ()
+{
+    sock_ = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock_ < 0) return false;
+    int on = 1;
+    setsockopt (sock_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+    setsockopt (sock_, SOL_SOCKET, SO_BROADCAST, &on, sizeof (on));
+    int buffer = 1 << 20;
+    setsockopt (sock_, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof (buffer));
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ip_;
+    addr.sin_port = htons ((uint16_t)(cfg_.ctrl_port + index_ * cfg_.port_step));
+    if (bind (sock_, (sockaddr *)&addr, sizeof (addr)) < 0)
+    {
+        fprintf (stderr, "Board %d: can't bind %s:%d - %s\n", index_, ip_str.c_str (),
+            cfg_.ctrl_port + index_ * cfg_.port_step, strerror (errno));
+        return false;
+    }
+    return true;
+}
+
+void VirtualBoard::reply (const std::string &text, const sockaddr_in &to)
+{
+    sendto (sock_, text.data (), text.size (), 0, (const sockaddr *)&to, sizeof (to));
+}
+
+std::string VirtualBoard::probe_reply () const
+{
+    char peer[INET_ADDRSTRLEN] = "none";
+    if (!peers_.empty ())
+    {
+        in_addr a;
+        a.s_addr = peers_.front ().ip;
+        inet_ntop (AF_INET, &a, peer, sizeof (peer));
+    }
+    char msg[320];
+    snprintf (msg, sizeof (msg),
+        "MEOW_HERE id=%s fw=%d fmt=%d ctrl=%d data=%d fs=%d fpp=%d decim=1 compress=0 fec=%d state=%s peer=%s"
+        " peers=%d mcast=none ch=%d",
+        id.c_str (), FIRMWARE_VERSION, PACKET_FORMAT_VERSION, cfg_.ctrl_port + index_ * cfg_.port_step,
+        cfg_.data_port + index_ * cfg_.port_step, rate_, fpp_, fec_group_ ? 1 : 0,
+        streaming_ ? "stream" : (peers_.empty () ? "disc" : "idle"), peer, (int)peers_.size (), cfg_.channels);
+    return msg;
+}
+
+// Datagram on the board's control port, or a broadcast caught by the listener
+void VirtualBoard::on_datagram (const uint8_t *data, int len, const sockaddr_in &from, bool broadcast)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    const std::string text ((const char *)data, (size_t)len);
+    const double now = now_seconds ();
+
+    if (text == "MEOW_MEOW") return;                         // Beacon of another (virtual) board
+
+    if (text == "WOOF_WOOF")
+    {
+        for (Peer &p : peers_)
+        {
+            if (p.ip == from.sin_addr.s_addr)
+            {
+                p.last_rx = now;
+                return;
+            }
+        }
+        if ((int)peers_.size () < MAX_PEERS) peers_.push_back (Peer { from.sin_addr.s_addr, now });
+        return;
+    }
+
+    if (text.compare (0, 10, "MEOW_PROBE") == 0)
+    {
+        reply (probe_reply (), from);
+        return;
+    }
+
+    // Everything else only from a subscriber. On one machine a broadcast comes from the host's own LAN address,
+    // not from the loopback one the driver subscribed with, so broadcasts only need some subscriber.
+    bool subscriber = false;
+    for (Peer &p : peers_)
+    {
+        if (broadcast || (p.ip == from.sin_addr.s_addr))
+        {
+            subscriber = true;
+            p.last_rx = now;
+        }
+    }
+    if (!subscriber || (len == 0) || (data[0] == CMD_BIN_MAGIC)) return;
+
+    ++commands;
+    handle_command (text, from);
+}
+
+void VirtualBoard::handle_command (const std::string &text, const sockaddr_in &from)
+{
+    // Same parsing as the firmware: family, command, arguments, case-insensitive
+    std::vector<std::string> tok;
+    size_t pos = 0;
+    while (pos < text.size ())
+    {
+        const size_t start = text.find_first_not_of (" \r\n\t", pos);
+        if (start == std::string::npos) break;
+        const size_t end = text.find_first_of (" \r\n\t", start);
+        std::string t = text.substr (start, end == std::string::npos ? std::string::npos : end - start);
+        std::transform (t.begin (), t.end (), t.begin (), ::tolower);
+        tok.push_back (t);
+        pos = (end == std::string::npos) ? text.size () : end;
+    }
+    if (tok.empty ()) return;
+    const std::string cmd = (tok.size () > 1) ? tok[1] : "";
+
+    if (tok[0] == "sys")
+    {
+        if (cmd == "start_cnt")
+        {
+            if (!streaming_)
+            {
+                streaming_ = true;
+                stream_start_ = now_seconds ();
+                stream_frame0_ = next_frame_;
+                last_send_ = stream_start_;
+            }
+            reply ("OK: start_cnt", from);
+            return;
+        }
+        if (cmd == "stop_cnt")
+        {
+            streaming_ = false;
+            return;                                          // No reply, same as the firmware
+        }
+        if (cmd == "fec_on" || cmd == "fec_off")
+        {
+            fec_group_ = (cmd == "fec_on") ? (fec_group_ ? fec_group_ : 8) : 0;
+            fec_count_ = 0;
+            reply ("OK: " + cmd, from);
+            return;
+        }
+        if (cmd == "fec_group")
+        {
+            const int n = (tok.size () > 2) ? atoi (tok[2].c_str ()) : 0;
+            if ((n < 2) || (n > 32))
+            {
+                reply ("ERR: fec_group - value must be 2 ... 32 packets", from);
+                return;
+            }
+            if (fec_group_) fec_group_ = n;
+            fec_count_ = 0;
+            reply ("OK: fec_group " + tok[2], from);
+            return;
+        }
+        reply ("OK: " + cmd + " (simulated)", from);
+        return;
+    }
+
+    if (tok[0] == "usr")
+    {
+        // Firmware stops continuous mode before every usr command
+        streaming_ = false;
+        if (cmd == "set_sampling_freq")
+        {
+            const int freq = (tok.size () > 2) ? atoi (tok[2].c_str ()) : 0;
+            if ((freq != 250) && (freq != 500) && (freq != 1000) && (freq != 2000) && (freq != 4000))
+            {
+                reply ("ERR: set_sampling_freq - got '" + std::to_string (freq) + "', allowed only 250,500,1000,2000,4000",
+                    from);
+                return;
+            }
+            rate_ = freq;
+            fpp_ = cfg_.frames_per_packet ? cfg_.frames_per_packet : default_fpp (rate_code ());
+            reply ("OK: sampling_freq set to " + std::to_string (freq) + " Hz", from);
+            return;
+        }
+        reply ("OK: " + cmd + " (simulated)", from);
+        return;
+    }
+
+    reply ("ERR: " + tok[0] + " - not simulated", from);
+}
+
+// Datagram to every subscriber, or nowhere if it's lost
+void VirtualBoard::transmit (const uint8_t *data, int len)
+{
+    if (lose_left_ == 0)
+    {
+        std::uniform_real_distribution<double> u (0.0, 1.0);
+        if ((cfg_.loss > 0.0) && (u (rng_) < cfg_.loss)) lose_left_ = std::max (1, cfg_.burst);
+    }
+    if (lose_left_ > 0)
+    {
+        --lose_left_;
+        ++lost;
+        return;
+    }
+    for (const Peer &p : peers_)
+    {
+        sockaddr_in to {};
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = p.ip;
+        to.sin_port = htons ((uint16_t)(cfg_.data_port + index_ * cfg_.port_step));
+        sendto (sock_, data, len, 0, (const sockaddr *)&to, sizeof (to));
+    }
+}
+
+// Data datagram, folded into the parity of its FEC group (same as sendDatagram() of the firmware)
+void VirtualBoard::send_datagram (const uint8_t *data, int len, uint32_t seq)
+{
+    transmit (data, len);
+    ++datagrams;
+    if (!fec_group_) return;
+
+    if (fec_count_ == 0)
+    {
+        std::fill (fec_parity_.begin (), fec_parity_.end (), 0);
+        fec_first_seq_ = seq;
+        fec_max_len_ = 0;
+        fec_len_xor_ = 0;
+    }
+    for (int i = 0; i < len; i++) fec_parity_[FEC_OVERHEAD + i] ^= data[i];
+    fec_len_xor_ ^= (uint16_t)len;
+    fec_max_len_ = std::max (fec_max_len_, len);
+
+    if (++fec_count_ >= fec_group_)
+    {
+        uint8_t *h = fec_parity_.data ();
+        h[0] = PACKET_FORMAT_VERSION;
+        h[1] = PACKET_TYPE_PARITY;
+        h[2] = (uint8_t)fec_count_;
+        h[3] = 0;
+        memcpy (&h[4], &fec_first_seq_, 4);
+        memset (&h[8], 0, 4);
+        memcpy (&h[PACKET_HEADER_SIZE], &fec_len_xor_, 2);
+        transmit (h, FEC_OVERHEAD + fec_max_len_);
+        ++parity;
+        fec_count_ = 0;
+    }
+}
+
+// Every packet whose last frame has been measured and whose (jittered) send time has come
+void VirtualBoard::send_due_packets (double now)
+{
+    const int channel_bytes = 3 * cfg_.channels;
+    const int frame_bytes = channel_bytes + TIMESTAMP_SIZE;
+    std::exponential_distribution<double> delay (cfg_.jitter_ms > 0.0 ? 1000.0 / cfg_.jitter_ms : 1.0);
+
+    if (phase_step_.size () != (size_t)cfg_.channels) phase_step_.assign (cfg_.channels, 0.0);
+    for (int ch = 0; ch < cfg_.channels; ++ch)
+    {
+        phase_step_[ch] = 2.0 * M_PI * (2.0 + 3.0 * ch) / rate_;   // 2, 5, 8 ... 47 Hz
+    }
+
+    while (streaming_ && !peers_.empty ())
+    {
+        const uint64_t first = next_frame_;
+        const double last_time = stream_start_ + (double)(first + fpp_ - 1 - stream_frame0_) / rate_;
+        const double send_time = std::max (last_send_, last_time + (cfg_.jitter_ms > 0.0 ? delay (rng_) : 0.0));
+        if (send_time > now) return;
+        last_send_ = send_time;
+
+        uint8_t *p = packet_.data ();
+        p[0] = PACKET_FORMAT_VERSION;
+        p[1] = PACKET_TYPE_FRAMES;
+        p[2] = (uint8_t)fpp_;
+        p[3] = (uint8_t)rate_code ();                        // Raw, no filters
+        memcpy (&p[4], &seq_, 4);
+        const uint32_t first32 = (uint32_t)first;
+        memcpy (&p[8], &first32, 4);
+
+        std::uniform_int_distribution<int> noise (-200, 200);
+        for (int f = 0; f < fpp_; ++f)
+        {
+            uint8_t *frame = p + PACKET_HEADER_SIZE + f * frame_bytes;
+            const uint64_t k = first + f;
+            const double t = stream_start_ + (double)(k - stream_frame0_) / rate_;
+            for (int ch = 0; ch < cfg_.channels; ++ch)
+            {
+                const int32_t v = (int32_t)(100000.0 * sin (phase_step_[ch] * (double)k)) + noise (rng_);
+                frame[3 * ch + 0] = (uint8_t)((v >> 16) & 0xFF);
+                frame[3 * ch + 1] = (uint8_t)((v >> 8) & 0xFF);
+                frame[3 * ch + 2] = (uint8_t)(v & 0xFF);
+            }
+            const uint32_t ticks = (uint32_t)(uint64_t)(tick_offset_ + (t - boot_) * (1.0 + drift_) / TICK_SECONDS);
+            memcpy (&frame[channel_bytes], &ticks, 4);
+        }
+        const float battery = (float)battery_;
+        memcpy (&p[PACKET_HEADER_SIZE + fpp_ * frame_bytes], &battery, BATTERY_SIZE);
+
+        send_datagram (p, PACKET_HEADER_SIZE + fpp_ * frame_bytes + BATTERY_SIZE, seq_++);
+        next_frame_ += fpp_;
+        frames += fpp_;
+    }
+}
+
+void VirtualBoard::run ()
+{
+    std::vector<uint8_t> rx (2048);
+    while (g_running)
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex_);
+            const double now = now_seconds ();
+
+            // Subscribers time out on their own, the last one gone ends the stream
+            peers_.erase (std::remove_if (peers_.begin (), peers_.end (),
+                [now] (const Peer &p) { return now - p.last_rx > PEER_TIMEOUT_SECONDS; }), peers_.end ());
+            if (peers_.empty ()) streaming_ = false;
+
+            // Beacon while nobody listens - unicast to this machine, a real board broadcasts it
+            if (peers_.empty () && (now - last_beacon_ >= BEACON_PERIOD_SECONDS))
+            {
+                sockaddr_in to {};
+                to.sin_family = AF_INET;
+                to.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+                to.sin_port = htons ((uint16_t)(cfg_.ctrl_port + index_ * cfg_.port_step));
+                reply ("MEOW_MEOW", to);
+                last_beacon_ = now;
+            }
+
+            send_due_packets (now);
+        }
+
+        // Sleep until a command arrives or the next packet is due, 1 ms at most
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (sock_, &fds);
+        timeval tv { 0, 1000 };
+        if (select (sock_ + 1, &fds, nullptr, nullptr, &tv) > 0)
+        {
+            sockaddr_in from {};
+            socklen_t from_len = sizeof (from);
+            const int n = (int)recvfrom (sock_, rx.data (), rx.size (), 0, (sockaddr *)&from, &from_len);
+            if (n >= 0) on_datagram (rx.data (), n, from, false);
+        }
+    }
+}
+
+
+// ====================================================================
+//                      BROADCAST LISTENER
+// ====================================================================
+// Probes and broadcast commands go to 255.255.255.255:ctrl_port, a socket bound to one board address never sees
+// them. One socket bound to the broadcast address hands them to every board (only with port_step 0).
+
+static void broadcast_thread (std::vector<std::unique_ptr<VirtualBoard>> *boards, int sock)
+{
+    std::vector<uint8_t> rx (2048);
+    while (g_running)
+    {
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (sock, &fds);
+        timeval tv { 0, 100000 };
+        if (select (sock + 1, &fds, nullptr, nullptr, &tv) <= 0) continue;
+        sockaddr_in from {};
+        socklen_t from_len = sizeof (from);
+        const int n = (int)recvfrom (sock, rx.data (), rx.size (), 0, (sockaddr *)&from, &from_len);
+        if (n < 0) continue;
+        for (auto &b : *boards) b->on_datagram (rx.data (), n, from, true);
+    }
+}
+
+
+// ====================================================================
+//                      MAIN
+// ====================================================================
+
+static void usage ()
+{
+    printf (
+        "board_simulator - virtual Meower boards\n"
+        "  --boards N         number of boards (1)\n"
+        "  --rate HZ          ADC rate at start, 250 ... 4000 (250), usr set_sampling_freq changes it\n"
+        "  --channels 16|8    channels per board (16)\n"
+        "  --fpp N            frames per packet (firmware default for the rate)\n"
+        "  --loss P           probability of a loss event per datagram, 0 ... 1 (0)\n"
+        "  --burst N          datagrams lost per event (1)\n"
+        "  --jitter MS        mean extra network delay, exponential (0)\n"
+        "  --drift PPM        board clocks spread over +-PPM (40)\n"
+        "  --fec N            parity after every N datagrams from the start (off, sys fec_on turns it on)\n"
+        "  --ip-base IP       address of board 0, the others follow (127.0.0.2)\n"
+        "  --ctrl-port P      control port of board 0 (5000)\n"
+        "  --data-port P      PC data port of board 0 (5001)\n"
+        "  --port-step N      port distance between boards, 0 - all on the same ports (0)\n"
+        "  --seconds S        run time, 0 - until Ctrl+C (0)\n"
+        "  --report S         progress line every S seconds, 0 - only at the end (5)\n");
+}
+
+int main (int argc, char **argv)
+{
+    SimConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!v || a == "--help" || a == "-h")
+        {
+            usage ();
+            return (a == "--help" || a == "-h") ? 0 : 1;
+        }
+        if      (a == "--boards")    cfg.boards = atoi (v);
+        else if (a == "--rate")      cfg.rate = atoi (v);
+        else if (a == "--channels")  cfg.channels = atoi (v);
+        else if (a == "--fpp")       cfg.frames_per_packet = atoi (v);
+        else if (a == "--loss")      cfg.loss = atof (v);
+        else if (a == "--burst")     cfg.burst = atoi (v);
+        else if (a == "--jitter")    cfg.jitter_ms = atof (v);
+        else if (a == "--drift")     cfg.drift_ppm = atof (v);
+        else if (a == "--fec")       cfg.fec_group = atoi (v);
+        else if (a == "--ip-base")   cfg.ip_base = v;
+        else if (a == "--ctrl-port") cfg.ctrl_port = atoi (v);
+        else if (a == "--data-port") cfg.data_port = atoi (v);
+        else if (a == "--port-step") cfg.port_step = atoi (v);
+        else if (a == "--seconds")   cfg.seconds = atof (v);
+        else if (a == "--report")    cfg.report_seconds = atof (v);
+        else
+        {
+            usage ();
+            return 1;
+        }
+        ++i;
+    }
+
+    const int frame_bytes = 3 * cfg.channels + TIMESTAMP_SIZE;
+    const int max_fpp = (MAX_UDP_PAYLOAD - FEC_OVERHEAD - PACKET_HEADER_SIZE - BATTERY_SIZE) / frame_bytes;
+    in_addr base {};
+    if ((cfg.boards < 1) || ((cfg.channels != 16) && (cfg.channels != 8)) || (cfg.frames_per_packet < 0) ||
+        (cfg.frames_per_packet > max_fpp) || (inet_pton (AF_INET, cfg.ip_base.c_str (), &base) != 1) ||
+        ((cfg.fec_group != 0) && ((cfg.fec_group < 2) || (cfg.fec_group > 32))))
+    {
+        fprintf (stderr, "Bad arguments (boards >= 1, channels 16 or 8, fpp <= %d, fec 2 ... 32)\n", max_fpp);
+        return 1;
+    }
+    signal (SIGINT, on_signal);
+    signal (SIGTERM, on_signal);
+
+    // ----------- Boards -----------
+    std::vector<std::unique_ptr<VirtualBoard>> boards;
+    for (int i = 0; i < cfg.boards; ++i)
+    {
+        boards.emplace_back (new VirtualBoard (i, cfg, htonl (ntohl (base.s_addr) + (uint32_t)i)));
+        if (!boards.back ()->open ()) return 1;
+        printf ("Board %d: %s at %s, control port %d, data to port %d\n", i, boards.back ()->id.c_str (),
+            boards.back ()->ip_str.c_str (), cfg.ctrl_port + i * cfg.port_step, cfg.data_port + i * cfg.port_step);
+    }
+
+    int bcast = -1;
+    if (cfg.port_step == 0)
+    {
+        bcast = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        int on = 1;
+        setsockopt (bcast, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl (INADDR_BROADCAST);
+        addr.sin_port = htons ((uint16_t)cfg.ctrl_port);
+        if (bind (bcast, (sockaddr *)&addr, sizeof (addr)) < 0)
+        {
+            fprintf (stderr, "Can't listen for broadcasts (%s) - discovery won't see the boards, give ip_address\n",
+                strerror (errno));
+            close (bcast);
+            bcast = -1;
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (auto &b : boards) threads.emplace_back (&VirtualBoard::run, b.get ());
+    if (bcast >= 0) threads.emplace_back (broadcast_thread, &boards, bcast);
+
+    // ----------- Progress -----------
+    const double start = now_seconds ();
+    double last_report = start;
+    unsigned long last_frames = 0;
+    while (g_running)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (50));
+        const double now = now_seconds ();
+        if ((cfg.seconds > 0.0) && (now - start >= cfg.seconds)) g_running = false;
+        if ((cfg.report_seconds > 0.0) && (now - last_report >= cfg.report_seconds))
+        {
+            unsigned long total = 0, lost = 0, streaming = 0;
+            for (auto &b : boards)
+            {
+                total += b->frames;
+                lost += b->lost;
+                streaming += (b->frames != 0);
+            }
+            printf ("%.0f s: %.0f frames/s from %lu board(s), %lu datagrams lost so far\n", now - start,
+                (total - last_frames) / (now - last_report), streaming, lost);
+            fflush (stdout);
+            last_frames = total;
+            last_report = now;
+        }
+    }
+    for (std::thread &t : threads) t.join ();
+    if (bcast >= 0) close (bcast);
+
+    // ----------- Totals -----------
+    printf ("%-18s %-12s %10s %10s %8s %8s %8s\n", "board", "ip", "datagrams", "frames", "lost", "parity", "commands");
+    for (auto &b : boards)
+    {
+        printf ("%-18s %-12s %10lu %10lu %8lu %8lu %8lu\n", b->id.c_str (), b->ip_str.c_str (), b->datagrams.load (),
+            b->frames.load (), b->lost.load (), b->parity.load (), b->commands.load ());
+    }
+    return 0;
+}
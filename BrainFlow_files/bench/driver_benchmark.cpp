@@ -0,0 +1,277 @@
+/*********************************************************************
+ * driver_benchmark.cpp - end-to-end throughput and latency of the BrainFlow driver
+ *
+ * Streams from board_simulator (or real boards) through BoardShim, the same path an application takes, and
+ * reports per run:
+ * - frames/s delivered against the rate that was asked for, frames missing (gaps in the row timestamps)
+ * - latency of every row: time it was taken by get_board_data() minus its timestamp (board clock mapped to PC
+ *   time by the driver), p50 / p90 / p99 / p99.9 / max. Includes up to poll_ms of polling delay.
+ * - CPU of this process (driver threads + polling), % of one core
+ * Last line is "RESULT key=value ...", one line per run to compare builds or track regressions.
+ *
+ * MODES:
+ *   separate (default)  N sessions of VRCHAT_BOARD, board i at 127.0.0.(2 + i) on ports 5001 / 5000 + 2 * i,
+ *                       simulator with --port-step 2
+ *   --aggregate         one VRCHAT_AGGREGATE session of N boards found by discovery, simulator with --port-step 0
+ *
+ * BUILD (Linux, macOS), against an installed BrainFlow with the VRChat boards:
+ *   g++ -O2 -std=c++14 driver_benchmark.cpp -o driver_benchmark -I<brainflow>/inc -L<brainflow>/lib \
+ *       -lBoardController -lDataHandler -lpthread
+ *
+ * EXAMPLE:
+ *   ./board_simulator --boards 4 --port-step 2 --seconds 40 &
+ *   ./driver_benchmark --boards 4 --rate 4000 --seconds 30
+ *********************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "board_shim.h"
+
+
+// ====================================================================
+//                      SETTINGS
+// ====================================================================
+
+constexpr int VRCHAT_BOARD     = 65;                     // BoardIds::VRCHAT_BOARD
+constexpr int VRCHAT_AGGREGATE = 67;                     // BoardIds::VRCHAT_AGGREGATE
+
+struct BenchConfig
+{
+    int boards { 1 };
+    int rate { 250 };
+    double seconds { 10.0 };
+    double warmup_seconds { 2.0 };                       // Not counted, the driver's clock model settles first
+    int poll_ms { 5 };
+    bool aggregate { false };
+    std::string ip_base { "127.0.0." };
+    int first_host { 2 };
+    int data_port { 5001 };
+    int ctrl_port { 5000 };
+    int port_step { 2 };
+};
+
+struct SessionStats
+{
+    std::unique_ptr<BoardShim> board;
+    int timestamp_row { -1 };
+    double last_timestamp { 0.0 };
+    unsigned long rows { 0 };
+    unsigned long missing { 0 };
+};
+
+static double cpu_seconds ()
+{
+    rusage usage {};
+    getrusage (RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+// Same clock as the row timestamps (BrainFlow get_timestamp(), seconds since the epoch)
+static double wall_seconds ()
+{
+    return std::chrono::duration<double> (std::chrono::system_clock::now ().time_since_epoch ()).count ();
+}
+
+static double percentile (std::vector<double> &v, double p)
+{
+    if (v.empty ()) return NAN;
+    const size_t k = std::min (v.size () - 1, (size_t)(p * (v.size () - 1) + 0.5));
+    std::nth_element (v.begin (), v.begin () + k, v.end ());
+    return v[k];
+}
+
+// Rows of one get_board_data() into the statistics, counted only after the warmup
+static void take_rows (SessionStats &s, const BrainFlowArray<double, 2> &data, double now, bool counted,
+    std::vector<double> &latency_ms, double period)
+{
+    const int num_rows = data.get_size (1);
+    for (int i = 0; i < num_rows; ++i)
+    {
+        const double ts = data.at (s.timestamp_row, i);
+        if (counted)
+        {
+            latency_ms.push_back ((now - ts) * 1000.0);
+            ++s.rows;
+            // A gap of k periods is k - 1 frames the driver never got
+            if ((s.last_timestamp > 0.0) && (ts - s.last_timestamp > 1.5 * period))
+            {
+                s.missing += (unsigned long)std::lround ((ts - s.last_timestamp) / period) - 1;
+            }
+        }
+        s.last_timestamp = ts;
+    }
+}
+
+
+// ====================================================================
+//                      MAIN
+// ====================================================================
+
+static void usage ()
+{
+    printf (
+        "driver_benchmark - BrainFlow driver throughput and latency, see board_simulator\n"
+        "  --boards N         boards, sessions of one board each or one aggregate session (1)\n"
+        "  --rate HZ          usr set_sampling_freq for every board (250)\n"
+        "  --seconds S        measured time (10)\n"
+        "  --warmup S         streamed before measuring (2)\n"
+        "  --poll-ms MS       get_board_data() period (5)\n"
+        "  --aggregate        one VRCHAT_AGGREGATE session, boards from discovery\n"
+        "  --ip-base PREFIX   separate sessions: board i at PREFIX(first + i) (127.0.0.)\n"
+        "  --first N          host part of board 0 (2)\n"
+        "  --data-port P      data port of board 0 (5001)\n"
+        "  --ctrl-port P      control port of board 0 (5000)\n"
+        "  --port-step N      port distance between separate sessions (2)\n");
+}
+
+int main (int argc, char **argv)
+{
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        if (a == "--aggregate")
+        {
+            cfg.aggregate = true;
+            continue;
+        }
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!v || a == "--help" || a == "-h")
+        {
+            usage ();
+            return (a == "--help" || a == "-h") ? 0 : 1;
+        }
+        if      (a == "--boards")    cfg.boards = atoi (v);
+        else if (a == "--rate")      cfg.rate = atoi (v);
+        else if (a == "--seconds")   cfg.seconds = atof (v);
+        else if (a == "--warmup")    cfg.warmup_seconds = atof (v);
+        else if (a == "--poll-ms")   cfg.poll_ms = atoi (v);
+        else if (a == "--ip-base")   cfg.ip_base = v;
+        else if (a == "--first")     cfg.first_host = atoi (v);
+        else if (a == "--data-port") cfg.data_port = atoi (v);
+        else if (a == "--ctrl-port") cfg.ctrl_port = atoi (v);
+        else if (a == "--port-step") cfg.port_step = atoi (v);
+        else
+        {
+            usage ();
+            return 1;
+        }
+        ++i;
+    }
+    if ((cfg.boards < 1) || (cfg.seconds <= 0.0) || (cfg.poll_ms < 1))
+    {
+        usage ();
+        return 1;
+    }
+
+    BoardShim::set_log_level ((int)LogLevels::LEVEL_WARN);
+    const std::string rate_command = "usr set_sampling_freq " + std::to_string (cfg.rate);
+    const double period = 1.0 / cfg.rate;
+    std::vector<SessionStats> sessions (cfg.aggregate ? 1 : cfg.boards);
+
+    try
+    {
+        // ----------- Sessions -----------
+        for (size_t i = 0; i < sessions.size (); ++i)
+        {
+            BrainFlowInputParams params;
+            int board_id = VRCHAT_BOARD;
+            if (cfg.aggregate)
+            {
+                board_id = VRCHAT_AGGREGATE;
+                params.ip_port = cfg.data_port;
+                params.ip_port_aux = cfg.ctrl_port;
+                params.other_info = "boards=" + std::to_string (cfg.boards);
+            }
+            else
+            {
+                params.ip_address = cfg.ip_base + std::to_string (cfg.first_host + (int)i);
+                params.ip_port = cfg.data_port + (int)i * cfg.port_step;
+                params.ip_port_aux = cfg.ctrl_port + (int)i * cfg.port_step;
+            }
+            SessionStats &s = sessions[i];
+            s.board.reset (new BoardShim (board_id, params));
+            s.timestamp_row = BoardShim::get_timestamp_channel (board_id);
+            s.board->prepare_session ();
+            s.board->config_board (rate_command);
+        }
+        for (SessionStats &s : sessions)
+        {
+            s.board->start_stream (450000);
+        }
+
+        // ----------- Measurement -----------
+        std::vector<double> latency_ms;
+        latency_ms.reserve ((size_t)(cfg.seconds * cfg.rate * sessions.size () * 1.1));
+        const auto start = std::chrono::steady_clock::now ();
+        const auto measure_from = start + std::chrono::duration<double> (cfg.warmup_seconds);
+        const auto measure_to = measure_from + std::chrono::duration<double> (cfg.seconds);
+        double cpu_start = 0.0;
+        bool counted = false;
+        while (std::chrono::steady_clock::now () < measure_to)
+        {
+            std::this_thread::sleep_for (std::chrono::milliseconds (cfg.poll_ms));
+            if (!counted && (std::chrono::steady_clock::now () >= measure_from))
+            {
+                counted = true;
+                cpu_start = cpu_seconds ();
+            }
+            for (SessionStats &s : sessions)
+            {
+                BrainFlowArray<double, 2> data = s.board->get_board_data ();
+                take_rows (s, data, wall_seconds (), counted, latency_ms, period);
+            }
+        }
+        const double cpu = cpu_seconds () - cpu_start;
+
+        for (SessionStats &s : sessions)
+        {
+            s.board->stop_stream ();
+            s.board->release_session ();
+        }
+
+        // ----------- Report -----------
+        unsigned long rows = 0, missing = 0;
+        for (size_t i = 0; i < sessions.size (); ++i)
+        {
+            const SessionStats &s = sessions[i];
+            printf ("Session %zu: %lu rows, %.1f rows/s, %lu missing\n", i, s.rows, s.rows / cfg.seconds, s.missing);
+            rows += s.rows;
+            missing += s.missing;
+        }
+        // Aggregate rows carry every board, frames = rows * boards either way
+        const double frames_per_s = rows * (cfg.aggregate ? cfg.boards : 1) / cfg.seconds;
+        const double expected = (double)cfg.rate * cfg.boards;
+        const double p50 = percentile (latency_ms, 0.5), p90 = percentile (latency_ms, 0.9);
+        const double p99 = percentile (latency_ms, 0.99), p999 = percentile (latency_ms, 0.999);
+        const double max = latency_ms.empty () ? NAN : *std::max_element (latency_ms.begin (), latency_ms.end ());
+        printf ("Frames/s %.1f of %.0f expected (%.2f %%), %lu rows missing\n", frames_per_s, expected,
+            100.0 * frames_per_s / expected, missing);
+        printf ("Latency ms: p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", p50, p90, p99, p999, max);
+        printf ("CPU %.1f %% of one core\n", 100.0 * cpu / cfg.seconds);
+        printf ("RESULT mode=%s boards=%d rate=%d seconds=%.0f frames_per_s=%.1f expected=%.0f missing=%lu "
+                "p50_ms=%.2f p90_ms=%.2f p99_ms=%.2f p999_ms=%.2f max_ms=%.2f cpu_pct=%.1f\n",
+            cfg.aggregate ? "aggregate" : "separate", cfg.boards, cfg.rate, cfg.seconds, frames_per_s, expected,
+            missing, p50, p90, p99, p999, max, 100.0 * cpu / cfg.seconds);
+    }
+    catch (const BrainFlowException &err)
+    {
+        fprintf (stderr, "BrainFlow error %d: %s\n", err.exit_code, err.what ());
+        for (SessionStats &s : sessions)
+        {
+            if (s.board && s.board->is_prepared ()) s.board->release_session ();
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -1234,6 +1234,101 @@ BrainFlowBoards::BrainFlowBoards()
         {"resistance_channels"     , {19}}, //
         {"other_channels"          , {18, 21}}  // Reserved for future use
     };
+    // Band power features of the board ("sys features_on" / "sys features_only"), one package per feature set:
+    // other channel ch * 8 + band is the power of channel ch in band (V^2, mean square of the band), bands the board
+    // doesn't send stay 0. Same for board 66 with 8 channels.
+    brainflow_boards_json["boards"]["65"]["auxiliary"] =
+    {
+        {"name", "VRChatBoardFeatures"},
+        {"sampling_rate"           ,  20 }, // default, "sys feature_rate"
+        {"timestamp_channel"       , 128 }, // Hardware timestamp of the last frame in the window, in PC time
+        {"battery_channel"         , 129 },
+        {"marker_channel"          , 130 },
+        {"package_num_channel"     ,   0 }, // Not used
+        {"num_rows"                , 131 },
+        {"other_channels"          , {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                      16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+                                      32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+                                      48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63,
+                                      64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79,
+                                      80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95,
+                                      96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111,
+                                      112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127}}
+    };
+    // Electrode impedance of the board ("sys impedance_on"), one package per measurement (about 1 s, 2 s at 250 Hz):
+    // resistance channel ch is the impedance of channel ch in ohms, NaN where the channel has no excitation
+    // (powered down or not on an electrode). Same for board 66 with 8 channels.
+    brainflow_boards_json["boards"]["65"]["ancillary"] =
+    {
+        {"name", "VRChatBoardImpedance"},
+        {"sampling_rate"           ,   1 }, // default, 0.5 at 250 Hz
+        {"timestamp_channel"       ,  16 }, // Hardware timestamp of the last frame of the measurement, in PC time
+        {"battery_channel"         ,  17 },
+        {"marker_channel"          ,  18 },
+        {"package_num_channel"     ,   0 }, // Not used
+        {"num_rows"                ,  19 },
+        {"resistance_channels"     , {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}}
+    };
+    // Same board built with one ADS1299 (firmware ADC_NUM_CHIPS 1), 28-byte frames.
+    // Needs VRCHAT_BOARD_8CH = 66 in BoardIds (brainflow_constants.h) and board_controller.cpp, same driver class.
+    brainflow_boards_json["boards"]["66"]["default"] =
+    {
+        {"name", "VRChatBoard8"},
+        {"sampling_rate"           , 250 }, // default
+        {"timestamp_channel"       ,   9 }, // Hardware timestamp converted to PC time, same as board 65
+        {"marker_channel"          ,  12 }, // For event markers
+        {"package_num_channel"     ,   0 }, // Not used (set to 0 or remove)
+        {"num_rows"                ,  14 }, // Total channels needed
+        {"eeg_channels"            , {0, 1, 2, 3, 4, 5, 6, 7}},
+        {"eeg_names"               , "CH1,CH2,CH3,CH4,CH5,CH6,CH7,CH8"},
+        {"battery_channel"         ,   8 }, //
+        {"resistance_channels"     , {11}}, //
+        {"other_channels"          , {10, 13}}  // Reserved for future use
+    };
+    brainflow_boards_json["boards"]["66"]["auxiliary"] =
+    {
+        {"name", "VRChatBoard8Features"},
+        {"sampling_rate"           ,  20 }, // default, "sys feature_rate"
+        {"timestamp_channel"       ,  64 }, // Same as board 65
+        {"battery_channel"         ,  65 },
+        {"marker_channel"          ,  66 },
+        {"package_num_channel"     ,   0 }, // Not used
+        {"num_rows"                ,  67 },
+        {"other_channels"          , {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                      16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+                                      32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+                                      48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63}}
+    };
+    brainflow_boards_json["boards"]["66"]["ancillary"] =
+    {
+        {"name", "VRChatBoard8Impedance"},
+        {"sampling_rate"           ,   1 }, // default, 0.5 at 250 Hz
+        {"timestamp_channel"       ,   8 }, // Same as board 65
+        {"battery_channel"         ,   9 },
+        {"marker_channel"          ,  10 },
+        {"package_num_channel"     ,   0 }, // Not used
+        {"num_rows"                ,  11 },
+        {"resistance_channels"     , {0, 1, 2, 3, 4, 5, 6, 7}}
+    };
+    // Several boards streamed as one (driver other_info "boards="), EEG of each board back to back in the order
+    // they were given (or by MAC): up to 4 boards of 16 or 8 of 8 channels. Battery of the first board in
+    // battery_channel, of the others in other_channels. Needs VRCHAT_AGGREGATE = 67 in BoardIds, same driver class.
+    brainflow_boards_json["boards"]["67"]["default"] =
+    {
+        {"name", "VRChatAggregate"},
+        {"sampling_rate"           , 250 }, // default, same on every board
+        {"timestamp_channel"       ,  65 }, // First board's hardware timestamp in PC time, the others are aligned to it
+        {"marker_channel"          ,  73 }, // For event markers
+        {"package_num_channel"     ,   0 }, // Not used (set to 0 or remove)
+        {"num_rows"                ,  74 }, // Total channels needed
+        {"eeg_channels"            , {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                      16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+                                      32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+                                      48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63}},
+        {"eeg_names"               , "CH1,CH2,CH3,CH4,CH5,CH6,CH7,CH8,CH9,CH10,CH11,CH12,CH13,CH14,CH15,CH16,CH17,CH18,CH19,CH20,CH21,CH22,CH23,CH24,CH25,CH26,CH27,CH28,CH29,CH30,CH31,CH32,CH33,CH34,CH35,CH36,CH37,CH38,CH39,CH40,CH41,CH42,CH43,CH44,CH45,CH46,CH47,CH48,CH49,CH50,CH51,CH52,CH53,CH54,CH55,CH56,CH57,CH58,CH59,CH60,CH61,CH62,CH63,CH64"},
+        {"battery_channel"         ,  64 }, // First board
+        {"other_channels"          , {66, 67, 68, 69, 70, 71, 72}}  // Batteries of boards 2..8
+    };
 }
 
 BrainFlowBoards boards_struct;
\ No newline at end of file
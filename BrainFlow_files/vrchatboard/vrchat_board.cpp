@@ -9,6 +9,7 @@
  * FEATURES:
  * - Auto-discovery: Automatically finds board IP via beacon packets
  * - Manual IP: Can also specify board IP directly
+ * - Wired: board on USB (params.serial_port), same datagrams and commands in frames on the serial port
  * 
  * DATA PACKET FORMAT (52 bytes per frame):
  * +-------------+-------------------------+--------------+
@@ -21,22 +22,70 @@
  * +-------------+-------------------------+--------------+
  * 
  * Think of a "frame" as one snapshot of all 16 channels at a single moment in time.
+ * 8-channel build (one ADS1299, VRCHAT_BOARD_8CH descriptor): 8 channels x 3 bytes, timestamp at 24-27, 28 bytes.
  * 
  * UDP DATAGRAM FORMAT:
- * [ frame_0 | frame_1 | ... | frame_n-1 | battery_voltage(float) ]
- * Total size = n*52 + 4 bytes, where 1 <= n <= 28
+ * [ header | frame_0 | frame_1 | ... | frame_n-1 | battery_voltage(float) ]
+ * Total size = 12 + n*52 + 4 bytes, where 1 <= n <= 27 (12 + n*28 + 4, n <= 51 with 8 channels)
+ * 
+ * PACKET HEADER (12 bytes, little-endian):
+ * +-------------+-------------------------------------------------------+
+ * | Offset      | Content                                               |
+ * +-------------+-------------------------------------------------------+
+ * | 0           | Format version (1)                                    |
+ * | 1           | Bits 0-3 packet type (0 = frames, 1 = compressed,     |
+ * |             | 2 = parity, 3 = features, 4 = impedance), bits 4-6    |
+ * |             | log2 of on-board decimation                           |
+ * |             | (0 = off, 4 = by 16), bit 7 backfill replay           |
+ * | 2           | Number of frames n                                    |
+ * | 3           | Bits 0-2 ADC sampling rate code, bits 3-7 filter flags|
+ * | 4-7         | Packet sequence (+1 per datagram)                     |
+ * | 8-11        | Index of first frame (counts every frame sent, i.e.   |
+ * |             | every ADC frame >> decimation)                        |
+ * +-------------+-------------------------------------------------------+
+ * 
+ * COMPRESSED DATAGRAM (packet type 1, "sys compress_on"):
+ * [ header | frame_0 (52 bytes) | 17 bit widths | bit stream | battery_voltage(float) ]
+ * Per stream (16 or 8 channels + timestamp) the bit stream holds zig-zag coded deltas of frames 1..n-1,
+ * LSB first, stream after stream, each with its stream's width. Up to 80 frames per datagram.
+ * 
+ * PARITY DATAGRAM (packet type 2, "sys fec_on"):
+ * [ header | XOR of lengths (uint16) | XOR of the group's datagrams, shorter ones zero padded ]
+ * Header byte 2 = datagrams in the group, bytes 4-7 = sequence of the first one. Parity has no sequence
+ * number of its own. Any single datagram of the group that was lost is rebuilt from it (see FEC RECOVERY).
+ * 
+ * FEATURE DATAGRAM (packet type 3, "sys features_on" / "sys features_only"):
+ * [ header | timestamp (uint32) | channels x bands float32 | battery_voltage(float) ]
+ * Band powers of every channel over the last 0.5 s, channel-major, in ADC counts^2 (mean square of the band).
+ * Header byte 2 = number of bands (1-8), bytes 8-11 = ADC frame index of the last frame in the window, the
+ * timestamp is that frame's. Same sequence numbers as frame datagrams, goes to the auxiliary preset.
+ * 
+ * IMPEDANCE DATAGRAM (packet type 4, "sys impedance_on"):
+ * [ header | timestamp (uint32) | channels float32 | battery_voltage(float) ]
+ * Electrode impedance of every channel in ohms, measured with the ADS1299 lead-off current at fs / 4 over
+ * about 1 s (2 s at 250 Hz), NaN for a channel with no excitation. Header byte 2 = lead-off current code
+ * (0-3: 6 nA, 24 nA, 6 uA, 24 uA), byte 3 = ADC sampling rate code only, bytes 8-11 = ADC frame index of the
+ * last frame of the measurement, the timestamp is that frame's. Goes to the ancillary preset.
+ * 
+ * REPLAYED DATAGRAMS (bit 7 of byte 1, "sys backfill_on"):
+ * After a Wi-Fi drop the board sends the datagrams of the drop again, unchanged but for the flag, next to
+ * the live ones. Live datagrams are held back while the replay runs, so frames still go out in order.
  * 
  * The board packs multiple frames into one network packet for efficiency.
- * Why max 28 frames? Ethernet MTU (1500) - IP header (20) - UDP header (8) = 1472 bytes
- * (1472 - 4) / 52 = 28.23, so maximum 28 complete frames per packet
+ * Why max 27 frames? Ethernet MTU (1500) - IP header (20) - UDP header (8) = 1472 bytes,
+ * and the board's WiFiUDP sends at most 1460 bytes per datagram.
+ * (1460 - 14 - 12 - 4) / 52 = 27.5, so maximum 27 complete frames per packet (14 bytes stay free for parity)
  *********************************************************************/
 
 #include "vrchat_board.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <deque>
 #include <numeric>
 #include <sstream>
 #include <mutex>
@@ -44,6 +93,7 @@
 #ifdef _WIN32
     #include <winsock2.h>
     #include <ws2tcpip.h>
+    #include <windows.h>      // COM port of the serial transport
     #pragma comment(lib, "ws2_32.lib")
 #else
     #include <sys/socket.h>
@@ -52,6 +102,8 @@
     #include <unistd.h>
     #include <fcntl.h>
     #include <errno.h>
+    #include <sys/uio.h>      // iovec for recvmmsg
+    #include <termios.h>      // tty of the serial transport
 #endif
 
 #include "brainflow_constants.h"
@@ -63,26 +115,54 @@
 // ====================================================================
 
 // ----------- Data Format Constants -----------
-constexpr int CHANNELS_PER_BOARD = 16;                                     // Number of EEG channels on the board
-constexpr int BYTES_PER_CHANNEL  = 3;                                      // Each sample is 24 bits = 3 bytes
-constexpr int CHANNEL_DATA_SIZE  = CHANNELS_PER_BOARD * BYTES_PER_CHANNEL; // Total bytes for all channels (48)
-constexpr int TIMESTAMP_SIZE     = 4;                                      // Hardware clock timestamp (32 bits = 4 bytes)
-constexpr int FRAME_SIZE         = CHANNEL_DATA_SIZE + TIMESTAMP_SIZE;     // One complete frame (52 bytes)
+// Board is built with one ADS1299 (8 channels, 28-byte frames) or two in daisy chain (16 channels, 52-byte frames),
+// firmware ADC_NUM_CHIPS. Frame layout is the same otherwise, the channel count comes from the board descriptor.
+constexpr int CHANNELS_PER_ADS1299   = 8;                                  // Channels of one ADC chip
+constexpr int MAX_CHANNELS_PER_BOARD = 2 * CHANNELS_PER_ADS1299;           // Master + slave (16)
+constexpr int BYTES_PER_CHANNEL      = 3;                                  // Each sample is 24 bits = 3 bytes
+constexpr int TIMESTAMP_SIZE         = 4;                                  // Hardware clock timestamp (32 bits = 4 bytes)
+
+// Total bytes for all channels (48 or 24) and one complete frame (52 or 28 bytes)
+constexpr int channel_data_size (int channels) { return channels * BYTES_PER_CHANNEL; }
+constexpr int frame_size (int channels) { return channel_data_size (channels) + TIMESTAMP_SIZE; }
+constexpr int MAX_FRAME_SIZE = frame_size (MAX_CHANNELS_PER_BOARD);
 
 // ----------- UDP Packet Constants -----------
 constexpr int BATTERY_SIZE = 4;                                            // Battery voltage as 32-bit floating point
 
+// Packet header at the start of every datagram (see DATA PACKET FORMAT above)
+constexpr int     PACKET_HEADER_SIZE    = 12;
+constexpr uint8_t PACKET_FORMAT_VERSION = 1;                               // The only version this driver understands
+constexpr uint8_t PACKET_TYPE_FRAMES    = 0;                               // [header][frames][battery]
+constexpr uint8_t PACKET_TYPE_DELTA     = 1;                               // [header][delta coded frames][battery]
+constexpr uint8_t PACKET_TYPE_PARITY    = 2;                               // [header][length XOR][datagram XOR]
+constexpr uint8_t PACKET_TYPE_FEATURES  = 3;                               // [header][timestamp][band powers][battery]
+constexpr uint8_t PACKET_TYPE_IMPEDANCE = 4;                               // [header][timestamp][ohms][battery]
+constexpr int     FEATURE_MAX_BANDS     = 8;                               // Bands per channel, also the row stride per channel
+
+// Forward error correction (see PARITY DATAGRAM above)
+constexpr int FEC_OVERHEAD = PACKET_HEADER_SIZE + 2;                       // Parity header + XOR of lengths
+constexpr int FEC_HISTORY  = 64;                                           // Data datagrams kept for rebuilding, 2x the biggest group
+
+// Backfill replay after Wi-Fi drops (see REPLAYED DATAGRAMS above)
+constexpr uint8_t PACKET_FLAG_REPLAY   = 0x80;                             // Header byte 1, bit 7
+constexpr int    DELIVERED_WINDOW      = 8192;                             // Sequences remembered as delivered, > board's backfill
+constexpr size_t REPLAY_HOLD_MAX       = 2048;                             // Live datagrams held back while replay runs, then give up
+constexpr double REPLAY_IDLE_SECONDS   = 1.0;                              // Replay is over if none came this long
+
+// Delta codec (see COMPRESSED DATAGRAM above), streams are the channels + timestamp
+constexpr int codec_fixed_bytes (int channels) { return frame_size (channels) + channels + 1; } // first frame + widths
+constexpr int MAX_FRAMES_PER_DATAGRAM = 255;                               // frame count is one byte in the header
+
 // Network MTU (Maximum Transmission Unit) explanation:
 // Ethernet standard specifies 1500-byte maximum frame payload. Any larger packet gets fragmented
 // (split into pieces), which hurts performance and reliability. We must subtract protocol headers:
 // - IPv4 header = 20 bytes (source/dest IP, protocol type, checksum, etc.)
 // - UDP header = 8 bytes (source/dest port, length, checksum)
-// Available for our data = 1500 - 20 - 8 = 1472 bytes
-// This is why we pack exactly 28 frames - using full capacity without fragmentation.
-constexpr int MAX_UDP_PAYLOAD = 1472;
+// Available for our data = 1500 - 20 - 8 = 1472 bytes.
+// The board's WiFiUDP sends at most 1460 bytes per datagram, that is the real limit for one packet.
+constexpr int MAX_UDP_PAYLOAD = 1460;
 
-// Maximum frames that fit in one UDP packet
-constexpr int MAX_FRAMES_PER_PACKET = (MAX_UDP_PAYLOAD - BATTERY_SIZE) / FRAME_SIZE;  // 28
 
 // Receive buffer is slightly larger than standard MTU for safety
 // 1. Protects against jumbo frames (non-standard large packets up to 9000 bytes on some LANs)
@@ -91,15 +171,70 @@ constexpr int MAX_FRAMES_PER_PACKET = (MAX_UDP_PAYLOAD - BATTERY_SIZE) / FRAME_S
 // Extra 28 bytes (1500-1472) costs nothing but prevents buffer overrun
 constexpr int RECV_BUFFER_SIZE = 1500;
 
+// ----------- Receive Pipeline -----------
+// recv_thread drains the socket into a ring of RECV_BUFFER_SIZE slots, read_thread decodes from it. 1024 slots is
+// 1.5 MB, several seconds of stream at any packing, so a slow push_package or a host hiccup only makes the ring fill up
+// instead of the kernel dropping datagrams. Kernel buffer is enlarged too for the time recv_thread itself is not scheduled.
+// Linux caps SO_RCVBUF at net.core.rmem_max (often 208 KB), the value actually granted is logged on start.
+constexpr uint32_t RX_RING_SLOTS     = 1024;                              // Power of two, index is a mask
+constexpr int RX_BATCH               = 32;                                // Datagrams per recvmmsg call
+constexpr int DATA_SOCKET_RCVBUF     = 4 * 1024 * 1024;                   // Requested kernel receive buffer, bytes
+static_assert ((RX_RING_SLOTS & (RX_RING_SLOTS - 1)) == 0, "RX_RING_SLOTS must be a power of two");
+
+// ----------- Runtime Statistics -----------
+// read_thread hands a copy of its counters to config_board("driver stats") this often, and pkt/s is over this interval
+constexpr double STATS_PUBLISH_SECONDS = 1.0;
+
+// ----------- Serial Transport (board on USB, params.serial_port) -----------
+// Both ways every datagram is one frame [USB_LINK_SYNC0][USB_LINK_SYNC1][type][length, uint16 LE][payload], see
+// usb_link.h of the firmware. Bytes outside frames are the board's debug text. A head with an unknown type or a
+// length no datagram has is taken for text, the search goes on from the byte after the sync.
+constexpr uint8_t USB_LINK_SYNC0      = 0xA5;
+constexpr uint8_t USB_LINK_SYNC1      = 0x5A;
+constexpr uint8_t USB_LINK_DATA       = 0x01;                             // Data datagram, byte for byte what UDP carries
+constexpr uint8_t USB_LINK_CTRL       = 0x02;                             // Command, reply or WOOF_WOOF
+constexpr int USB_LINK_OVERHEAD       = 5;
+constexpr int SERIAL_READ_CHUNK       = 16384;                            // Bytes per read, ~80 ms of 16 channels at 4 kHz
+constexpr int SERIAL_READ_TIMEOUT_MS  = 100;                              // How often the serial thread checks keep_serial_
+
+// ----------- Board Clock Model -----------
+// Board timestamps are getTimer8us(): 32-bit, 8 us per tick, wrap every 2^32 * 8 us = ~9.5 hours.
+// Crystal drift vs PC is tens of ppm (up to ~0.2 s per hour), it's tracked by ClockModel.
+constexpr double CLOCK_TICK_SECONDS     = 0.000008;
+constexpr double CLOCK_WINDOW_SECONDS   = 4.0;                            // One fit point (offset minimum) per window
+constexpr double CLOCK_MIN_FIT_SPAN     = 20.0;                           // Shorter history gives offset only, no drift
+constexpr double CLOCK_JUMP_SECONDS     = 0.5;                            // Arriving this much "before" it was sent = board clock changed
+constexpr int32_t CLOCK_REORDER_TICKS   = 125000;                         // 1 s, steps back up to this are late packets
+
 // ----------- Timing Constants -----------
 constexpr int KEEPALIVE_INTERVAL_SEC    = 5;                              // Board timeout prevention
 constexpr int DEFAULT_DISCOVERY_TIMEOUT_MS = 3000;                        // Board beacon wait time
+constexpr int PROBE_RETRY_MS            = 250;                            // Probe again while nobody answered
+constexpr int DISCOVERY_COLLECT_MS      = 150;                            // After the first reply, wait for other boards
 constexpr int CONTROL_SOCKET_TIMEOUT_MS = 1000;                           // Command response timeout
+constexpr int DATA_SOCKET_TIMEOUT_MS    = 100;                            // How often idle stream threads check keep_alive_
 
 // ----------- Network Port Defaults -----------
 constexpr int DEFAULT_DATA_PORT    = 5001;                                // High-speed EEG data
 constexpr int DEFAULT_CONTROL_PORT = 5000;                                // Commands and beacons
 
+// ----------- Discovery and Keep-alive Words (see src/defines.h of the firmware) -----------
+constexpr char BOARD_BEACON[]  = "MEOW_MEOW";                             // Board broadcasts while it has no PC
+constexpr char PROBE_WORD[]    = "MEOW_PROBE";                            // PC broadcast, every board answers at once
+constexpr char PROBE_REPLY[]   = "MEOW_HERE";                             // ... with its ID and stream config
+constexpr char KEEPALIVE_WORD[] = "WOOF_WOOF";                            // Claims the board for this PC, keeps it
+constexpr int FW_BROADCAST_COMMANDS = 6;                                  // Boards take a broadcast command from their PC only
+
+// ----------- Aggregate Session (other_info "boards=") -----------
+// Every board is decoded by its own VrchatBoard (one of these descriptors), rows of all of them are lined up on the
+// first board's timeline. A board that stopped sending is waited for ALIGN_MAX_WAIT_SECONDS at most, then its
+// last values are held, so one dead board doesn't stop the others.
+constexpr int VRCHAT_BOARD_ID          = 65;                              // BoardIds::VRCHAT_BOARD, 16 channels
+constexpr int VRCHAT_BOARD_8CH_ID      = 66;                              // BoardIds::VRCHAT_BOARD_8CH
+constexpr int ADC_BASE_RATE_HZ         = 250;                             // Header byte 3 rate code 0, each code doubles it
+constexpr double ALIGN_MAX_WAIT_SECONDS = 0.5;                            // Rows of the first board held back at most this long
+constexpr size_t ALIGN_MAX_QUEUE       = 8192;                            // Frames queued per board, 2 s at 4 kHz
+
 // ----------- ADS1299 Scaling -----------
 // The ADS1299 is the chip that measures brain signals. It converts analog voltages to digital numbers.
 // Per ADS1299 datasheet: input range is +/-4.5V (4.5V comes from the chip's reference voltage specification).
@@ -109,6 +244,513 @@ constexpr int DEFAULT_CONTROL_PORT = 5000;                                // Com
 constexpr double ADS1299_SCALE = 4.5 / double(1 << 23);
 
 
+// ====================================================================
+//                        DELTA DECODER
+// ====================================================================
+
+// Decodes a PACKET_TYPE_DELTA payload back into num_frames plain frames of CH channels, exactly what the board had
+// before coding. Returns false if the payload is shorter or longer than the widths say (corrupted or not a delta packet).
+template <int CH>
+static bool decode_delta_frames (const uint8_t *payload, int payload_size, int num_frames, uint8_t *frames_out)
+{
+    constexpr int CHANNEL_DATA_SIZE = channel_data_size (CH);
+    constexpr int FRAME_SIZE        = frame_size (CH);
+    constexpr int CODEC_NUM_STREAMS = CH + 1;
+    constexpr int CODEC_FIXED_BYTES = codec_fixed_bytes (CH);
+
+    if ((num_frames < 1) || (payload_size < CODEC_FIXED_BYTES))
+    {
+        return false;
+    }
+
+    const uint8_t *widths = payload + FRAME_SIZE;
+    long total_bits = 0;
+    for (int s = 0; s < CODEC_NUM_STREAMS; ++s)
+    {
+        if (widths[s] > 32)
+        {
+            return false;
+        }
+        total_bits += (long)widths[s] * (num_frames - 1);
+    }
+    if (payload_size != CODEC_FIXED_BYTES + (int)((total_bits + 7) / 8))
+    {
+        return false;
+    }
+
+    // Frame 0 is sent as is
+    memcpy (frames_out, payload, FRAME_SIZE);
+
+    const uint8_t *src = payload + CODEC_FIXED_BYTES;
+    uint64_t acc = 0;  // bits read but not used yet, LSB first
+    int nbits = 0;
+    for (int s = 0; s < CODEC_NUM_STREAMS; ++s)
+    {
+        const int w = widths[s];
+        const uint64_t mask = (w == 32) ? 0xFFFFFFFFull : ((1ull << w) - 1);
+
+        // Previous value of this stream, channels sign-extended from 24 bits, timestamp as is
+        uint32_t prev;
+        if (s < CH)
+        {
+            const uint8_t *b = payload + s * BYTES_PER_CHANNEL;
+            prev = (uint32_t)((int32_t)(((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8)) >> 8);
+        }
+        else
+        {
+            memcpy (&prev, payload + CHANNEL_DATA_SIZE, sizeof (uint32_t));
+        }
+
+        for (int f = 1; f < num_frames; ++f)
+        {
+            uint32_t z = 0;
+            if (w > 0)
+            {
+                while (nbits < w)
+                {
+                    acc |= (uint64_t)(*src++) << nbits;
+                    nbits += 8;
+                }
+                z = (uint32_t)(acc & mask);
+                acc >>= w;
+                nbits -= w;
+            }
+
+            // Undo zig-zag, then the delta
+            prev += (z >> 1) ^ (0u - (z & 1u));
+
+            uint8_t *frame = frames_out + f * FRAME_SIZE;
+            if (s < CH)
+            {
+                frame[s * BYTES_PER_CHANNEL]     = (uint8_t)(prev >> 16);
+                frame[s * BYTES_PER_CHANNEL + 1] = (uint8_t)(prev >> 8);
+                frame[s * BYTES_PER_CHANNEL + 2] = (uint8_t)prev;
+            }
+            else
+            {
+                memcpy (frame + CHANNEL_DATA_SIZE, &prev, sizeof (uint32_t));
+            }
+        }
+    }
+    return true;
+}
+
+
+// ====================================================================
+//                        BATCHED SAMPLE DECODE
+// ====================================================================
+
+// Converts the channel data of num_frames plain frames of CH channels into volts, channel after channel inside a frame:
+// samples_out[frame * CH + channel]. Whole datagram in one pass, fixed trip count and no branches
+// in the inner loop, so the compiler unrolls it and vectorizes the int -> double conversion and scaling.
+// 24-bit big-endian: byte 0 is the MSB. Putting the 3 bytes into the top of a 32-bit word and shifting back
+// arithmetically sign-extends without any if.
+template <int CH>
+static void decode_samples (const uint8_t *frames, int num_frames, double *samples_out)
+{
+    for (int f = 0; f < num_frames; ++f)
+    {
+        const uint8_t *b = frames + f * frame_size (CH);
+        double *out = samples_out + f * CH;
+        for (int ch = 0; ch < CH; ++ch)
+        {
+            const uint32_t raw = ((uint32_t)b[ch * BYTES_PER_CHANNEL] << 24) |
+                                 ((uint32_t)b[ch * BYTES_PER_CHANNEL + 1] << 16) |
+                                 ((uint32_t)b[ch * BYTES_PER_CHANNEL + 2] << 8);
+            out[ch] = (double)((int32_t)raw >> 8) * ADS1299_SCALE;
+        }
+    }
+}
+
+
+// ====================================================================
+//                        FEC RECOVERY
+// ====================================================================
+// read_thread keeps the last FEC_HISTORY valid data datagrams as they came off the network, slot = sequence % FEC_HISTORY.
+// A parity datagram XORed with every datagram of its group that did arrive gives back the one that didn't.
+// Only one per group can be rebuilt, two or more missing are lost for good.
+
+struct FecHistory
+{
+    std::vector<uint32_t> seq;
+    std::vector<int> size;                                                 // 0 = empty slot
+    std::vector<uint8_t> data;
+
+    FecHistory () : seq (FEC_HISTORY, 0), size (FEC_HISTORY, 0), data ((size_t)FEC_HISTORY * RECV_BUFFER_SIZE) {}
+
+    bool has (uint32_t packet_seq) const
+    {
+        const uint32_t idx = packet_seq % FEC_HISTORY;
+        return (size[idx] > 0) && (seq[idx] == packet_seq);
+    }
+
+    const uint8_t *get (uint32_t packet_seq) const
+    {
+        return &data[(size_t)(packet_seq % FEC_HISTORY) * RECV_BUFFER_SIZE];
+    }
+
+    void store (uint32_t packet_seq, const uint8_t *datagram, int datagram_size)
+    {
+        const uint32_t idx = packet_seq % FEC_HISTORY;
+        seq[idx] = packet_seq;
+        size[idx] = datagram_size;
+        memcpy (&data[(size_t)idx * RECV_BUFFER_SIZE], datagram, datagram_size);
+    }
+};
+
+// Rebuild the missing datagram of a parity's group into datagram_out (RECV_BUFFER_SIZE bytes).
+// Returns its size, 0 if nothing is missing, -1 if it can't be done: missing > 1 (too many lost) or the parity
+// doesn't match what was received (missing == 1, or 0 for a malformed parity).
+static int fec_rebuild (const uint8_t *parity, int parity_size, const FecHistory &history, uint8_t *datagram_out,
+                        int &missing)
+{
+    const int group = parity[2];
+    const int body_size = parity_size - FEC_OVERHEAD;
+    uint32_t first_seq;
+    memcpy (&first_seq, &parity[4], sizeof (uint32_t));
+
+    missing = 0;
+    if ((group < 1) || (group > FEC_HISTORY / 2) || (body_size <= 0) || (body_size > RECV_BUFFER_SIZE))
+    {
+        return -1;
+    }
+
+    uint32_t missing_seq = 0;
+    for (int i = 0; i < group; ++i)
+    {
+        if (!history.has (first_seq + i))
+        {
+            ++missing;
+            missing_seq = first_seq + i;
+        }
+    }
+    if (missing != 1)
+    {
+        return (missing == 0) ? 0 : -1;
+    }
+
+    uint16_t length;
+    memcpy (&length, &parity[PACKET_HEADER_SIZE], sizeof (uint16_t));
+    memcpy (datagram_out, parity + FEC_OVERHEAD, body_size);
+    for (int i = 0; i < group; ++i)
+    {
+        const uint32_t packet_seq = first_seq + i;
+        if (packet_seq == missing_seq) continue;
+
+        const int size = history.size[packet_seq % FEC_HISTORY];
+        if (size > body_size) return -1;
+        const uint8_t *received = history.get (packet_seq);
+        for (int b = 0; b < size; ++b)
+        {
+            datagram_out[b] ^= received[b];
+        }
+        length ^= (uint16_t)size;
+    }
+
+    // Rebuilt header must be the one of the datagram we miss, otherwise something in the group was not what the board sent
+    uint32_t rebuilt_seq;
+    memcpy (&rebuilt_seq, &datagram_out[4], sizeof (uint32_t));
+    if ((length < PACKET_HEADER_SIZE) || (length > body_size) ||
+        (datagram_out[0] != PACKET_FORMAT_VERSION) || (rebuilt_seq != missing_seq))
+    {
+        return -1;
+    }
+    return length;
+}
+
+// ====================================================================
+//                        BACKFILL REPLAY
+// ====================================================================
+// After a Wi-Fi drop the board sends its stored datagrams again from a bit before the drop, so some of them
+// were delivered already and some fill the hole. read_thread remembers the last DELIVERED_WINDOW sequences it
+// pushed to BrainFlow, slot = sequence % DELIVERED_WINDOW, and that decides which replayed datagram is new.
+
+struct DeliveredSeqs
+{
+    std::vector<uint32_t> seq;
+
+    DeliveredSeqs () : seq (DELIVERED_WINDOW)
+    {
+        for (int i = 0; i < DELIVERED_WINDOW; ++i) seq[i] = (uint32_t)i + 1; // Never equal to a sequence of its slot
+    }
+
+    bool has (uint32_t packet_seq) const { return seq[packet_seq % DELIVERED_WINDOW] == packet_seq; }
+    void mark (uint32_t packet_seq) { seq[packet_seq % DELIVERED_WINDOW] = packet_seq; }
+};
+
+// One live datagram held back while the replay of a Wi-Fi drop is coming in
+struct HeldDatagram
+{
+    std::vector<uint8_t> data;
+    double arrival;
+};
+
+// ====================================================================
+//                        BOARD CLOCK MODEL
+// ====================================================================
+// See ClockModel in vrchat_board.h. Everything is in seconds, board times on the unwrapped 64-bit timeline.
+
+// Out-of-class definition, C++11 needs it once the constant is bound to a reference (std::min below)
+constexpr int ClockModel::CLOCK_MAX_POINTS;
+
+void ClockModel::reset ()
+{
+    *this = ClockModel ();
+}
+
+void ClockModel::restart_fit ()
+{
+    num_points = 0;
+    next_point = 0;
+    window_packets = 0;
+    fit_span = 0.0;
+    drift = 0.0;
+    residual_rms = 0.0;
+}
+
+int64_t ClockModel::unwrap (uint32_t ticks, double arrival)
+{
+    if (!started)
+    {
+        started = true;
+        last_ticks = ticks;
+        last_ticks64 = ticks;
+        last_arrival = arrival;
+        return last_ticks64;
+    }
+
+    // Small step back is a reordered packet, the newest packet stays the reference
+    const int32_t step = (int32_t)(ticks - last_ticks);
+    if ((step <= 0) && (step >= -CLOCK_REORDER_TICKS))
+    {
+        return last_ticks64 + step;
+    }
+
+    // Anything else moves forward, over the wrap if raw value went down
+    int64_t forward = (int64_t)(uint32_t)(ticks - last_ticks);
+    if (step < 0)
+    {
+        // More than half a wrap period forward, or board clock restarted (reboot). PC time tells which.
+        const double elapsed_ticks = (arrival - last_arrival) / CLOCK_TICK_SECONDS;
+        if (elapsed_ticks < 2147483648.0)
+        {
+            // Restarted - keep the timeline going with PC time and fit from scratch
+            ++resets;
+            restart_fit ();
+            last_ticks = ticks;
+            last_ticks64 += std::max<int64_t> ((int64_t)elapsed_ticks, 1);
+            last_arrival = arrival;
+            return last_ticks64;
+        }
+
+        // Stream was paused for hours, add the wraps that happened meanwhile
+        forward += (int64_t)std::llround ((elapsed_ticks - (double)forward) / 4294967296.0) * 4294967296LL;
+    }
+    wraps += (unsigned long)(((uint64_t)last_ticks + (uint64_t)forward) >> 32);
+
+    last_ticks = ticks;
+    last_ticks64 += forward;
+    last_arrival = arrival;
+    return last_ticks64;
+}
+
+void ClockModel::update (double hw_seconds, double arrival)
+{
+    // Packet apparently arrived before it was sent - the fit started inside a long Wi-Fi stall (every packet
+    // of the first windows late), or the board clock jumped forward. Nothing learned so far applies anymore.
+    if ((num_points > 0) && (arrival - to_pc (hw_seconds) < -CLOCK_JUMP_SECONDS))
+    {
+        restart_fit ();
+    }
+
+    const double packet_offset = arrival - hw_seconds;
+    if (window_packets == 0)
+    {
+        window_start = hw_seconds;
+        window_min_offset = packet_offset;
+        window_min_hw = hw_seconds;
+        window_delay_sum = 0.0;
+        window_delay_sq = 0.0;
+    }
+    else if (packet_offset < window_min_offset)
+    {
+        window_min_offset = packet_offset;
+        window_min_hw = hw_seconds;
+    }
+    ++window_packets;
+
+    if (num_points == 0)
+    {
+        // Nothing fitted yet, running minimum of this first window
+        offset = window_min_offset;
+        ref = window_min_hw;
+    }
+    else
+    {
+        const double delay = arrival - to_pc (hw_seconds);
+        window_delay_sum += delay;
+        window_delay_sq += delay * delay;
+    }
+
+    if (hw_seconds - window_start >= CLOCK_WINDOW_SECONDS)
+    {
+        if (num_points > 0)
+        {
+            delay_mean = window_delay_sum / window_packets;
+            jitter = std::sqrt (std::max (0.0, window_delay_sq / window_packets - delay_mean * delay_mean));
+        }
+        point_hw[next_point] = window_min_hw;
+        point_offset[next_point] = window_min_offset;
+        next_point = (next_point + 1) % CLOCK_MAX_POINTS;
+        num_points = std::min (num_points + 1, CLOCK_MAX_POINTS);
+        window_packets = 0;
+        fit ();
+    }
+}
+
+void ClockModel::fit ()
+{
+    /*
+     * Least squares line through the window minima. Offsets are ~1.7e9 s (UNIX time), they are taken relative
+     * to the first point so the sums keep microseconds. A window where every packet was stuck in a Wi-Fi stall
+     * has a minimum far above the line - second pass drops points more than 3 sigma (at least 1 ms) above it.
+     */
+    const double base = point_offset[0];
+    bool use[CLOCK_MAX_POINTS];
+    std::fill (use, use + num_points, true);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        int n = 0;
+        double mean_hw = 0.0, mean_off = 0.0, min_hw = 0.0, max_hw = 0.0;
+        for (int i = 0; i < num_points; ++i)
+        {
+            if (!use[i]) continue;
+            if ((n == 0) || (point_hw[i] < min_hw)) min_hw = point_hw[i];
+            if ((n == 0) || (point_hw[i] > max_hw)) max_hw = point_hw[i];
+            mean_hw += point_hw[i];
+            mean_off += point_offset[i] - base;
+            ++n;
+        }
+        mean_hw /= n;
+        mean_off /= n;
+
+        double sxx = 0.0, sxy = 0.0;
+        for (int i = 0; i < num_points; ++i)
+        {
+            if (!use[i]) continue;
+            const double dx = point_hw[i] - mean_hw;
+            sxx += dx * dx;
+            sxy += dx * (point_offset[i] - base - mean_off);
+        }
+
+        fit_span = max_hw - min_hw;
+        ref = mean_hw;
+        offset = base + mean_off;
+        drift = ((fit_span >= CLOCK_MIN_FIT_SPAN) && (sxx > 0.0)) ? (sxy / sxx) : 0.0;
+
+        double sq = 0.0;
+        for (int i = 0; i < num_points; ++i)
+        {
+            if (!use[i]) continue;
+            const double r = point_offset[i] - (offset + drift * (point_hw[i] - ref));
+            sq += r * r;
+        }
+        residual_rms = std::sqrt (sq / n);
+
+        if (pass == 0)
+        {
+            const double limit = std::max (3.0 * residual_rms, 0.001);
+            bool dropped = false;
+            for (int i = 0; i < num_points; ++i)
+            {
+                if (point_offset[i] - (offset + drift * (point_hw[i] - ref)) > limit)
+                {
+                    use[i] = false;
+                    dropped = true;
+                }
+            }
+            if (!dropped || (std::count (use, use + num_points, true) < 2)) break;
+        }
+    }
+}
+
+std::string ClockModel::describe () const
+{
+    if (!started)
+    {
+        return "clock: no data yet";
+    }
+
+    char text[320];
+    snprintf (text, sizeof (text),
+        "clock: drift %+.2f ppm%s, offset %.6f s, %d windows over %.0f s, fit residual %.3f ms, "
+        "delay %.3f ms, jitter %.3f ms, %lu wraps, %lu resets",
+        drift * 1e6, (fit_span >= CLOCK_MIN_FIT_SPAN) ? "" : " (needs more data)", offset, num_points, fit_span,
+        residual_rms * 1e3, delay_mean * 1e3, jitter * 1e3, wraps, resets);
+    return text;
+}
+
+// ====================================================================
+//                        STREAM STATISTICS
+// ====================================================================
+
+void StreamStats::add_latency (double seconds)
+{
+    const double us = seconds * 1e6;
+    const int bin = (us <= 1.0) ? 0 : std::min ((int)(8.0 * std::log2 (us)), LATENCY_BINS - 1);
+    ++latency[bin];
+    ++latency_count;
+    latency_max = std::max (latency_max, seconds);
+}
+
+// Upper edge of the bin the fraction falls into, seconds, never above the largest latency seen
+double StreamStats::latency_percentile (double fraction) const
+{
+    const double target = fraction * (double)latency_count;
+    unsigned long sum = 0;
+    for (int bin = 0; bin < LATENCY_BINS; ++bin)
+    {
+        sum += latency[bin];
+        if ((double)sum >= target)
+        {
+            return std::min (std::exp2 ((bin + 1) / 8.0) * 1e-6, latency_max);
+        }
+    }
+    return latency_max;
+}
+
+std::string StreamStats::describe () const
+{
+    if (!started)
+    {
+        return "stats: no stream yet";
+    }
+
+    char text[768];
+    snprintf (text, sizeof (text),
+        "stats: %.1f s, %lu received, %lu decoded, %lu invalid, %lu lost, %lu reordered, %lu duplicates, "
+        "%lu frames dropped by board, %lu recovered by FEC, %lu lost beyond FEC, %lu replayed (%lu known), "
+        "%lu frames, %lu feature sets, %lu impedance sets, %.1f pkt/s, latency p50 %.3f p90 %.3f p99 %.3f p99.9 %.3f max %.3f ms, "
+        "decode %.1f us avg %.1f us max, ring hwm %u/%u slots, ring full %lu time(s), socket read hwm %u/%d",
+        update_time - start_time, received, decoded, bad, lost, reordered, duplicates, board_drop_frames,
+        fec_recovered, fec_unrecoverable, replayed, replay_known, frames, features, impedance, packet_rate,
+        latency_percentile (0.5) * 1e3, latency_percentile (0.9) * 1e3, latency_percentile (0.99) * 1e3,
+        latency_percentile (0.999) * 1e3, latency_max * 1e3,
+        latency_count ? decode_sum / latency_count * 1e6 : 0.0, decode_max * 1e6,
+        (unsigned)ring_hwm, (unsigned)RX_RING_SLOTS, ring_full, (unsigned)batch_hwm, RX_BATCH);
+    return text;
+}
+
+// Raise a high-water mark, one writer per mark
+static void raise_hwm (std::atomic<uint32_t> &hwm, uint32_t value)
+{
+    if (value > hwm.load (std::memory_order_relaxed)) hwm.store (value, std::memory_order_relaxed);
+}
+
+// Value of "key=value" in a MEOW_HERE reply (HELPER FUNCTIONS below)
+static std::string reply_field (const std::string &reply, const std::string &key);
+
 // ====================================================================
 //                        CONSTRUCTOR / DESTRUCTOR
 // ====================================================================
@@ -143,93 +785,127 @@ int VrchatBoard::prepare_session ()
         return (int)BrainFlowExitCodes::STATUS_OK;
     }
 
+    // ----------- Channel Count -----------
+    // 8 EEG rows in the descriptor - single ADS1299 build, 28-byte frames. Anything else is the 16 channel board
+    board_channels_ = MAX_CHANNELS_PER_BOARD;
+    try
+    {
+        if (!board_descr.empty () &&
+            (board_descr["default"]["eeg_channels"].size () == (size_t)CHANNELS_PER_ADS1299))
+        {
+            board_channels_ = CHANNELS_PER_ADS1299;
+        }
+    }
+    catch (...)
+    {
+        // Keep 16, read_thread logs the broken descriptor
+    }
+
+    // ----------- Board on USB - serial port instead of sockets and discovery -----------
+    if (!params.serial_port.empty ())
+    {
+        return prepare_serial ();
+    }
+
     // ----------- Create Data Socket (for receiving EEG data) -----------
     // This socket RECEIVES high-speed UDP packets from the board. We "bind" it to a specific port number,
     // which is like telling the operating system "any data arriving on port 5001 should come to me".
-    data_srv_ = new SocketServerUDP (data_port_);
-    
-    // Attempt to bind the data socket
-    int bind_result = data_srv_->bind ();
-    if (bind_result != (int)SocketServerUDPReturnCodes::STATUS_OK)
+    int open_result = open_data_socket ();
+    if (open_result != (int)BrainFlowExitCodes::STATUS_OK)
     {
-        safe_logger (spdlog::level::err, "Failed to bind data port {} - port may be in use", data_port_);
-        delete data_srv_;
-        data_srv_ = nullptr;
-        return (int)BrainFlowExitCodes::UNABLE_TO_OPEN_PORT_ERROR;
+        return open_result;
     }
 
     // ----------- Handle Board IP Discovery or Direct Connection -----------
     // If no IP provided, use auto-discovery via beacon. If IP provided, connect directly.
     
     std::string board_ip = params.ip_address;
+
+    // Wait for board beacon (configurable timeout)
+    int timeout_ms = DEFAULT_DISCOVERY_TIMEOUT_MS;
     
-    if (board_ip.empty ())
+    // Check if custom timeout specified in other_info
+    size_t timeout_pos = params.other_info.find("discovery_timeout=");
+    if (timeout_pos != std::string::npos)
     {
-        // Wait for board beacon (configurable timeout)
-        int timeout_ms = DEFAULT_DISCOVERY_TIMEOUT_MS;
-        
-        // Check if custom timeout specified in other_info
-        size_t timeout_pos = params.other_info.find("discovery_timeout=");
-        if (timeout_pos != std::string::npos)
+        try
         {
-            try
-            {
-                timeout_ms = std::stoi(params.other_info.substr(timeout_pos + 18));
-            }
-            catch (...)
-            {
-                // Keep default timeout if parsing fails (e.g., "discovery_timeout=abc" or overflow).
-                // This ensures discovery still works even with malformed config strings.
-            }
+            timeout_ms = std::stoi(params.other_info.substr(timeout_pos + 18));
+        }
+        catch (...)
+        {
+            // Keep default timeout if parsing fails (e.g., "discovery_timeout=abc" or overflow).
+            // This ensures discovery still works even with malformed config strings.
+        }
+    }
+
+    // Several boards as one session - always discovered, commands go to each board's own IP
+    size_t boards_pos = params.other_info.find ("boards=");
+    sync_start_ = (params.other_info.find ("sync_start=0") == std::string::npos);
+    if (boards_pos != std::string::npos)
+    {
+        std::string boards = params.other_info.substr (boards_pos + 7);
+        boards = boards.substr (0, boards.find (' '));
+        const int aggregate_result = prepare_aggregate (timeout_ms, boards);
+        if (aggregate_result != (int)BrainFlowExitCodes::STATUS_OK)
+        {
+            close_sockets ();
+            return aggregate_result;
+        }
+        board_ip.clear ();
+    }
+    else if (board_ip.empty ())
+    {
+        // Several boards on the network - pick by MAC
+        std::string board_id;
+        size_t id_pos = params.other_info.find ("board_id=");
+        if (id_pos != std::string::npos)
+        {
+            board_id = params.other_info.substr (id_pos + 9);
+            board_id = board_id.substr (0, board_id.find (' '));
         }
         
-        bool discovered = wait_for_beacon (timeout_ms);
+        bool discovered = wait_for_beacon (timeout_ms, board_id);
         
         if (!discovered)
         {
             safe_logger (spdlog::level::err, "Failed to discover board - no beacon received within {}ms", timeout_ms);
             
             // Cleanup
-            data_srv_->close ();
-            delete data_srv_;
-            data_srv_ = nullptr;
+            close_sockets ();
             
             return (int)BrainFlowExitCodes::BOARD_NOT_READY_ERROR;
         }
         
         board_ip = discovered_ip_;
         safe_logger (spdlog::level::info, "Board discovered at IP: {}", board_ip);
+
+        // Channel count of the firmware (ch= in MEOW_HERE, fw 5+) must match the descriptor, frames differ in size.
+        // Beacon-only and older boards don't say, they are 16 channel ones
+        for (const DiscoveredBoard &b : discovered_boards_)
+        {
+            const std::string ch = reply_field (b.info, "ch");
+            if ((b.ip == board_ip) && !ch.empty () && (ch != std::to_string (board_channels_)))
+            {
+                safe_logger (spdlog::level::err,
+                    "Board {} has {} channels, session was opened for {} - use the matching board id", b.id, ch,
+                    board_channels_);
+                close_sockets ();
+                return (int)BrainFlowExitCodes::INVALID_ARGUMENTS_ERROR;
+            }
+        }
     }
 
     // ----------- Create Control Socket (for sending/receiving commands) -----------
-    // We use raw UDP socket instead of SocketServerUDP because we need sendto() functionality
-    // to send commands to specific IP addresses (board IP). SocketServerUDP is receive-only.
+    // Raw UDP socket, we need sendto() to send commands to a specific IP address (board IP).
+    // Winsock is already initialized by open_data_socket().
     
-    // Initialize platform-specific socket support if needed
-#ifdef _WIN32
-    if (!wsa_initialized_)
-    {
-        WSADATA wsaData;
-        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
-        {
-            safe_logger (spdlog::level::err, "Failed to initialize Winsock");
-            data_srv_->close ();
-            delete data_srv_;
-            data_srv_ = nullptr;
-            return (int)BrainFlowExitCodes::GENERAL_ERROR;
-        }
-        wsa_initialized_ = true;
-    }
-#endif
-    
-    // Create raw UDP socket for control
-    ctrl_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (ctrl_socket_ < 0)
+    // Create raw UDP socket for control
+    ctrl_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (ctrl_socket_ < 0)
     {
         safe_logger (spdlog::level::err, "Failed to create control socket");
-        data_srv_->close ();
-        delete data_srv_;
-        data_srv_ = nullptr;
+        close_sockets ();
         return (int)BrainFlowExitCodes::GENERAL_ERROR;
     }
     
@@ -260,9 +936,7 @@ int VrchatBoard::prepare_session ()
         close(ctrl_socket_);
 #endif
         ctrl_socket_ = -1;
-        data_srv_->close ();
-        delete data_srv_;
-        data_srv_ = nullptr;
+        close_sockets ();
         return (int)BrainFlowExitCodes::UNABLE_TO_OPEN_PORT_ERROR;
     }
     
@@ -281,6 +955,10 @@ int VrchatBoard::prepare_session ()
     // Store the board IP for sending commands
     board_ip_ = board_ip;
 
+    // First WOOF_WOOF right here, not from the thread - the board drops commands until it heard one, so
+    // config_board() right after prepare_session() would race it
+    send_keepalive ();
+
     // Set floof ping flag
     keep_floof_ = true;
 
@@ -333,6 +1011,11 @@ std::string VrchatBoard::get_discovered_ip () const
     return discovered_ip_;
 }
 
+std::vector<DiscoveredBoard> VrchatBoard::get_discovered_boards () const
+{
+    return discovered_boards_;
+}
+
 int VrchatBoard::start_stream (int buffer_size, const char *streamer_params)
 {
     // Validate preconditions
@@ -356,6 +1039,74 @@ int VrchatBoard::start_stream (int buffer_size, const char *streamer_params)
         return result;
     }
 
+    // Aggregate session - queues, rings and threads of every board, boards start together
+    if (!members_.empty ())
+    {
+        {
+            std::lock_guard<std::mutex> lock (align_mutex_);
+            for (AggregateMember &m : members_)
+            {
+                m.frames.clear ();
+                m.period = 0.0;
+                m.last = AlignedFrame {};
+                m.used = m.held = m.skipped = 0;
+            }
+            std::fill (align_row_.begin (), align_row_.end (), 0.0);
+            align_rows_ = 0;
+        }
+
+        if (start_aggregate () != (int)BrainFlowExitCodes::STATUS_OK)
+        {
+            safe_logger (spdlog::level::err, "Failed to start continuous mode on every board");
+        }
+
+        keep_alive_ = true;
+        for (AggregateMember &m : members_)
+        {
+            VrchatBoard &b = *m.board;
+            b.rx_data_.resize ((size_t)RX_RING_SLOTS * RECV_BUFFER_SIZE);
+            b.rx_size_.resize (RX_RING_SLOTS);
+            b.rx_time_.resize (RX_RING_SLOTS);
+            b.rx_head_ = 0;
+            b.rx_tail_ = 0;
+            b.rx_ring_full_ = 0;
+            b.rx_ring_hwm_ = 0;
+            b.rx_batch_hwm_ = 0;
+            b.keep_alive_ = true;
+            b.read_th_ = std::thread (&VrchatBoard::read_thread, &b);
+        }
+        recv_th_ = std::thread (&VrchatBoard::aggregate_recv_thread, this);
+
+        streaming_ = true;
+        safe_logger (spdlog::level::info, "Stream of {} boards started successfully", members_.size ());
+        return (int)BrainFlowExitCodes::STATUS_OK;
+    }
+
+    // Empty receive ring, allocated once and reused by every stream. Under rx_wait_mutex_: with the board on USB
+    // serial_thread runs all session long and only fills the ring under it while keep_alive_ is set
+    {
+        std::lock_guard<std::mutex> lock (rx_wait_mutex_);
+        rx_data_.resize ((size_t)RX_RING_SLOTS * RECV_BUFFER_SIZE);
+        rx_size_.resize (RX_RING_SLOTS);
+        rx_time_.resize (RX_RING_SLOTS);
+        rx_head_ = 0;
+        rx_tail_ = 0;
+        rx_ring_full_ = 0;
+        rx_ring_hwm_ = 0;
+        rx_batch_hwm_ = 0;
+
+        // Set thread control flag, the threads are ready before the first datagram
+        keep_alive_ = true;
+    }
+
+    // Launch data threads - one only drains the socket, the other decodes and pushes to BrainFlow.
+    // Board on USB - serial_thread drains the port already
+    if (serial_ < 0)
+    {
+        recv_th_ = std::thread (&VrchatBoard::recv_thread, this);
+    }
+    read_th_ = std::thread (&VrchatBoard::read_thread, this);
+
     // Send command to start continuous data transmission
     std::string response;
     int cmd_result = config_board("sys start_cnt", response);
@@ -365,12 +1116,6 @@ int VrchatBoard::start_stream (int buffer_size, const char *streamer_params)
         // Optionally return error, or continue anyway
         // return cmd_result;
     }
-
-    // Set thread control flag and launch worker threads
-    keep_alive_ = true;
-    
-    // Launch data reception thread - this receives and processes EEG packets
-    read_th_ = std::thread (&VrchatBoard::read_thread, this);
     
     // Mark streaming as active
     streaming_ = true;
@@ -398,16 +1143,41 @@ int VrchatBoard::stop_stream ()
         // Continue with thread cleanup anyway
     }
     
-    // Signal threads to stop
+    // Signal threads to stop, wake read thread if it sleeps on an empty ring
     keep_alive_ = false;
+    {
+        std::lock_guard<std::mutex> lock (rx_wait_mutex_);
+    }
+    rx_wait_cv_.notify_all ();
     
     // Wait for threads to finish
     // joinable() check prevents exception if thread was never started (e.g., start_stream failed early)
-    // Note: read thread may take up to SocketServerUDP's internal timeout to notice keep_alive_ change
+    // Note: recv thread may take up to DATA_SOCKET_TIMEOUT_MS to notice keep_alive_ change
+    if (recv_th_.joinable ())
+    {
+        recv_th_.join ();
+    }
     if (read_th_.joinable ())
     {
         read_th_.join ();
     }
+
+    // Aggregate session - read threads of the boards, they may still be pushing their last frames
+    for (AggregateMember &m : members_)
+    {
+        VrchatBoard &b = *m.board;
+        b.keep_alive_ = false;
+        {
+            std::lock_guard<std::mutex> lock (b.rx_wait_mutex_);
+        }
+        b.rx_wait_cv_.notify_all ();
+        if (b.read_th_.joinable ())
+        {
+            b.read_th_.join ();
+        }
+        safe_logger (spdlog::level::info, "Board {}: {} frames used, {} held, {} skipped while aligning",
+            m.id, m.used, m.held, m.skipped);
+    }
     
     // Clear streaming flag
     streaming_ = false;
@@ -434,6 +1204,14 @@ int VrchatBoard::release_session ()
     {
         ping_th_.join ();
     }
+
+    // Serial reader of a board on USB, notices within SERIAL_READ_TIMEOUT_MS
+    keep_serial_ = false;
+    if (serial_th_.joinable ())
+    {
+        serial_th_.join ();
+        safe_logger (spdlog::level::info, "Serial port closed, {} frame heads skipped as text", serial_resyncs_);
+    }
     
     // Close all sockets and free resources
     close_sockets ();
@@ -444,12 +1222,19 @@ int VrchatBoard::release_session ()
     // Clear discovered IP
     discovered_ip_.clear();
     board_ip_.clear();
+    members_.clear ();
     
     // Reset timestamp alignment
-    first_packet_received_ = false;
-    timestamp_offset_ = 0.0;
+    {
+        std::lock_guard<std::mutex> lock (clock_mutex_);
+        clock_.reset ();
+    }
     
-    safe_logger (spdlog::level::info, "Session released");
+    // Boards of an aggregate session go quietly, the session logs for them
+    if (aggregate_ == nullptr)
+    {
+        safe_logger (spdlog::level::info, "Session released");
+    }
     
     return (int)BrainFlowExitCodes::STATUS_OK;
 }
@@ -484,11 +1269,26 @@ int VrchatBoard::config_board (std::string config, std::string &response)
      *   - "sys erase_flash"              : Erase saved WiFi credentials
      *   - "sys start_cnt"                : Start continuous data transmission mode
      *   - "sys stop_cnt"                 : Stop continuous data transmission mode
+     * 
+     * Board on USB (params.serial_port): same commands, as frames on the serial port
+     *
+     * Driver (answered here, nothing is sent to the board):
+     *   - "driver clock"                 : Board clock drift, offset, network delay and jitter
+     *   - "driver align"                 : Aggregate session, frames used / held / skipped per board
+     *   - "driver stats"                 : Packets, loss, pkt/s, latency percentiles, decode time, ring high-water marks
+     *
+     * Aggregate session: the command goes to every board in turn, response is "<MAC>: <reply>; ..."
      * -----------------------------------------------------------------
      */
 
-    // Validate that we have a control socket
-    if (ctrl_socket_ < 0)
+    // Driver queries work without a board, even before prepare_session
+    if (config.compare (0, 7, "driver ") == 0)
+    {
+        return handle_driver_command (config, response);
+    }
+
+    // Validate that we have a control socket (or the serial port of a board on USB)
+    if ((ctrl_socket_ < 0) && (serial_ < 0))
     {
         safe_logger (spdlog::level::err, 
             "Control socket not available - board IP must be provided or discovered");
@@ -504,6 +1304,30 @@ int VrchatBoard::config_board (std::string config, std::string &response)
         return (int)BrainFlowExitCodes::INVALID_ARGUMENTS_ERROR;
     }
 
+    // Board on USB
+    if (serial_ >= 0)
+    {
+        return serial_command (config, response);
+    }
+
+    // Aggregate session - same command to each board, the first error is the result
+    if (!members_.empty ())
+    {
+        int result = (int)BrainFlowExitCodes::STATUS_OK;
+        response.clear ();
+        for (const AggregateMember &m : members_)
+        {
+            std::string reply;
+            const int board_result = send_command (m.ip, config, reply);
+            response += (response.empty () ? "" : "; ") + m.id + ": " + reply;
+            if ((board_result != (int)BrainFlowExitCodes::STATUS_OK) && (result == (int)BrainFlowExitCodes::STATUS_OK))
+            {
+                result = board_result;
+            }
+        }
+        return result;
+    }
+
     // Validate that we have a board IP
     if (board_ip_.empty())
     {
@@ -512,6 +1336,11 @@ int VrchatBoard::config_board (std::string config, std::string &response)
         return (int)BrainFlowExitCodes::BOARD_NOT_READY_ERROR;
     }
 
+    return send_command (board_ip_, config, response);
+}
+
+int VrchatBoard::send_command (const std::string &ip, const std::string &config, std::string &response)
+{
     // ----------- Send Command via UDP -----------
     // Protect control socket with mutex. Without this lock, ping_thread could send "floof" while
     // we're waiting for a command response, causing us to receive "floof" response instead of
@@ -523,7 +1352,7 @@ int VrchatBoard::config_board (std::string config, std::string &response)
     memset(&dest_addr, 0, sizeof(dest_addr));  // Zero all fields to prevent garbage values in padding bytes
     dest_addr.sin_family = AF_INET;
     dest_addr.sin_port = htons(ctrl_port_);
-    inet_pton(AF_INET, board_ip_.c_str(), &dest_addr.sin_addr);  // Convert IP string to binary format
+    inet_pton(AF_INET, ip.c_str(), &dest_addr.sin_addr);  // Convert IP string to binary format
     
     // Send command
     int bytes_sent = sendto(ctrl_socket_, config.c_str(), config.length(), 0,
@@ -541,8 +1370,22 @@ int VrchatBoard::config_board (std::string config, std::string &response)
     // Some commands may not send a response, so timeout is not an error condition for this protocol.
     char buffer[256] = {0};  // Response buffer - board responses are typically < 50 bytes
     
-    // Attempt to receive response
-    int bytes_received = recv(ctrl_socket_, buffer, sizeof(buffer) - 1, 0);
+    // Attempt to receive response. Control port also gets beacons of unclaimed boards and late replies of other
+    // boards (aggregate session), only what came from ip is the answer. That includes the board's own beacon,
+    // still queued from before it heard the first WOOF_WOOF
+    int bytes_received = -1;
+    for (int stray = 0; stray < 8; ++stray)
+    {
+        struct sockaddr_in from_addr;
+        socklen_t from_len = sizeof(from_addr);
+        bytes_received = recvfrom(ctrl_socket_, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*)&from_addr, &from_len);
+        const bool beacon = (bytes_received == (int)sizeof(BOARD_BEACON) - 1) &&
+                            (memcmp(buffer, BOARD_BEACON, sizeof(BOARD_BEACON) - 1) == 0);
+        if ((bytes_received <= 0) || ((from_addr.sin_addr.s_addr == dest_addr.sin_addr.s_addr) && !beacon))
+        {
+            break;
+        }
+    }
     
     if (bytes_received > 0)
     {
@@ -627,7 +1470,7 @@ void VrchatBoard::read_thread ()
 {
     // ----------- BrainFlow Channel Mapping -----------
     // Get board description to know which BrainFlow channels to use
-    // Default channel layout:
+    // Default channel layout (16 channel board, see brainflow_boards.cpp for the 8 channel one):
     //   0-15: EEG channels (16 channels)
     //   16:   Battery voltage
     //   17:   Hardware timestamp (from board's internal clock)
@@ -635,12 +1478,31 @@ void VrchatBoard::read_thread ()
     //   19:   Other/Reserved
     //   20:   Other/Reserved
     
+    // Frame layout of this session, 16 or 8 channels (set in prepare_session). Decoders are instantiated per
+    // channel count, so their loops have a fixed trip count either way.
+    const int channels = board_channels_;
+    const int channel_bytes = channel_data_size (channels);  // 48 or 24
+    const int frame_bytes = frame_size (channels);           // 52 or 28
+    const bool one_chip = (channels == CHANNELS_PER_ADS1299);
+    bool (*const decode_delta) (const uint8_t *, int, int, uint8_t *) =
+        one_chip ? decode_delta_frames<CHANNELS_PER_ADS1299> : decode_delta_frames<MAX_CHANNELS_PER_BOARD>;
+    void (*const decode) (const uint8_t *, int, double *) =
+        one_chip ? decode_samples<CHANNELS_PER_ADS1299> : decode_samples<MAX_CHANNELS_PER_BOARD>;
+
     int num_rows = 0;                   // Total number of channels in BrainFlow
-    std::vector<int> eeg_idx (CHANNELS_PER_BOARD);      // Indices for EEG channels
+    std::vector<int> eeg_idx (channels);                // Indices for EEG channels
     int battery_idx = -1;               // Initialize to -1 (invalid) to detect if config explicitly sets it. 
                                         // Prevents accidental writes if channel not configured.
     int hw_timestamp_idx = -1;          // Initialize to -1 (invalid) for same reason - ensures we only write
                                         // to this channel if explicitly configured in board description.
+    int aux_num_rows = 0;               // Auxiliary preset (band power features), 0 - the board has none
+    std::vector<int> aux_feature_rows;  // Row of channel ch, band b at ch * FEATURE_MAX_BANDS + b
+    int aux_timestamp_idx = -1;
+    int aux_battery_idx = -1;
+    int anc_num_rows = 0;               // Ancillary preset (electrode impedance), 0 - the board has none
+    std::vector<int> anc_resistance_rows;   // Row of channel ch at ch
+    int anc_timestamp_idx = -1;
+    int anc_battery_idx = -1;
 
     try
     {
@@ -661,215 +1523,1557 @@ void VrchatBoard::read_thread ()
             {
                 hw_timestamp_idx = board_descr["default"]["timestamp_channel"];
             }
+
+            // Band power features go to the auxiliary preset, if the board has one
+            if (board_descr.contains("auxiliary"))
+            {
+                const auto &aux = board_descr["auxiliary"];
+                aux_num_rows = aux["num_rows"];
+                aux_feature_rows = aux["other_channels"].get<std::vector<int>>();
+                if (aux.contains("timestamp_channel")) aux_timestamp_idx = aux["timestamp_channel"];
+                if (aux.contains("battery_channel")) aux_battery_idx = aux["battery_channel"];
+            }
+
+            // Electrode impedance goes to the ancillary preset, if the board has one
+            if (board_descr.contains("ancillary"))
+            {
+                const auto &anc = board_descr["ancillary"];
+                anc_num_rows = anc["num_rows"];
+                anc_resistance_rows = anc["resistance_channels"].get<std::vector<int>>();
+                if (anc.contains("timestamp_channel")) anc_timestamp_idx = anc["timestamp_channel"];
+                if (anc.contains("battery_channel")) anc_battery_idx = anc["battery_channel"];
+            }
+        }
+    }
+    catch (...)
+    {
+        safe_logger (spdlog::level::warn, "Failed to parse board description");
+    }
+
+    // Fallback if board description is missing
+    if (num_rows == 0)
+    {
+        num_rows = one_chip ? 14 : 21;  // EEG + battery + hw_timestamp + marker + other/reserved
+        std::iota (eeg_idx.begin (), eeg_idx.end (), 0);  // Fill with 0,1,2,...15 (sequential channel numbers)
+        battery_idx = channels;          // Battery voltage channel
+        hw_timestamp_idx = channels + 1; // Hardware timestamp channel
+        safe_logger (spdlog::level::warn, 
+            "Board description missing - using default {} rows", num_rows);
+    }
+    
+    // ----------- Buffers for Data Reception -----------
+    std::vector<uint8_t> decoded_frames (MAX_FRAMES_PER_DATAGRAM * MAX_FRAME_SIZE); // Plain frames of a compressed packet
+
+    // Whole datagram is converted at once: samples in volts, then one BrainFlow package per frame laid out back to back
+    // (column-major num_rows x frames block). Rows nobody writes (markers, reserved) stay zero forever.
+    std::vector<double> samples (MAX_FRAMES_PER_DATAGRAM * MAX_CHANNELS_PER_BOARD);
+    std::vector<double> block (MAX_FRAMES_PER_DATAGRAM * (size_t)num_rows, 0.0);
+    std::vector<double> frame_times (MAX_FRAMES_PER_DATAGRAM);                 // Hardware timestamps in PC time
+
+    // Channel mapping checked once here instead of for every frame. EEG rows that are out of range are skipped,
+    // the usual 0..15 (or any other run of consecutive rows) takes the plain copy path below.
+    std::vector<int> eeg_rows;
+    for (size_t ch = 0; (ch < eeg_idx.size ()) && (ch < (size_t)channels); ++ch)
+    {
+        if ((eeg_idx[ch] >= 0) && (eeg_idx[ch] < num_rows))
+        {
+            eeg_rows.push_back (eeg_idx[ch]);
+        }
+        else
+        {
+            safe_logger (spdlog::level::warn, "EEG channel {} maps to row {} outside of {} rows, skipped",
+                ch, eeg_idx[ch], num_rows);
+            eeg_rows.push_back (-1);
+        }
+    }
+    bool eeg_consecutive = (eeg_rows.size () == (size_t)channels);
+    for (size_t ch = 0; eeg_consecutive && (ch < eeg_rows.size ()); ++ch)
+    {
+        eeg_consecutive = (eeg_rows[ch] == eeg_rows[0] + (int)ch);
+    }
+    const bool has_timestamp = (hw_timestamp_idx >= 0) && (hw_timestamp_idx < num_rows);
+    const bool has_battery   = (battery_idx >= 0) && (battery_idx < num_rows);
+    std::vector<double> aux_package ((size_t)aux_num_rows, 0.0);
+    bool features_warned = false;         // Feature datagrams with no auxiliary preset to put them in, said once
+    std::vector<double> anc_package ((size_t)anc_num_rows, 0.0);
+    bool impedance_warned = false;        // Same for impedance datagrams and the ancillary preset
+
+    // Statistics of this stream, published to stats_ for config_board("driver stats") (StreamStats).
+    // lost counts sequence numbers skipped - lost on the network, or late and counted again below.
+    // duplicates are sequence numbers seen twice (late original of a rebuilt packet), replayed the ones
+    // the board replayed after a Wi-Fi drop that filled a hole (replay_known - delivered already), both dropped.
+    StreamStats st;
+    st.started = true;
+    st.start_time = get_timestamp ();
+    double last_publish = -STATS_PUBLISH_SECONDS; // Publish right away, the previous stream's numbers are gone then
+    unsigned long decoded_at_publish = 0;
+    const auto publish = [&] (double now) {
+        st.update_time = now;
+        st.packet_rate = (last_publish > 0.0) ? (st.decoded - decoded_at_publish) / (now - last_publish) : 0.0;
+        st.ring_full = rx_ring_full_.load (std::memory_order_relaxed);
+        st.ring_hwm = rx_ring_hwm_.load (std::memory_order_relaxed);
+        st.batch_hwm = rx_batch_hwm_.load (std::memory_order_relaxed);
+        last_publish = now;
+        decoded_at_publish = st.decoded;
+        std::lock_guard<std::mutex> lock (stats_mutex_);
+        stats_ = st;
+    };
+    // Datagram went out to BrainFlow: its latency and the time spent on it since it was taken from the ring
+    const auto note_pushed = [&st] (double arrival, std::chrono::steady_clock::time_point taken) {
+        const double work = std::chrono::duration<double> (std::chrono::steady_clock::now () - taken).count ();
+        st.decode_sum += work;
+        st.decode_max = std::max (st.decode_max, work);
+        st.add_latency (get_timestamp () - arrival);
+    };
+    bool have_seq = false;                // False until the first valid packet, nothing to compare with before that
+    bool have_frame = false;              // False until the first frame datagram, expected_frame means nothing before
+    uint32_t expected_seq = 0;            // Sequence of the next packet if nothing is lost
+    uint32_t expected_frame = 0;          // First frame index of the next packet if nothing is lost
+    int decimation_log2 = -1;             // High nibble of header byte 1 of the last packet, -1 before the first one
+
+    // ----------- Loss Recovery (FEC) -----------
+    // Data datagrams by sequence for parity packets, and the one a parity rebuilt - processed on the next
+    // loop pass as if it came late, before anything new is taken from the ring
+    FecHistory fec_history;
+    std::vector<uint8_t> recovered (RECV_BUFFER_SIZE);
+    int recovered_size = 0;
+    double recovered_arrival = 0.0;
+
+    // ----------- Backfill Replay -----------
+    // While the board replays a Wi-Fi drop, live datagrams wait in held so frames still go out in sequence.
+    // Replay is over once it caught up with the first held one (or stopped coming), then held ones are processed
+    // one per loop pass, after a rebuilt datagram and before the ring.
+    DeliveredSeqs delivered;
+    std::deque<HeldDatagram> held;
+    HeldDatagram released;
+    bool replay_active = false;
+    double last_replay_arrival = 0.0;
+
+    // Gives the ring slot back to recv_thread when the loop body is left, whatever "continue" it took
+    struct SlotRelease
+    {
+        std::atomic<uint32_t> &tail;
+        uint32_t next;
+        bool active;
+        ~SlotRelease () { if (active) tail.store (next, std::memory_order_release); }
+    };
+
+    // ----------- Main Processing Loop -----------
+    while (keep_alive_)
+    {
+        const double loop_time = get_timestamp ();
+        if (loop_time - last_publish >= STATS_PUBLISH_SECONDS)
+        {
+            publish (loop_time);
+        }
+
+        // Replay over - caught up with the live datagrams held back, or no more replay coming
+        if (replay_active)
+        {
+            uint32_t held_seq = 0;
+            if (!held.empty ()) memcpy (&held_seq, &held.front ().data[4], sizeof (uint32_t));
+            if ((!held.empty () && have_seq && ((int32_t)(held_seq - expected_seq) <= 0)) ||
+                (loop_time - last_replay_arrival > REPLAY_IDLE_SECONDS))
+            {
+                replay_active = false;
+                safe_logger (spdlog::level::info, "Backfill replay done, {} held packet(s) released", held.size ());
+            }
+        }
+
+        // Take next datagram from the receive ring, sleep (with timeout to check keep_alive_) while it's empty
+        const uint32_t tail = rx_tail_.load (std::memory_order_relaxed);
+        const bool is_recovered = (recovered_size > 0);
+        const bool is_released = !is_recovered && !replay_active && !held.empty ();
+        if (is_released)
+        {
+            released = std::move (held.front ());
+            held.pop_front ();
+        }
+        if (!is_recovered && !is_released && (rx_head_.load (std::memory_order_acquire) == tail))
+        {
+            std::unique_lock<std::mutex> lock (rx_wait_mutex_);
+            rx_wait_cv_.wait_for (lock, std::chrono::milliseconds (DATA_SOCKET_TIMEOUT_MS), [this, tail] {
+                return (rx_head_.load (std::memory_order_acquire) != tail) || !keep_alive_;
+            });
+            continue;
+        }
+        const bool from_ring = !is_recovered && !is_released;
+        SlotRelease release_slot { rx_tail_, tail + 1, from_ring };
+        const uint32_t slot = tail & (RX_RING_SLOTS - 1);
+        const uint8_t *datagram = is_recovered ? recovered.data () :
+                                  is_released  ? released.data.data () : &rx_data_[(size_t)slot * RECV_BUFFER_SIZE];
+        const int bytes_received = is_recovered ? recovered_size :
+                                   is_released  ? (int)released.data.size () : rx_size_[slot];
+        const double arrival = is_recovered ? recovered_arrival : is_released ? released.arrival : rx_time_[slot];
+        const auto taken = std::chrono::steady_clock::now ();
+        recovered_size = 0;
+        if (from_ring) ++st.received;
+
+        // ----------- Validate Packet Header -----------
+        // Valid packet must be: PACKET_HEADER_SIZE + n*frame_bytes + BATTERY_SIZE bytes (header + n frames + battery)
+        if (bytes_received < PACKET_HEADER_SIZE + frame_bytes + BATTERY_SIZE)
+        {
+            // Packet too small
+            ++st.bad;
+            safe_logger (spdlog::level::warn, 
+                "Packet too small: {} bytes (minimum: {})", bytes_received, PACKET_HEADER_SIZE + frame_bytes + BATTERY_SIZE);
+            continue;
+        }
+
+        const uint8_t *header = datagram;
+        const uint8_t packet_type = header[1] & 0x0F;
+        if ((header[0] != PACKET_FORMAT_VERSION) ||
+            ((packet_type != PACKET_TYPE_FRAMES) && (packet_type != PACKET_TYPE_DELTA) &&
+             (packet_type != PACKET_TYPE_PARITY) && (packet_type != PACKET_TYPE_FEATURES) &&
+             (packet_type != PACKET_TYPE_IMPEDANCE)))
+        {
+            // Firmware speaks a format this driver doesn't know
+            ++st.bad;
+            safe_logger (spdlog::level::warn, 
+                "Unsupported packet: version {} type {}", header[0], packet_type);
+            continue;
+        }
+
+        // ----------- Backfill Replay -----------
+        // Replayed datagram - the board is sending what it stored during a Wi-Fi drop. Live ones (parity too,
+        // its group may be held) wait until the replay has caught up with them.
+        const bool is_replay = (header[1] & PACKET_FLAG_REPLAY) != 0;
+        if (is_replay)
+        {
+            if (!replay_active)
+            {
+                safe_logger (spdlog::level::info, "Board replays packets after a Wi-Fi drop, live ones held back");
+            }
+            replay_active = true;
+            last_replay_arrival = arrival;
+        }
+        else if (replay_active && from_ring)
+        {
+            held.push_back (HeldDatagram { std::vector<uint8_t> (datagram, datagram + bytes_received), arrival });
+            if (held.size () >= REPLAY_HOLD_MAX)
+            {
+                replay_active = false;
+                safe_logger (spdlog::level::warn, "Backfill replay too slow, {} held packet(s) released", held.size ());
+            }
+            continue;
+        }
+
+        // ----------- Parity (FEC) -----------
+        // Rebuild the one datagram of the group that never arrived, it goes through everything below on the next pass
+        if (packet_type == PACKET_TYPE_PARITY)
+        {
+            int missing = 0;
+            const int rebuilt = fec_rebuild (datagram, bytes_received, fec_history, recovered.data (), missing);
+            if (rebuilt > 0)
+            {
+                recovered_size = rebuilt;
+                recovered_arrival = arrival;
+                ++st.fec_recovered;
+            }
+            else if (missing > 1)
+            {
+                st.fec_unrecoverable += missing;
+                safe_logger (spdlog::level::debug, "Parity can't rebuild {} lost packets of one group", missing);
+            }
+            else if (rebuilt < 0)
+            {
+                ++st.bad;
+                safe_logger (spdlog::level::warn, "Parity packet doesn't match its group ({} bytes)", bytes_received);
+            }
+            continue;
+        }
+
+        // Frame count from the header must match the datagram size exactly
+        // Feature datagram has no frames, byte 2 is the number of bands and the size follows from it.
+        // Impedance datagram has none either, its size only depends on the channels.
+        const bool is_features = (packet_type == PACKET_TYPE_FEATURES);
+        const bool is_impedance = (packet_type == PACKET_TYPE_IMPEDANCE);
+        const bool is_side = is_features || is_impedance;      // One timestamp, no frames
+        const int frames_in_packet = is_side ? 0 : header[2];
+        const int feature_bands = is_features ? header[2] : 0;
+        const uint8_t *frames_base = datagram + PACKET_HEADER_SIZE; // Plain 52 (28) byte frames, back to back
+        if (is_features)
+        {
+            if ((feature_bands < 1) || (feature_bands > FEATURE_MAX_BANDS) ||
+                (bytes_received != PACKET_HEADER_SIZE + TIMESTAMP_SIZE + channels * feature_bands * 4 + BATTERY_SIZE))
+            {
+                ++st.bad;
+                safe_logger (spdlog::level::warn, 
+                    "Invalid feature packet: {} bytes for {} bands", bytes_received, feature_bands);
+                continue;
+            }
+        }
+        else if (is_impedance)
+        {
+            if (bytes_received != PACKET_HEADER_SIZE + TIMESTAMP_SIZE + channels * 4 + BATTERY_SIZE)
+            {
+                ++st.bad;
+                safe_logger (spdlog::level::warn, "Invalid impedance packet: {} bytes", bytes_received);
+                continue;
+            }
+        }
+        else if (packet_type == PACKET_TYPE_DELTA)
+        {
+            // Compressed - decode into plain frames first, everything below works on them as usual
+            if (!decode_delta (frames_base, bytes_received - PACKET_HEADER_SIZE - BATTERY_SIZE,
+                               frames_in_packet, decoded_frames.data ()))
+            {
+                ++st.bad;
+                safe_logger (spdlog::level::warn, 
+                    "Invalid compressed packet: {} bytes for {} frames", bytes_received, frames_in_packet);
+                continue;
+            }
+            frames_base = decoded_frames.data ();
+        }
+        else if (bytes_received != PACKET_HEADER_SIZE + frames_in_packet * frame_bytes + BATTERY_SIZE)
+        {
+            // Packet size doesn't match expected format
+            ++st.bad;
+            safe_logger (spdlog::level::warn, 
+                "Invalid packet size: {} bytes for {} frames (expected {} + n*{} + {})", 
+                bytes_received, frames_in_packet, PACKET_HEADER_SIZE, frame_bytes, BATTERY_SIZE);
+            continue;
+        }
+        ++st.decoded;
+
+        // ----------- Sequence Tracking -----------
+        // Sequence counts datagrams sent by the board, first frame index counts every frame the ADC produced.
+        // Unsigned subtraction handles 32-bit wrap. Differences are interpreted as signed so a late packet
+        // (reordered) is told apart from a gap (lost).
+        uint32_t packet_seq, first_frame;
+        memcpy (&packet_seq, &header[4], sizeof (uint32_t));
+        memcpy (&first_frame, &header[8], sizeof (uint32_t));
+
+        // Same sequence again - the original of a packet already rebuilt from parity arrived after all,
+        // or the board replays one that did get through before the Wi-Fi drop
+        if (delivered.has (packet_seq))
+        {
+            if (is_replay) ++st.replay_known;
+            else           ++st.duplicates;
+            continue;
+        }
+        delivered.mark (packet_seq);
+        fec_history.store (packet_seq, datagram, bytes_received);
+        if (is_replay) ++st.replayed;
+
+        // With "sys decimation" frame index counts output frames, so it jumps when the ratio changes.
+        // Take the new index as is instead of counting the jump as frames dropped on the board.
+        // Feature and impedance datagrams count ADC frames and always say 0, they don't take part in the frame index checks.
+        const int packet_decimation = (header[1] >> 4) & 0x07;
+        if (!is_side && (packet_decimation != decimation_log2))
+        {
+            safe_logger (spdlog::level::info, "Board decimation: {} (ADC rate code {}, frames are ADC rate / {})", 
+                1 << packet_decimation, header[3] & 0x07, 1 << packet_decimation);
+            if (decimation_log2 >= 0) expected_frame = first_frame;
+            decimation_log2 = packet_decimation;
+        }
+
+        if (have_seq)
+        {
+            const int32_t seq_delta = (int32_t)(packet_seq - expected_seq);
+            if (seq_delta > 0)
+            {
+                st.lost += seq_delta;
+                safe_logger (spdlog::level::debug, "Lost {} packet(s) before seq {}", seq_delta, packet_seq);
+            }
+            else if (seq_delta < 0)
+            {
+                // Late (rebuilt from parity, replayed) packet, it was counted as lost when we skipped over it
+                if (!is_recovered && !is_replay) ++st.reordered;
+                if (st.lost > 0) --st.lost;
+                safe_logger (spdlog::level::debug, "Reordered packet seq {} (expected {})", packet_seq, expected_seq);
+            }
+            else if (!is_side && have_frame && ((int32_t)(first_frame - expected_frame) > 0))
+            {
+                st.board_drop_frames += first_frame - expected_frame;
+                safe_logger (spdlog::level::debug, "Board dropped {} frame(s) before frame {}", 
+                    first_frame - expected_frame, first_frame);
+            }
+        }
+        if (!have_seq || (int32_t)(packet_seq - expected_seq) >= 0)
+        {
+            expected_seq = packet_seq + 1;
+            have_seq     = true;
+            if (!is_side)
+            {
+                expected_frame = first_frame + frames_in_packet;
+                have_frame     = true;
+            }
+        }
+
+        // Features of a board in an aggregate session aren't merged, and without an auxiliary preset they have nowhere to go
+        if (is_features && ((aggregate_ != nullptr) || (aux_num_rows == 0)))
+        {
+            if (!features_warned && (aggregate_ == nullptr))
+            {
+                safe_logger (spdlog::level::warn, "Board sends band power features, but the board has no auxiliary preset");
+            }
+            features_warned = true;
+            continue;
+        }
+        if (is_impedance && ((aggregate_ != nullptr) || (anc_num_rows == 0)))
+        {
+            if (!impedance_warned && (aggregate_ == nullptr))
+            {
+                safe_logger (spdlog::level::warn, "Board sends electrode impedance, but the board has no ancillary preset");
+            }
+            impedance_warned = true;
+            continue;
+        }
+
+        // ----------- Extract Battery Voltage -----------
+        // Last BATTERY_SIZE bytes contain battery voltage as IEEE 754 32-bit float in little-endian format.
+        // Little-endian = least significant byte first. Example: float 12.5 = 0x41480000 in hex,
+        // stored as bytes: [0x00, 0x00, 0x48, 0x41]. This is ESP32/Arduino default byte order.
+        // memcpy handles endianness correctly on all platforms.
+        float battery_voltage;
+        memcpy(&battery_voltage, &datagram[bytes_received - BATTERY_SIZE], sizeof(float));
+
+        // ----------- Decode Whole Datagram -----------
+        // Each channel uses 3 bytes, big-endian (most significant byte first), see decode_samples().
+        decode (frames_base, frames_in_packet, samples.data ());
+
+        // ----------- Hardware Timestamp Alignment -----------
+        // Bytes 48-51 (24-27 with 8 channels) of a frame contain a 32-bit unsigned integer timestamp from the board's internal clock.
+        // Format: little-endian, units of 8 microseconds since board power-on.
+        // The last frame of the datagram was measured right before it was sent, its timestamp and the time the
+        // datagram came off the socket go into the clock model. Every frame is then unwrapped relative to it
+        // and mapped to PC time with the current offset and drift.
+        // A replayed datagram was sent seconds after it was measured and may be older than the newest live one,
+        // it's only mapped, relative to the newest packet the model has seen.
+        // A feature (impedance) datagram carries one timestamp, of the frame that closed its window, right after the header.
+        if (has_timestamp || is_side || (aggregate_ != nullptr))
+        {
+            uint32_t last_ticks;
+            memcpy (&last_ticks, is_side ? frames_base : &frames_base[(frames_in_packet - 1) * frame_bytes + channel_bytes],
+                    sizeof (uint32_t));
+
+            std::lock_guard<std::mutex> lock (clock_mutex_);
+            const bool first = !clock_.started;
+            const unsigned long resets = clock_.resets;
+            const bool model_it = first || !is_replay;
+            const int64_t last_ticks64 = model_it ? clock_.unwrap (last_ticks, arrival) :
+                                         clock_.last_ticks64 + (int32_t)(last_ticks - clock_.last_ticks);
+            if (model_it) clock_.update (last_ticks64 * CLOCK_TICK_SECONDS, arrival);
+            if (first)
+            {
+                safe_logger (spdlog::level::debug, 
+                    "Timestamp alignment: PC={:.6f}, HW={:.6f}, Offset={:.6f}", 
+                    arrival, last_ticks64 * CLOCK_TICK_SECONDS, clock_.offset);
+            }
+            else if (clock_.resets != resets)
+            {
+                safe_logger (spdlog::level::warn, "Board clock jumped (board restarted?), timestamps re-aligned");
+            }
+
+            for (int frame_idx = 0; frame_idx < frames_in_packet; ++frame_idx)
+            {
+                uint32_t hw_timestamp;
+                memcpy (&hw_timestamp, &frames_base[frame_idx * frame_bytes + channel_bytes], sizeof (uint32_t));
+                const int64_t ticks64 = last_ticks64 + (int32_t)(hw_timestamp - last_ticks);
+                frame_times[frame_idx] = clock_.to_pc (ticks64 * CLOCK_TICK_SECONDS);
+            }
+            if (is_side) frame_times[0] = clock_.to_pc (last_ticks64 * CLOCK_TICK_SECONDS);
+        }
+
+        // ----------- Band Power Features -----------
+        // One auxiliary package per datagram: counts^2 to V^2, channel ch band b at row ch * FEATURE_MAX_BANDS + b
+        if (is_features)
+        {
+            const uint8_t *powers = frames_base + TIMESTAMP_SIZE;
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                for (int band = 0; band < feature_bands; ++band, powers += 4)
+                {
+                    const size_t at = (size_t)ch * FEATURE_MAX_BANDS + band;
+                    if (at >= aux_feature_rows.size ()) continue;
+                    const int row = aux_feature_rows[at];
+                    if ((row < 0) || (row >= aux_num_rows)) continue;
+                    float power;
+                    memcpy (&power, powers, sizeof (float));
+                    aux_package[row] = power * ADS1299_SCALE * ADS1299_SCALE;
+                }
+            }
+            if ((aux_timestamp_idx >= 0) && (aux_timestamp_idx < aux_num_rows)) aux_package[aux_timestamp_idx] = frame_times[0];
+            if ((aux_battery_idx >= 0) && (aux_battery_idx < aux_num_rows)) aux_package[aux_battery_idx] = battery_voltage;
+            push_package (aux_package.data (), (int)BrainFlowPresets::AUXILIARY_PRESET);
+            ++st.features;
+            note_pushed (arrival, taken);
+            continue;
+        }
+
+        // ----------- Electrode Impedance -----------
+        // One ancillary package per datagram, ohms as the board sent them (NaN - channel not excited)
+        if (is_impedance)
+        {
+            const uint8_t *ohms = frames_base + TIMESTAMP_SIZE;
+            for (int ch = 0; (ch < channels) && (ch < (int)anc_resistance_rows.size ()); ++ch)
+            {
+                const int row = anc_resistance_rows[ch];
+                if ((row < 0) || (row >= anc_num_rows)) continue;
+                float value;
+                memcpy (&value, ohms + ch * 4, sizeof (float));
+                anc_package[row] = value;
+            }
+            if ((anc_timestamp_idx >= 0) && (anc_timestamp_idx < anc_num_rows)) anc_package[anc_timestamp_idx] = frame_times[0];
+            if ((anc_battery_idx >= 0) && (anc_battery_idx < anc_num_rows)) anc_package[anc_battery_idx] = battery_voltage;
+            push_package (anc_package.data (), (int)BrainFlowPresets::ANCILLARY_PRESET);
+            ++st.impedance;
+            note_pushed (arrival, taken);
+            continue;
+        }
+
+        // ----------- Aggregate Session -----------
+        // Board of an aggregate session: its frames are lined up with the other boards' and pushed by the session
+        if (aggregate_ != nullptr)
+        {
+            const double frame_period = (double)(1 << decimation_log2) / (ADC_BASE_RATE_HZ << (header[3] & 0x07));
+            aggregate_->merge_frames (member_index_, samples.data (), frame_times.data (), frames_in_packet,
+                battery_voltage, frame_period);
+            st.frames += frames_in_packet;
+            note_pushed (arrival, taken);
+            continue;
+        }
+
+        // ----------- Build BrainFlow Packages -----------
+        // One package (num_rows doubles) per frame: EEG in volts, hardware time converted to PC time, battery.
+        for (int frame_idx = 0; frame_idx < frames_in_packet; ++frame_idx)
+        {
+            double *package_row = block.data () + (size_t)frame_idx * num_rows;
+            const double *frame_samples = samples.data () + frame_idx * channels;
+
+            if (eeg_consecutive)
+            {
+                memcpy (package_row + eeg_rows[0], frame_samples, channels * sizeof (double));
+            }
+            else
+            {
+                for (size_t ch = 0; ch < eeg_rows.size (); ++ch)
+                {
+                    if (eeg_rows[ch] >= 0)
+                    {
+                        package_row[eeg_rows[ch]] = frame_samples[ch];
+                    }
+                }
+            }
+
+            if (has_timestamp)
+            {
+                package_row[hw_timestamp_idx] = frame_times[frame_idx];
+            }
+            if (has_battery)
+            {
+                package_row[battery_idx] = battery_voltage;
+            }
+        }
+
+        // ----------- Send to BrainFlow -----------
+        // BrainFlow takes one package per call (there is no bulk push in the Board API), everything else is done
+        // by now, so this loop is only the ring-buffer inserts. Users can write to marker channel via BrainFlow API.
+        for (int frame_idx = 0; frame_idx < frames_in_packet; ++frame_idx)
+        {
+            push_package (block.data () + (size_t)frame_idx * num_rows, (int)BrainFlowPresets::DEFAULT_PRESET);
+        }
+        st.frames += frames_in_packet;
+        note_pushed (arrival, taken);
+    }
+    publish (get_timestamp ());
+
+    safe_logger (spdlog::level::info, 
+        "Stream stopped: {} packets, {} frames, {} bad, {} lost, {} reordered, {} frames dropped by board, "
+        "{} recovered by FEC, {} lost beyond FEC, {} duplicates, {} replayed after Wi-Fi drops ({} known), "
+        "{} feature sets, {} impedance sets, receive ring full {} time(s)", 
+        st.decoded, st.frames, st.bad, st.lost, st.reordered, st.board_drop_frames,
+        st.fec_recovered, st.fec_unrecoverable, st.duplicates, st.replayed, st.replay_known,
+        st.features, st.impedance, rx_ring_full_.load ());
+}
+
+// ====================================================================
+//                    DATA RECEIVE THREAD
+// ====================================================================
+
+void VrchatBoard::recv_thread ()
+{
+    /*
+     * First stage of the data pipeline. Does nothing but move datagrams from the socket into the receive ring,
+     * so the kernel buffer is emptied as fast as it's filled even while read_thread is busy pushing to BrainFlow.
+     *
+     * On Linux recvmmsg() takes every datagram already queued (up to RX_BATCH) in one system call, written straight
+     * into free ring slots. MSG_WAITFORONE blocks only for the first one (up to SO_RCVTIMEO), so a single packet
+     * is not held back waiting for a batch. Windows and macOS have no recvmmsg, there it's one recv() per datagram,
+     * still decoupled from decoding.
+     *
+     * Ring full means read_thread is a whole ring behind. Datagrams are left in the kernel buffer then,
+     * it's drained again as soon as a slot is free.
+     */
+#ifdef __linux__
+    std::vector<struct mmsghdr> msgs (RX_BATCH);
+    std::vector<struct iovec> iovs (RX_BATCH);
+#endif
+
+    while (keep_alive_)
+    {
+        const uint32_t head = rx_head_.load (std::memory_order_relaxed);
+        const uint32_t free_slots = RX_RING_SLOTS - (head - rx_tail_.load (std::memory_order_acquire));
+        if (free_slots == 0)
+        {
+            ++rx_ring_full_;
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+            continue;
+        }
+
+#ifdef __linux__
+        // Free slots may wrap around the end of the ring, each message gets its own slot anyway
+        const int batch = (free_slots < (uint32_t)RX_BATCH) ? (int)free_slots : RX_BATCH;
+        for (int i = 0; i < batch; ++i)
+        {
+            const uint32_t slot = (head + i) & (RX_RING_SLOTS - 1);
+            iovs[i].iov_base = &rx_data_[(size_t)slot * RECV_BUFFER_SIZE];
+            iovs[i].iov_len  = RECV_BUFFER_SIZE;
+            memset (&msgs[i], 0, sizeof (msgs[i]));
+            msgs[i].msg_hdr.msg_iov    = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int received = recvmmsg (data_socket_, msgs.data (), batch, MSG_WAITFORONE, nullptr);
+        if (received <= 0)
+        {
+            // Timeout (lets us check keep_alive_) or temporary network error, both are normal
+            continue;
+        }
+        const double now = get_timestamp ();  // One arrival time per batch, the clock model only uses the earliest ones
+        for (int i = 0; i < received; ++i)
+        {
+            rx_size_[(head + i) & (RX_RING_SLOTS - 1)] = (int)msgs[i].msg_len;
+            rx_time_[(head + i) & (RX_RING_SLOTS - 1)] = now;
+        }
+#else
+        const uint32_t slot = head & (RX_RING_SLOTS - 1);
+        const int bytes = recv (data_socket_, (char*)&rx_data_[(size_t)slot * RECV_BUFFER_SIZE], RECV_BUFFER_SIZE, 0);
+        if (bytes <= 0)
+        {
+            // Timeout (lets us check keep_alive_) or temporary network error, both are normal
+            continue;
+        }
+        rx_size_[slot] = bytes;
+        rx_time_[slot] = get_timestamp ();
+        const int received = 1;
+#endif
+
+        // Publish, slots must be complete before head moves. Locking the mutex once per batch makes sure
+        // read_thread is either before its empty check or already waiting, so the notification is never lost.
+        rx_head_.store (head + (uint32_t)received, std::memory_order_release);
+        raise_hwm (rx_ring_hwm_, head + (uint32_t)received - rx_tail_.load (std::memory_order_relaxed));
+        raise_hwm (rx_batch_hwm_, (uint32_t)received);
+        {
+            std::lock_guard<std::mutex> lock (rx_wait_mutex_);
+        }
+        rx_wait_cv_.notify_one ();
+    }
+}
+
+// ====================================================================
+//                    KEEP-ALIVE THREAD (FLOOF)
+// ====================================================================
+
+void VrchatBoard::ping_thread ()
+{
+    /*
+     * This thread sends periodic "WOOF_WOOF" messages to the board.
+     * 
+     * PURPOSE:
+     * - Claims the board - it takes commands only from the PC it heard WOOF_WOOF from, the first one goes out
+     *   right when the session is prepared, so discovery is one probe and one WOOF_WOOF
+     * - Maintains UDP connection state (keeps the connection "alive")
+     * - Prevents board timeout - board firmware stops sending data if no messages received for 10 seconds
+     * - Helps with NAT traversal - home routers/firewalls close inactive UDP mappings after 30-300 seconds,
+     *   our 5-second interval ensures the path stays open
+     * 
+     * WOOF_WOOF is handled by the board's network code directly, it's no command and gets no reply,
+     * so it can't end up as the answer config_board() is waiting for.
+     */
+
+    // Send keep-alive every KEEPALIVE_INTERVAL_SEC seconds, the first one went out in prepare_session
+    while (keep_floof_)
+    {
+        std::this_thread::sleep_for (std::chrono::seconds(KEEPALIVE_INTERVAL_SEC));
+        if (keep_floof_)
+        {
+            send_keepalive ();
+        }
+    }
+}
+
+void VrchatBoard::send_keepalive ()
+{
+    // Board on USB - one CTRL frame, the board's USB stream has the same watchdog as Wi-Fi
+    if (serial_ >= 0)
+    {
+        std::lock_guard<std::mutex> lock (ctrl_mutex_);
+        if (serial_send (USB_LINK_CTRL, KEEPALIVE_WORD, sizeof (KEEPALIVE_WORD) - 1))
+        {
+            ++floof_count_;
+        }
+        else
+        {
+            safe_logger (spdlog::level::warn, "Failed to send keep-alive #{} to {}", floof_count_ + 1, params.serial_port);
+        }
+        return;
+    }
+
+    // The board, or every board of an aggregate session (members_ doesn't change while the session runs)
+    std::vector<std::string> targets;
+    if (!board_ip_.empty ())
+    {
+        targets.push_back (board_ip_);
+    }
+    for (const AggregateMember &m : members_)
+    {
+        targets.push_back (m.ip);
+    }
+
+    if (ctrl_socket_ < 0 || targets.empty())  // Only send if socket is open AND we know where to send
+    {
+        return;
+    }
+
+    // Protect control socket with mutex. This prevents config_board() from interfering
+    // with our keep-alive messages. Without this lock, responses could get mixed up.
+    std::lock_guard<std::mutex> lock(ctrl_mutex_);
+
+    for (const std::string &ip : targets)
+    {
+        // Prepare destination address
+        struct sockaddr_in dest_addr;
+        memset(&dest_addr, 0, sizeof(dest_addr));  // Zero-initialize structure
+        dest_addr.sin_family = AF_INET;
+        dest_addr.sin_port = htons(ctrl_port_);
+        inet_pton(AF_INET, ip.c_str(), &dest_addr.sin_addr);  // Board IP was set during prepare_session
+
+        // Send the keep-alive message
+        int result = sendto(ctrl_socket_, KEEPALIVE_WORD, sizeof(KEEPALIVE_WORD) - 1, 0,
+                           (struct sockaddr*)&dest_addr, sizeof(dest_addr));
+
+        if (result > 0)
+        {
+            ++floof_count_;  // Track successful keep-alives for debugging connection stability
+        }
+        else
+        {
+            safe_logger (spdlog::level::warn,
+                "Failed to send keep-alive #{} to {}: {}", floof_count_ + 1, ip, result);
+        }
+    }
+}
+
+
+// ====================================================================
+//                    SERIAL TRANSPORT (BOARD ON USB)
+// ====================================================================
+
+// Open the serial port raw: no echo, no line editing, reads return what is there after at most SERIAL_READ_TIMEOUT_MS.
+// Baud rate means nothing to USB CDC, it's set for adapters that care. Returns -1 if the port can't be opened.
+static intptr_t serial_port_open (const std::string &port)
+{
+#ifdef _WIN32
+    // COM10 and up only open with the device namespace prefix, it works for COM1 - COM9 too
+    const std::string path = (port.compare (0, 4, "\\\\.\\") == 0) ? port : "\\\\.\\" + port;
+    HANDLE handle = CreateFileA (path.c_str (), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return -1;
+    }
+
+    // DTR and RTS stay low - the ESP32-C3 USB port resets the chip on some of their transitions
+    DCB dcb;
+    memset (&dcb, 0, sizeof (dcb));
+    dcb.DCBlength = sizeof (dcb);
+    GetCommState (handle, &dcb);
+    dcb.BaudRate = CBR_115200;
+    dcb.ByteSize = 8;
+    dcb.Parity = NOPARITY;
+    dcb.StopBits = ONESTOPBIT;
+    dcb.fBinary = TRUE;
+    dcb.fOutxCtsFlow = FALSE;
+    dcb.fOutxDsrFlow = FALSE;
+    dcb.fOutX = FALSE;
+    dcb.fInX = FALSE;
+    dcb.fDtrControl = DTR_CONTROL_DISABLE;
+    dcb.fRtsControl = RTS_CONTROL_DISABLE;
+    SetCommState (handle, &dcb);
+
+    // Read returns as soon as there is anything, or after the timeout with nothing
+    COMMTIMEOUTS timeouts;
+    memset (&timeouts, 0, sizeof (timeouts));
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = SERIAL_READ_TIMEOUT_MS;
+    timeouts.WriteTotalTimeoutConstant = CONTROL_SOCKET_TIMEOUT_MS;
+    SetCommTimeouts (handle, &timeouts);
+    PurgeComm (handle, PURGE_RXCLEAR | PURGE_TXCLEAR);
+    return (intptr_t)handle;
+#else
+    const int fd = open (port.c_str (), O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct termios tio;
+    if (tcgetattr (fd, &tio) != 0)
+    {
+        close (fd);
+        return -1;
+    }
+    cfmakeraw (&tio);
+    cfsetispeed (&tio, B115200);
+    cfsetospeed (&tio, B115200);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;                                // Return with whatever arrived ...
+    tio.c_cc[VTIME] = SERIAL_READ_TIMEOUT_MS / 100;    // ... or after this many tenths of a second
+    tcsetattr (fd, TCSANOW, &tio);
+    tcflush (fd, TCIOFLUSH);                           // Debug text of the board from before the session
+    return fd;
+#endif
+}
+
+// Bytes read, 0 on timeout, < 0 on error (port gone)
+static int serial_port_read (intptr_t port, uint8_t *buffer, int size)
+{
+#ifdef _WIN32
+    DWORD got = 0;
+    if (!ReadFile ((HANDLE)port, buffer, (DWORD)size, &got, nullptr))
+    {
+        return -1;
+    }
+    return (int)got;
+#else
+    const ssize_t got = read ((int)port, buffer, (size_t)size);
+    if ((got < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+    {
+        return 0;
+    }
+    return (int)got;
+#endif
+}
+
+// Whole buffer or false
+static bool serial_port_write (intptr_t port, const uint8_t *data, int size)
+{
+    while (size > 0)
+    {
+#ifdef _WIN32
+        DWORD sent = 0;
+        if (!WriteFile ((HANDLE)port, data, (DWORD)size, &sent, nullptr) || (sent == 0))
+        {
+            return false;
+        }
+#else
+        const ssize_t sent = write ((int)port, data, (size_t)size);
+        if ((sent < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+#endif
+        data += sent;
+        size -= (int)sent;
+    }
+    return true;
+}
+
+int VrchatBoard::prepare_serial ()
+{
+    if (params.other_info.find ("boards=") != std::string::npos)
+    {
+        safe_logger (spdlog::level::err, "Aggregate session needs the boards on Wi-Fi, serial_port takes one board");
+        return (int)BrainFlowExitCodes::INVALID_ARGUMENTS_ERROR;
+    }
+
+    serial_ = serial_port_open (params.serial_port);
+    if (serial_ < 0)
+    {
+        safe_logger (spdlog::level::err, "Failed to open serial port {}", params.serial_port);
+        return (int)BrainFlowExitCodes::UNABLE_TO_OPEN_PORT_ERROR;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (serial_reply_mutex_);
+        serial_replies_.clear ();
+    }
+    serial_resyncs_ = 0;
+    keep_serial_ = true;
+    serial_th_ = std::thread (&VrchatBoard::serial_thread, this);
+
+    // Keep-alive as on Wi-Fi, the board stops its USB stream after 10 s without a frame from us
+    send_keepalive ();
+    keep_floof_ = true;
+    ping_th_ = std::thread (&VrchatBoard::ping_thread, this);
+
+    initialized_ = true;
+    safe_logger (spdlog::level::info, "Session prepared on serial port {}", params.serial_port);
+    return (int)BrainFlowExitCodes::STATUS_OK;
+}
+
+void VrchatBoard::serial_thread ()
+{
+    /*
+     * Frame parser over the byte stream of the port. Payload is collected in one buffer, a data frame is copied into
+     * the next free ring slot as a datagram (arrival time is the time of the read it completed in, like a recvmmsg
+     * batch), a CTRL frame becomes the next reply. Outside a stream data frames are dropped.
+     *
+     * Ring full: USB has flow control, so the thread waits for read_thread instead of dropping - the port is not read
+     * meanwhile and the board counts what didn't fit into its TX buffer (sys stats usb_busy).
+     */
+    std::vector<uint8_t> chunk (SERIAL_READ_CHUNK);
+    std::vector<uint8_t> payload (RECV_BUFFER_SIZE);
+    int head = 0;                            // Bytes of the frame head seen, USB_LINK_OVERHEAD - in the payload
+    uint8_t type = 0;
+    size_t length = 0;
+    size_t filled = 0;
+    bool port_lost = false;
+
+    while (keep_serial_)
+    {
+        const int bytes = serial_port_read (serial_, chunk.data (), SERIAL_READ_CHUNK);
+        if (bytes < 0)
+        {
+            if (!port_lost)
+            {
+                safe_logger (spdlog::level::err, "Serial port {} stopped working (unplugged?)", params.serial_port);
+                port_lost = true;
+            }
+            std::this_thread::sleep_for (std::chrono::milliseconds (SERIAL_READ_TIMEOUT_MS));
+            continue;
+        }
+        const double now = get_timestamp ();
+
+        for (int i = 0; i < bytes; ++i)
+        {
+            const uint8_t c = chunk[i];
+            if (head < USB_LINK_OVERHEAD)
+            {
+                switch (head)
+                {
+                    case 0: head = (c == USB_LINK_SYNC0) ? 1 : 0; break;
+                    case 1: head = (c == USB_LINK_SYNC1) ? 2 : ((c == USB_LINK_SYNC0) ? 1 : 0); break;
+                    case 2: type = c; head = 3; break;
+                    case 3: length = c; head = 4; break;
+                    default:
+                        length |= (size_t)c << 8;
+                        filled = 0;
+                        head = USB_LINK_OVERHEAD;
+                        if (((type != USB_LINK_DATA) && (type != USB_LINK_CTRL)) || (length == 0) ||
+                            (length > (size_t)RECV_BUFFER_SIZE))
+                        {
+                            ++serial_resyncs_;
+                            head = 0;
+                        }
+                        break;
+                }
+                continue;
+            }
+
+            // Payload, as much of it as this read has
+            const size_t take = std::min (length - filled, (size_t)(bytes - i));
+            memcpy (&payload[filled], &chunk[i], take);
+            filled += take;
+            i += (int)take - 1;
+            if (filled < length)
+            {
+                continue;
+            }
+            head = 0;
+
+            if (type == USB_LINK_CTRL)
+            {
+                {
+                    std::lock_guard<std::mutex> lock (serial_reply_mutex_);
+                    serial_replies_.emplace_back ((const char *)payload.data (), length);
+                }
+                serial_reply_cv_.notify_one ();
+                continue;
+            }
+
+            // Data frame - wait for a free slot, then publish it like recv_thread does
+            while (keep_alive_ && (rx_head_.load (std::memory_order_relaxed) -
+                                   rx_tail_.load (std::memory_order_acquire) >= RX_RING_SLOTS))
+            {
+                ++rx_ring_full_;
+                std::this_thread::sleep_for (std::chrono::milliseconds (1));
+            }
+            {
+                std::lock_guard<std::mutex> lock (rx_wait_mutex_);
+                if (!keep_alive_)
+                {
+                    continue;
+                }
+                const uint32_t slot_head = rx_head_.load (std::memory_order_relaxed);
+                const uint32_t slot = slot_head & (RX_RING_SLOTS - 1);
+                const size_t size = std::min (length, (size_t)RECV_BUFFER_SIZE);   // head check bounds it already
+                memcpy (&rx_data_[(size_t)slot * RECV_BUFFER_SIZE], payload.data (), size);
+                rx_size_[slot] = (int)size;
+                rx_time_[slot] = now;
+                rx_head_.store (slot_head + 1, std::memory_order_release);
+                raise_hwm (rx_ring_hwm_, slot_head + 1 - rx_tail_.load (std::memory_order_relaxed));
+            }
+            rx_wait_cv_.notify_one ();
+        }
+    }
+}
+
+bool VrchatBoard::serial_send (uint8_t type, const void *data, size_t len)
+{
+    if (len > (size_t)RECV_BUFFER_SIZE)
+    {
+        return false;                        // Length field is 16 bit, the board takes no more than one datagram
+    }
+    std::vector<uint8_t> frame (USB_LINK_OVERHEAD + len);
+    frame[0] = USB_LINK_SYNC0;
+    frame[1] = USB_LINK_SYNC1;
+    frame[2] = type;
+    frame[3] = (uint8_t)(len & 0xFF);
+    frame[4] = (uint8_t)(len >> 8);
+    if (len > 0)
+    {
+        memcpy (&frame[USB_LINK_OVERHEAD], data, len);
+    }
+    return serial_port_write (serial_, frame.data (), (int)frame.size ());
+}
+
+int VrchatBoard::serial_command (const std::string &config, std::string &response)
+{
+    // Same rules as send_command: one command at a time, keep-alives wait (ctrl_mutex_), no reply within
+    // CONTROL_SOCKET_TIMEOUT_MS is "TIMEOUT" and no error, reply with "ERR" is one
+    std::lock_guard<std::mutex> lock (ctrl_mutex_);
+    {
+        std::lock_guard<std::mutex> replies (serial_reply_mutex_);
+        serial_replies_.clear ();            // Late replies of earlier commands
+    }
+
+    if (!serial_send (USB_LINK_CTRL, config.data (), config.size ()))
+    {
+        safe_logger (spdlog::level::err, "Failed to send command '{}' to {}", config, params.serial_port);
+        response = "SEND_FAILED";
+        return (int)BrainFlowExitCodes::BOARD_WRITE_ERROR;
+    }
+
+    std::unique_lock<std::mutex> replies (serial_reply_mutex_);
+    if (!serial_reply_cv_.wait_for (replies, std::chrono::milliseconds (CONTROL_SOCKET_TIMEOUT_MS),
+            [this] { return !serial_replies_.empty (); }))
+    {
+        response = "TIMEOUT";
+        return (int)BrainFlowExitCodes::STATUS_OK;
+    }
+    response = serial_replies_.front ();
+    serial_replies_.pop_front ();
+
+    if (response.find ("ERR") != std::string::npos)
+    {
+        safe_logger (spdlog::level::err, "Board returned error for command '{}': {}", config, response);
+        return (int)BrainFlowExitCodes::BOARD_WRITE_ERROR;
+    }
+    return (int)BrainFlowExitCodes::STATUS_OK;
+}
+
+
+// ====================================================================
+//                    AGGREGATE SESSION (SEVERAL BOARDS)
+// ====================================================================
+
+int VrchatBoard::prepare_aggregate (int timeout_ms, const std::string &boards)
+{
+    /*
+     * "boards=N" takes N boards that answered the probe, the ones not streaming to another PC first, by MAC
+     * (so the channel order stays the same from session to session). "boards=<MAC>,<MAC>,..." takes exactly
+     * these, in this order. Discovery is repeated until all of them answered or timeout_ms is over: a probe
+     * reply that got lost only costs another round. Boards that only send MEOW_MEOW (firmware before the probe)
+     * can't be told apart and don't take part.
+     *
+     * Each board gets a VrchatBoard of its own (16 or 8 channel descriptor, ch= of MEOW_HERE). It opens no sockets,
+     * aggregate_recv_thread fills its receive ring and its read_thread decodes and timestamps as usual,
+     * then hands the frames over to merge_frames().
+     */
+    std::vector<std::string> wanted_ids;
+    size_t wanted_count = 0;
+    if (boards.find (':') != std::string::npos)
+    {
+        std::stringstream list (boards);
+        std::string id;
+        while (std::getline (list, id, ','))
+        {
+            std::transform (id.begin (), id.end (), id.begin (), ::toupper);
+            if (!id.empty ()) wanted_ids.push_back (id);
+        }
+        wanted_count = wanted_ids.size ();
+    }
+    else
+    {
+        try
+        {
+            wanted_count = (size_t)std::max (0, std::stoi (boards));
+        }
+        catch (...)
+        {
+            // Reported below
+        }
+    }
+    if (wanted_count == 0)
+    {
+        safe_logger (spdlog::level::err, "boards={} - expected a count or a list of MACs", boards);
+        return (int)BrainFlowExitCodes::INVALID_ARGUMENTS_ERROR;
+    }
+
+    // ----------- Discovery -----------
+    std::vector<DiscoveredBoard> found;
+    const auto deadline = std::chrono::steady_clock::now () + std::chrono::milliseconds (timeout_ms);
+    bool beacon_only = false;
+    while (true)
+    {
+        const int remaining_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds> (
+            deadline - std::chrono::steady_clock::now ()).count ();
+        if (remaining_ms <= 0) break;
+
+        beacon_only = wait_for_beacon (remaining_ms) && discovered_boards_.empty ();
+        for (const DiscoveredBoard &b : discovered_boards_)
+        {
+            bool known = false;
+            for (const DiscoveredBoard &f : found)
+            {
+                known = known || (f.id == b.id);
+            }
+            if (!known) found.push_back (b);
+        }
+
+        size_t have = 0;
+        for (const DiscoveredBoard &f : found)
+        {
+            have += wanted_ids.empty () ||
+                    (std::find (wanted_ids.begin (), wanted_ids.end (), f.id) != wanted_ids.end ());
+        }
+        if (have >= wanted_count) break;
+    }
+    discovered_boards_ = found;
+    if (beacon_only)
+    {
+        safe_logger (spdlog::level::warn, "A board with firmware older than the probe answered, it can't be aggregated");
+    }
+
+    // ----------- Pick -----------
+    std::vector<const DiscoveredBoard *> picked;
+    if (!wanted_ids.empty ())
+    {
+        for (const std::string &id : wanted_ids)
+        {
+            for (const DiscoveredBoard &f : found)
+            {
+                if (f.id == id) picked.push_back (&f);
+            }
+        }
+    }
+    else
+    {
+        std::vector<const DiscoveredBoard *> order;
+        for (const DiscoveredBoard &f : found)
+        {
+            order.push_back (&f);
+        }
+        std::sort (order.begin (), order.end (), [] (const DiscoveredBoard *a, const DiscoveredBoard *b)
+        {
+            const bool a_free = (reply_field (a->info, "peer") == "none");
+            const bool b_free = (reply_field (b->info, "peer") == "none");
+            return (a_free != b_free) ? a_free : (a->id < b->id);
+        });
+        order.resize (std::min (order.size (), wanted_count));
+        picked = order;
+    }
+    if (picked.size () < wanted_count)
+    {
+        safe_logger (spdlog::level::err, "Aggregate session needs {} boards, {} answered the probe within {}ms",
+            wanted_count, picked.size (), timeout_ms);
+        return (int)BrainFlowExitCodes::BOARD_NOT_READY_ERROR;
+    }
+
+    // ----------- Rows of the combined package -----------
+    int num_rows = 0;
+    std::vector<int> eeg_idx;
+    std::vector<int> other_idx;
+    int battery_idx = -1;
+    int timestamp_idx = -1;
+    try
+    {
+        if (!board_descr.empty ())
+        {
+            num_rows = board_descr["default"]["num_rows"];
+            eeg_idx = board_descr["default"]["eeg_channels"].get<std::vector<int>>();
+            if (board_descr["default"].contains ("battery_channel"))
+            {
+                battery_idx = board_descr["default"]["battery_channel"];
+            }
+            if (board_descr["default"].contains ("timestamp_channel"))
+            {
+                timestamp_idx = board_descr["default"]["timestamp_channel"];
+            }
+            if (board_descr["default"].contains ("other_channels"))
+            {
+                other_idx = board_descr["default"]["other_channels"].get<std::vector<int>>();
+            }
         }
     }
     catch (...)
     {
         safe_logger (spdlog::level::warn, "Failed to parse board description");
+        num_rows = 0;
     }
 
-    // Fallback if board description is missing
+    int total_channels = 0;
+    for (const DiscoveredBoard *b : picked)
+    {
+        total_channels += (reply_field (b->info, "ch") == std::to_string (CHANNELS_PER_ADS1299)) ?
+                          CHANNELS_PER_ADS1299 : MAX_CHANNELS_PER_BOARD;
+    }
     if (num_rows == 0)
     {
-        num_rows = 21;  // 16 EEG + battery + hw_timestamp + marker + 2 other/reserved
-        std::iota (eeg_idx.begin (), eeg_idx.end (), 0);  // Fill with 0,1,2,...15 (sequential channel numbers)
-        battery_idx = 16;      // Battery voltage channel
-        hw_timestamp_idx = 17; // Hardware timestamp channel
-        safe_logger (spdlog::level::warn, 
-            "Board description missing - using default {} rows", num_rows);
+        // Without a descriptor: EEG of all boards, timestamp, battery of every board, marker
+        num_rows = total_channels + 2 + (int)picked.size ();
+        eeg_idx.resize (total_channels);
+        std::iota (eeg_idx.begin (), eeg_idx.end (), 0);
+        timestamp_idx = total_channels;
+        battery_idx = total_channels + 1;
+        other_idx.resize (picked.size () - 1);
+        std::iota (other_idx.begin (), other_idx.end (), total_channels + 2);
+        safe_logger (spdlog::level::warn, "Board description missing - using default {} rows", num_rows);
     }
-    
-    // ----------- Buffers for Data Reception -----------
-    std::vector<double> package (num_rows, 0.0);    // BrainFlow data package. Pre-filled with zeros to ensure
-                                                     // unused channels (markers, reserved) have defined values.
-    std::vector<uint8_t> recv_buffer (RECV_BUFFER_SIZE);    // UDP receive buffer
+    if (total_channels > (int)eeg_idx.size ())
+    {
+        safe_logger (spdlog::level::err, "{} boards have {} EEG channels, the board description has room for {}",
+            picked.size (), total_channels, eeg_idx.size ());
+        return (int)BrainFlowExitCodes::INVALID_ARGUMENTS_ERROR;
+    }
+    align_row_.assign (num_rows, 0.0);
+    align_time_row_ = ((timestamp_idx >= 0) && (timestamp_idx < num_rows)) ? timestamp_idx : -1;
+
+    // ----------- Boards -----------
+    members_.clear ();
+    int next_eeg = 0;
+    for (size_t i = 0; i < picked.size (); ++i)
+    {
+        const DiscoveredBoard &b = *picked[i];
+        AggregateMember m;
+        m.ip = b.ip;
+        m.id = b.id;
+        m.channels = (reply_field (b.info, "ch") == std::to_string (CHANNELS_PER_ADS1299)) ?
+                     CHANNELS_PER_ADS1299 : MAX_CHANNELS_PER_BOARD;
+        try
+        {
+            m.firmware = std::stoi (reply_field (b.info, "fw"));
+        }
+        catch (...)
+        {
+            m.firmware = 0;
+        }
+        struct in_addr addr;
+        inet_pton (AF_INET, m.ip.c_str (), &addr);
+        m.addr = addr.s_addr;
+
+        for (int ch = 0; ch < m.channels; ++ch)
+        {
+            const int row = eeg_idx[next_eeg++];
+            m.eeg_rows.push_back (((row >= 0) && (row < num_rows)) ? row : -1);
+        }
+        const int battery_row = (i == 0) ? battery_idx : (i - 1 < other_idx.size ()) ? other_idx[i - 1] : -1;
+        m.battery_row = ((battery_row >= 0) && (battery_row < num_rows)) ? battery_row : -1;
+
+        BrainFlowInputParams board_params = params;
+        board_params.ip_address = m.ip;
+        board_params.other_info.clear ();
+        m.board.reset (new VrchatBoard (
+            (m.channels == CHANNELS_PER_ADS1299) ? VRCHAT_BOARD_8CH_ID : VRCHAT_BOARD_ID, board_params));
+        m.board->aggregate_ = this;
+        m.board->member_index_ = (int)i;
+        m.board->board_ip_ = m.ip;
+        m.board->board_channels_ = m.channels;
+
+        safe_logger (spdlog::level::info, "Aggregate board {}: {} at {}, {} channels from row {}", i, m.id, m.ip,
+            m.channels, m.eeg_rows.empty () ? -1 : m.eeg_rows[0]);
+        members_.push_back (std::move (m));
+    }
+    discovered_ip_ = members_.front ().ip;
 
-    // Statistics counters for debugging/monitoring. Not exposed via BrainFlow API currently,
-    // but could be logged or made available through config_board() if needed for diagnostics.
-    unsigned long datagram_count = 0;     // Total UDP packets received
-    unsigned long frame_count = 0;        // Total EEG frames processed  
-    unsigned long bad_packet_count = 0;   // Packets with wrong size/format
+    return (int)BrainFlowExitCodes::STATUS_OK;
+}
 
-    // ----------- Main Reception Loop -----------
-    while (keep_alive_)
+int VrchatBoard::start_aggregate ()
+{
+    /*
+     * Unicast sys start_cnt to N boards one after another starts them a command round trip apart (several ms
+     * over Wi-Fi). One broadcast reaches all of them in the same frame, they start within a fraction of a ms.
+     * Boards take a broadcast command only from a PC they stream to (fw 6+), boards of other PCs on the same
+     * network ignore it. With older firmware, or sync_start=0, it's one by one.
+     * Every board answers the broadcast to us directly, a board that didn't gets the command again on its own.
+     */
+    std::string response;
+    bool sync = sync_start_;
+    for (const AggregateMember &m : members_)
     {
-        // Receive UDP datagram (blocking with timeout)
-        int bytes_received = data_srv_->recv (recv_buffer.data (), static_cast<int>(recv_buffer.size ()));
-        
-        if (bytes_received <= 0)
+        if (sync && (m.firmware < FW_BROADCAST_COMMANDS))
         {
-            // No data received - either timeout or error. Both are normal:
-            // - Timeout: SocketServerUDP has internal timeout (varies by platform, typically 100-1000ms)
-            //   This allows thread to periodically check keep_alive_ flag and exit cleanly
-            // - Error: Network temporarily unavailable, will retry on next loop iteration
-            continue;
+            safe_logger (spdlog::level::warn, "Board {} has firmware {}, boards are started one by one", m.id,
+                m.firmware);
+            sync = false;
         }
+    }
+    if (!sync)
+    {
+        return config_board ("sys start_cnt", response);
+    }
 
-        // ----------- Validate Packet Size -----------
-        // Valid packet must be: n*FRAME_SIZE + BATTERY_SIZE bytes (n frames + battery)
-        if (bytes_received < FRAME_SIZE + BATTERY_SIZE)
+    static const char command[] = "sys start_cnt";
+    std::vector<bool> confirmed (members_.size (), false);
+    {
+        std::lock_guard<std::mutex> lock (ctrl_mutex_);
+
+        int broadcast = 1;
+        setsockopt (ctrl_socket_, SOL_SOCKET, SO_BROADCAST, (const char*)&broadcast, sizeof(broadcast));
+        struct sockaddr_in dest_addr;
+        memset (&dest_addr, 0, sizeof(dest_addr));
+        dest_addr.sin_family = AF_INET;
+        dest_addr.sin_addr.s_addr = htonl (INADDR_BROADCAST);
+        dest_addr.sin_port = htons (ctrl_port_);
+        if (sendto (ctrl_socket_, command, sizeof(command) - 1, 0, (struct sockaddr*)&dest_addr, sizeof(dest_addr)) < 0)
         {
-            // Packet too small
-            ++bad_packet_count;
-            safe_logger (spdlog::level::warn, 
-                "Packet too small: {} bytes (minimum: {})", bytes_received, FRAME_SIZE + BATTERY_SIZE);
-            continue;
+            safe_logger (spdlog::level::warn, "Broadcast sys start_cnt failed, boards are started one by one");
         }
-        
-        if ((bytes_received - BATTERY_SIZE) % FRAME_SIZE != 0)
+        else
         {
-            // Packet size doesn't match expected format
-            ++bad_packet_count;
-            safe_logger (spdlog::level::warn, 
-                "Invalid packet size: {} bytes (not n*{} + {})", bytes_received, FRAME_SIZE, BATTERY_SIZE);
-            continue;
+            // Replies until every board answered or one CONTROL_SOCKET_TIMEOUT_MS went by without any.
+            // Our own broadcast comes back too, it's from no board and skipped like anything else foreign.
+            size_t num_confirmed = 0;
+            char buffer[256];
+            while (num_confirmed < members_.size ())
+            {
+                struct sockaddr_in from_addr;
+                socklen_t from_len = sizeof(from_addr);
+                const int bytes = recvfrom (ctrl_socket_, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*)&from_addr,
+                                            &from_len);
+                if (bytes <= 0)
+                {
+                    break;
+                }
+                buffer[bytes] = '\0';
+                for (size_t i = 0; i < members_.size (); ++i)
+                {
+                    if ((members_[i].addr == from_addr.sin_addr.s_addr) && !confirmed[i])
+                    {
+                        confirmed[i] = true;
+                        ++num_confirmed;
+                        if (strstr (buffer, "ERR") != nullptr)
+                        {
+                            safe_logger (spdlog::level::err, "Board {} returned error for '{}': {}", members_[i].id,
+                                command, buffer);
+                        }
+                    }
+                }
+            }
         }
+    }
 
-        // Calculate number of frames in this packet
-        const int frames_in_packet = (bytes_received - BATTERY_SIZE) / FRAME_SIZE;
-        ++datagram_count;
+    int result = (int)BrainFlowExitCodes::STATUS_OK;
+    for (size_t i = 0; i < members_.size (); ++i)
+    {
+        if (!confirmed[i])
+        {
+            safe_logger (spdlog::level::warn, "Board {} didn't confirm the broadcast start, sending it directly",
+                members_[i].id);
+            const int board_result = send_command (members_[i].ip, command, response);
+            if (result == (int)BrainFlowExitCodes::STATUS_OK) result = board_result;
+        }
+    }
+    return result;
+}
 
-        // ----------- Extract Battery Voltage -----------
-        // Last BATTERY_SIZE bytes contain battery voltage as IEEE 754 32-bit float in little-endian format.
-        // Little-endian = least significant byte first. Example: float 12.5 = 0x41480000 in hex,
-        // stored as bytes: [0x00, 0x00, 0x48, 0x41]. This is ESP32/Arduino default byte order.
-        // memcpy handles endianness correctly on all platforms.
-        float battery_voltage;
-        memcpy(&battery_voltage, &recv_buffer[bytes_received - BATTERY_SIZE], sizeof(float));
+void VrchatBoard::aggregate_recv_thread ()
+{
+    /*
+     * recv_thread of an aggregate session. Which ring a datagram belongs in is only known once it's read, so
+     * a batch goes into a staging buffer first (recvmmsg with sender addresses on Linux, recvfrom elsewhere),
+     * then each datagram is copied into the ring of the board that sent it and that board's read_thread is woken.
+     * A copy of 1.5 kB per datagram costs nothing next to decoding it.
+     *
+     * A board whose ring is full loses the datagram (counted as its ring full), waiting for it like recv_thread
+     * does would hold up every other board too. Datagrams of senders that are no member are dropped.
+     */
+    std::vector<uint8_t> staging ((size_t)RX_BATCH * RECV_BUFFER_SIZE);
+    std::vector<struct sockaddr_in> senders (RX_BATCH);
+    std::vector<int> sizes (RX_BATCH);
+    std::vector<bool> woken (members_.size ());
+#ifdef __linux__
+    std::vector<struct mmsghdr> msgs (RX_BATCH);
+    std::vector<struct iovec> iovs (RX_BATCH);
+#endif
 
-        // ----------- Process Each Frame in Packet -----------
-        for (int frame_idx = 0; frame_idx < frames_in_packet; ++frame_idx)
+    while (keep_alive_)
+    {
+#ifdef __linux__
+        for (int i = 0; i < RX_BATCH; ++i)
         {
-            // Calculate offset to current frame
-            const uint8_t *frame_data = recv_buffer.data () + (frame_idx * FRAME_SIZE);
+            iovs[i].iov_base = &staging[(size_t)i * RECV_BUFFER_SIZE];
+            iovs[i].iov_len  = RECV_BUFFER_SIZE;
+            memset (&msgs[i], 0, sizeof (msgs[i]));
+            msgs[i].msg_hdr.msg_iov     = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+            msgs[i].msg_hdr.msg_name    = &senders[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof (senders[i]);
+        }
 
-            // ----------- Parse 24-bit Samples -----------
-            // Each channel uses 3 bytes to represent one sample value. The bytes are arranged in big-endian format,
-            // meaning the most significant byte (MSB - the byte with the largest value contribution) comes first.
-            for (size_t ch = 0; ch < eeg_idx.size (); ++ch)
-            {
-                // Extract 3 bytes for this channel
-                const int byte_offset = ch * BYTES_PER_CHANNEL;
-                
-                // Combine 3 bytes into 24-bit unsigned value. Big-endian byte order means:
-                // byte[0] = MSB (most significant), byte[2] = LSB (least significant)
-                // Example: bytes [0x12, 0x34, 0x56] become 0x123456 = 1,193,046 decimal
-                uint32_t raw_24bit = (frame_data[byte_offset]     << 16) |  // MSB shifted to bits 23-16
-                                     (frame_data[byte_offset + 1] << 8)  |  // Middle byte to bits 15-8
-                                      frame_data[byte_offset + 2];          // LSB stays in bits 7-0
-                
-                // Sign-extension: Convert 24-bit signed to 32-bit signed while preserving sign.
-                // This works by shifting left 8 bits (putting the 24-bit value in the upper bits of a 32-bit int),
-                // then arithmetic right shift 8 bits (which replicates the sign bit). Branchless technique
-                // avoids if-statements, improving performance by preventing CPU pipeline stalls.
-                int32_t raw_value = (int32_t)(raw_24bit << 8) >> 8;
-                
-                // Convert the raw ADC value to actual voltage and store in BrainFlow's data package
-                package[eeg_idx[ch]] = raw_value * ADS1299_SCALE;
-            }
+        const int received = recvmmsg (data_socket_, msgs.data (), RX_BATCH, MSG_WAITFORONE, nullptr);
+        if (received <= 0)
+        {
+            // Timeout (lets us check keep_alive_) or temporary network error, both are normal
+            continue;
+        }
+        for (int i = 0; i < received; ++i)
+        {
+            sizes[i] = (int)msgs[i].msg_len;
+        }
+#else
+        socklen_t sender_len = sizeof (senders[0]);
+        sizes[0] = recvfrom (data_socket_, (char*)staging.data (), RECV_BUFFER_SIZE, 0,
+                             (struct sockaddr*)&senders[0], &sender_len);
+        if (sizes[0] <= 0)
+        {
+            // Timeout (lets us check keep_alive_) or temporary network error, both are normal
+            continue;
+        }
+        const int received = 1;
+#endif
+        const double now = get_timestamp ();
 
-            // ----------- Extract Hardware Timestamp -----------
-            // Bytes 48-51 contain a 32-bit unsigned integer timestamp from the board's internal clock.
-            // Format: little-endian, units of 8 microseconds since board power-on.
-            // We store this to detect packet loss (gaps > expected interval) and measure timing jitter.
-            if ((hw_timestamp_idx >= 0) && (hw_timestamp_idx < num_rows))
+        std::fill (woken.begin (), woken.end (), false);
+        for (int i = 0; i < received; ++i)
+        {
+            for (size_t m = 0; m < members_.size (); ++m)
             {
-                uint32_t hw_timestamp;
-                memcpy(&hw_timestamp, &frame_data[48], sizeof(uint32_t));
-                // Convert to seconds: multiply by 8 microseconds per tick
-                double hw_time_seconds = hw_timestamp * 0.000008;
-                
-                // On first packet, calculate offset to align hardware time with PC time
-                if (!first_packet_received_)
+                if (members_[m].addr != senders[i].sin_addr.s_addr)
+                {
+                    continue;
+                }
+                VrchatBoard &b = *members_[m].board;
+                const uint32_t head = b.rx_head_.load (std::memory_order_relaxed);
+                if (head - b.rx_tail_.load (std::memory_order_acquire) >= RX_RING_SLOTS)
                 {
-                    // Get PC timestamp when first packet is received (UNIX microseconds)
-                    double pc_timestamp = get_timestamp();
-
-                    timestamp_offset_ = pc_timestamp - hw_time_seconds;
-                    first_packet_received_ = true;
-                    safe_logger (spdlog::level::debug, 
-                        "Timestamp alignment: PC={:.6f}, HW={:.6f}, Offset={:.6f}", 
-                        pc_timestamp, hw_time_seconds, timestamp_offset_);
+                    ++b.rx_ring_full_;
+                    break;
                 }
-                
-                // Apply offset to convert hardware time to PC time
-                package[hw_timestamp_idx] = hw_time_seconds + timestamp_offset_;
+                const uint32_t slot = head & (RX_RING_SLOTS - 1);
+                memcpy (&b.rx_data_[(size_t)slot * RECV_BUFFER_SIZE], &staging[(size_t)i * RECV_BUFFER_SIZE], sizes[i]);
+                b.rx_size_[slot] = sizes[i];
+                b.rx_time_[slot] = now;
+                b.rx_head_.store (head + 1, std::memory_order_release);
+                raise_hwm (b.rx_ring_hwm_, head + 1 - b.rx_tail_.load (std::memory_order_relaxed));
+                raise_hwm (b.rx_batch_hwm_, (uint32_t)received);
+                woken[m] = true;
+                break;
             }
+        }
 
-            // ----------- Add Battery Voltage -----------
-            // Store battery voltage in configured channel. The bounds check prevents writing
-            // past array end if board description specifies invalid channel number.
-            if ((battery_idx >= 0) && (battery_idx < num_rows))
+        // Same handshake as recv_thread, once per board and batch
+        for (size_t m = 0; m < members_.size (); ++m)
+        {
+            if (woken[m])
             {
-                package[battery_idx] = battery_voltage;
+                VrchatBoard &b = *members_[m].board;
+                {
+                    std::lock_guard<std::mutex> lock (b.rx_wait_mutex_);
+                }
+                b.rx_wait_cv_.notify_one ();
             }
-
-            // ----------- Send to BrainFlow -----------
-            // Push the complete data package to BrainFlow's ring buffer. This makes the data available
-            // to the user's application via get_board_data() or similar BrainFlow API calls.
-            // Channels 18, 19, 20 remain as zeros (initialized at buffer creation) - reserved for user
-            // markers and future features. Users can write to marker channel via BrainFlow API.
-            push_package (package.data (), (int)BrainFlowPresets::DEFAULT_PRESET);
-            ++frame_count;
         }
     }
 }
 
-// ====================================================================
-//                    KEEP-ALIVE THREAD (FLOOF)
-// ====================================================================
+void VrchatBoard::merge_frames (int member, const double *samples, const double *times, int frames, double battery,
+    double period)
+{
+    std::lock_guard<std::mutex> lock (align_mutex_);
+    AggregateMember &m = members_[member];
+    m.period = period;
+    for (int f = 0; f < frames; ++f)
+    {
+        AlignedFrame frame;
+        frame.time = times[f];
+        frame.battery = battery;
+        memcpy (frame.samples, samples + (size_t)f * m.channels, m.channels * sizeof (double));
+        m.frames.push_back (frame);
+    }
+    while (m.frames.size () > ALIGN_MAX_QUEUE)
+    {
+        m.frames.pop_front ();
+        ++m.skipped;
+    }
+    align_frames ();
+}
 
-void VrchatBoard::ping_thread ()
+void VrchatBoard::align_frames ()
 {
     /*
-     * This thread sends periodic "floof" messages to the board.
-     * 
-     * PURPOSE:
-     * - Maintains UDP connection state (keeps the connection "alive")
-     * - Prevents board timeout - board firmware stops sending data if no messages received for 100 seconds
-     * - Helps with NAT traversal - home routers/firewalls close inactive UDP mappings after 30-300 seconds,
-     *   our 5-second interval ensures the path stays open
-     * 
-     * The word "floof" is an arbitrary keep-alive message that the board recognizes.
-     * Any message would work, but "floof" is short and unlikely to conflict with commands.
+     * First board sets the rows: one combined row per frame of it, at its (PC) time t. Every other board gives
+     * its frame closest to t, i.e. within half a sample period of it, timelines are drift corrected by each
+     * board's clock model so they don't walk apart. Frames older than that had no row to go to (board started
+     * earlier, or ran faster for a moment) and are skipped. No frame within half a period - it was lost or
+     * comes later: while the board has nothing newer queued, the row waits for it, up to ALIGN_MAX_WAIT_SECONDS
+     * of the first board's frames, then the previous frame is held. Same sample rate on every board is assumed,
+     * the boards are configured by the same commands.
      */
+    AggregateMember &ref = members_.front ();
+    while (!ref.frames.empty ())
+    {
+        const double row_time = ref.frames.front ().time;
+        const double half_period = 0.5 * ref.period;
+        const bool waited_enough = (ref.frames.back ().time - row_time) > ALIGN_MAX_WAIT_SECONDS;
 
-    using namespace std::chrono_literals;  // Enables 5s syntax instead of std::chrono::seconds(5)
-    unsigned long floof_count = 0;  // Track successful keep-alives for debugging connection stability
+        bool ready = true;
+        for (size_t i = 1; i < members_.size (); ++i)
+        {
+            AggregateMember &m = members_[i];
+            while (!m.frames.empty () && (m.frames.front ().time < row_time - half_period))
+            {
+                m.frames.pop_front ();
+                ++m.skipped;
+            }
+            ready = ready && (!m.frames.empty () || waited_enough);
+        }
+        if (!ready)
+        {
+            break;
+        }
 
-    // Send keep-alive every KEEPALIVE_INTERVAL_SEC seconds
-    while (keep_floof_)
-    {
-        if (ctrl_socket_ >= 0 && !board_ip_.empty())  // Only send if socket is open AND we know where to send
+        for (size_t i = 0; i < members_.size (); ++i)
         {
-            // Protect control socket with mutex. This prevents config_board() from interfering
-            // with our keep-alive messages. Without this lock, responses could get mixed up.
-            std::lock_guard<std::mutex> lock(ctrl_mutex_);
-            
-            // Prepare destination address
-            struct sockaddr_in dest_addr;
-            memset(&dest_addr, 0, sizeof(dest_addr));  // Zero-initialize structure
-            dest_addr.sin_family = AF_INET;
-            dest_addr.sin_port = htons(ctrl_port_);
-            inet_pton(AF_INET, board_ip_.c_str(), &dest_addr.sin_addr);  // Board IP was set during prepare_session
-            
-            // Send the keep-alive message
-            int result = sendto(ctrl_socket_, "floof", 5, 0,
-                               (struct sockaddr*)&dest_addr, sizeof(dest_addr));
-            
-            if (result > 0)
+            AggregateMember &m = members_[i];
+            if (!m.frames.empty () && (m.frames.front ().time < row_time + half_period))
             {
-                ++floof_count;
+                m.last = m.frames.front ();
+                m.frames.pop_front ();
+                ++m.used;
             }
             else
             {
-                safe_logger (spdlog::level::warn, 
-                    "Failed to send keep-alive #{}: {}", floof_count + 1, result);
+                ++m.held;
             }
+            for (int ch = 0; ch < m.channels; ++ch)
+            {
+                if (m.eeg_rows[ch] >= 0) align_row_[m.eeg_rows[ch]] = m.last.samples[ch];
+            }
+            if (m.battery_row >= 0) align_row_[m.battery_row] = m.last.battery;
         }
-        
-        // Wait before next keep-alive
-        std::this_thread::sleep_for (std::chrono::seconds(KEEPALIVE_INTERVAL_SEC));
+        if (align_time_row_ >= 0) align_row_[align_time_row_] = row_time;
+
+        push_package (align_row_.data (), (int)BrainFlowPresets::DEFAULT_PRESET);
+        ++align_rows_;
     }
 }
 
@@ -878,16 +3082,34 @@ void VrchatBoard::ping_thread ()
 //                        HELPER FUNCTIONS
 // ====================================================================
 
-bool VrchatBoard::wait_for_beacon (int timeout_ms)
+// Value of "key=value" in a MEOW_HERE reply, empty if it's not there
+static std::string reply_field (const std::string &reply, const std::string &key)
+{
+    const std::string tag = " " + key + "=";
+    const size_t pos = reply.find (tag);
+    if (pos == std::string::npos)
+    {
+        return "";
+    }
+    const size_t start = pos + tag.size ();
+    return reply.substr (start, reply.find (' ', start) - start);
+}
+
+bool VrchatBoard::wait_for_beacon (int timeout_ms, const std::string &board_id)
 {
     /*
-     * Wait for a beacon packet from the board to discover its IP address. The board periodically sends UDP packets 
-     * to the control port. This implementation uses raw sockets to extract the sender's IP, then switches back to 
-     * BrainFlow's socket classes for normal operation.
+     * Find the board IP. A MEOW_PROBE is broadcast to the control port and every board answers right away with
+     * MEOW_HERE (its MAC, firmware, ports, stream config and current peer), so this takes one round trip instead
+     * of up to a second of waiting for the MEOW_MEOW beacon. Probe is repeated every PROBE_RETRY_MS while nobody
+     * answered (it's UDP), after the first reply we wait DISCOVERY_COLLECT_MS more for the other boards, then pick
+     * one: board_id if given, or the first that is not claimed by another PC. A MEOW_MEOW beacon still works,
+     * for boards with older firmware (no board_id match possible there, beacons carry no ID).
+     * This implementation uses raw sockets to extract the sender's IP.
      * 
      * Note: This function handles its own Windows socket initialization if needed.
      * 
      * @param timeout_ms Maximum time to wait in milliseconds
+     * @param board_id MAC of the board to pick, empty - any
      * @return true if board discovered, false if timeout
      */
     
@@ -920,6 +3142,25 @@ bool VrchatBoard::wait_for_beacon (int timeout_ms)
     {
         // Non-critical error, continue
     }
+
+    // Probe goes to the broadcast address. Without it only the beacon path is left, still works, just slower
+    int broadcast = 1;
+    if (setsockopt(discovery_sock, SOL_SOCKET, SO_BROADCAST, 
+                   (const char*)&broadcast, sizeof(broadcast)) < 0)
+    {
+        safe_logger (spdlog::level::warn, "Discovery socket can't broadcast, waiting for board beacon only");
+    }
+    struct sockaddr_in probe_addr;
+    memset(&probe_addr, 0, sizeof(probe_addr));
+    probe_addr.sin_family = AF_INET;
+    probe_addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    probe_addr.sin_port = htons(ctrl_port_);
+    const std::string probe = std::string (PROBE_WORD) + " ctrl=" + std::to_string (ctrl_port_) +
+                              " data=" + std::to_string (data_port_);
+
+    // MACs come upper case from the board
+    std::string wanted_id = board_id;
+    std::transform (wanted_id.begin (), wanted_id.end (), wanted_id.begin (), ::toupper);
     
     // Bind to control port
     struct sockaddr_in bind_addr;
@@ -950,10 +3191,14 @@ bool VrchatBoard::wait_for_beacon (int timeout_ms)
     fcntl(discovery_sock, F_SETFL, flags | O_NONBLOCK);
 #endif
     
-    // Wait for beacon with timeout
+    // Probe, then wait for replies (or a beacon) with timeout
     auto start_time = std::chrono::steady_clock::now();
-    char buffer[256];  // Beacon messages are typically short (~20 bytes), 256 is generous
+    auto probe_time = start_time - std::chrono::milliseconds (PROBE_RETRY_MS);  // first probe right away
+    auto first_reply_time = start_time;
+    char buffer[512];  // Beacon is 9 bytes, a probe reply ~200, 512 is generous
     bool discovered = false;
+    bool have_candidate = false;  // Some board answered (the wanted one, if board_id is given)
+    discovered_boards_.clear ();
     
     while (!discovered)
     {
@@ -965,6 +3210,23 @@ bool VrchatBoard::wait_for_beacon (int timeout_ms)
         {
             break;
         }
+
+        // Wanted board answered, or replies collected for DISCOVERY_COLLECT_MS - every board that heard the probe
+        // has answered by now
+        if (have_candidate && (!wanted_id.empty () ||
+            (std::chrono::duration_cast<std::chrono::milliseconds>(now - first_reply_time).count() >= DISCOVERY_COLLECT_MS)))
+        {
+            break;
+        }
+
+        // (Re)send probe while nobody (or not the wanted board) answered
+        if (!have_candidate &&
+            (std::chrono::duration_cast<std::chrono::milliseconds>(now - probe_time).count() >= PROBE_RETRY_MS))
+        {
+            sendto(discovery_sock, probe.c_str(), static_cast<int>(probe.size()), 0,
+                   (struct sockaddr*)&probe_addr, sizeof(probe_addr));
+            probe_time = now;
+        }
         
         // Try to receive a packet
         struct sockaddr_in sender_addr;
@@ -981,22 +3243,84 @@ bool VrchatBoard::wait_for_beacon (int timeout_ms)
             char ip_str[INET_ADDRSTRLEN];
             inet_ntop(AF_INET, &sender_addr.sin_addr, ip_str, INET_ADDRSTRLEN);
             
-            discovered_ip_ = std::string(ip_str);
-            discovered = true;
-            
-            // Null terminate beacon content for safety if we want to log it. The beacon typically contains
-            // a board ID string like "VRChatEEG-v1.0". Without null termination, string functions could
-            // read past buffer end. Currently we don't use the content, but this makes it safe if we do.
+            // Null terminate so the content can be compared and logged as a string
             buffer[bytes_received] = '\0';
-            
-            safe_logger (spdlog::level::info, "Board discovered at {}", discovered_ip_);
+            const std::string message (buffer);
+
+            if (message.compare (0, sizeof(PROBE_REPLY) - 1, PROBE_REPLY) == 0)
+            {
+                // Probe reply - note the board, the choice is made once everyone had time to answer
+                DiscoveredBoard board { ip_str, reply_field (message, "id"), message };
+                bool known = false;
+                for (const DiscoveredBoard &b : discovered_boards_)
+                {
+                    known = known || (b.ip == board.ip);
+                }
+                if (!known)
+                {
+                    if (!have_candidate && (wanted_id.empty () || (board.id == wanted_id)))
+                    {
+                        have_candidate = true;
+                        first_reply_time = now;
+                    }
+                    safe_logger (spdlog::level::info, "Board {} at {}: {}", board.id, board.ip, message);
+                    if (reply_field (message, "data") != std::to_string (data_port_))
+                    {
+                        safe_logger (spdlog::level::warn, "Board {} sends data to port {}, driver listens on {}",
+                            board.id, reply_field (message, "data"), data_port_);
+                    }
+                    discovered_boards_.push_back (board);
+                }
+            }
+            else if ((message == BOARD_BEACON) && wanted_id.empty () && discovered_boards_.empty ())
+            {
+                // Beacon of a board that doesn't answer probes (older firmware) - take it as before
+                discovered_ip_ = std::string(ip_str);
+                discovered = true;
+                safe_logger (spdlog::level::info, "Board discovered at {} (beacon)", discovered_ip_);
+            }
+            // Anything else on the control port (our own probe echo, other PCs' traffic) is ignored
         }
         else
         {
             // No data available - sleep briefly to avoid busy-waiting (consuming 100% CPU).
-            // 10ms is a good balance: responsive enough to catch beacons quickly (beacon sent every ~100ms)
-            // but not so frequent that we waste CPU. At 10ms sleep, we check 100 times per second.
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // 2 ms keeps the probe round trip visible as such and still costs nothing.
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    // Pick one of the boards that answered the probe
+    if (!discovered && !discovered_boards_.empty ())
+    {
+        const DiscoveredBoard *pick = nullptr;
+        for (const DiscoveredBoard &b : discovered_boards_)
+        {
+            if (!wanted_id.empty ())
+            {
+                if (b.id == wanted_id) pick = &b;
+            }
+            else if ((pick == nullptr) && (reply_field (b.info, "peer") == "none"))
+            {
+                pick = &b;
+            }
+        }
+        if ((pick == nullptr) && wanted_id.empty ())
+        {
+            // All of them talk to some PC already, maybe this one from an earlier session
+            pick = &discovered_boards_.front ();
+        }
+
+        if (pick != nullptr)
+        {
+            discovered_ip_ = pick->ip;
+            discovered = true;
+            safe_logger (spdlog::level::info, "Board discovered at {} ({} of {} answered the probe)",
+                discovered_ip_, pick->id, discovered_boards_.size ());
+        }
+        else
+        {
+            safe_logger (spdlog::level::err, "No board {} among the {} that answered the probe",
+                wanted_id, discovered_boards_.size ());
         }
     }
     
@@ -1011,20 +3335,171 @@ bool VrchatBoard::wait_for_beacon (int timeout_ms)
 }
 
 
+int VrchatBoard::open_data_socket ()
+{
+    /*
+     * Raw UDP socket instead of BrainFlow's SocketServerUDP - we need the descriptor for SO_RCVBUF and recvmmsg().
+     * Kernel receive buffer is made as large as the OS allows, it holds the stream while recv_thread is not running.
+     */
+    
+    // Initialize platform-specific socket support if needed
+#ifdef _WIN32
+    if (!wsa_initialized_)
+    {
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        {
+            safe_logger (spdlog::level::err, "Failed to initialize Winsock");
+            return (int)BrainFlowExitCodes::GENERAL_ERROR;
+        }
+        wsa_initialized_ = true;
+    }
+#endif
+
+    data_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (data_socket_ < 0)
+    {
+        safe_logger (spdlog::level::err, "Failed to create data socket");
+        data_socket_ = -1;
+        close_sockets ();
+        return (int)BrainFlowExitCodes::GENERAL_ERROR;
+    }
+
+    // Larger kernel buffer. Not fatal if refused, the OS default just holds less of the stream.
+    // Linux reports twice the granted size (bookkeeping overhead included), capped by net.core.rmem_max.
+    int rcvbuf = DATA_SOCKET_RCVBUF;
+    setsockopt(data_socket_, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf));
+    int granted = 0;
+    socklen_t granted_len = sizeof(granted);
+    getsockopt(data_socket_, SOL_SOCKET, SO_RCVBUF, (char*)&granted, &granted_len);
+    safe_logger (spdlog::level::info, "Data socket receive buffer: {} bytes (requested {})", granted, rcvbuf);
+
+    // Board multicasts the data (sys multicast <group>): "multicast=<group>" in other_info joins the group.
+    // Port is shared then, so the GUI or another session on the same machine can receive the stream as well.
+    std::string multicast_group;
+    size_t mcast_pos = params.other_info.find ("multicast=");
+    if (mcast_pos != std::string::npos)
+    {
+        multicast_group = params.other_info.substr (mcast_pos + 10);
+        multicast_group = multicast_group.substr (0, multicast_group.find (' '));
+        int reuse = 1;
+        setsockopt(data_socket_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    }
+
+    struct sockaddr_in bind_addr;
+    memset(&bind_addr, 0, sizeof(bind_addr));
+    bind_addr.sin_family = AF_INET;
+    bind_addr.sin_addr.s_addr = INADDR_ANY;
+    bind_addr.sin_port = htons(data_port_);
+    if (bind(data_socket_, (struct sockaddr*)&bind_addr, sizeof(bind_addr)) < 0)
+    {
+        safe_logger (spdlog::level::err, "Failed to bind data port {} - port may be in use", data_port_);
+        close_sockets ();
+        return (int)BrainFlowExitCodes::UNABLE_TO_OPEN_PORT_ERROR;
+    }
+
+    if (!multicast_group.empty ())
+    {
+        struct ip_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if ((inet_pton(AF_INET, multicast_group.c_str(), &mreq.imr_multiaddr) != 1) ||
+            (setsockopt(data_socket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&mreq, sizeof(mreq)) < 0))
+        {
+            safe_logger (spdlog::level::err, "Failed to join multicast group '{}'", multicast_group);
+            close_sockets ();
+            return (int)BrainFlowExitCodes::UNABLE_TO_OPEN_PORT_ERROR;
+        }
+        safe_logger (spdlog::level::info, "Data socket joined multicast group {}", multicast_group);
+    }
+
+    // Short timeout so recv_thread notices keep_alive_ quickly when the stream is idle
+#ifdef _WIN32
+    DWORD timeout = DATA_SOCKET_TIMEOUT_MS;
+    setsockopt(data_socket_, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+#else
+    struct timeval tv;
+    tv.tv_sec = DATA_SOCKET_TIMEOUT_MS / 1000;
+    tv.tv_usec = (DATA_SOCKET_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(data_socket_, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+#endif
+
+    return (int)BrainFlowExitCodes::STATUS_OK;
+}
+
+
+int VrchatBoard::handle_driver_command (const std::string &config, std::string &response)
+{
+    if ((config == "driver clock") && !members_.empty ())
+    {
+        response.clear ();
+        for (const AggregateMember &m : members_)
+        {
+            std::lock_guard<std::mutex> lock (m.board->clock_mutex_);
+            response += (response.empty () ? "" : "; ") + m.id + ": " + m.board->clock_.describe ();
+        }
+        return (int)BrainFlowExitCodes::STATUS_OK;
+    }
+
+    if (config == "driver clock")
+    {
+        std::lock_guard<std::mutex> lock (clock_mutex_);
+        response = clock_.describe ();
+        return (int)BrainFlowExitCodes::STATUS_OK;
+    }
+
+    if ((config == "driver stats") && !members_.empty ())
+    {
+        response.clear ();
+        for (const AggregateMember &m : members_)
+        {
+            std::lock_guard<std::mutex> lock (m.board->stats_mutex_);
+            response += (response.empty () ? "" : "; ") + m.id + ": " + m.board->stats_.describe ();
+        }
+        return (int)BrainFlowExitCodes::STATUS_OK;
+    }
+
+    if (config == "driver stats")
+    {
+        std::lock_guard<std::mutex> lock (stats_mutex_);
+        response = stats_.describe ();
+        return (int)BrainFlowExitCodes::STATUS_OK;
+    }
+
+    if (config == "driver align")
+    {
+        std::lock_guard<std::mutex> lock (align_mutex_);
+        response = "rows=" + std::to_string (align_rows_);
+        for (const AggregateMember &m : members_)
+        {
+            response += "; " + m.id + ": used=" + std::to_string (m.used) + " held=" + std::to_string (m.held) +
+                        " skipped=" + std::to_string (m.skipped) + " queued=" + std::to_string (m.frames.size ());
+        }
+        return (int)BrainFlowExitCodes::STATUS_OK;
+    }
+
+    safe_logger (spdlog::level::warn, "Unknown driver command: {}", config);
+    response = "UNKNOWN_DRIVER_COMMAND";
+    return (int)BrainFlowExitCodes::INVALID_ARGUMENTS_ERROR;
+}
+
+
 void VrchatBoard::close_sockets ()
 {
     /*
-     * Safely close and delete all socket objects. Called during session cleanup to ensure
-     * all network resources are properly released. All operations are safe on uninitialized
-     * objects: delete nullptr is no-op, close(-1) returns error but doesn't crash.
+     * Safely close all sockets. Called during session cleanup and on prepare_session errors
+     * to ensure all network resources are properly released. Sockets that were never opened are -1 and skipped.
      */
     
     // Close data reception socket
-    if (data_srv_) 
+    if (data_socket_ >= 0) 
     { 
-        data_srv_->close (); 
-        delete data_srv_; 
-        data_srv_ = nullptr;
+#ifdef _WIN32
+        closesocket(data_socket_);
+#else
+        close(data_socket_);
+#endif
+        data_socket_ = -1;
     }
     
     // Close control socket
@@ -1037,6 +3512,17 @@ void VrchatBoard::close_sockets ()
 #endif
         ctrl_socket_ = -1;
     }
+
+    // Close serial port of a board on USB, serial_thread is joined by now
+    if (serial_ >= 0)
+    {
+#ifdef _WIN32
+        CloseHandle ((HANDLE)serial_);
+#else
+        close ((int)serial_);
+#endif
+        serial_ = -1;
+    }
     
     // Clean up Windows sockets once at the end
 #ifdef _WIN32
@@ -3,7 +3,8 @@
  * vrchat_board.h - BrainFlow UDP driver for VRChat EEG Board
  * 
  * OVERVIEW:
- * This class implements BrainFlow support for a custom 16-channel EEG board based on ESP32 + ADS1299. 
+ * This class implements BrainFlow support for a custom 16-channel EEG board based on ESP32 + ADS1299
+ * (or its 8-channel build with one ADS1299, VRCHAT_BOARD_8CH descriptor). 
  * The board communicates via UDP (a fast network protocol that doesn't guarantee delivery):
  * 
  * - Data Port (default 5001): Receives high-speed EEG data packets
@@ -47,9 +48,24 @@
  * board.stop_stream();
  * board.release_session();
  * ```
+ * 
+ * WIRED, BOARD ON USB (params.serial_port = "/dev/ttyACM0", "COM5", ...):
+ * No sockets and no discovery, the same datagrams and commands go over the board's USB CDC port in frames
+ * [0xA5][0x5A][type][length, uint16 LE][payload] (firmware usb_link.h). No Wi-Fi in the path - no loss, no jitter,
+ * and the board may send up to 1000 packets/s (sys latency 1). One board per session, no aggregate.
+ * 
+ * SEVERAL BOARDS AS ONE (VRCHAT_AGGREGATE descriptor, other_info "boards=2" or "boards=<MAC>,<MAC>"):
+ * Every board streams to the same data port, datagrams are told apart by sender IP and each board's are decoded
+ * and timestamped on its own (own clock model). Frames are lined up on the first board's timeline, nearest frame
+ * of every other board within half a sample period, and pushed as one row: the boards' EEG channels back to back,
+ * in the order of the list (or by MAC). All boards start with one broadcast sys start_cnt.
  *********************************************************************/
 
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <thread>
 #include <vector>
 #include <string>
@@ -57,7 +73,145 @@
 
 #include "board.h"
 #include "board_controller.h"
-#include "socket_server_udp.h"
+
+
+/**
+ * Online model of the board clock (getTimer8us(), 32-bit, 8 us ticks, wraps every ~9.5 hours) versus PC time.
+ * - Ticks are unwrapped into a 64-bit timeline, reordered packets and board reboots are told apart from wrap
+ * - Offset PC - board is taken as the minimum over each window of board time: Wi-Fi only ever adds delay,
+ *   so the minimum is the packet that got through fastest and jitter is mostly gone from it
+ * - Linear regression over the last CLOCK_MAX_POINTS window minima gives offset and drift
+ * Used by read_thread only, config_board("driver clock") reads it under VrchatBoard::clock_mutex_.
+ */
+struct ClockModel
+{
+    static constexpr int CLOCK_MAX_POINTS = 128;
+
+    // ---------- Unwrapping ----------
+    bool started { false };
+    uint32_t last_ticks { 0 };               // Raw value of the newest packet
+    int64_t last_ticks64 { 0 };              // Same on the 64-bit timeline
+    double last_arrival { 0.0 };             // PC time it arrived
+    unsigned long wraps { 0 };
+    unsigned long resets { 0 };              // Board clock restarted (reboot), fit started over
+
+    // ---------- Current window ----------
+    double window_start { 0.0 };             // Board time (s) the window began at
+    double window_min_offset { 0.0 };        // Smallest arrival - board time in it
+    double window_min_hw { 0.0 };            // Board time of that packet
+    double window_delay_sum { 0.0 };         // Arrival delays above the model, for jitter
+    double window_delay_sq { 0.0 };
+    unsigned long window_packets { 0 };
+
+    // ---------- Fit over window minima: offset(hw) = offset + drift * (hw - ref) ----------
+    double point_hw[CLOCK_MAX_POINTS];
+    double point_offset[CLOCK_MAX_POINTS];
+    int num_points { 0 };
+    int next_point { 0 };
+    double ref { 0.0 };
+    double offset { 0.0 };
+    double drift { 0.0 };                    // Relative, 1e-6 is 1 ppm (PC clock runs faster when positive)
+    double fit_span { 0.0 };                 // Board time covered by the points, drift stays 0 until it's long enough
+    double residual_rms { 0.0 };             // Of window minima around the fit, seconds
+    double delay_mean { 0.0 };               // Arrival delay above the model and its standard deviation,
+    double jitter { 0.0 };                   // last complete window, seconds
+
+    void reset ();
+    int64_t unwrap (uint32_t ticks, double arrival);
+    void update (double hw_seconds, double arrival);
+    double to_pc (double hw_seconds) const { return hw_seconds + offset + drift * (hw_seconds - ref); }
+    std::string describe () const;
+
+private:
+    void restart_fit ();
+    void fit ();
+};
+
+
+/**
+ * Runtime statistics of one stream, for config_board("driver stats").
+ * read_thread counts into its own copy and publishes it to VrchatBoard::stats_ under stats_mutex_ every
+ * STATS_PUBLISH_SECONDS, the datagram path itself takes no lock. Latency is from the socket read (rx_time_) to the
+ * last push of the datagram, in a log histogram with 8 bins per octave from 1 us (percentiles within ~9 %).
+ */
+struct StreamStats
+{
+    static constexpr int LATENCY_BINS = 8 * 24;   // Up to 2^24 us, about 17 s
+
+    bool started { false };                  // False until the first stream of the session
+    double start_time { 0.0 };               // PC time the stream started and the snapshot was taken
+    double update_time { 0.0 };
+
+    // ---------- Datagrams ----------
+    unsigned long received { 0 };            // Taken from the receive ring, valid or not
+    unsigned long decoded { 0 };             // Valid frame / feature / impedance datagrams
+    unsigned long frames { 0 };
+    unsigned long bad { 0 };                 // Wrong size or format
+    unsigned long lost { 0 };                // Sequence numbers never seen (the network lost them, not the host)
+    unsigned long reordered { 0 };
+    unsigned long board_drop_frames { 0 };   // Frames the board dropped itself (frame index gap)
+    unsigned long fec_recovered { 0 };
+    unsigned long fec_unrecoverable { 0 };
+    unsigned long duplicates { 0 };
+    unsigned long replayed { 0 };
+    unsigned long replay_known { 0 };
+    unsigned long features { 0 };
+    unsigned long impedance { 0 };           // Impedance datagrams pushed to the ancillary preset
+    double packet_rate { 0.0 };              // Decoded datagrams/s over the last publish interval
+
+    // ---------- Host side ----------
+    unsigned long latency[LATENCY_BINS] {};  // Receive -> push, per datagram
+    unsigned long latency_count { 0 };
+    double latency_max { 0.0 };              // Seconds
+    double decode_sum { 0.0 };               // Seconds read_thread spent on each pushed datagram, ring to push
+    double decode_max { 0.0 };
+    unsigned long ring_full { 0 };           // Copied from the receive ring at publish time
+    uint32_t ring_hwm { 0 };
+    uint32_t batch_hwm { 0 };
+
+    void add_latency (double seconds);
+    double latency_percentile (double fraction) const;
+    std::string describe () const;
+};
+
+
+// One board that answered the discovery probe (MEOW_HERE, see wait_for_beacon)
+struct DiscoveredBoard
+{
+    std::string ip;
+    std::string id;                          // Board MAC, "AA:BB:CC:DD:EE:FF"
+    std::string info;                        // Whole reply: firmware, ports, stream config, state, current peer
+};
+
+
+class VrchatBoard;
+
+// Frame of one board of an aggregate session, decoded and in PC time, waiting to be lined up with the others
+struct AlignedFrame
+{
+    double time;
+    double battery;
+    double samples[16];                      // MAX_CHANNELS_PER_BOARD, 8 used by single ADS1299 boards
+};
+
+// One board of an aggregate session (other_info "boards=...")
+struct AggregateMember
+{
+    std::string ip;
+    std::string id;
+    int channels { 16 };
+    int firmware { 0 };                      // fw= of its MEOW_HERE
+    uint32_t addr { 0 };                     // ip in network byte order, datagrams are matched by it
+    std::unique_ptr<VrchatBoard> board;      // Decodes this board's datagrams, only its read_thread runs
+    std::deque<AlignedFrame> frames;         // Oldest first, under VrchatBoard::align_mutex_
+    double period { 0.0 };                   // Sample period of its stream, seconds
+    AlignedFrame last {};                    // Last frame used, held while no newer one fits
+    std::vector<int> eeg_rows;               // Rows of its channels in the combined package
+    int battery_row { -1 };
+    unsigned long used { 0 };                // Frames that went into a row
+    unsigned long held { 0 };                // Rows that got the previous frame again (lost / late)
+    unsigned long skipped { 0 };             // Frames dropped, no row of the first board matched them
+};
 
 
 class VrchatBoard : public Board
@@ -74,6 +228,12 @@ public:
      * 
      * Special params.other_info options:
      * - "discovery_timeout=5000" : Set discovery timeout in ms (default 3000)
+     * - "board_id=AA:BB:CC:DD:EE:FF" : With several boards on the network, the one with this MAC
+     * - "multicast=239.1.2.3"        : Board multicasts the data (sys multicast), join the group on the data port
+     * - "boards=2"                   : Aggregate session (VRCHAT_AGGREGATE), the first 2 boards that answer discovery
+     *                                   and are not streaming to another PC, by MAC
+     * - "boards=AA:..:01,AA:..:02"   : Aggregate session of these boards, channels in this order
+     * - "sync_start=0"               : Aggregate - start the boards one by one, not with one broadcast
      */
     VrchatBoard (int board_id, struct BrainFlowInputParams params);
     
@@ -112,6 +272,13 @@ public:
      * Useful for displaying connection info or reconnecting
      */
     std::string get_discovered_ip () const;
+
+    /**
+     * Every board that answered the probe of the last discovery, the chosen one included
+     *
+     * Boards with firmware older than the probe only show up as MEOW_MEOW beacon and are not listed here
+     */
+    std::vector<DiscoveredBoard> get_discovered_boards () const;
     
     /**
      * Start streaming EEG data from the board
@@ -141,7 +308,8 @@ public:
     int release_session () override;
     
     /**
-     * Send configuration command to the board
+     * Send configuration command to the board (every board of an aggregate session, replies joined as
+     * "<MAC>: <reply>; ...", the first error is returned)
      * 
      * Supported commands include:
      * - Filter control (sys filters_on/off, etc.)
@@ -160,22 +328,105 @@ private:
     // ====================================================================
     
     /**
-     * Worker thread for receiving and processing EEG data
-     * - Receives UDP packets containing EEG frames
-     * - Parses 24-bit samples from 16 channels  
+     * Worker thread for receiving EEG datagrams (first stage of the data pipeline)
+     * - Drains the data socket in batches (recvmmsg on Linux, one recv per call elsewhere)
+     * - Stores datagrams as they are into the receive ring, no parsing at all
+     * - Keeps the kernel buffer empty while read_thread is busy, so bursts after a Wi-Fi stall are not lost
+     */
+    void recv_thread ();
+
+    /**
+     * Worker thread for processing EEG data (second stage of the data pipeline)
+     * - Takes datagrams from the receive ring
+     * - Validates headers, decodes compressed packets, parses 24-bit samples from 16 channels
      * - Pushes data to BrainFlow's ring buffer
      */
     void read_thread ();
     
+    /**
+     * Receive thread of an aggregate session, takes recv_thread's place
+     * - Drains the data socket like recv_thread, with the sender address of every datagram
+     * - Hands each datagram to the receive ring of the board it came from, unknown senders are dropped
+     */
+    void aggregate_recv_thread ();
+
+    /**
+     * Decoded frames of one board of an aggregate session (called by that board's read_thread instead of pushing)
+     * - Queues them, then pushes every row of the first board that all the others have a frame for by now
+     * @param member Index in members_
+     * @param samples frames x channels, volts
+     * @param times PC time of every frame
+     */
+    void merge_frames (int member, const double *samples, const double *times, int frames, double battery,
+        double period);
+
+    /**
+     * Line up queued frames and push the combined rows, caller holds align_mutex_
+     */
+    void align_frames ();
+
+    /**
+     * Discover the boards of an aggregate session and set them up (members_), see other_info "boards="
+     * @return BrainFlowExitCodes::STATUS_OK, BOARD_NOT_READY_ERROR if not all of them answered,
+     *         INVALID_ARGUMENTS_ERROR if their channels don't fit into the descriptor
+     */
+    int prepare_aggregate (int timeout_ms, const std::string &boards);
+
+    /**
+     * Start every board of an aggregate session at once: one sys start_cnt to the broadcast address,
+     * the boards that didn't confirm get it again directly
+     */
+    int start_aggregate ();
+
+    /**
+     * Send one command to the control port of ip and wait for its reply (replies of other boards are skipped)
+     */
+    int send_command (const std::string &ip, const std::string &config, std::string &response);
+
+    /**
+     * Board on USB (params.serial_port): open the port, start serial_thread and the keep-alive, no sockets
+     * @return BrainFlowExitCodes::STATUS_OK, UNABLE_TO_OPEN_PORT_ERROR, or INVALID_ARGUMENTS_ERROR with boards=
+     */
+    int prepare_serial ();
+
+    /**
+     * Reads the serial port for the whole session (board on USB), takes the place of recv_thread
+     * - Finds the frames in the byte stream, the board's debug text in between is skipped
+     * - Data frames go into the receive ring while streaming, read_thread decodes them as datagrams
+     * - Replies go to serial_replies_, for serial_command
+     */
+    void serial_thread ();
+
+    /**
+     * One command as a CTRL frame, wait for the reply frame (caller holds nothing, takes ctrl_mutex_)
+     */
+    int serial_command (const std::string &config, std::string &response);
+
+    /**
+     * One frame to the board, caller holds ctrl_mutex_
+     */
+    bool serial_send (uint8_t type, const void *data, size_t len);
+
     /**
      * Worker thread for sending keep-alive messages
      * - Sends "floof" message every 5 seconds
      * - Maintains UDP connection state
      */
     void ping_thread ();
+
+    /**
+     * One "WOOF_WOOF" to the board, or to every board of an aggregate session
+     */
+    void send_keepalive ();
     
     /**
-     * Helper to close and delete all socket objects
+     * Create and bind the data socket with a large kernel receive buffer
+     * @return BrainFlowExitCodes::STATUS_OK on success
+     */
+    int open_data_socket ();
+
+    /**
+     * Helper to close and delete all socket objects (and the serial port)
      */
     void close_sockets ();
 
@@ -184,18 +435,30 @@ private:
     // ====================================================================
     
     // ---------- Network Sockets ----------
-    SocketServerUDP *data_srv_ { nullptr };  // Receives EEG data packets. Initialized to nullptr for safe
-                                             // cleanup (delete nullptr is safe) and to detect if socket was created.
+    int data_socket_ { -1 };                 // Receives EEG data packets (raw socket, needed for recvmmsg and SO_RCVBUF).
+                                             // -1 means not open, same as ctrl_socket_.
     int ctrl_socket_ { -1 };                 // Control socket (raw socket for send/recv). Initialize to -1 (invalid
                                              // file descriptor) to detect if socket is open. Valid sockets are always >= 0.
     std::mutex ctrl_mutex_;                  // Thread safety lock - prevents ping and config from interfering
+    unsigned long floof_count_ { 0 };        // Keep-alives sent, for the warning when one fails (under ctrl_mutex_)
+
+    // ---------- Serial Transport (board on USB) ----------
+    intptr_t serial_ { -1 };                 // Port of params.serial_port: file descriptor, HANDLE on Windows.
+                                             // -1 means not open (UDP session), same as the sockets.
+    std::atomic<bool> keep_serial_ { false };
+    std::thread serial_th_;                  // Serial reader, prepare_session to release_session
+    std::mutex serial_reply_mutex_;
+    std::condition_variable serial_reply_cv_;
+    std::deque<std::string> serial_replies_; // CTRL frames from the board, oldest first
+    unsigned long serial_resyncs_ { 0 };     // Frame heads that didn't make sense (debug text, lost bytes)
 
     // ---------- Thread Management ----------
     std::atomic<bool> keep_alive_ { false }; // Thread control flag. Atomic ensures read/write operations are thread-safe
                                              // without mutex overhead. Critical here because read_thread checks this
                                              // in tight loop while main thread may set it during stop_stream().
     std::atomic<bool> keep_floof_ { false };
-    std::thread read_th_;                    // Data reception thread - continuously reads EEG packets
+    std::thread recv_th_;                    // Data reception thread - drains the data socket into the receive ring
+    std::thread read_th_;                    // Data processing thread - decodes datagrams from the ring, pushes to BrainFlow
     std::thread ping_th_;                    // Keep-alive thread - sends periodic "hello" messages
 
     // ---------- State Tracking ----------
@@ -211,8 +474,10 @@ private:
     int ctrl_port_ { 5000 };                 // UDP port for control commands (default)
     
     // ---------- Auto-discovery ----------
-    std::string discovered_ip_ { "" };       // Board IP discovered from beacon
+    std::string discovered_ip_ { "" };       // Board IP discovered from probe reply or beacon
+    std::vector<DiscoveredBoard> discovered_boards_; // Probe replies of the last discovery
     std::string board_ip_ { "" };            // Board IP for sending commands
+    int board_channels_ { 16 };              // EEG channels of this build, 16 or 8 (one ADS1299), from the board descriptor
     
     // ---------- Platform-specific ----------
 #ifdef _WIN32
@@ -221,15 +486,57 @@ private:
                                              // This flag prevents multiple init/cleanup calls which would fail.
 #endif
     
+    // ---------- Receive Ring (recv_thread -> read_thread) ----------
+    // Single producer / single consumer, lock-free: recv_thread only writes rx_head_, read_thread only writes rx_tail_,
+    // both count up forever and the slot is (index % ring size). Slot i is rx_data_[i * slot size], its length rx_size_[i].
+    // The mutex and condition variable are only there to let read_thread sleep while the ring is empty.
+    std::vector<uint8_t> rx_data_;
+    std::vector<int> rx_size_;
+    std::vector<double> rx_time_;            // PC time (get_timestamp) the datagram was read from the socket
+    std::atomic<uint32_t> rx_head_ { 0 };    // Datagrams written by recv_thread
+    std::atomic<uint32_t> rx_tail_ { 0 };    // Datagrams consumed by read_thread
+    std::atomic<unsigned long> rx_ring_full_ { 0 }; // Times recv_thread found the ring full and had to wait
+    std::atomic<uint32_t> rx_ring_hwm_ { 0 };  // Most slots in use right after a write, since the stream started
+    std::atomic<uint32_t> rx_batch_hwm_ { 0 }; // Most datagrams one socket read took (recvmmsg, kernel buffer backlog)
+    std::mutex rx_wait_mutex_;
+    std::condition_variable rx_wait_cv_;
+
     // ---------- Timestamp Alignment ----------
-    bool first_packet_received_ { false };    // Flag to track first packet
-    double timestamp_offset_ { 0.0 };         // Offset to convert hw time to PC time
+    ClockModel clock_;                        // Board clock -> PC time, kept across streams of one session
+    std::mutex clock_mutex_;                  // read_thread updates clock_, config_board("driver clock") reads it
+
+    // ---------- Runtime Statistics ----------
+    StreamStats stats_;                       // Last snapshot of read_thread, kept after the stream stopped
+    std::mutex stats_mutex_;                  // read_thread publishes stats_, config_board("driver stats") reads it
+
+    // ---------- Aggregate Session (several boards as one) ----------
+    std::vector<AggregateMember> members_;   // Empty in a single board session
+    VrchatBoard *aggregate_ { nullptr };      // Set on a member: session its frames go to (merge_frames)
+    int member_index_ { -1 };
+    bool sync_start_ { true };               // One broadcast sys start_cnt for all boards
+    std::mutex align_mutex_;                 // Member queues and the combined row, member read_threads share them
+    std::vector<double> align_row_;          // Combined package, num_rows of the descriptor
+    int align_time_row_ { -1 };
+    unsigned long align_rows_ { 0 };         // Rows pushed this stream
+
+    /**
+     * Commands starting with "driver " are answered by the driver itself, nothing is sent to the board
+     * - "driver clock" : drift (ppm), offset, fit residual, network delay and jitter of the board clock model
+     *                      (of every board in an aggregate session)
+     * - "driver align" : aggregate session, frames used / held / skipped per board
+     * - "driver stats" : packets received / decoded / invalid / lost, pkt/s, receive -> push latency percentiles,
+     *                      decode time, receive ring and socket read high-water marks (per board in an aggregate session)
+     * @return BrainFlowExitCodes::STATUS_OK, or INVALID_ARGUMENTS_ERROR for an unknown command
+     */
+    int handle_driver_command (const std::string &config, std::string &response);
     
     /**
-     * Wait for board beacon and discover IP address. Uses raw sockets to extract sender's IP from UDP beacon.
+     * Discover the board IP: broadcast a MEOW_PROBE and take the MEOW_HERE replies (one round trip),
+     * or the next MEOW_MEOW beacon of a board with older firmware. Uses raw sockets to get the sender's IP.
      * 
      * @param timeout_ms Maximum time to wait in milliseconds
+     * @param board_id MAC of the board to pick, empty - the first one not streaming to another PC
      * @return true if board discovered, false if timeout
      */
-    bool wait_for_beacon (int timeout_ms);
+    bool wait_for_beacon (int timeout_ms, const std::string &board_id = "");
 };
\ No newline at end of file
@@ -25,33 +25,30 @@ DSP_SYMBOLS = [
     "g_bytesPerPacket",         # volatile uint32_t - ADC data bytes threshold
     "g_udpPacketBytes",         # volatile uint32_t - total UDP payload size
     
-    # --- FIR Equalizer (adcEqualizer_16ch_7tap) ---
-    # Note: These are static inside the function, shown with C++ mangling
-    "fir_idx",                  # uint8_t - circular buffer index
-    "fir_hist",                 # int32_t[16][7] - circular buffer, 16ch × 7 taps
-    
-    # --- DC Blocker IIR (dcBlockerIIR_16ch_2p) ---
-    "coef_B",                   # int32_t[26][3] - numerator coeffs (25 sets + bypass)
-    "coef_A",                   # int32_t[26][2] - denominator coeffs 
-    "x1_q", "x2_q",            # int32_t[16] - input state history per channel
-    "y1_q", "y2_q",            # int32_t[16] - output state history per channel
-    
-    # --- 50/60 Hz Notch (notch5060Hz_16ch_4p) ---
-    "BQ_B",                     # int32_t[11][3] - biquad numerators (10 sets + bypass)
-    "BQ_A",                     # int32_t[11][2] - biquad denominators
-    "state",                    # int32_t[16][2][4] - per channel, 2 stages, 4 states
-    
-    # --- 100/120 Hz Notch (notch100120Hz_16ch_4p) ---
-    # Same names but different functions - C++ mangles them differently
-    
+    # --- Fused filter chain (dspChain_16ch<EQ, DC, N50, N100>) ---
+    "EQ_FIR_H",                 # int32_t[7] - FIR equalizer coeffs
+    "DC_IIR_B",                 # int32_t[25][3] - DC blocker numerators
+    "DC_IIR_A",                 # int32_t[25][2] - DC blocker denominators
+    "NOTCH5060_B",              # int32_t[10][3] - 50/60 Hz biquad numerators
+    "NOTCH5060_A",              # int32_t[10][2] - 50/60 Hz biquad denominators
+    "NOTCH100120_B",            # int32_t[10][3] - 100/120 Hz biquad numerators
+    "NOTCH100120_A",            # int32_t[10][2] - 100/120 Hz biquad denominators
+    "HB_SHORT_H",               # int32_t[4] - decimation halfband, 15 taps
+    "HB_LONG_H",                # int32_t[13] - decimation halfband, 51 taps
+    "DSP_CHAIN_TABLE",          # fn ptr[16] - kernel per filter on/off combination
+    "dspState",                 # DspChainState - history of all filters, 16 channels
+    "decimState",               # DecimState - halfband decimator history, 16 channels (~7 KB)
+    "dspCoefs",                 # DspChainCoefs - coefficient rows for current presets
+
     # --- Main Task Data Buffers ---
     "rawADCdata",               # uint8_t[54] - raw SPI data (2×27 bytes)
-    "parsedADCdata",            # uint8_t[48] - stripped preambles (16ch × 3 bytes)
-    "dataBuffer",               # uint8_t[1456] - packed frames (max 28 × 52 bytes)
-    "dspBuffer",                # int32_t[16] - unpacked samples for DSP
-    
-    # --- UDP Task Buffer ---
-    "txBuf",                    # uint8_t[1460] - final UDP payload + battery
+    "g_dmaRx",                  # uint8_t[56] - DMA readout RX frame (54 + 2 pad)
+    "g_dmaTx",                  # uint8_t[56] - DMA readout TX zeros
+    "packetRing",               # PacketSlot[5] - blocks shared by ADC and sender tasks (12 + 80 × 52 + 4 bytes each)
+    "g_stats",                  # Stats - sys stats counters and histograms
+    "txDatagram",               # uint8_t[1460] - compressed / split datagram built by the sender
+    "fecParity",                # uint8_t[1460] - XOR parity of the FEC group being sent
+    "backfill",                 # BackfillRing - last data datagrams for replay after a Wi-Fi drop (~96 KB)
     
     # --- Global Filter Control Flags ---
     "g_filtersEnabled",         # volatile bool - master filter switch
@@ -65,7 +62,8 @@ DSP_SYMBOLS = [
     "g_selectDCcutoffFreq",    # volatile uint32_t - cutoff index (0-4)
     
     # --- Queue Handles ---
-    "adcFrameQue",             # QueueHandle_t - 5 slots, variable size
+    "freeSlotQue",             # QueueHandle_t - free packet ring slot indices
+    "readySlotQue",            # QueueHandle_t - filled packet ring slot indices
     "cmdQue",                  # QueueHandle_t - 8 slots × 512 bytes
 ]
 
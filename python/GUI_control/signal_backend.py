@@ -85,6 +85,57 @@ def parse_frame(raw: bytes) -> np.ndarray:
     return vals
 
 
+# ────────────────────── Delta Decoder ──────────────────────────
+
+def decode_delta(payload, n_frames: int) -> Optional[bytearray]:
+    """
+    Decode a compressed packet payload (packet type 1, "sys compress_on").
+    
+    Payload: [first frame, 52 B][17 bit widths][bit stream]. For every
+    stream (16 channels, then timestamp) the bit stream holds zig-zag coded
+    deltas of frames 1..n-1, LSB first, each with its stream's width.
+    
+    Args:
+        payload: Bytes between packet header and battery float
+        n_frames: Frame count from the packet header
+        
+    Returns:
+        n_frames plain 52-byte frames back to back, or None if payload
+        size doesn't match the widths
+    """
+    n_streams = 17
+    fixed = 52 + n_streams
+    if n_frames < 1 or len(payload) < fixed:
+        return None
+    widths = payload[52:fixed]
+    total_bits = sum(widths) * (n_frames - 1)
+    if len(payload) != fixed + (total_bits + 7) // 8:
+        return None
+    
+    out = bytearray(n_frames * 52)
+    out[0:52] = payload[0:52]
+    bits = int.from_bytes(payload[fixed:], 'little')
+    pos = 0
+    for s in range(n_streams):
+        w = widths[s]
+        mask = (1 << w) - 1
+        if s < 16:
+            prev = int.from_bytes(payload[3 * s:3 * s + 3], 'big', signed=True)
+        else:
+            prev = struct.unpack_from('<I', payload, 48)[0]
+        for f in range(1, n_frames):
+            z = (bits >> pos) & mask
+            pos += w
+            prev += (z >> 1) ^ -(z & 1)           # undo zig-zag, then delta
+            base = f * 52
+            if s < 16:
+                out[base + 3 * s:base + 3 * s + 3] = (prev & 0xFFFFFF).to_bytes(3, 'big')
+            else:
+                prev &= 0xFFFFFFFF
+                struct.pack_into('<I', out, base + 48, prev)
+    return out
+
+
 # ── ADS1299 Scaling Factor ────────────────────────────────────
 # Full scale range: ±4.5V, 24-bit signed ADC
 # LSB = 4.5V / 2^23 = 0.536 µV
@@ -106,14 +157,17 @@ class _Reader(mp.Process):
     """
     
     # Protocol constants
+    HEADERSIZE = 12         # version, type, frame count, format, u32 sequence, u32 first frame index
+    FORMAT_VERSION = 1      # Only header version we understand
     FRAMESIZE = 52          # 48 bytes data + 4 bytes timestamp
+    MIN_CHANNELS = 8        # Feature / impedance datagrams of a one-chip board carry 8 channels
     MAX_PACKET = 4096       # Maximum UDP packet size
     MAX_PACKETS_PER_CYCLE = 10  # Process up to 10 packets at once
     RESIZE_CHECK_INTERVAL = 100  # Check buffer resize every N frames
     SOCKET_TIMEOUT = 0.010  # 10ms blocking timeout
     STATS_INTERVAL = 1.0    # Print performance stats every second
     
-    def __init__(self, cfg_ns, shared, lock, port, ip="0.0.0.0"):
+    def __init__(self, cfg_ns, shared, lock, port, ip="0.0.0.0", multicast=None):
         """
         Initialize reader process.
         
@@ -123,6 +177,7 @@ class _Reader(mp.Process):
             lock: Lock for shared memory access
             port: UDP port to listen on (default 5001)
             ip: IP to bind to (0.0.0.0 = all interfaces)
+            multicast: Group to join when the board multicasts the data (sys multicast), None = unicast
         """
         super().__init__(daemon=True, name="SignalReader")
         self.cfg = cfg_ns
@@ -130,12 +185,19 @@ class _Reader(mp.Process):
         self.lock = lock
         self.port = port
         self.ip = ip
+        self.multicast = multicast
         
     def run(self):
         """Main process loop - receives and processes UDP packets."""
         # Create UDP socket with timeout (blocking but not infinite)
         sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        if self.multicast:
+            # Shared port, BrainFlow driver on this machine can join the same group
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
         sock.bind((self.ip, self.port))
+        if self.multicast:
+            mreq = socket.inet_aton(self.multicast) + socket.inet_aton("0.0.0.0")
+            sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
         sock.settimeout(self.SOCKET_TIMEOUT)
         
         # Pre-allocate receive buffer to avoid allocations
@@ -159,6 +221,11 @@ class _Reader(mp.Process):
         frames_processed = 0
         enable_stats = False  # Set False to disable performance printing
         
+        # Packet loss tracking from header sequence numbers
+        expected_seq = None   # Sequence of the next packet if nothing is lost
+        lost_packets = 0      # Skipped sequence numbers
+        reordered_packets = 0 # Packets older than expected
+        
         # Main processing loop
         while True:
             # ─────── Periodic Tasks (every N frames) ───────
@@ -213,28 +280,65 @@ class _Reader(mp.Process):
                     # Receive directly into pre-allocated buffer (zero-copy)
                     nbytes = sock.recv_into(recv_buf)
                     
-                    # Validate packet size
-                    if nbytes < self.FRAMESIZE:
+                    # Validate packet size - header and battery, the rest depends on the type
+                    if nbytes < self.HEADERSIZE + 4:
                         continue  # Too small, skip
                     
-                    packets_this_cycle += 1
+                    # Packet format: [Header][Frame1][Frame2]...[FrameN][BatteryFloat]
+                    version, ptype, frames, _fmt, seq, _first = struct.unpack_from('<BBBBII', recv_buf, 0)
+                    if ptype & 0x80:
+                        continue  # Backfill replay after a Wi-Fi drop - old data, live view doesn't need it
+                    ptype &= 0x0F
+                    if version != self.FORMAT_VERSION or ptype not in (0, 1, 3, 4):
+                        continue  # Unknown format, skip
+                    if ptype == 3:
+                        min_size = self.HEADERSIZE + 4 + self.MIN_CHANNELS * frames * 4 + 4  # byte 2 = number of bands
+                    elif ptype == 4:
+                        min_size = self.HEADERSIZE + 4 + self.MIN_CHANNELS * 4 + 4
+                    else:
+                        min_size = self.HEADERSIZE + self.FRAMESIZE + 4
+                    if nbytes < min_size:
+                        continue  # Too small for its type, skip
+                    if ptype in (3, 4):
+                        frames = 0  # Band power features / electrode impedance, no frames - only counted in the sequence below
+                        frame_src = recv_buf
+                        frame_off = self.HEADERSIZE
+                    elif ptype == 1:
+                        # Compressed - decode into plain frames, parsed below as usual
+                        frame_src = decode_delta(recv_buf[self.HEADERSIZE:nbytes - 4], frames)
+                        if frame_src is None:
+                            continue  # Corrupted, skip
+                        frame_off = 0
+                    elif nbytes != self.HEADERSIZE + frames * self.FRAMESIZE + 4:
+                        continue  # Frame count doesn't match size, skip
+                    else:
+                        frame_src = recv_buf
+                        frame_off = self.HEADERSIZE
+                    
+                    # Sequence gap = lost on the network, going back = reordered (32-bit wrap safe)
+                    if expected_seq is not None:
+                        delta = (seq - expected_seq) & 0xFFFFFFFF
+                        if delta >= 0x80000000:
+                            reordered_packets += 1
+                        else:
+                            lost_packets += delta
+                    if expected_seq is None or ((seq - expected_seq) & 0xFFFFFFFF) < 0x80000000:
+                        expected_seq = (seq + 1) & 0xFFFFFFFF
                     
-                    # Calculate number of complete frames in packet
-                    # Packet format: [Frame1][Frame2]...[FrameN][BatteryFloat]
-                    frames = (nbytes - 4) // self.FRAMESIZE
+                    packets_this_cycle += 1
                     frames_this_cycle += frames
                     
                     # Extract battery voltage (last 4 bytes of packet)
-                    batt = struct.unpack_from('<f', recv_buf, frames * self.FRAMESIZE)[0]
+                    batt = struct.unpack_from('<f', recv_buf, nbytes - 4)[0]
                     
                     # Process each frame in the packet
                     for n in range(frames):
-                        base = n * self.FRAMESIZE
+                        base = frame_off + n * self.FRAMESIZE
                         
                         # Parse 24-bit samples using OPTIMIZED vectorized function
-                        buf_raw[ptr] = parse_frame(recv_buf[base:base + 48])
+                        buf_raw[ptr] = parse_frame(bytes(frame_src[base:base + 48]))
                         # Timestamp is in units of 8 microseconds (hardware specific)
-                        buf_time[ptr] = struct.unpack_from('<I', recv_buf, base + 48)[0]
+                        buf_time[ptr] = struct.unpack_from('<I', frame_src, base + 48)[0]
                         
                         # Advance circular buffer pointer
                         ptr = (ptr + 1) % current_buf_len
@@ -273,7 +377,8 @@ class _Reader(mp.Process):
                     elapsed = now - last_stat_time
                     pps = packets_processed / elapsed
                     fps = frames_processed / elapsed
-                    print(f"[PERF] {pps:.1f} pkt/s, {fps:.1f} frm/s")
+                    print(f"[PERF] {pps:.1f} pkt/s, {fps:.1f} frm/s, "
+                          f"lost {lost_packets}, reordered {reordered_packets}")
                     last_stat_time = now
                     packets_processed = 0
                     frames_processed = 0
@@ -301,13 +406,14 @@ class SignalWorker:
             batt = snapshot['batt_v']  # Battery voltage
     """
     
-    def __init__(self, cfg: SigConfig, data_port: int = 5001):
+    def __init__(self, cfg: SigConfig, data_port: int = 5001, multicast: Optional[str] = None):
         """
         Initialize signal worker.
         
         Args:
             cfg: Signal configuration
             data_port: UDP port for data reception (default 5001)
+            multicast: Multicast group of the data stream (sys multicast), None = unicast
         """
         # Multiprocessing setup
         self._mgr = mp.Manager()
@@ -320,7 +426,7 @@ class SignalWorker:
         self.cfg.pause_reception = False
         
         # Create reader process
-        self._proc = _Reader(self.cfg, self._shared, self._lock, data_port)
+        self._proc = _Reader(self.cfg, self._shared, self._lock, data_port, multicast=multicast)
         
     def start(self):
         """Start the background reader process."""
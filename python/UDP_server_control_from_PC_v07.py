@@ -98,8 +98,9 @@ def udp_reader_process(shared_dict, shared_bat, shared_tim,
                        lock, sample_rate, buf_size, ip, port):
     DEBUG = False
     log   = (lambda *a, **k: None) if not DEBUG else (lambda *a, **k: print("[UDP]", *a, **k))
+    HDR_LEN  = 12 # packet header: version, type, frame count, format, u32 seq, u32 first frame
     FR_LEN   = 52
-    MIN_LEN  = FR_LEN
+    MIN_LEN  = HDR_LEN + FR_LEN + 4
     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
     sock.bind((ip, port))
     sock.setblocking(False)
@@ -123,14 +124,14 @@ def udp_reader_process(shared_dict, shared_bat, shared_tim,
             L = len(raw)
             if L < MIN_LEN:
                 continue
-            frames = (L - 4) // FR_LEN
-            if frames == 0:
+            frames = raw[2]
+            if raw[0] != 1 or frames == 0 or L != HDR_LEN + frames * FR_LEN + 4:
                 continue
 
-            batt = struct.unpack_from('<f', raw, frames * FR_LEN)[0]
+            batt = struct.unpack_from('<f', raw, HDR_LEN + frames * FR_LEN)[0]
 
             for n in range(frames):
-                base = n * FR_LEN
+                base = HDR_LEN + n * FR_LEN
                 try:
                     frame = parse_frame(raw[base : base + 48])
                     ts = struct.unpack_from('<I', raw, base + 48)[0]
@@ -327,6 +328,7 @@ def main():
     # Start continuous streaming
     ctrl_sock.sendto(b"sys start_cnt ", (ESP_IP, CTRL_PORT))
     time.sleep(0.1)
+    flush_udp_buffer(ctrl_sock)  # drop the "OK: start_cnt" ack, the next read is the reply of the next command
 
 
 
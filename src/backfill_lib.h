@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef BACKFILL_LIB_H
+#define BACKFILL_LIB_H
+
+#include <stdint.h>
+#include <string.h>
+#include <defines.h>
+
+
+
+
+// BACKFILL RING (sys backfill_on / backfill_off)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Byte FIFO of the last data datagrams sent, see BACKFILL_* in defines.h. Every entry is
+//     [2 Bytes datagram length][4 Bytes millis() when it was sent][datagram]
+// and may wrap around the end of the buffer, datagrams are copied in and out anyway. Oldest entries are dropped to make
+// room. head, tail, cursor and end are positions in the buffer, always kept below BACKFILL_BYTES (96 KB doesn't divide
+// 2^32, running counters would jump at their wrap). At least one byte stays free, so head == tail means empty.
+// Replay range is [cursor, end), set once per reconnect, end stays put while new datagrams keep coming in behind it.
+// An entry with a length that can't be there (0, more than MAX_UDP_PAYLOAD or past head) empties the ring.
+// Used by the sender task only, no locks.
+
+constexpr uint32_t BACKFILL_ENTRY_HEADER = 6;
+
+struct BackfillRing
+{
+    uint8_t  data[BACKFILL_BYTES];
+    uint32_t head;     // next entry is written here
+    uint32_t tail;     // oldest entry
+    uint32_t cursor;   // next entry to replay
+    uint32_t end;      // replay stops here, cursor == end - nothing to replay
+};
+
+// backfill_wrap - position len bytes after pos
+static inline uint32_t backfill_wrap(const uint32_t pos,
+                                     const uint32_t len)
+{
+    return (pos + len) % BACKFILL_BYTES;
+}
+
+// backfill_used - bytes stored from pos up to head
+static inline uint32_t backfill_used(const BackfillRing & r  ,
+                                     const uint32_t       pos)
+{
+    return (r.head + BACKFILL_BYTES - pos) % BACKFILL_BYTES;
+}
+
+// backfill_copyIn / backfill_copyOut - bytes at a position, split in two at the end of the buffer
+static inline void backfill_copyIn(BackfillRing &         r  ,
+                                   const uint32_t         pos,
+                                   const void * const     src,
+                                   const uint32_t         len)
+{
+    const uint32_t first = (len < BACKFILL_BYTES - pos) ? len : (BACKFILL_BYTES - pos);
+    memcpy(&r.data[pos], src, first);
+    memcpy(&r.data[0], (const uint8_t*)src + first, len - first);
+}
+static inline void backfill_copyOut(const BackfillRing & r  ,
+                                    const uint32_t       pos,
+                                    void * const         dst,
+                                    const uint32_t       len)
+{
+    const uint32_t first = (len < BACKFILL_BYTES - pos) ? len : (BACKFILL_BYTES - pos);
+    memcpy(dst, &r.data[pos], first);
+    memcpy((uint8_t*)dst + first, &r.data[0], len - first);
+}
+
+// backfill_entry - datagram length and send time of the entry at pos, 0 if the length can't be right
+static inline uint32_t backfill_entry(const BackfillRing & r     ,
+                                      const uint32_t       pos   ,
+                                      uint32_t * const     sentMs)
+{
+    if (backfill_used(r, pos) < BACKFILL_ENTRY_HEADER) return 0u;
+    uint8_t hdr[BACKFILL_ENTRY_HEADER];
+    backfill_copyOut(r, pos, hdr, BACKFILL_ENTRY_HEADER);
+    uint16_t len;
+    memcpy(&len, &hdr[0], sizeof(len));
+    if ((len > MAX_UDP_PAYLOAD) || (BACKFILL_ENTRY_HEADER + len > backfill_used(r, pos))) return 0u;
+    if (sentMs) memcpy(sentMs, &hdr[2], sizeof(*sentMs));
+    return len;
+}
+
+static inline void backfill_reset(BackfillRing & r)
+{
+    r.head = r.tail = r.cursor = r.end = 0u;
+}
+
+static inline bool backfill_pending(const BackfillRing & r)
+{
+    return r.cursor != r.end;
+}
+
+// backfill_store - keep one datagram, dropping the oldest ones (also from the replay range) if there is no room
+static inline void backfill_store(BackfillRing &        r       ,
+                                  const uint8_t * const datagram,
+                                  const uint32_t        len     ,
+                                  const uint32_t        nowMs   )
+{
+    const uint32_t need = BACKFILL_ENTRY_HEADER + len;
+    if ((len == 0u) || (len > MAX_UDP_PAYLOAD)) return;
+
+    while (backfill_used(r, r.tail) + need >= BACKFILL_BYTES)
+    {
+        const uint32_t oldest = backfill_entry(r, r.tail, nullptr);
+        if (oldest == 0u)
+        {
+            backfill_reset(r);
+            break;
+        }
+        const uint32_t next = backfill_wrap(r.tail, BACKFILL_ENTRY_HEADER + oldest);
+        if (r.cursor == r.tail) r.cursor = next;   // not replayed in time, it's gone
+        if (r.end    == r.tail) r.end    = next;
+        r.tail = next;
+    }
+
+    uint8_t        hdr[BACKFILL_ENTRY_HEADER];
+    const uint16_t len16 = (uint16_t)len;
+    memcpy(&hdr[0], &len16, sizeof(len16));
+    memcpy(&hdr[2], &nowMs, sizeof(nowMs));
+    backfill_copyIn(r, r.head                                      , hdr     , BACKFILL_ENTRY_HEADER);
+    backfill_copyIn(r, backfill_wrap(r.head, BACKFILL_ENTRY_HEADER), datagram, len);
+
+    // Nothing to replay - keep the empty range at the newest entry, so it never points into dropped data
+    const uint32_t head = backfill_wrap(r.head, need);
+    if (r.cursor == r.end) r.cursor = r.end = head;
+    r.head = head;
+}
+
+// backfill_rewind - replay everything sent at fromMs or later, up to what is stored right now
+static inline void backfill_rewind(BackfillRing & r     ,
+                                   const uint32_t fromMs)
+{
+    uint32_t pos = r.tail;
+    while (pos != r.head)
+    {
+        uint32_t sentMs;
+        const uint32_t len = backfill_entry(r, pos, &sentMs);
+        if (len == 0u)
+        {
+            backfill_reset(r);
+            return;
+        }
+        if ((int32_t)(sentMs - fromMs) >= 0) break;
+        pos = backfill_wrap(pos, BACKFILL_ENTRY_HEADER + len);
+    }
+    r.cursor = pos;
+    r.end    = r.head;
+}
+
+// backfill_peek - next datagram to replay into dst (dstSize bytes), returns its length, 0 if none
+// An entry that doesn't fit into dst can only be a broken ring, it's emptied.
+static inline uint32_t backfill_peek(BackfillRing &  r      ,
+                                     uint8_t * const dst    ,
+                                     const uint32_t  dstSize)
+{
+    if (!backfill_pending(r)) return 0u;
+    const uint32_t len = backfill_entry(r, r.cursor, nullptr);
+    if ((len == 0u) || (len > dstSize))
+    {
+        backfill_reset(r);
+        return 0u;
+    }
+    backfill_copyOut(r, backfill_wrap(r.cursor, BACKFILL_ENTRY_HEADER), dst, len);
+    return len;
+}
+
+// backfill_advance - the datagram from backfill_peek went out
+static inline void backfill_advance(BackfillRing & r)
+{
+    if (!backfill_pending(r)) return;
+    const uint32_t len = backfill_entry(r, r.cursor, nullptr);
+    if (len == 0u) backfill_reset(r);
+    else           r.cursor = backfill_wrap(r.cursor, BACKFILL_ENTRY_HEADER + len);
+}
+
+#endif // BACKFILL_LIB_H
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef CODEC_LIB_H
+#define CODEC_LIB_H
+
+#include <stdint.h>
+#include <string.h>
+#include <defines.h>
+
+
+
+
+// DELTA CODEC (PACKET_TYPE_DELTA)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Lossless codec for a block of 52-byte frames, works on what goes into the datagram anyway (samples after pack 32 -> 24 bits).
+// Every frame has 17 "streams": 16 channels (24-bit signed, big-endian) and the timestamp (32-bit, little-endian).
+// With one ADC (ADC_NUM_CHIPS 1) frames are 28 bytes with 9 streams, everything below scales with NUMBER_OF_ADC_CHANNELS.
+// For each stream:
+//     d[n]  = x[n] - x[n-1]                      first order delta, 25 bits are enough for 24-bit samples
+//     z[n]  = (d[n] << 1) ^ (d[n] >> 31)         zig-zag, small negative and positive deltas both become small numbers
+//     width = bits of the largest z[n]           one width per stream per packet, 0 if the stream does not change
+// After the DC blocker EEG deltas are a few LSB of noise plus the signal slope, so a stream needs 6-12 bits instead of 24
+// and a timestamp only ~6 bits instead of 32.
+//
+// Payload layout (after the packet header, battery float stays the last 4 bytes of the datagram):
+//     [first frame, 52 bytes, as is][17 widths, 1 byte each][bit stream]
+// Bit stream is stream after stream (channel 0 ... last channel, timestamp), frames 1 ... N-1 inside a stream, every z[n]
+// is written with the width of its stream, LSB first. Last byte is padded with zeros.
+// Encoder and PC decoder never need anything from previous packets, a lost datagram costs only its own frames.
+
+constexpr uint32_t CODEC_NUM_STREAMS = NUMBER_OF_ADC_CHANNELS + 1;                 // 16 channels + timestamp
+constexpr uint32_t CODEC_FIXED_BYTES = ADC_FULL_FRAME_SIZE + CODEC_NUM_STREAMS;    // first frame + widths
+
+// codec_value - one stream value of one frame
+// ------------------------------------------------------------------------------------------------------------------
+// Channels come back sign-extended to 32 bits, timestamp as is. Deltas are done in uint32 so wrap is well defined.
+static inline uint32_t codec_value(const uint8_t * const frame ,
+                                   const uint32_t        stream)
+{
+    if (stream < NUMBER_OF_ADC_CHANNELS)
+    {
+        const uint8_t * b = &frame[stream * 3u];
+        return (uint32_t)((int32_t)(((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8)) >> 8);
+    }
+    uint32_t ts;
+    memcpy(&ts, &frame[ADC_PARSED_FRAME], sizeof(ts));
+    return ts;
+}
+
+static inline uint32_t codec_zigzag(const uint32_t delta)
+{
+    return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+// codec_deltaSize - widths of all streams and payload size in bytes
+// ------------------------------------------------------------------------------------------------------------------
+// First pass of the encoder. Cheap enough to call just to decide if a block fits into one datagram.
+// - frames:    numFrames frames of ADC_FULL_FRAME_SIZE bytes back to back
+// - widths:    [out] CODEC_NUM_STREAMS bit widths
+// returns payload size (no packet header, no battery)
+static inline uint32_t codec_deltaSize(const uint8_t * const frames   ,
+                                       const uint32_t        numFrames,
+                                       uint8_t * const       widths   )
+{
+    uint32_t totalBits = 0;
+    for (uint32_t s = 0; s < CODEC_NUM_STREAMS; s++)
+    {
+        uint32_t prev  = codec_value(frames, s);
+        uint32_t orAll = 0;                      // OR of all z, its top bit is the width
+        for (uint32_t f = 1; f < numFrames; f++)
+        {
+            const uint32_t x = codec_value(&frames[f * ADC_FULL_FRAME_SIZE], s);
+            orAll |= codec_zigzag(x - prev);
+            prev   = x;
+        }
+        widths[s]  = (uint8_t)(orAll ? (32u - __builtin_clz(orAll)) : 0u);
+        totalBits += widths[s] * (numFrames - 1u);
+    }
+    return CODEC_FIXED_BYTES + ((totalBits + 7u) >> 3);
+}
+
+// codec_deltaEncode - write the payload
+// ------------------------------------------------------------------------------------------------------------------
+// - widths: from codec_deltaSize() for the same frames
+// - out:    must have codec_deltaSize() bytes
+// returns bytes written
+static inline uint32_t codec_deltaEncode(const uint8_t * const frames   ,
+                                         const uint32_t        numFrames,
+                                         const uint8_t * const widths   ,
+                                         uint8_t * const       out      )
+{
+    memcpy(out, frames, ADC_FULL_FRAME_SIZE);
+    memcpy(&out[ADC_FULL_FRAME_SIZE], widths, CODEC_NUM_STREAMS);
+
+    uint8_t * dst   = &out[CODEC_FIXED_BYTES];
+    uint64_t  acc   = 0;   // bits not yet written, LSB first
+    uint32_t  nbits = 0;   // always < 8 between values, so 32 more bits always fit
+    for (uint32_t s = 0; s < CODEC_NUM_STREAMS; s++)
+    {
+        const uint32_t w = widths[s];
+        if (w == 0) continue;
+
+        uint32_t prev = codec_value(frames, s);
+        for (uint32_t f = 1; f < numFrames; f++)
+        {
+            const uint32_t x = codec_value(&frames[f * ADC_FULL_FRAME_SIZE], s);
+            acc   |= (uint64_t)codec_zigzag(x - prev) << nbits;
+            nbits += w;
+            prev   = x;
+            while (nbits >= 8)
+            {
+                *dst++  = (uint8_t)acc;
+                acc   >>= 8;
+                nbits  -= 8;
+            }
+        }
+    }
+    if (nbits) *dst++ = (uint8_t)acc;
+
+    return (uint32_t)(dst - out);
+}
+
+#endif // CODEC_LIB_H
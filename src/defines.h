@@ -13,6 +13,7 @@
 
 #define SPI_COMMAND_CLOCK 2000000           // Hz, during full reset we ALWAYS do that at 2 MHz, since at 8 or 5 or even 4 MHz sometimes it's unstable
 #define SPI_NORMAL_OPERATION_CLOCK 16000000 // Hz, 16 MHz at the moment is the highest stable clock i was able to get
+#define ADC_DMA_READOUT 1                   // 1 - in continuous mode frames are read by GDMA with hardware CS (CPU is free during transfer), 0 - polled xfer() as before
 
 #define PIN_LED       20 // physical pin 30, GPIO20, U0RXD
 #define LED_ON_MS     250  // LED HIGH for 250 ms
@@ -25,29 +26,169 @@
 // Frame packing configuration - combines multiple ADC frames into single UDP packet
 // 
 // Why pack frames?
-// 1. MTU LIMIT: Ethernet MTU is 1500 bytes. After IP/UDP headers: 1472 bytes usable
-//    Maximum frames = (1472 - 4) / 52 = 28.23, so MAX = 28 frames
+// 1. MTU LIMIT: Ethernet MTU is 1500 bytes. After IP/UDP headers: 1472 bytes usable.
+//    WiFiUDP buffers one outgoing datagram in 1460 bytes, anything longer goes out as a second datagram,
+//    so 1460 is the real limit (MAX_UDP_PAYLOAD)
+//    Maximum frames = (1460 - 14 - 12 - 4) / 52 = 27.5, so MAX = 27 frames (14 bytes are kept free for FEC parity)
+//    With one ADC (ADC_NUM_CHIPS 1) frames are 28 bytes, (1460 - 14 - 12 - 4) / 28 = 51 frames
 // 2. WIFI LIMIT: ESP32 needs ~6ms minimum between UDP packets (166 pkt/s max)
 //    Without packing at 4000Hz = 4000 pkt/s = IMPOSSIBLE
 //    With max packing at 4000Hz = 142 pkt/s = SAFE
 // 3. EFFICIENCY: Each packet has 28 bytes overhead. Packing reduces overhead 28x
 // 
-// Frame structure: [48 Bytes ADC data][4 Bytes timestamp] = 52 bytes per frame
-// Packet structure: [Frame1][Frame2]...[FrameN][4 Bytes battery] = N*52+4 bytes total
+// Frame structure: [48 Bytes ADC data][4 Bytes timestamp] = 52 bytes per frame (24 + 4 = 28 with one ADC)
+// Packet structure: [12 Bytes header][Frame1][Frame2]...[FrameN][4 Bytes battery] = 12+N*52+4 bytes total
 // 
 // Examples:
-// -  5 frames:  5*52+4 =  264 bytes (good for 250Hz -> 50 pkt/s)
-// - 28 frames: 28*52+4 = 1460 bytes (max MTU safe, for high rates)
-#define MAX_FRAMES_PER_PACKET 28  // MTU limit: 28*52+4 = 1460 < 1472
+// -  5 frames: 12+ 5*52+4 =  276 bytes (good for 250Hz -> 50 pkt/s)
+// - 27 frames: 12+27*52+4 = 1420 bytes (max MTU safe, for high rates)
+#define MAX_UDP_PAYLOAD       1460 // bytes, WiFiUDP TX buffer (fits the 1472 bytes MTU limit)
+#define MAX_FRAMES_PER_PACKET ((MAX_UDP_PAYLOAD - FEC_OVERHEAD - PACKET_HEADER_SIZE - 4) / ADC_FULL_FRAME_SIZE) // 27, 12+27*52+4 = 1420 <= 1460
 #define TARGET_WIFI_FPS 50        // Target packet rate when possible
 
+// Packet header - first 12 bytes of every data datagram, multi-byte fields are little-endian
+// [0]     format version, PACKET_FORMAT_VERSION. PC side drops datagrams with a version it does not know
+// [1]     bits 0-3: packet type (PACKET_TYPE_FRAMES), bits 4-6: log2 of the on-board decimation (0 - off, 4 - by 16),
+//         bit 7: PACKET_FLAG_REPLAY, sent again from the backfill ring after a Wi-Fi drop
+// [2]     number of frames in this datagram
+// [3]     bits 0-2: ADC sampling rate code (0 - 250 Hz, 1 - 500 Hz ... 4 - 4000 Hz), rate of the frames = ADC rate >> [1] high nibble
+//         bits 3-7: filters applied to this datagram: master, equalizer, DC, 50/60 Hz, 100/120 Hz
+// [4-7]   packet sequence, +1 for every datagram sent. Gaps on PC side = lost on the network, going back = reordered
+// [8-11]  index of the first frame, counts every frame read from ADC since boot. Gaps with no sequence gap = board dropped it
+//         With decimation it counts output frames (ADC frame index >> log2 of the decimation)
+// Bits 4-6 and 7 of [1] are masked out by the type checks on PC side (type = [1] & 0x0F)
+#define PACKET_HEADER_SIZE    12
+#define PACKET_FORMAT_VERSION 1
+#define PACKET_TYPE_FRAMES    0 // [header][frames][battery], as above
+#define PACKET_TYPE_DELTA     1 // [header][delta coded frames][battery], see codec_lib.h
+#define PACKET_TYPE_PARITY    2 // [header][2 Bytes XOR of lengths][XOR of the group's datagrams], see FEC below
+#define PACKET_TYPE_FEATURES  3 // [header][4 Bytes timestamp][band powers][battery], see band power features below
+#define PACKET_TYPE_IMPEDANCE 4 // [header][4 Bytes timestamp][impedance of every channel][battery], see electrode impedance below
+
+// Forward error correction (sys fec_on | fec_off | fec_group <n>) - after every fec_group data datagrams one parity
+// datagram goes out: byte-wise XOR of the whole datagrams (headers included, shorter ones zero padded) and of their
+// lengths. PC side rebuilds any single lost datagram of the group from it, no retransmission, +1/n airtime.
+// Parity header: [1] PACKET_TYPE_PARITY, [2] datagrams in the group, [3] 0, [4-7] sequence of the first one, [8-11] 0.
+// Parity doesn't take a sequence number. Data datagrams are kept FEC_OVERHEAD bytes shorter, so parity still fits.
+#define FEC_OVERHEAD      (PACKET_HEADER_SIZE + 2)
+#define FEC_MIN_GROUP     2
+#define FEC_MAX_GROUP     32
+#define FEC_DEFAULT_GROUP 8
+
+// Band power features (sys features_on | features_only | features_off | feature_bands <lo>-<hi> ... | feature_rate <hz>)
+// Power of every channel in up to FEATURE_MAX_BANDS bands, computed on board from the filtered signal (feature_lib.h).
+// Signal is averaged down to FEATURE_BASE_HZ, a sliding DFT over the last FEATURE_WINDOW samples (0.5 s, bins every
+// FEATURE_BIN_HZ) gives a new set every 1 / feature_rate s. features_only sends nothing else, ~20 datagrams of ~340 bytes
+// per second instead of ~50 of ~276-1420, so the radio mostly naps.
+// Datagram: [1] PACKET_TYPE_FEATURES, [2] number of bands, [3] as for frames, [4-7] same sequence as all data datagrams,
+//           [8-11] ADC frame index of the last frame in the window
+//           then 4 Bytes timestamp of that frame, channels x bands float32 (channel-major, ADC counts^2), 4 Bytes battery
+// Band covers bins lo <= f < hi, so with 2 Hz bins 8-13 Hz is 8, 10 and 12 Hz.
+#define FEATURE_BASE_HZ      250
+#define FEATURE_WINDOW       125 // samples at FEATURE_BASE_HZ
+#define FEATURE_BIN_HZ       (FEATURE_BASE_HZ / FEATURE_WINDOW)
+#define FEATURE_MAX_BANDS    8
+#define FEATURE_MAX_BINS     31  // bins 1 ... 31, up to 62 Hz
+#define FEATURE_DEFAULT_RATE 20  // sets per second
+#define FEATURE_MAX_RATE     50
+#define FEATURES_OFF         0
+#define FEATURES_ON          1   // raw frames and features
+#define FEATURES_ONLY        2   // features instead of raw frames
+
+// Electrode impedance (sys impedance_on [6na|24na|6ua|24ua] | impedance_off) - ADS1299 AC lead-off current at fs / 4 on
+// every electrode while streaming, impedance of every channel from the raw samples (impedance_lib.h), the tone is notched
+// out of the frames. One datagram per block of IMPEDANCE_BLOCK_MS (twice that at 250 Hz), ~90 bytes a second.
+// Datagram: [1] PACKET_TYPE_IMPEDANCE, [2] excitation current code, [3] sampling rate code only (before any filter),
+//           [4-7] same sequence as all data datagrams, [8-11] ADC frame index of the last frame in the block
+//           then 4 Bytes timestamp of that frame, channels x float32 ohms (NaN - no excitation on that channel), 4 Bytes battery
+// Current code is ILEAD_OFF of the LOFF register: 0 - 6 nA, 1 - 24 nA, 2 - 6 uA, 3 - 24 uA.
+#define IMPEDANCE_BLOCK_MS        1000
+#define IMPEDANCE_NUM_CURRENTS    4
+#define IMPEDANCE_DEFAULT_CURRENT 0   // 6 nA, a few hundred uV over a bad contact, nothing near saturation
+
+// Backfill (sys backfill_on | backfill_off) - every data datagram is also kept in a RAM ring, as it was sent (delta coded
+// with compress_on, so the ring then holds 2-3x more time). Wi-Fi dropping while streaming doesn't end the stream:
+// datagrams keep getting sequence numbers and go into the ring only, and once Wi-Fi is back streaming resumes to the
+// same PC and the ring is sent again from BACKFILL_LOOKBACK_MS before the drop, flagged PACKET_FLAG_REPLAY, oldest first,
+// next to the live packets. Replay uses what's left of MAX_WIFI_FPS. PC side merges it back by sequence number.
+// 96 KB is ~7 s of raw stream at 250 Hz, ~1.8 s at 1000 Hz, ~0.5 s at 4000 Hz (~1.2 s compressed).
+#define PACKET_FLAG_REPLAY      0x80
+#define BACKFILL_BYTES          (96u * 1024u)
+#define BACKFILL_LOOKBACK_MS    2000 // Wi-Fi notices a drop only after missing AP beacons, packets right before it are lost too
+#define BACKFILL_MIN_REPLAY_PPS 20   // replay never slower than this, even next to a fast live stream
+#define BACKFILL_REPLAY_BURST   4    // replay datagrams sent back to back at most
+
+// Compressed streaming (sys compress_on) - frames are collected in blocks of up to MAX_FRAMES_PER_BLOCK and sent
+// delta coded, so at 2000/4000 Hz it's still 50 pkt/s instead of 74/148. A block that does not fit into one
+// datagram even after coding is split in halves, so a packet is never bigger than MAX_UDP_PAYLOAD.
+#define MAX_FRAMES_PER_BLOCK 80
+
+// Packetization policy (sys packing_auto | latency <ms> | packetrate <pps>)
+// - PACKING_AUTO:    frames per packet from FRAMES_PER_PACKET_LUT, ~50 pkt/s (default)
+// - PACKING_LATENCY: as many frames as fit into the latency budget, frames = fs * ms / 1000
+// - PACKING_RATE:    as few frames as give the wanted packet rate, frames = fs / pps rounded up
+// In every mode packet rate is capped at MAX_WIFI_FPS (MAX_USB_FPS streaming over USB) and frames at what one datagram
+// (or block) holds.
+#define PACKING_AUTO    0
+#define PACKING_LATENCY 1
+#define PACKING_RATE    2
+#define MAX_WIFI_FPS    150 // pkt/s, ESP32-C3 does ~166 at most, keep some head-room
+
+// Adaptive back-off: if the sender falls behind (ready slots pile up) or Wi-Fi refuses datagrams
+// frames per packet are doubled, up to PACKING_MAX_BACKOFF times. After PACKING_RECOVER_PACKETS
+// clean packets in a row one doubling is taken back.
+#define PACKING_MAX_BACKOFF     2
+#define PACKING_RECOVER_PACKETS 250
+
 // Default frame packing for 250 Hz startup (board initializes at 250 Hz)
 // 250 Hz / 5 frames = 50 FPS target
 #define DEFAULT_FRAMES_PER_PACKET 5
 
+// Number of preallocated packets (blocks of up to MAX_FRAMES_PER_BLOCK frames) in the ring between ADC task and sender task.
+// 5 slots at 27 frames @500 SPS = 270 ms of Wi-Fi stall before packets get dropped
+#define PACKET_RING_SLOTS 5
+
+// Task stacks (bytes), sized from the deepest call path of each (host -fstack-usage of the DSP code plus the IDF / lwIP
+// calls on top), `sys stats` shows how much of them was never touched on the board.
+// - ADC task (~1 KB): DMA or polled SPI readout through the IDF driver, unpacked straight into the slot
+// - sender (~2 KB): decimation (~0.8 KB, two 80-entry buffers) or the filter chain (~0.6 KB), then sendFrames (split in
+//   halves), FEC, the lwIP tcpip_api_call message and Debug.log (128 B buffer + vsnprintf) for every datagram
+#define ADC_TASK_STACK    3072
+#define SENDER_TASK_STACK 4096
+
 // Buffer size for incoming command UDP packets (adjust based on your max command length)
 #define CMD_BUFFER_SIZE 512 // Bytes
 
+// Binary commands - control datagram that starts with CMD_BIN_MAGIC (never the first byte of a text command)
+//     request : [CMD_BIN_MAGIC][seq] then records [op][len][len bytes of arguments] ...
+//     reply   : [CMD_BIN_MAGIC][seq] then for every record [op][len][status][len - 1 bytes of result] ...
+// Records run in order, every one gets its reply record, all in one reply datagram. seq is copied back as is.
+//     PING      -                                   -> [FIRMWARE_VERSION]
+//     TEXT      text command, e.g. "sys fec_on"     -> its reply text, ERR status if it was ERR:
+//     SPI       [target 'B'|'M'|'S'|'T'][bytes]     -> bytes read back (as spi <target> <len> <bytes>)
+//     REG_READ  [reg]                               -> [master][slave]
+//     REG_WRITE [reg][mask][bits]                   -> -, read-modify-write on both ADCs, ERR if read back differs
+//     START / STOP                                  -> -, as sys start_cnt / stop_cnt
+//     DSP       [switches][dc 0-4][net 0-1][gain 0-8] -> [1 if held by sys settings_hold]
+//               switches bit 0 filters, 1 equalizer, 2 DC, 3 50/60 Hz, 4 100/120 Hz, values as the sys commands
+#define CMD_BIN_MAGIC       0xB5
+#define CMD_BIN_PING        0x01
+#define CMD_BIN_TEXT        0x02
+#define CMD_BIN_SPI         0x03
+#define CMD_BIN_REG_READ    0x04
+#define CMD_BIN_REG_WRITE   0x05
+#define CMD_BIN_START       0x06
+#define CMD_BIN_STOP        0x07
+#define CMD_BIN_DSP         0x08
+#define CMD_BIN_ST_OK       0   // done
+#define CMD_BIN_ST_ERR      1   // ran and failed
+#define CMD_BIN_ST_UNKNOWN  2   // no such op
+#define CMD_BIN_ST_BAD_ARGS 3   // wrong length or value, record cut short
+#define CMD_BIN_ST_NO_ROOM  4   // ran, result didn't fit into the reply
+#define CMD_BIN_RESULT_MAX  254 // bytes of result per record
+#define CMD_BIN_REPLY_SIZE  1024
+#define CMD_BIN_LAST_REG    0x17 // CONFIG4, last ADS1299 register
+
 // ms between beacons when you are not connected to anyone
 #define WIFI_BEACON_PERIOD 1000
 
@@ -61,18 +202,69 @@
 #define WIFI_KEEPALIVE_WORD "WOOF_WOOF"
 #define WIFI_KEEPALIVE_WORD_LEN 9
 
+// Data subscribers - every PC that sends WOOF_WOOF gets the data stream, each one expires on its own keep-alive.
+// Datagram is built once and sent to each of them, or once to the multicast group when one is set (sys multicast).
+// Start / stop and settings are shared, any subscriber's sys stop_cnt stops the stream for all of them.
+// A command sent to the broadcast address is taken only from a subscriber (PC drivers start several boards at once
+// with one broadcast sys start_cnt), boards of other PCs on the same network ignore it.
+#define WIFI_MAX_PEERS 4
+
+// Instant discovery - instead of waiting up to WIFI_BEACON_PERIOD for MEOW_MEOW, PC broadcasts
+//     "MEOW_PROBE ctrl=<port> data=<port>"
+// to the control port and every board answers right away, by unicast to where the probe came from:
+//     "MEOW_HERE id=<MAC> fw=<FIRMWARE_VERSION> fmt=<PACKET_FORMAT_VERSION> ctrl=<port> data=<port>
+//      fs=<Hz> fpp=<frames per packet> decim=<R> compress=<0|1> fec=<0|1> state=<disc|idle|stream> peer=<PC IP|none>
+//      peers=<subscribers> mcast=<group IP|none> ch=<NUMBER_OF_ADC_CHANNELS>"
+// A probe doesn't claim the board, PC still sends WOOF_WOOF to the one it picked. Ports in the probe are what PC
+// listens on, board keeps its own (NVS) and reports them, so a mismatch is seen at once.
+#define WIFI_PROBE_WORD      "MEOW_PROBE"
+#define WIFI_PROBE_WORD_LEN  10
+#define WIFI_PROBE_REPLY     "MEOW_HERE"
+#define FIRMWARE_VERSION     7      // control protocol revision, 2 - MEOW_PROBE, 3 - several subscribers, multicast, 4 - binary commands, 5 - ch= in MEOW_HERE,
+                                    // 6 - broadcast commands only from subscribers, 7 - wired streaming over USB (USB_LINK_*)
+
 // Default TX power settings to prevent over-saturation
 #define AP_MODE_TX_POWER          WIFI_POWER_11dBm   // 11 dBm for Access Point mode
 #define NORMAL_MODE_TX_POWER      WIFI_POWER_15dBm   // 15 dBm initial for Station mode
 #define NORMAL_MODE_TX_POWER_HIGH WIFI_POWER_19_5dBm // 19.5 dBm after successful connection (optional)
 
 // I don't want main loop to run too often, so i set default period of 50 ms
+// Commands don't wait for it, command arrival wakes loop() right away
 #define MAIN_LOOP_PERIOD_MS 50
 
+// Power management (sys power_auto | power_max | light_sleep_on | light_sleep_off), see power_lib.h
+// CPU clock follows the measured load of the ADC and sender tasks: PM_CPU_MHZ_LOW while the stream needs at most
+// PM_MAX_LOAD_PCT of it, PM_CPU_MHZ_HIGH otherwise. 80 MHz is the lowest clock Wi-Fi runs with on ESP32-C3, APB stays at
+// 80 MHz either way so SPI, UART and timers don't notice. After every start and every change of rate, filters,
+// decimation or features it's PM_CPU_MHZ_HIGH for PM_SETTLE_MS while the new load is measured.
+#define PM_CPU_MHZ_LOW   80
+#define PM_CPU_MHZ_HIGH  160
+#define PM_MAX_LOAD_PCT  50   // % of the low clock the stream may use, the rest is for Wi-Fi, lwIP and commands
+#define PM_SETTLE_MS     1000
+#define PM_LOAD_SHIFT    4    // load average over ~2^4 frames / packets
+
 // Do you need debug stuff?
 #define SERIAL_DEBUG 1
 #define SERIAL_BAUD  115200
 
+// Wired streaming over the native USB CDC port - the same Serial as debug and CLI, see usb_link.h
+// PC wraps everything it sends in a frame, board answers and streams in frames, bytes outside a frame go to the text CLI:
+//     [USB_LINK_SYNC0][USB_LINK_SYNC1][type][length, uint16 little-endian][length bytes]
+// - USB_LINK_CTRL: command (text or binary, same as a control datagram) or one reply datagram. WOOF_WOOF is the
+//   keep-alive, stream stops after WIFI_SERVER_TIMEOUT without any frame from the PC
+// - USB_LINK_DATA: one data datagram, byte for byte what goes over UDP
+// sys start_cnt that came over USB streams over USB only (and stops the Wi-Fi stream), Wi-Fi stays up for the rest.
+// Packet rate is capped at MAX_USB_FPS instead of MAX_WIFI_FPS, no FEC parity and no backfill - USB loses nothing.
+// Debug output is muted while the USB stream runs, it would break the framing.
+#define USB_LINK_SYNC0     0xA5
+#define USB_LINK_SYNC1     0x5A
+#define USB_LINK_DATA      0x01
+#define USB_LINK_CTRL      0x02
+#define USB_LINK_OVERHEAD  5
+#define USB_TX_BUFFER_SIZE 8192 // bytes, HWCDC TX ring (default 256), ~40 ms of the 16 channel stream at 4000 Hz
+#define USB_CTRL_WAIT_MS   20   // replies wait this long for room behind the data, dropped after that
+#define MAX_USB_FPS        1000 // pkt/s, one per 1 ms USB frame
+
 // BCI MODE?
 // IF YES IT WILL SET UP ALL CHANNEL TO BASIC ON EACH RESET
 // BCI mode means: SRB2 mode (all positive shorted together)
@@ -101,21 +293,46 @@
 #define PIN_CS_MASTER  1 // ADS1299 data-ready pin; must be a free GPIO
 #define PIN_CS_SLAVE   5 // ADS1299 data-ready pin; must be a free GPIO
 
-// Size of the frame for 2 ADCs together, 27 bytes per each: 3 bytes constant load + 8 channels * 3 bytes (24 bits per sample)
-#define ADC_SAMPLES_FRAME 54 // bytes
+// ADC topology. 2 - master + slave in daisy chain, 16 channels (default board). 1 - master ADS1299 only,
+// 8 channels, for single chip units: SPI reads, DSP and packets only carry what is populated.
+// Everything bellow (frame sizes, channel count, which CS is toggled, MAX_FRAMES_PER_PACKET) follows from it.
+#ifndef ADC_NUM_CHIPS
+#define ADC_NUM_CHIPS 2
+#endif
+#if (ADC_NUM_CHIPS != 1) && (ADC_NUM_CHIPS != 2)
+#error "ADC_NUM_CHIPS must be 1 (master only) or 2 (master + slave)"
+#endif
 
-// Size of the frame for 2 ADCs together without preambs, 24 bits * 16 = 384 bits or 48 bytes
+// Channels of one ADS1299
+#define ADC_CHANNELS_PER_CHIP 8
+
+// Raw frame of one ADS1299: 3 bytes constant load (preamble) + 8 channels * 3 bytes (24 bits per sample)
+#define ADC_CHIP_FRAME 27 // bytes
+
+// Size of the frame for all ADCs together, 27 bytes per each (54 for 2 ADCs)
+#define ADC_SAMPLES_FRAME (ADC_CHIP_FRAME * ADC_NUM_CHIPS) // bytes
+
+// Size of the frame for all ADCs together without preambs, 24 bits * 16 = 384 bits or 48 bytes for 2 ADCs, 24 for one
 // we do not need constant load, so we will trim it and this way we can pack more frames together
-#define ADC_PARSED_FRAME 48 // bytes
+#define ADC_PARSED_FRAME (3 * ADC_CHANNELS_PER_CHIP * ADC_NUM_CHIPS) // bytes
 
 // Size of a counter we add at the end of each ADC frame. It's uint32 so 4 bytes
 #define TIMESTAMP_SIZE 4
 
-// One full ADC frame size with timestamp included at the end in BYTES
+// One full ADC frame size with timestamp included at the end in BYTES (52 for 2 ADCs, 28 for one)
 #define ADC_FULL_FRAME_SIZE (ADC_PARSED_FRAME + TIMESTAMP_SIZE)
 
 // Number of ADC channels we have
-#define NUMBER_OF_ADC_CHANNELS 16
+#define NUMBER_OF_ADC_CHANNELS (ADC_CHANNELS_PER_CHIP * ADC_NUM_CHIPS)
+
+// xfer() target of a data read, and channel range for messages
+#if ADC_NUM_CHIPS == 2
+#define ADC_READ_TARGET   'B'
+#define ADC_CHANNELS_TEXT "0-15"
+#else
+#define ADC_READ_TARGET   'M'
+#define ADC_CHANNELS_TEXT "0-7"
+#endif
 
 // Number of filter presets for different frequencies
 #define NUM_OF_FREQ_PRESETS 5
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef FEATURE_LIB_H
+#define FEATURE_LIB_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <defines.h>
+#include <settings_lib.h>
+
+
+
+
+// BAND POWER FEATURES (sys features_on / features_only / feature_bands / feature_rate)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Runs on filtered frames, see FEATURE_* in defines.h for the datagram.
+// 1. Every R = fs / FEATURE_BASE_HZ frames are averaged into one sample (boxcar, its nulls sit right on the multiples of
+//    250 Hz, so what would fold back onto the low bins is gone first).
+// 2. Sliding DFT over the last FEATURE_WINDOW samples, only for the bins some band needs:
+//        S_k(n) = S_k(n-1) + (x(n) - x(n-N)) * W[(k*n) mod N],   W = e^(-j*2*pi*m/N) in Q15
+//    No twiddle rotation of S_k, so every bin is the DFT of the window up to a phase, magnitude is the same. Everything is
+//    int64 and adds exactly what it subtracts N samples later, nothing drifts however long it runs.
+// 3. Every 1 / rate s (once the window is full) band power = sum over its bins of 2 * |X_k|^2 / N^2 - mean square of the
+//    24-bit signal in that band, a sine of amplitude A in the band reads A^2 / 2.
+// Rectangular window: a strong line between bins leaks a few % into the next band, good enough for alpha/beta ratios.
+// Sender task only, no locks. ~16 KB state.
+
+constexpr uint32_t FEATURE_Q         = 15;    // W is Q15
+constexpr uint32_t FEATURE_MAG_SHIFT = 17;    // |S| >> 17 before squaring, sum of 31 bins still fits uint64
+
+struct FeatureState
+{
+    int64_t  re[FEATURE_MAX_BINS][NUMBER_OF_ADC_CHANNELS];
+    int64_t  im[FEATURE_MAX_BINS][NUMBER_OF_ADC_CHANNELS];
+    int32_t  hist[NUMBER_OF_ADC_CHANNELS][FEATURE_WINDOW];   // last N samples, x(n-N) is at pos
+    int32_t  boxSum[NUMBER_OF_ADC_CHANNELS];
+    int16_t  cosQ[FEATURE_WINDOW];
+    int16_t  sinQ[FEATURE_WINDOW];                           // -sin, so S is the forward DFT
+    uint8_t  binK[FEATURE_MAX_BINS];                         // bin index k of every used bin
+    uint8_t  binBand[FEATURE_MAX_BINS];                      // band it belongs to
+    uint32_t binPhase[FEATURE_MAX_BINS];                     // (k*n) mod N of the next sample
+    uint32_t numBins;
+    uint32_t numBands;
+    uint32_t log2R;        // boxcar length, log2
+    uint32_t boxCount;     // frames in boxSum
+    uint32_t pos;          // ring index of the next sample
+    uint32_t filled;       // samples in the window, up to N
+    uint32_t hop;          // samples between two outputs
+    uint32_t hopCount;     // samples since the last output
+};
+
+// features_configure - bins for the bands, boxcar for the sampling rate, empty window
+// Called when features get enabled or bands, rate or sampling frequency change. First set comes one window later.
+static inline void features_configure(FeatureState &      st   ,
+                                      const DspSettings & s    ,
+                                      const uint32_t      fsIdx)
+{
+    memset(&st, 0, sizeof(st));
+    for (uint32_t m = 0; m < FEATURE_WINDOW; ++m)
+    {
+        const float a = 6.28318530718f * (float)m / (float)FEATURE_WINDOW;
+        st.cosQ[m] = (int16_t)lrintf( 32767.0f * cosf(a));
+        st.sinQ[m] = (int16_t)lrintf(-32767.0f * sinf(a));
+    }
+
+    st.numBands = (s.featureNumBands <= FEATURE_MAX_BANDS) ? s.featureNumBands : FEATURE_MAX_BANDS;
+    for (uint32_t k = 1; k <= FEATURE_MAX_BINS; ++k)
+    {
+        const uint32_t f = k * FEATURE_BIN_HZ;
+        for (uint32_t b = 0; b < st.numBands; ++b)
+        {
+            if ((f < s.featureBandLo[b]) || (f >= s.featureBandHi[b])) continue;
+            st.binK   [st.numBins] = (uint8_t)k;
+            st.binBand[st.numBins] = (uint8_t)b;
+            st.numBins++;
+            break;   // bands may overlap, a bin counts for the first one only
+        }
+    }
+
+    const uint32_t rate = (s.featureRateHz >= 1u && s.featureRateHz <= FEATURE_MAX_RATE) ? s.featureRateHz : FEATURE_DEFAULT_RATE;
+    st.hop   = FEATURE_BASE_HZ / rate;
+    st.log2R = fsIdx;   // fs = 250 << fsIdx
+}
+
+// features_sample - one averaged sample of all channels into the window
+static inline void features_sample(FeatureState & st, const int32_t * const x)
+{
+    int32_t d[NUMBER_OF_ADC_CHANNELS];
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    {
+        d[ch]               = x[ch] - st.hist[ch][st.pos];
+        st.hist[ch][st.pos] = x[ch];
+    }
+
+    for (uint32_t i = 0; i < st.numBins; ++i)
+    {
+        const int64_t wr = st.cosQ[st.binPhase[i]];
+        const int64_t wi = st.sinQ[st.binPhase[i]];
+        int64_t * const re = st.re[i];
+        int64_t * const im = st.im[i];
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+        {
+            re[ch] += wr * d[ch];
+            im[ch] += wi * d[ch];
+        }
+        st.binPhase[i] += st.binK[i];
+        if (st.binPhase[i] >= FEATURE_WINDOW) st.binPhase[i] -= FEATURE_WINDOW;
+    }
+
+    if (++st.pos >= FEATURE_WINDOW) st.pos = 0;
+    if (st.filled < FEATURE_WINDOW) st.filled++;
+}
+
+// features_run - feed frames until a new set is ready
+// - frames:    first frame, ADC_FULL_FRAME_SIZE bytes per frame, 24-bit big-endian samples
+// - consumed:  [out] frames taken, the last one closed the window when true is returned
+// returns true if a set is ready (features_write), call again with the rest of the frames
+static inline bool features_run(FeatureState &        st       ,
+                                const uint8_t *       frames   ,
+                                const uint32_t        numFrames,
+                                uint32_t &            consumed )
+{
+    const uint32_t R = 1u << st.log2R;
+    for (uint32_t f = 0; f < numFrames; ++f, frames += ADC_FULL_FRAME_SIZE)
+    {
+        const uint8_t * p = frames;
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch, p += 3)
+        {
+            const uint32_t raw = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2]);
+            st.boxSum[ch] += (raw & 0x800000) ? (int32_t)(raw | 0xFF000000) : (int32_t)raw;
+        }
+        if (++st.boxCount < R) continue;
+
+        int32_t x[NUMBER_OF_ADC_CHANNELS];
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+        {
+            x[ch]         = (st.boxSum[ch] + (int32_t)(R >> 1)) >> st.log2R;
+            st.boxSum[ch] = 0;
+        }
+        st.boxCount = 0;
+        features_sample(st, x);
+
+        if (st.filled < FEATURE_WINDOW) continue;
+        if (++st.hopCount < st.hop) continue;
+        st.hopCount = 0;
+        consumed    = f + 1u;
+        return true;
+    }
+    consumed = numFrames;
+    return false;
+}
+
+// features_write - band powers of the current window, channel-major (all bands of channel 1, then channel 2 ...)
+// returns bytes written, NUMBER_OF_ADC_CHANNELS * numBands * 4
+static inline uint32_t features_write(const FeatureState & st, uint8_t * const dst)
+{
+    const float scale = 2.0f * (float)(1u << (2u * (FEATURE_MAG_SHIFT - FEATURE_Q))) / (float)(FEATURE_WINDOW * FEATURE_WINDOW);
+    uint32_t n = 0;
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    {
+        uint64_t acc[FEATURE_MAX_BANDS] = {};
+        for (uint32_t i = 0; i < st.numBins; ++i)
+        {
+            const int64_t r = st.re[i][ch] >> FEATURE_MAG_SHIFT;
+            const int64_t q = st.im[i][ch] >> FEATURE_MAG_SHIFT;
+            acc[st.binBand[i]] += (uint64_t)(r * r) + (uint64_t)(q * q);
+        }
+        for (uint32_t b = 0; b < st.numBands; ++b, n += 4)
+        {
+            const float power = (float)acc[b] * scale;
+            memcpy(&dst[n], &power, 4);
+        }
+    }
+    return n;
+}
+
+#endif // FEATURE_LIB_H
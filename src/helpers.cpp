@@ -3,8 +3,11 @@
 // Project: Meower
 
 #include "helpers.h"
+#include "usb_link.h"
+#include "impedance_lib.h"
 
 extern Debugger Debug;
+extern UsbLink  usbLink;
 
 extern volatile uint32_t g_selectSamplingFreq;
 extern volatile bool continuousReading;
@@ -14,11 +17,96 @@ extern volatile uint32_t g_framesPerPacket;
 extern volatile uint32_t g_bytesPerPacket;
 extern volatile uint32_t g_udpPacketBytes;
 
+// Packing results are written by the command task (policy, compression, start of continuous mode) and by the sender
+// task (back-off), so the whole update runs under this lock. ADC task reads its two values under it too.
+static portMUX_TYPE packingMux = portMUX_INITIALIZER_UNLOCKED;
+
+// frame_packing_get - slot size and flush deadline of the same update, ADC task takes them once per slot
+void IRAM_ATTR frame_packing_get(uint32_t & bytesPerPacket,
+                                 uint32_t & flushTicks8us )
+{
+    portENTER_CRITICAL(&packingMux);
+    bytesPerPacket = g_bytesPerPacket;
+    flushTicks8us  = g_flushTicks8us;
+    portEXIT_CRITICAL(&packingMux);
+}
+
+// Adaptive frame packing based on sampling rate, packetization policy and compression
+// Goal: Maintain ~50 packets/second by default, or what sys latency / packetrate asked for, respect WiFi timing limits.
+// Called on every start of continuous mode, when policy or compression is switched and by the sender task when
+// it backs off. ADC task picks the new size up with the next packet it starts (frame_packing_get).
+// backoffStep moves the back-off first (+1 / -1 by the sender, -PACKING_MAX_BACKOFF clears it), kept within
+// 0 ... PACKING_MAX_BACKOFF.
+void update_frame_packing(const int32_t backoffStep)
+{
+    portENTER_CRITICAL(&packingMux);
+
+    int32_t backoff = (int32_t)g_packingBackoff + backoffStep;
+    if (backoff < 0)                   backoff = 0;
+    if (backoff > PACKING_MAX_BACKOFF) backoff = PACKING_MAX_BACKOFF;
+    g_packingBackoff = (uint32_t)backoff;
+
+    // Policy is about what goes to the PC, so everything is in output frames at the output rate fsAdc / R.
+    // fsAdc is kept in the formulas instead of the output rate, 250 Hz / 16 is not a whole number.
+    const uint32_t log2R     = g_decimationLog2;
+    const uint32_t fsAdc     = 250u << g_selectSamplingFreq;                                 // Hz
+    const uint32_t value     = g_packingValue;
+    const int32_t  outIdx    = (int32_t)g_selectSamplingFreq - (int32_t)log2R;               // LUT index of the output rate, < 0 - below 250 Hz
+
+    // One datagram (or block) of output frames, and the slot has to hold all ADC frames they are made of
+    uint32_t maxFrames = g_compressStream ? MAX_FRAMES_PER_BLOCK : MAX_FRAMES_PER_PACKET;
+    if (maxFrames > (MAX_FRAMES_PER_BLOCK >> log2R)) maxFrames = MAX_FRAMES_PER_BLOCK >> log2R;
+
+    uint32_t frames;
+    switch (g_packingMode)
+    {
+        case PACKING_LATENCY: frames = (fsAdc * value) / (1000u << log2R);                               break; // fits into the budget
+        case PACKING_RATE   : frames = value ? (fsAdc + (value << log2R) - 1u) / (value << log2R) : 1u; break; // at most that many pkt/s
+        default             : frames = (outIdx < 0)      ? 1u
+                                     : g_compressStream ? FRAMES_PER_BLOCK_COMPRESSED_LUT[outIdx]
+                                                        : FRAMES_PER_PACKET_LUT          [outIdx];     break;
+    }
+
+    // Never more packets than Wi-Fi (or USB, while streaming over it) can carry, never less than one frame
+    const uint32_t maxFps    = usbLink.streaming() ? MAX_USB_FPS : MAX_WIFI_FPS;
+    const uint32_t minFrames = (fsAdc + (maxFps << log2R) - 1u) / (maxFps << log2R);
+    if (frames < minFrames) frames = minFrames;
+
+    // Sender asked for bigger packets
+    frames <<= backoff;
+    if (frames > maxFrames) frames = maxFrames;
+
+    g_framesPerPacket = frames;                                                   // How many 52-byte frames go into a packet
+    g_bytesPerPacket  = ADC_FULL_FRAME_SIZE * (g_framesPerPacket << log2R);       // ADC data bytes the ADC task collects for it (before decimation)
+    g_udpPacketBytes  = PACKET_HEADER_SIZE + ADC_FULL_FRAME_SIZE * g_framesPerPacket + Battery_Sense::DATA_SIZE; // Final UDP payload size (header + ADC + 4-byte battery), uncompressed
+
+    // Flush deadline in 8 us ticks, measured from the first frame of a packet. Frame count alone gives the same
+    // latency while DRDY is regular, deadline keeps a packet from waiting longer than planned if it's not.
+    // (frames - 1) periods plus one more for jitter. 125000 ticks of 8 us in one second.
+    g_flushTicks8us = ((g_framesPerPacket << log2R) * 125000u) / fsAdc;
+
+    portEXIT_CRITICAL(&packingMux);
+
+    // Log the configuration change (outside the lock, from the values of this update)
+    // Formula: actual_sample_rate / frames_per_packet = packets_per_second
+    // Example: 250 Hz / 5 frames = 50 packets/second
+    Debug.log("[ADC] Sampling rate index %u, decimation %u, packing %u frames = %u FPS%s%s", 
+                g_selectSamplingFreq, 
+                1u << log2R,
+                frames,
+                fsAdc / (frames << log2R),
+                g_compressStream ? " (compressed)" : "",
+                backoff ? " (backed off)" : "");
+}
+
 // Setting start signal for continuous mode. Either ON or OFF
 void continuous_mode_start_stop(uint8_t on_off)
 {
     if (on_off == HIGH) // Start continuous mode
     {
+        // Restart while already streaming - commands below need SPIClass, so get the bus back first
+        spi_dmaReadout_end();
+
         // Before any start of the continuous we must check board Sample Rate
         // which is at Config 1 which is to read is 0x21
         uint8_t tx_mex[3] = {0x21, 0x00, 0x00};
@@ -35,36 +123,36 @@ void continuous_mode_start_stop(uint8_t on_off)
             case 2: g_selectSamplingFreq = 4; break; // 4000 Hz
         }
 
-        // Update adaptive frame packing based on sampling rate
-        // Goal: Maintain ~50 packets/second when possible, respect WiFi timing limits
-        g_framesPerPacket = FRAMES_PER_PACKET_LUT[g_selectSamplingFreq]; // How many 52-byte frames to pack
-        g_bytesPerPacket  = ADC_FULL_FRAME_SIZE * g_framesPerPacket;     // Total ADC data bytes (frames * 52)
-        g_udpPacketBytes  = g_bytesPerPacket + Battery_Sense::DATA_SIZE; // Final UDP payload size (ADC + 4-byte battery)
-
-        // Log the configuration change
-        // Formula: actual_sample_rate / frames_per_packet = packets_per_second
-        // Example: 250 Hz / 5 frames = 50 packets/second
-        Debug.log("[ADC] Sampling rate index %u, packing %u frames = %u FPS", 
-                    g_selectSamplingFreq, 
-                    g_framesPerPacket,
-                    (250 << (4 - g_selectSamplingFreq)) / g_framesPerPacket);
+        // Update adaptive frame packing based on sampling rate, fresh start without any back-off
+        update_frame_packing(-PACKING_MAX_BACKOFF);
 
         // Turn ON start signal (pull it UP)
         digitalWrite(PIN_START, on_off);
 
+        // Lead-off excitation again from the channel settings of now - usr gain / ch_srb2 / ch_input stop the stream and
+        // may have changed what it depends on. Registers are writable only before RDATAC
+        if (g_leadOff.on && !continuousReading) ads1299_applyLeadOff();
+
         // Prepare RDATAC message and empty holder for receiving
         uint8_t RDATAC_mes = 0x10;
         xfer('B', 1u, &RDATAC_mes, rx_mes); // Send RDATAC
 
         // Back to fast SPI clock
+        // With DMA readout the bus goes to IDF spi_master for the whole continuous mode, SPIClass is used only if it fails
         spiTransaction_OFF();
-        spiTransaction_ON(SPI_NORMAL_OPERATION_CLOCK);
+        if (!(ADC_DMA_READOUT && spi_dmaReadout_begin(SPI_NORMAL_OPERATION_CLOCK)))
+        {
+            spiTransaction_ON(SPI_NORMAL_OPERATION_CLOCK);
+        }
 
         // Set continuous mode flag to True
         continuousReading = true;
     }
     else // Otherwise stop
     {
+        // Give the bus back to SPIClass if DMA readout has it (waits for the frame in flight, no-op otherwise)
+        spi_dmaReadout_end();
+
         // Switch SPI clock to command clock speeds, which should be 2 MHz (maybe 4) be default
         spiTransaction_OFF();
         spiTransaction_ON(SPI_COMMAND_CLOCK);
@@ -250,12 +338,19 @@ void ads1299_full_reset()
     //                   1XY10ZZZ
     // Master_conf_1 = 0b10110110; # Daisy ON, Clock OUT ON,  250 SPS
     // Slave_conf_1  = 0b10010110; # Daisy ON, Clock OUT OFF, 250 SPS
+    // With one ADC (ADC_NUM_CHIPS 1) there is nobody to feed the clock to, master gets Slave_conf_1 and that's it
     {
         // Master config
+#if ADC_NUM_CHIPS > 1
         const uint8_t Master_conf_1[3u] = {0x41, 0x00, 0xB6};
+#else
+        const uint8_t Master_conf_1[3u] = {0x41, 0x00, 0x96};
+#endif
         uint8_t              rx_mes[3u] = {0}; // just empty message, we don't need any response here
         xfer('M', 3u, Master_conf_1, rx_mes);
 
+#if ADC_NUM_CHIPS > 1
+
         // Slave config
         const uint8_t Slave_conf_1[3u] = {0x41, 0x00, 0x96};
         xfer('S', 3u, Slave_conf_1, rx_mes);
@@ -267,6 +362,7 @@ void ads1299_full_reset()
         // after this config 3 messages they will be in similar modes again
         const uint8_t Config_3[3u] = {0x43, 0x00, 0xE0};
         xfer('B', 3u, Config_3, rx_mes);
+#endif
     }
 
     // CONFIG 2
@@ -303,6 +399,10 @@ void ads1299_full_reset()
         // wait for 1 ms
         delay(1);
     }
+
+    // RESET cleared the lead-off registers too
+    g_leadOff.on = false;
+    g_leadOff.epoch++;
 }
 
 void BCI_preset()
@@ -342,11 +442,64 @@ void BCI_preset()
         uint8_t              rx_mes[3u]        = {0}; // just empty message, we don't need any response here
         xfer('M', 3u, Master_conf_3, rx_mes);
 
+#if ADC_NUM_CHIPS > 1
         const uint8_t Slave_conf_3[3u] = {0x43, 0x00, 0xE8};
         xfer('S', 3u, Slave_conf_3, rx_mes);
+#endif
     }
 }
 
+// AC lead-off excitation for the impedance monitor (sys impedance_on / impedance_off), see impedance_lib.h.
+// Needs SDATAC and the command clock, i.e. stopped continuous mode (continuous_mode_start_stop(LOW)).
+// - LOFF: ILEAD_OFF from g_leadOff.current, FLEAD_OFF = 11 (AC at fDR / 4), comparator threshold stays at 0
+// - LOFF_SENSP / LOFF_SENSN: electrode side of every channel with normal input (mux 000) that is not powered down,
+//   N with SRB2 closed (P is the reference then), P otherwise. Read from CHnSET of every chip, so one chip may differ
+// - excitation off: all three zeroed
+// PGA gain of every excited channel goes to g_leadOff.pgaGain for the ohms, 0 for the others.
+void ads1299_applyLeadOff()
+{
+    static const uint8_t PGA_GAIN[8] = { 1, 2, 4, 6, 8, 12, 24, 24 };   // CHnSET bits 6:4, 111 is reserved
+
+    const bool on = g_leadOff.on;
+    uint8_t sensP[2] = {0}, sensN[2] = {0};
+    for (uint8_t ind = 0; ind < ADC_CHANNELS_PER_CHIP; ind++)
+    {
+        const RegValues r        = read_Register_Daisy(0x05 + ind);
+        const uint8_t   chset[2] = { r.master_reg_byte, r.slave_reg_byte };
+        for (uint32_t chip = 0; chip < ADC_NUM_CHIPS; chip++)
+        {
+            const uint8_t bit     = (uint8_t)(1u << ind);
+            const bool    excited = on && !(chset[chip] & 0x80) && ((chset[chip] & 0x07) == 0x00);
+            if (excited && (chset[chip] & 0x08)) sensN[chip] |= bit;
+            else if (excited)                    sensP[chip] |= bit;
+            g_leadOff.pgaGain[chip * ADC_CHANNELS_PER_CHIP + ind] = excited ? PGA_GAIN[(chset[chip] >> 4) & 0x07] : 0u;
+        }
+    }
+
+    // LOFF, same on both
+    // bit 7 6 5   | 4        | 3 2       | 1 0
+    // COMP_TH     | Always 0 | ILEAD_OFF | FLEAD_OFF
+    {
+        const uint8_t Loff[3u]   = { 0x44, 0x00, on ? (uint8_t)(((g_leadOff.current & 0x03u) << 2) | 0x03u) : (uint8_t)0x00 };
+        uint8_t       rx_mes[3u] = {0}; // just empty message, we don't need any response here
+        xfer('B', 3u, Loff, rx_mes);
+    }
+
+    // LOFF_SENSP (0x0F) and LOFF_SENSN (0x10) in one WREG, chip by chip
+    {
+        const uint8_t Master_sens[4u] = { 0x4F, 0x01, sensP[0], sensN[0] };
+        uint8_t       rx_mes[4u]      = {0};
+        xfer('M', 4u, Master_sens, rx_mes);
+
+#if ADC_NUM_CHIPS > 1
+        const uint8_t Slave_sens[4u] = { 0x4F, 0x01, sensP[1], sensN[1] };
+        xfer('S', 4u, Slave_sens, rx_mes);
+#endif
+    }
+
+    g_leadOff.epoch++;
+}
+
 // The ADS1299 ID register (0x00) is always accessible immediately after power-up, even before any other configuration.
 void wait_until_ads1299_is_ready()
 {
@@ -423,6 +576,69 @@ bool NetConfig::save() const
     return true;
 }
 
+bool NetConfig::loadLink(const String &ssid, NetLink &link) const
+{
+    Preferences p;
+    if (!p.begin(NS, /*read-only=*/true)) return false;
+
+    link.staticIp = p.getBool("static_ip", false);
+    const bool ok = p.isKey("link_bssid") && (p.getString("link_ssid", "") == ssid) &&
+                    (p.getBytes("link_bssid", link.bssid, sizeof(link.bssid)) == sizeof(link.bssid));
+    link.channel  = ok ? p.getUChar("link_ch", 0) : 0;
+    link.ip       = p.getUInt("link_ip",   0);
+    link.gateway  = p.getUInt("link_gw",   0);
+    link.subnet   = p.getUInt("link_mask", 0);
+    link.dns      = p.getUInt("link_dns",  0);
+    p.end();
+    return link.channel != 0;
+}
+
+bool NetConfig::saveLink(const String &ssid, const NetLink &link) const
+{
+    Preferences p;
+    if (!p.begin(NS, /*read-write=*/false)) return false;
+
+    p.putString("link_ssid",  ssid);
+    p.putBytes ("link_bssid", link.bssid, sizeof(link.bssid));
+    p.putUChar ("link_ch",    link.channel);
+    p.putUInt  ("link_ip",    link.ip);
+    p.putUInt  ("link_gw",    link.gateway);
+    p.putUInt  ("link_mask",  link.subnet);
+    p.putUInt  ("link_dns",   link.dns);
+    p.end();
+    return true;
+}
+
+bool NetConfig::saveStaticIp(bool on) const
+{
+    Preferences p;
+    if (!p.begin(NS, /*read-write=*/false)) return false;
+
+    p.putBool("static_ip", on);
+    p.end();
+    return true;
+}
+
+uint32_t NetConfig::loadMulticast() const
+{
+    Preferences p;
+    if (!p.begin(NS, /*read-only=*/true)) return 0;
+
+    const uint32_t group = p.getUInt("mcast_grp", 0);
+    p.end();
+    return group;
+}
+
+bool NetConfig::saveMulticast(uint32_t group) const
+{
+    Preferences p;
+    if (!p.begin(NS, /*read-write=*/false)) return false;
+
+    p.putUInt("mcast_grp", group);
+    p.end();
+    return true;
+}
+
 
 
 /**
@@ -458,6 +674,18 @@ bool NetConfig::save() const
  */
 RegValues read_Register_Daisy(uint8_t reg_addr)
 {
+#if ADC_NUM_CHIPS == 1
+    // One ADC - plain 3 byte RREG from master. Slave value is the same byte, so callers
+    // that check both ADCs after a write still see what they expect
+    const uint8_t tx[3] = {static_cast<uint8_t>(0x20 | reg_addr), 0x00, 0x00};
+    uint8_t       rx[3] = {0};
+    xfer('M', 3, tx, rx);
+
+    RegValues result;
+    result.master_reg_byte = rx[2];
+    result.slave_reg_byte  = rx[2];
+    return result;
+#else
     // Build RREG command: 0x20 OR'd with register address
     // This tells ADS1299 to read starting at reg_addr
     uint8_t tx[30] = {0};
@@ -487,4 +715,5 @@ RegValues read_Register_Daisy(uint8_t reg_addr)
     //        Position: [27][28][29][30-53]
     
     return result;
+#endif
 }
\ No newline at end of file
@@ -21,6 +21,17 @@
 // ---------------------------------------------------------------------------------------------------------------------------------
 extern volatile bool     continuousReading;
 extern const    uint32_t FRAMES_PER_PACKET_LUT[5];
+extern const    uint32_t FRAMES_PER_BLOCK_COMPRESSED_LUT[5];
+extern volatile bool     g_compressStream;
+extern volatile bool     g_fecStream;
+extern volatile uint32_t g_fecGroup;
+extern volatile bool     g_backfill;
+extern volatile uint32_t g_packingMode;
+extern volatile uint32_t g_packingValue;
+extern volatile uint32_t g_packingBackoff;
+extern volatile bool     g_packingAdaptive;
+extern volatile uint32_t g_flushTicks8us;
+extern volatile uint32_t g_decimationLog2;
 
 
 
@@ -42,7 +53,10 @@ struct RegValues
 // ---------------------------------------------------------------------------------------------------------------------------------
 void ads1299_full_reset();
 void BCI_preset();
+void ads1299_applyLeadOff();
 void continuous_mode_start_stop(uint8_t on_off);
+void update_frame_packing(int32_t backoffStep = 0);
+void frame_packing_get(uint32_t & bytesPerPacket, uint32_t & flushTicks8us);
 void wait_until_ads1299_is_ready();
 RegValues read_Register_Daisy(uint8_t reg_addr);
 
@@ -291,6 +305,19 @@ struct NetSettings
     uint16_t   portData = UDP_PORT_PC_DATA;
 };
 
+// Last association that worked - lets NetManager connect straight to that AP on that channel instead of scanning.
+// Saved by NetManager on GOT_IP when it changed, for the SSID it was made with only.
+struct NetLink
+{
+    uint8_t    bssid[6] = {};
+    uint8_t    channel  = 0;     // 0 - nothing cached
+    uint32_t   ip       = 0;     // DHCP lease of that connect, reused as static IP when staticIp is set
+    uint32_t   gateway  = 0;
+    uint32_t   subnet   = 0;
+    uint32_t   dns      = 0;
+    bool       staticIp = false; // sys fast_ip_on / fast_ip_off, skips DHCP on directed connects
+};
+
 class NetConfig
 {
 public:
@@ -298,6 +325,15 @@ public:
     bool  load();              // NVS -> members
     bool  save() const;        // members -> NVS
 
+    // cached association (see NetLink), loadLink is true only if there is one for this SSID
+    bool  loadLink(const String &ssid, NetLink &link) const;
+    bool  saveLink(const String &ssid, const NetLink &link) const;
+    bool  saveStaticIp(bool on) const;
+
+    // Data multicast group (sys multicast), 0 = off - data goes to every subscriber by unicast
+    uint32_t loadMulticast() const;
+    bool     saveMulticast(uint32_t group) const;
+
     // quick access helpers
     const NetSettings &get() const    { return s_; }
     void set(const NetSettings &n)    { s_          = n; }
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef IMPEDANCE_LIB_H
+#define IMPEDANCE_LIB_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <defines.h>
+
+
+
+
+// ELECTRODE IMPEDANCE (sys impedance_on [6na|24na|6ua|24ua] | impedance_off)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Contact quality of every electrode while streaming, see IMPEDANCE_* in defines.h for the datagram.
+// 1. ADS1299 AC lead-off (ads1299_applyLeadOff in helpers.cpp): square wave current of ILEAD_OFF at fDR / 4 into the
+//    electrode input of every channel that has an electrode on it (normal input, not powered down) - INxN with SRB2 closed
+//    (BCI preset, INxP is the reference then), INxP otherwise. fDR / 4 is 62.5 Hz at 250 Hz ... 1 kHz at 4000 Hz, the
+//    other two lead-off frequencies (7.8 and 31.2 Hz) would sit right in the EEG bands. Comparators stay off.
+// 2. Goertzel at fs / 4 on the raw samples, before digital gain and filters. Its coefficient 2 * cos(2 * pi / 4) is 0,
+//    so the recurrence is just s(n) = x(n) - s(n - 2): even and odd samples are two independent chains, one int64 subtract
+//    per sample and no multiply at all. Block of N = fs samples, 2 * fs at 250 Hz - N must be a multiple of 4 for fs / 4 to
+//    be a bin. Then DC, mains and all their harmonics are on bins of their own and leak nothing into it.
+// 3. End of a block: tone amplitude A = 2 * sqrt(s(N-1)^2 + s(N-2)^2) / N counts, and
+//        Z = A * 4.5 V / (PGA gain * 2^23) / (I * IMPEDANCE_TONE_GAIN)
+//    IMPEDANCE_TONE_GAIN is the square wave fundamental (4 / pi) times the ADS1299 sinc3 at fDR / 4, (sin(pi/4) / (pi/4))^3.
+//    The odd harmonics fold back onto the same bin, depending on the phase of the excitation to the conversions that
+//    moves it by +-1.5 %.
+//    It's the impedance the current sees on its way: electrode, skin and back through the reference / bias electrode,
+//    so a bad reference raises every channel. Good for contact quality, not a lab measurement.
+// 4. First block after every (re)configuration is thrown away, it starts while the ADC and the excitation settle.
+//    Same after a lost frame (frame index not contiguous, or a conversion lost in front of the slot): even and odd chains
+//    would swap phase against the excitation, the block starts over.
+// The tone is taken out of the EEG path by the fs / 4 notch in front of the filter chain (TONE_NOTCH_* in math_lib.h).
+// g_leadOff is written by the command task (registers), the Goertzel runs in the sender task only.
+
+constexpr float IMPEDANCE_TONE_GAIN = 0.929f;    // 4 / pi * (sin(pi/4) / (pi/4))^3
+constexpr float IMPEDANCE_VOLT_LSB  = 4.5f / 8388608.0f;    // V per count at PGA gain 1, VREF 4.5 V
+
+// ILEAD_OFF of the LOFF register, index is the current code
+static const float IMPEDANCE_CURRENT_A[IMPEDANCE_NUM_CURRENTS] = { 6e-9f, 24e-9f, 6e-6f, 24e-6f };
+
+// LeadOffState - what the ADS1299 lead-off registers were last set to (sys impedance_on / impedance_off)
+struct LeadOffState
+{
+    volatile bool     on;                               // excitation runs
+    volatile uint32_t current;                          // current code, 0 ... IMPEDANCE_NUM_CURRENTS - 1
+    volatile uint32_t epoch;                            // +1 with every write of the registers, Goertzel starts over
+    volatile uint8_t  pgaGain[NUMBER_OF_ADC_CHANNELS];  // PGA gain of every channel, 0 - no excitation on it
+};
+
+extern LeadOffState g_leadOff;   // main.cpp
+
+struct ImpedanceState
+{
+    int64_t  s[2][NUMBER_OF_ADC_CHANNELS];   // Goertzel chains of the even and the odd samples, s(n - 2) of the next one
+    float    ohmsPerCount[NUMBER_OF_ADC_CHANNELS];   // 2 / N * volts per count / (I * IMPEDANCE_TONE_GAIN), 0 - not excited
+    uint32_t blockLen;     // N
+    uint32_t count;        // samples of the block so far
+    uint32_t nextFrame;    // ADC frame index the next sample must have
+    bool     settled;      // false - the block running now is thrown away
+};
+
+// impedance_restart - block starts over from the next frame and is thrown away (frames were lost)
+static inline void impedance_restart(ImpedanceState & st)
+{
+    memset(st.s, 0, sizeof(st.s));
+    st.count   = 0;
+    st.settled = false;
+}
+
+// impedance_configure - new block length and scale, Goertzel starts over, first block is thrown away
+// Called when the lead-off registers were written again (g_leadOff.epoch) or the sampling frequency changes.
+static inline void impedance_configure(ImpedanceState &     st   ,
+                                       const LeadOffState & lo   ,
+                                       const uint32_t       fsIdx)
+{
+    memset(&st, 0, sizeof(st));
+    const uint32_t fsHz = 250u << fsIdx;
+    const uint32_t n    = (fsHz * IMPEDANCE_BLOCK_MS) / 1000u;
+    st.blockLen = (n & 3u) ? 2u * n : n;   // 250 Hz: 250 is no multiple of 4, 2 s
+
+    const float current = IMPEDANCE_CURRENT_A[(lo.current < IMPEDANCE_NUM_CURRENTS) ? lo.current : 0u];
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    {
+        const uint32_t gain = lo.pgaGain[ch];
+        st.ohmsPerCount[ch] = gain ? (2.0f * IMPEDANCE_VOLT_LSB) / ((float)st.blockLen * (float)gain * current * IMPEDANCE_TONE_GAIN)
+                                   : 0.0f;
+    }
+}
+
+// impedance_run - feed raw frames until a block is complete
+// - frames:     first frame, ADC_FULL_FRAME_SIZE bytes per frame, 24-bit big-endian samples (before the DSP)
+// - firstFrame: ADC frame index of the first one, a jump from the last frame taken restarts the block
+// - consumed:   [out] frames taken, the last one closed the block when true is returned
+// returns true if a settled block is ready (impedance_write), call again with the rest of the frames
+static inline bool impedance_run(ImpedanceState & st        ,
+                                 const uint8_t *  frames    ,
+                                 const uint32_t   numFrames ,
+                                 const uint32_t   firstFrame,
+                                 uint32_t &       consumed  )
+{
+    if (firstFrame != st.nextFrame) impedance_restart(st);
+    st.nextFrame = firstFrame + numFrames;
+    for (uint32_t f = 0; f < numFrames; ++f, frames += ADC_FULL_FRAME_SIZE)
+    {
+        int64_t * const s = st.s[st.count & 1u];
+        const uint8_t * p = frames;
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch, p += 3)
+        {
+            const uint32_t raw = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2]);
+            s[ch] = (int64_t)((raw & 0x800000) ? (int32_t)(raw | 0xFF000000) : (int32_t)raw) - s[ch];
+        }
+        if (++st.count < st.blockLen) continue;
+
+        // s[1] is s(N-1), s[0] is s(N-2) - kept until impedance_write, zeroed when the next block starts
+        st.count = 0;
+        consumed = f + 1u;
+        if (st.settled)
+        {
+            st.nextFrame = firstFrame + consumed;    // the rest comes with the next call
+            return true;
+        }
+        st.settled = true;
+        memset(st.s, 0, sizeof(st.s));
+    }
+    consumed = numFrames;
+    return false;
+}
+
+// impedance_write - ohms of every channel of the block that just closed, NaN where there is no excitation, and the next
+// block starts from zero. returns bytes written, NUMBER_OF_ADC_CHANNELS * 4
+static inline uint32_t impedance_write(ImpedanceState & st, uint8_t * const dst)
+{
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    {
+        const float s1   = (float)st.s[1][ch];
+        const float s2   = (float)st.s[0][ch];
+        const float ohms = (st.ohmsPerCount[ch] > 0.0f) ? sqrtf(s1 * s1 + s2 * s2) * st.ohmsPerCount[ch] : NAN;
+        memcpy(&dst[4 * ch], &ohms, 4);
+    }
+    memset(st.s, 0, sizeof(st.s));
+    return NUMBER_OF_ADC_CHANNELS * 4u;
+}
+
+#endif // IMPEDANCE_LIB_H
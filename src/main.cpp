@@ -12,9 +12,17 @@
 #include <messages_lib.h>
 #include <net_manager.h>
 #include <math_lib.h>
+#include <codec_lib.h>
+#include <stats_lib.h>
+#include <power_lib.h>
+#include <backfill_lib.h>
+#include <settings_lib.h>
+#include <feature_lib.h>
+#include <impedance_lib.h>
 #include <ap_config.h>
 #include <Preferences.h>
 #include <serial_io.h>
+#include <usb_link.h>
 
 
 
@@ -23,6 +31,7 @@
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
 NetManager net;
+UsbLink    usbLink;              // wired streaming over USB CDC, same Serial as Debug and CLI
 SPIClass spi(SPI);                 // Use the default SPI instance on the ESP32-C3
 
 // Classes
@@ -33,23 +42,83 @@ Debugger      Debug(Serial, SERIAL_BAUD);   // even tho just one hardware Serial
 SerialCli     CLI(Serial, SERIAL_BAUD);     // even tho just one hardware Serial will be used kind of anyway, we are just telling explicetly we use hardware serial provided by ESP and same baud speed
 
 // FreeRTOS handles
-static TaskHandle_t  adcTaskHandle = nullptr;
-static QueueHandle_t adcFrameQue   = nullptr; // Processed ADC packet with multiple frames (frames+timestamps); battery added later in transmission task
-QueueHandle_t        cmdQue        = nullptr;
+TaskHandle_t         adcTaskHandle    = nullptr; // DRDY ISR notifies it, sys stats reads its stack high-water mark
+TaskHandle_t         senderTaskHandle = nullptr;
+static QueueHandle_t freeSlotQue      = nullptr; // Indices of packet ring slots the ADC task may fill
+static QueueHandle_t readySlotQue     = nullptr; // Indices of packet ring slots with full packets (raw frames+timestamps) for the sender task
+QueueHandle_t        cmdQue           = nullptr;
+TaskHandle_t         cmdTask          = nullptr; // loop() task, net_manager wakes it when a command is queued
 static MsgContext    msgCtx;
 
 // Dynamic packet sizing to maintain ~50 FPS over WiFi
 // These variables are updated in continuous_mode_start_stop() when sampling rate changes
 volatile uint32_t g_framesPerPacket = DEFAULT_FRAMES_PER_PACKET;  // Number of ADC frames to pack per UDP packet (5 frames at startup for 250 Hz = 50 FPS)
 volatile uint32_t g_bytesPerPacket  = ADC_FULL_FRAME_SIZE * DEFAULT_FRAMES_PER_PACKET;     // Size in bytes of ADC data portion only (frames * 52 bytes each)
-volatile uint32_t g_udpPacketBytes  = (ADC_FULL_FRAME_SIZE * DEFAULT_FRAMES_PER_PACKET) + Battery_Sense::DATA_SIZE; // Total UDP payload size (ADC data + 4-byte battery voltage)
+volatile uint32_t g_udpPacketBytes  = PACKET_HEADER_SIZE + (ADC_FULL_FRAME_SIZE * DEFAULT_FRAMES_PER_PACKET) + Battery_Sense::DATA_SIZE; // Total UDP payload size (header + ADC data + 4-byte battery voltage)
 
 // Lookup table: sampling rate -> frames to pack for ~50 FPS
+// FPP_CAP - as many as asked, but not more than fit into one datagram (MAX_FRAMES_PER_PACKET depends on the channel count)
+#define FPP_CAP(n) (((n) < MAX_FRAMES_PER_PACKET) ? (n) : MAX_FRAMES_PER_PACKET)
 const uint32_t FRAMES_PER_PACKET_LUT[5] = {  5 ,  //  250 Hz:  250/ 5 = 50 FPS exactly
                                             10 ,  //  500 Hz:  500/10 = 50 FPS exactly  
                                             20 ,  // 1000 Hz: 1000/20 = 50 FPS exactly
-                                            28 ,  // 2000 Hz: 2000/28 = 71.4 FPS (max packing)
-                                            28 }; // 4000 Hz: 4000/28 = 142.8 FPS (max packing)
+                                            FPP_CAP(40) ,  // 2000 Hz: 2000/27 = 74.1 FPS (max packing, 16 ch), 2000/40 = 50 FPS (8 ch)
+                                            FPP_CAP(80) }; // 4000 Hz: 4000/27 = 148.1 FPS (max packing, 16 ch), 4000/51 = 78.4 FPS (8 ch)
+
+// Same for compressed streaming, blocks are split again in the sender if they don't fit one datagram
+const uint32_t FRAMES_PER_BLOCK_COMPRESSED_LUT[5] = {  5 ,  //  250 Hz:  250/ 5 = 50 FPS exactly
+                                                      10 ,  //  500 Hz:  500/10 = 50 FPS exactly
+                                                      20 ,  // 1000 Hz: 1000/20 = 50 FPS exactly
+                                                      40 ,  // 2000 Hz: 2000/40 = 50 FPS exactly
+                                                      80 }; // 4000 Hz: 4000/80 = 50 FPS exactly
+
+// Lossless delta coding of data packets (sys compress_on / compress_off)
+volatile bool g_compressStream = false;
+
+// XOR parity after every g_fecGroup data packets (sys fec_on / fec_off / fec_group <n>)
+volatile bool     g_fecStream = false;
+volatile uint32_t g_fecGroup  = FEC_DEFAULT_GROUP;
+
+// Every data datagram is also kept for replay after a Wi-Fi drop (sys backfill_on / backfill_off)
+volatile bool g_backfill = true;
+
+// Packetization policy, see PACKING_* in defines.h
+volatile uint32_t g_packingMode     = PACKING_AUTO;
+volatile uint32_t g_packingValue    = 0;    // ms for PACKING_LATENCY, pkt/s for PACKING_RATE
+volatile uint32_t g_packingBackoff  = 0;    // frames per packet are shifted left by this (adaptive back-off)
+volatile bool     g_packingAdaptive = true; // sys packing_adapt_on / off
+volatile uint32_t g_flushTicks8us   = UINT32_MAX; // ADC task hands a packet over once its first frame is this old
+
+// On-board decimation (sys decimation <1|2|4|8|16>), every 1 << g_decimationLog2 -th filtered frame goes out
+volatile uint32_t g_decimationLog2 = 0;
+
+// Packet ring - preallocated datagrams passed between ADC and sender task by index, never copied.
+// Slot is owned by exactly one task at a time:
+//   free queue -> ADC task writes frames -> ready queue -> sender task runs DSP in place, adds battery, sends -> free queue
+// Uncompressed, slot data is the final datagram: [12 Bytes header][Frame1][Frame2]...[FrameN][4 Bytes battery]. ADC task
+// writes frames only, header is written by the sender task. Battery space is reserved at the end of the max size block,
+// actual battery position is right after the last frame.
+// Slot is big enough for a compressed block (MAX_FRAMES_PER_BLOCK), such blocks are coded into txDatagram by the sender.
+// Head in front of data lets lwIP send the datagram straight from the slot (NetTxHead in net_manager.h).
+struct PacketSlot
+{
+    uint32_t numFrames;                                                                     // frames the ADC task has put in (after decimation - frames left)
+    uint32_t firstFrame;                                                                    // ADC frame index of the first of them (after decimation - output frame index)
+    bool     gap;                                                                           // a conversion was lost in front of or between them (DRDY missed, DMA late, restart)
+    NetTxHead tx;                                                                           // lwIP sends data in place, see NetTxHead
+    uint8_t  data[PACKET_HEADER_SIZE + ADC_FULL_FRAME_SIZE * MAX_FRAMES_PER_BLOCK + Battery_Sense::DATA_SIZE]; // datagram
+};
+static_assert(offsetof(PacketSlot, data) == offsetof(PacketSlot, tx) + sizeof(NetTxHead), "datagram must follow its NetTxHead");
+static PacketSlot packetRing[PACKET_RING_SLOTS];
+
+// Counters and timing histograms of the streaming path (sys stats), see stats_lib.h
+Stats g_stats = {};
+
+// CPU clock from the measured load (sys power_auto / power_max), see power_lib.h
+PowerState g_power = {};
+
+// ADS1299 lead-off excitation for the impedance monitor (sys impedance_on / impedance_off), see impedance_lib.h. Off at boot
+LeadOffState g_leadOff = {};
 
 // continuous reading mode state and maximum time we will wait before resseting mode if anything happened and ADC give no data back
 volatile bool continuousReading = false;
@@ -57,48 +126,29 @@ volatile bool continuousReading = false;
 // Timer counter for main loop, so we can control how often it's executed. Default is 1 time per 50 ms
 static uint32_t previousTime = 0; // timer for main loop
 
-// Digital gain. If signal you analyze uses maximum +-0.2V or any other value you better to
-// amplify it so it uses the entire dynamic range of 24 bits.
-// Gain made as bit shoft operation so we can get 1, 2, 4, 8, 16 and so on times which means 0, 1, 2, 3 bit shift and so on
-// GAIN WILL SATURATE AND CORRUPT SIGNAL IF DYNAMIC RANGE AFTER GAIN IS BIGGER THAN sint32
-volatile uint32_t g_digitalGain = 0; // Number of bits to shift, i.e. s = s << g_digitalGain
-
-// Select between 50-100Hz (0) and 60-120Hz modes for notch filters. Mostly useful for sample rates upt to 500 Hz,
-// but still works upto 4000 Hz
-// [50-100 60-120] Hz
-// [     0      1] select number
-volatile uint32_t g_selectNetworkFreq = 0;
+// Filter settings - one block, double buffered between command task and DSP (settings_lib.h). All off at boot.
+// - digitalGain: if signal you analyze uses maximum +-0.2V or any other value you better to amplify it so it uses the
+//   entire dynamic range of 24 bits. Gain made as bit shift operation so we can get 1, 2, 4, 8, 16 and so on times which
+//   means 0, 1, 2, 3 bit shift and so on. GAIN WILL SATURATE AND CORRUPT SIGNAL IF DYNAMIC RANGE AFTER GAIN IS BIGGER THAN sint32
+// - selectNetworkFreq: 50-100Hz (0) and 60-120Hz (1) modes for notch filters. Mostly useful for sample rates up to 500 Hz,
+//   but still works up to 4000 Hz
+// - selectDCcutoffFreq: cutOff frequency for DC filter [0.5 1 2 4 8] Hz -> [0 1 2 3 4].
+//   So, just in case, 0.5 Hz second order IIR for DC falls apart even with 32 bit coefficients and 32 bit signal.
+//   I've tried a lot of things and scaling signal by 8 bits for processing to always have 32 bit occupied and
+//   adding digital gain to push it even firther if signal itself never uses more then 16 bits for example, but still
+//   there are limits and 0.5 Hz at 4000 Hz sample rate is not stable and does not work really well - spkies can become permanent like
+//   resonator, you dont delete DC, you just inver it instead.
+//   So here you are - several cutoff frequencies you can choose from. Hope at least someone find it useful.
+// - adcEqualizer, removeDC, block5060Hz, block100120Hz: filter switches (sys filter_*_on / off)
+// - filtersEnabled: global switch for all filters being ON or OFF
+DspSettingsBlock g_dspSettings = {};
 
 // Select for current working sampling frequency. It's needed for filters to set proper coefficients
+// Read from ADC on every start of continuous mode, so not a part of the settings block
 // [250 500 1000 2000 4000] Hz
 // [  0   1    2    3    4] select number
 volatile uint32_t g_selectSamplingFreq = 0; // Sampling rate selector index
 
-// Select cutOff frequency for DC filter.
-// So, just in case, 0.5 Hz second order IIR for DC falls apart even with 32 bit coefficients and 32 bit signal.
-// I've tried a lot of things and scaling signal by 8 bits for processing to always have 32 bit occupied and
-// adding digital gain to push it even firther if signal itself never uses more then 16 bits for example, but still
-// there are limits and 0.5 Hz at 4000 Hz sample rate is not stable and does not work really well - spkies can become permanent like
-// resonator, you dont delete DC, you just inver it instead.
-// So here you are - several cutoff frequencies you can choose from. Hope at least someone find it useful.
-// [0.5 1 2 4 8] Hz
-// [  0 1 2 3 4] select number
-volatile uint32_t g_selectDCcutoffFreq = 0;
-
-// ADC equalizer master switch. The SYS commands FILTER_EQUALIZER_ON / FILTER_EQUALIZER_OFF toggle it at run time.
-volatile bool g_adcEqualizer = false;
-
-// IIR (DC removal) master switch. The SYS commands FILTER_DC_ON / FILTER_DC_OFF toggle it at run time.
-volatile bool g_removeDC = false;
-
-// IIR 50/60 Hz notch filter master switch. The SYS commands FILTER_5060_ON / FILTER_5060_OFF toggle it at run time.
-volatile bool g_block5060Hz = false;
-
-// IIR 100/120 Hz notch filter master switch. The SYS commands FILTER_100120_ON / FILTER_100120_OFF toggle it at run time.
-volatile bool g_block100120Hz = false;
-
-// Global switch for all filters being ON or OFF
-volatile bool g_filtersEnabled = false;
 
 
 
@@ -106,15 +156,11 @@ volatile bool g_filtersEnabled = false;
 // Helpers
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
-// Reads ONE complete command datagram from the queue.
-// Returns the byte count (0 if none).  Mirrors the old signature so
-// message_lib.cpp stays untouched.
-int32_t udp_read(char* buf, size_t cap)
+// Reads ONE complete command datagram from the queue (non-blocking).
+// Returns false if there is none.
+bool udp_read(CmdMsg &msg)
 {
-    if (!buf || cap == 0) return 0;
-    if (xQueueReceive(cmdQue, buf, 0) == pdTRUE)
-        return strnlen(buf, cap);
-    return 0;
+    return cmdQue && (xQueueReceive(cmdQue, &msg, 0) == pdTRUE);
 }
 
 
@@ -141,6 +187,9 @@ void IRAM_ATTR drdy_isr() // IRAM_ATTR: place code in IRAM, not flash -> no cach
     // hp == pdFALSE ->  it can wait until the next tick
     BaseType_t hp = pdFALSE;
 
+    // Start of the DRDY -> frame read out measurement (sys stats)
+    g_stats.drdyCycle = stats_cycles();
+
     // Atomically increments the “notification value” that belongs to adcTaskHandle (ADC task).
     // If that task was blocked on ulTaskNotifyTake(), it becomes Ready.
     // If the ADC task’s priority ≥ the one that was interrupted, hp is set to pdTRUE.
@@ -161,30 +210,41 @@ void IRAM_ATTR drdy_isr() // IRAM_ATTR: place code in IRAM, not flash -> no cach
     // the selected task.
 }
 
-// ADC continuous frame pulling and Signal processing.
-// Why like this? because then we do not have to pass data vectors from ADC to UDP task
-// which were taking too much time and stallking device and cause at some points
-// frame loss from wifi side (wifi task were to slow)
-// The ADC task queues multiple frames to adcFrameQue.
-// DSP packs FRAMES_PER_PACKET (N) frames and later hands the full datagram to the network task.
+// ADC continuous frame pulling and packing.
+// The ADC task does only the time critical part: reads SPI on every DRDY, removes preambles
+// and appends the raw frame with its timestamp to the packet. The DSP is NOT done here anymore,
+// it runs once per packet on the whole block in the sender task (see dsp_processPacket), so each
+// DRDY costs just the SPI read and a couple of memcpy.
+// Frames are written straight into a packet ring slot. When FRAMES_PER_PACKET (N) raw frames are in,
+// the slot index goes to readySlotQue and the network task works on that same memory.
 void IRAM_ATTR task_getADCsamplesAndPack(void*)
 {
     // Prelocate tx empty data with zeros for ADC sample read (we are sending zeros and ADC gives us back samples)
     const uint8_t tx_mes[ADC_SAMPLES_FRAME] = {0};
 
     // Raw ADC data from SPI
-    // we need it separately to parse sample and remove two preambles from it, so we can have 48 bytes per one raw ADC frame instead of 54 
+    // we need it separately to parse sample and remove preambles from it, so we can have 48 bytes per one raw ADC frame instead of 54
+    // (24 instead of 27 with one ADC)
     static uint8_t rawADCdata[ADC_SAMPLES_FRAME];
 
-    // Parsed ADC frame without preambles
-    static uint8_t parsedADCdata[ADC_PARSED_FRAME];
+    // Packet ring slot we are filling right now, up to MAX_FRAMES_PER_BLOCK frames with timestamps
+    // Each frame: [48 Bytes ADC data][4 Bytes timestamp] = 52 bytes (ADC_FULL_FRAME_SIZE)
+    // At start all slots are free, so this never waits
+    uint8_t slotIdx = 0;
+    xQueueReceive(freeSlotQue, &slotIdx, portMAX_DELAY);
+    uint8_t * dataBuffer = packetRing[slotIdx].data + PACKET_HEADER_SIZE;
 
-    // Buffer to store up to MAX_FRAMES_PER_PACKET frames with timestamps
-    // Each frame: [48 Bytes ADC data][4 Bytes timestamp] = 52 bytes
-    static uint8_t dataBuffer[ADC_FULL_FRAME_SIZE * MAX_FRAMES_PER_PACKET];
+    // Every frame read from ADC since boot, dropped or not. Goes into the packet header so PC can see what board dropped
+    uint32_t frameCounter = 0u;
 
-    // Buffer for unpacked ADC samples from 24 to 32 bits which we will use for processing
-    static int32_t dspBuffer[NUMBER_OF_ADC_CHANNELS] = {0};
+    // Timestamp of the first frame in the current slot, for the flush deadline, and the packing it's collected with
+    uint32_t slotStartTs    = 0u;
+    uint32_t slotBytes      = 0u;
+    uint32_t slotFlushTicks = 0u;
+
+    // A conversion was lost since the last frame stored (frameCounter doesn't count it), and the current slot has one
+    bool lostConversion = false;
+    bool slotGap        = false;
 
     // We need to know if we were in continuous mode each loop.
     // If yes we just go as usual
@@ -195,6 +255,9 @@ void IRAM_ATTR task_getADCsamplesAndPack(void*)
     // First value is 0, then we move it by ADC_FULL_FRAME_SIZE, then again by ADC_FULL_FRAME_SIZE and so on
     uint32_t bytesWritten = 0u;
 
+    // Full clock while working, power_idle() before every wait gives it back
+    power_busy(g_power);
+
     // Start infinite loop
     for (;;) // Endless loop - a FreeRTOS task never returns.
     {
@@ -205,6 +268,9 @@ void IRAM_ATTR task_getADCsamplesAndPack(void*)
 
             // Reset cursor - next packet starts at byte 0
             bytesWritten = 0;
+
+            // Nothing was read while stopped
+            lostConversion = true;
         }
 
         // store whether we were continuously reading or not for the next frame
@@ -212,16 +278,25 @@ void IRAM_ATTR task_getADCsamplesAndPack(void*)
         
         // Wait until ADC pulls DRDY down (adc samples are ready to read)
         // We will wait here forever
-        ulTaskNotifyTake(pdTRUE       ,  // clear on exit
-                         portMAX_DELAY); // no timeout, hangs for ever
+        // Count above 1 means DRDY came again before we were done with the previous frame, those frames are gone
+        power_idle(g_power);
+        const uint32_t notified = ulTaskNotifyTake(pdTRUE       ,  // clear on exit
+                                                   portMAX_DELAY); // no timeout, hangs for ever
+        power_busy(g_power);
+        uint32_t busyStart = stats_cycles();   // CPU time of this frame for the power manager
+        if (continuousReading && (notified > 1))
+        {
+            g_stats.drdyMissed += notified - 1;
+            lostConversion      = true;
+        }
 
         // Write timestamp (4 bytes) into the buffer at the end of the channel data for this frame.
         // - We use memcpy here (instead of casting uint8_t* to uint32_t*) because:
         //   (1) The offset into the buffer (bytesWritten + ADC_PARSED_FRAME) must be divisible by 4,
-        //   (2) The base address of dataBuffer itself must also be 4-byte aligned.
+        //   (2) The base address of the slot itself must also be 4-byte aligned.
         //   If either is not guaranteed, pointer casting is unsafe on some MCUs (may cause alignment faults).
         // - memcpy is always safe, even if alignment or buffer padding is not guaranteed.
-        // - The timestamp sits directly after the 48 bytes of channel data, at offset +48 in each frame.
+        // - The timestamp sits directly after the channel data, at offset +ADC_PARSED_FRAME (48, or 24 with one ADC) in each frame.
         // - Suitable for real-time use, provides low-latency timestamping.
         uint32_t timeStamp = getTimer8us(); // 8us timer
         memcpy(&dataBuffer[bytesWritten + ADC_PARSED_FRAME], &timeStamp, sizeof(timeStamp));
@@ -231,58 +306,78 @@ void IRAM_ATTR task_getADCsamplesAndPack(void*)
         {
             // Get ADC samples
             // We are sending SPI messages with zeros to ADCs and ADCs give us back samples one by one in return
-            // Here both master and slave should have Chip Select active
-            xfer('B', ADC_SAMPLES_FRAME, tx_mes, rawADCdata);
-
-            // Now let's remove two preambles from raw ADC frame, it will save us 6 bytes and we can pack more frames together because of that
-            removeAdcPreambles(rawADCdata, parsedADCdata);
-
-            // Unpack all smaple to 32 bits, left-shift by 8 bits (multiply by 256) to
-            // let signal use full dynamic range of a signed 32-bit integer and apply digital gain.
-            // It's needed to preserve as much dynamic range as possible.
-            // I added constant 8 bit shoft after filters started to fall apart on higher sampling rates because
-            // keeping signal at 24 bits without moving up and 31 bits coeefficients is just
-            // not enough unfortunately
-            // Unpack is also here outside of filters chain since we have digital gain, which means we have to run it every time.
-            // Digital gain can help to reduce precision errors for filters and processing even more.
-            // It's advised to use as high gain as possible if signal does not occupy the entire +-4.5V range (all 24 bits)
-            unpack_24to32_and_gain(parsedADCdata, dspBuffer, g_digitalGain);
-
-            // Filtering
-            // BYPASS if global for all filters is OFF
-            // --------------------------------------------------------------------------------------------
-            adcEqualizer_16ch_7tap(dspBuffer,                                             g_adcEqualizer  && g_filtersEnabled); // if we need adc frequency response equalizer - filter data using FIR with 7 taps
-            dcBlockerIIR_16ch_2p  (dspBuffer, g_selectSamplingFreq, g_selectDCcutoffFreq, g_removeDC      && g_filtersEnabled); // Remove DC
-            notch5060Hz_16ch_4p   (dspBuffer, g_selectSamplingFreq, g_selectNetworkFreq , g_block5060Hz   && g_filtersEnabled); // Notch filter for 50/60 Hz
-            notch100120Hz_16ch_4p (dspBuffer, g_selectSamplingFreq, g_selectNetworkFreq , g_block100120Hz && g_filtersEnabled); // Notch filter for 100/120 Hz
-
-            // Pack all samples back to 24 bits with scaling them back by 8 bits (>>8 or /256).
-            // Shift by 8 was added to signal to occupy full dynamic range of int32 during unpacking
-            pack_32to24(dspBuffer, parsedADCdata);
-
-            // Copy one processed (or raw, if filters are off) ADC frame (16 channels × 24 bits = 48 bytes),
-            // where the timestamp (4 bytes) has already been appended at the end in dataBuffer.
-            // Each frame totals 52 bytes in the packet; memcpy writes only the 48 bytes of channel data here.
-            memcpy(&dataBuffer[bytesWritten], // Write pointer for next frame in datagram
-                   parsedADCdata,             // Source: 48 bytes of processed or raw channel data
-                   ADC_PARSED_FRAME);         // Number of bytes to copy: 48 (no timestamp, just data)
+            // Here both master and slave should have Chip Select active (only master with ADC_NUM_CHIPS 1)
+            // With DMA readout this task sleeps until the frame is in, so sender task (DSP, Wi-Fi) gets the CPU meanwhile.
+            // If DMA is not active it's the same polled xfer() as always. If DMA is active but could not be started, the frame
+            // is skipped - SPIClass is detached from the bus then.
+            // Task sleeps while DMA runs, that part is not counted as load
+            const uint8_t * frame = rawADCdata;
+            if (spi_dmaReadout_start())
+            {
+                const uint32_t waitStart = stats_cycles();
+                frame      = spi_dmaReadout_collect();
+                busyStart += stats_cycles() - waitStart;
+            }
+            else if (spi_dmaReadout_active()) frame = nullptr;
+            else xfer(ADC_READ_TARGET, ADC_SAMPLES_FRAME, tx_mes, rawADCdata);
+
+            // DMA could not start or did not finish in time - skip this frame, timestamp slot will be written again by the next one
+            if (frame == nullptr)
+            {
+                g_stats.dmaTimeouts++;
+                lostConversion = true;
+                continue;
+            }
+            stats_record(g_stats.drdyToSpi, stats_cycles() - g_stats.drdyCycle);
+            g_stats.framesRead++;
+
+            // Now let's remove preambles from raw ADC frame, it will save us 3 bytes per ADC and we can pack more frames together because of that.
+            // Parsed frame goes straight into the packet, right in front of the timestamp written above.
+            // Unpacking, digital gain, filtering and packing back happen later for the whole packet at once (dsp_processPacket)
+            removeAdcPreambles(frame, &dataBuffer[bytesWritten]);
 
             // Increment amount of writen bytes (which also means frames).
             // this way we can count and also move pointer so next ADC frame will be writen nicely right after this one.
-            bytesWritten += ADC_FULL_FRAME_SIZE;
+            if (bytesWritten == 0)
+            {
+                slotStartTs = timeStamp;
+                slotGap     = false;
+                frame_packing_get(slotBytes, slotFlushTicks);   // size and deadline of one packing update, whole packet
+            }
+            slotGap        = slotGap || lostConversion;
+            lostConversion = false;
+            bytesWritten  += ADC_FULL_FRAME_SIZE;
+            frameCounter++;
 
-            // Is the data buffer now exactly full?
-            if (bytesWritten >= g_bytesPerPacket)
+            // Is the data buffer now exactly full, or is the oldest frame in it already as old as the latency policy allows?
+            if ((bytesWritten >= slotBytes) || ((timeStamp - slotStartTs) >= slotFlushTicks))
             {
-                // Send one complete packet (ADC frames + time-stamps) to Wi-Fi task.
-                // Battery voltage is merged in the UDP task just before transmission.
-                xQueueSend(adcFrameQue,    // queue handle
-                           dataBuffer,     // pointer to packet
-                           0); // wait if both slots are full in que. It means if UDP never reads from que DSP will stay here forever. DSP is not allowed to write to que if que is full
+                // Hand the complete packet (raw ADC frames + time-stamps) to Wi-Fi task, only index goes through the queue.
+                // DSP and battery voltage are done in the UDP task just before transmission.
+                // We give the slot away only if there is a free one to continue with. If sender is behind and every
+                // other slot is still in flight, this packet is dropped and the same slot is filled again -
+                // ADC task never blocks here.
+                uint8_t nextIdx;
+                if (xQueueReceive(freeSlotQue, &nextIdx, 0) == pdTRUE)
+                {
+                    packetRing[slotIdx].numFrames  = bytesWritten / ADC_FULL_FRAME_SIZE;
+                    packetRing[slotIdx].firstFrame = frameCounter - packetRing[slotIdx].numFrames;
+                    packetRing[slotIdx].gap        = slotGap;
+                    xQueueSend(readySlotQue, &slotIdx, 0); // can't be full, it's as deep as the ring
+                    stats_max(g_stats.readyHwm, uxQueueMessagesWaiting(readySlotQue));
+                    slotIdx    = nextIdx;
+                    dataBuffer = packetRing[slotIdx].data + PACKET_HEADER_SIZE;
+                }
+                else
+                {
+                    g_stats.droppedPackets++;
+                    g_stats.droppedFrames += bytesWritten / ADC_FULL_FRAME_SIZE;
+                }
 
                 // Reset cursor - next packet starts at byte 0
                 bytesWritten = 0;
             }
+            power_noteLoad(g_power.adcCycles, stats_cycles() - busyStart);
         }
 
         #ifdef DEBUG
@@ -295,7 +390,339 @@ void IRAM_ATTR task_getADCsamplesAndPack(void*)
     }
 }
 
+// Front buffer of the DSP settings, settings of the packet being processed (filters and features), sender task only
+static DspSettings dsp    = {};
+static uint32_t    dspSeq = 0;    // g_dspSettings.seq of the front buffer
+
+// Block DSP - runs once per packet over all N frames of it
+// ---------------------------------------------------------------------------------------------------------------------------------
+// The whole chain (unpack + digital gain -> EQ -> DC -> 50/60 -> 100/120 -> pack) is one fused kernel from math_lib.h,
+// specialized at compile time for every on/off combination of the filters. Disabled filters cost nothing at all.
+// Settings are taken from the double buffer once per packet (settings_lib.h), so any change applies from the next
+// packet as a whole. Filter state and kernel selection live in dspChain (dspChain_process has the rules).
+// Digital gain: signal is left-shifted by 8 + gain bits during unpack, so it uses the full int32 range during filtering.
+// It's advised to use as high gain as possible if signal does not occupy the entire +-4.5V range (all 24 bits)
+// Timestamps between frames are not touched, samples are written back in place.
+// Returns byte 3 of the packet header - sampling rate code and filters this packet went through.
+// IRAM: hot loop, should not wait for flash cache.
+static DspChain  dspChain;     // filter chain of the stream, sender task only, dspChain_init() in setup()
+static Decimator decimator;    // decimation after it, decim_init() in setup()
+
+static uint8_t IRAM_ATTR dsp_processPacket(uint8_t * const packet, const uint32_t numFrames)
+{
+    // Packet boundary - take the newest complete settings set
+    dspSettings_take(g_dspSettings, dsp, dspSeq);
+
+    return dspChain_process(dspChain, dsp, g_selectSamplingFreq, packet, numFrames, g_leadOff.on);
+}
+
+// Decimation - runs after the filter chain, so the chain still works at the ADC rate with its own coefficients
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Halfband cascade from math_lib.h, output frames go to the front of the slot and numFrames shrinks accordingly.
+// Frame index of the slot becomes an index of output frames: ADC frame index the first output was computed on >> log2(R),
+// so it still grows by exactly numFrames per packet and gaps still mean frames dropped on the board.
+// Stages are primed from the first frame when decimation is switched on or R changes.
+// Returns log2(R) this packet went through (header byte 1, high nibble), 0 - decimation off, slot untouched.
+static uint8_t IRAM_ATTR dsp_decimatePacket(PacketSlot & slot)
+{
+    const uint32_t log2R = g_decimationLog2;
+    uint32_t       firstSource;
+    slot.numFrames = decim_process(decimator, log2R, slot.data + PACKET_HEADER_SIZE, slot.numFrames, firstSource);
+    if (log2R == 0) return 0;
+
+    slot.firstFrame = (slot.firstFrame + firstSource) >> log2R;
+    return (uint8_t)log2R;
+}
+
+// Packet header (see defines.h for the layout), both counters little-endian as the CPU
+static void writePacketHeader(uint8_t * const dst       ,
+                              const uint8_t   type      ,
+                              const uint32_t  numFrames ,
+                              const uint8_t   format    ,
+                              const uint32_t  seq       ,
+                              const uint32_t  firstFrame)
+{
+    dst[0] = PACKET_FORMAT_VERSION;
+    dst[1] = type;
+    dst[2] = (uint8_t)numFrames;
+    dst[3] = format;
+    memcpy(&dst[4], &seq       , sizeof(seq));
+    memcpy(&dst[8], &firstFrame, sizeof(firstFrame));
+}
+
+// Datagram built by the sender when a slot can't go out in place (delta coded, or just a part of a block)
+static NetTxBuffer<MAX_UDP_PAYLOAD> txBuffer;
+static uint8_t * const              txDatagram = txBuffer.data;
+
+// Parity datagram of the FEC group being sent (see FEC in defines.h), XOR of the data datagrams starts after FEC_OVERHEAD
+static NetTxBuffer<MAX_UDP_PAYLOAD> fecBuffer;
+static uint8_t * const fecParity   = fecBuffer.data;
+static uint32_t fecCount    = 0u; // datagrams folded in so far
+static uint32_t fecFirstSeq = 0u;
+static uint32_t fecMaxLen   = 0u;
+static uint16_t fecLenXor   = 0u;
+
+// Last data datagrams for replay after a Wi-Fi drop, sender task only (see BACKFILL in defines.h)
+static BackfillRing backfill;
+
+// Somebody takes the stream - PC on the USB link, or Wi-Fi subscribers (also while Wi-Fi reconnects, see NetManager)
+static inline bool streamActive(void)
+{
+    return usbLink.streaming() || net.streamSession();
+}
+
+// Send one data datagram, keep it for the backfill replay, with FEC on fold it into the parity and send the parity
+// once the group is complete. Sequence numbers of a group are consecutive, every data datagram goes through here
+// exactly once - also while Wi-Fi is down, then only the backfill copy is made.
+// Streaming over USB it's just the frame: USB doesn't drop datagrams, nothing to replay or rebuild.
+static bool sendDatagram(NetTxHead &           tx  ,
+                         const uint32_t        len ,
+                         const uint32_t        seq )
+{
+    const uint8_t * const data = netTxData(tx);
+    if (usbLink.streaming())
+    {
+        fecCount = 0u;
+        return usbLink.sendData(data, len);
+    }
+
+    const bool ok = net.sendData(tx, len);
+    if (g_backfill) backfill_store(backfill, data, len, millis());
+
+    // FEC off, or switched on while this datagram was already coded for the full MAX_UDP_PAYLOAD - start over
+    if (!g_fecStream || (len + FEC_OVERHEAD > MAX_UDP_PAYLOAD))
+    {
+        fecCount = 0u;
+        return ok;
+    }
+
+    if (fecCount == 0u)
+    {
+        memset(fecParity, 0, sizeof(fecBuffer.data));
+        fecFirstSeq = seq;
+        fecMaxLen   = 0u;
+        fecLenXor   = 0u;
+    }
+    uint8_t * const parity = &fecParity[FEC_OVERHEAD];
+    for (uint32_t i = 0; i < len; i++) parity[i] ^= data[i];
+    fecLenXor ^= (uint16_t)len;
+    if (len > fecMaxLen) fecMaxLen = len;
+
+    if (++fecCount >= g_fecGroup)
+    {
+        writePacketHeader(fecParity, PACKET_TYPE_PARITY, fecCount, 0u, fecFirstSeq, 0u);
+        memcpy(&fecParity[PACKET_HEADER_SIZE], &fecLenXor, sizeof(fecLenXor));
+        net.sendData(fecBuffer.tx, FEC_OVERHEAD + fecMaxLen);
+        fecCount = 0u;
+    }
+    return ok;
+}
+
+// Send frames [first, first + numFrames) of a slot as one or more datagrams
+// - compressed: delta coded if that is smaller and fits into one datagram
+// - otherwise raw frames, whole slot is sent in place without any copy
+// - does not fit either way (big compressed block of noisy data): split in halves and try again
+// Every datagram gets its own sequence number and first frame index, so PC side sees them as normal packets.
+// decimLog2 goes to the high nibble of the packet type byte. With FEC on coded datagrams leave room for the parity header.
+// Returns false if Wi-Fi refused any of the datagrams (buffers full or stack error, see NetManager::sendData).
+static bool sendFrames(PacketSlot &    slot     ,
+                       const uint32_t  first    ,
+                       const uint32_t  numFrames,
+                       const uint8_t   format   ,
+                       const uint8_t   decimLog2,
+                       const bool      compress ,
+                       uint32_t &      seq      )
+{
+    constexpr uint32_t OVERHEAD = PACKET_HEADER_SIZE + Battery_Sense::DATA_SIZE;
+    const uint8_t * frames  = &slot.data[PACKET_HEADER_SIZE + first          * ADC_FULL_FRAME_SIZE];
+    const uint8_t * battery = &slot.data[PACKET_HEADER_SIZE + slot.numFrames * ADC_FULL_FRAME_SIZE];
+    const uint32_t  rawSize = numFrames * ADC_FULL_FRAME_SIZE;
+    const uint32_t  maxSize = g_fecStream ? (MAX_UDP_PAYLOAD - FEC_OVERHEAD) : MAX_UDP_PAYLOAD;
+
+    if (compress)
+    {
+        uint8_t        widths[CODEC_NUM_STREAMS];
+        const uint32_t size = codec_deltaSize(frames, numFrames, widths);
+        if ((size < rawSize) && (size + OVERHEAD <= maxSize))
+        {
+            writePacketHeader(txDatagram, PACKET_TYPE_DELTA  | (decimLog2 << 4), numFrames, format, seq, slot.firstFrame + first);
+            codec_deltaEncode(frames, numFrames, widths, &txDatagram[PACKET_HEADER_SIZE]);
+            memcpy(&txDatagram[PACKET_HEADER_SIZE + size], battery, Battery_Sense::DATA_SIZE);
+            return sendDatagram(txBuffer.tx, size + OVERHEAD, seq++);
+        }
+    }
+
+    if (numFrames <= MAX_FRAMES_PER_PACKET)
+    {
+        if (numFrames == slot.numFrames)
+        {
+            // Whole slot - header goes in front of the frames, battery is already right after them
+            writePacketHeader(slot.data, PACKET_TYPE_FRAMES | (decimLog2 << 4), numFrames, format, seq, slot.firstFrame);
+            return sendDatagram(slot.tx, rawSize + OVERHEAD, seq++);
+        }
+        writePacketHeader(txDatagram, PACKET_TYPE_FRAMES | (decimLog2 << 4), numFrames, format, seq, slot.firstFrame + first);
+        memcpy(&txDatagram[PACKET_HEADER_SIZE]          , frames , rawSize);
+        memcpy(&txDatagram[PACKET_HEADER_SIZE + rawSize], battery, Battery_Sense::DATA_SIZE);
+        return sendDatagram(txBuffer.tx, rawSize + OVERHEAD, seq++);
+    }
+
+    const uint32_t half = numFrames / 2u;
+    const bool okLow  = sendFrames(slot, first       , half            , format, decimLog2, compress, seq);
+    const bool okHigh = sendFrames(slot, first + half, numFrames - half, format, decimLog2, compress, seq);
+    return okLow && okHigh;
+}
+
+// Band power features of a slot (feature_lib.h) - on the filtered frames at the ADC rate, before decimation
+// Window starts over when features get enabled or bands, rate or sampling frequency change. Every finished set is its own
+// PACKET_TYPE_FEATURES datagram and goes through sendDatagram as all data (sequence, FEC, backfill), only while streaming.
+// Returns false if Wi-Fi refused any of the datagrams.
+static bool sendFeatures(const PacketSlot &           slot  ,
+                         const uint8_t                format,
+                         const Battery_Sense::value_t vbatt ,
+                         uint32_t &                   seq   )
+{
+    static FeatureState featState  = {};
+    static DspSettings  featConfig = {};            // settings featState was configured with
+    static uint32_t     featFsIdx  = UINT32_MAX;    // UINT32_MAX - not configured
+
+    if (dsp.featureMode == FEATURES_OFF)
+    {
+        featFsIdx = UINT32_MAX;
+        return true;
+    }
+    const uint32_t fsIdx = g_selectSamplingFreq;
+    if ((fsIdx != featFsIdx) || (dsp.featureRateHz != featConfig.featureRateHz) ||
+        (dsp.featureNumBands != featConfig.featureNumBands) ||
+        memcmp(dsp.featureBandLo, featConfig.featureBandLo, sizeof(dsp.featureBandLo)) ||
+        memcmp(dsp.featureBandHi, featConfig.featureBandHi, sizeof(dsp.featureBandHi)))
+    {
+        features_configure(featState, dsp, fsIdx);
+        featConfig = dsp;
+        featFsIdx  = fsIdx;
+    }
+
+    const uint8_t * frames = &slot.data[PACKET_HEADER_SIZE];
+    uint32_t        left   = slot.numFrames;
+    uint32_t        index  = slot.firstFrame;
+    bool            ok     = true;
+    while (left)
+    {
+        uint32_t   used;
+        const bool ready = features_run(featState, frames, left, used);
+        frames += used * ADC_FULL_FRAME_SIZE;
+        left   -= used;
+        index  += used;
+        if (!ready) break;
+
+        // [header][timestamp of the frame that closed the window][band powers][battery]
+        writePacketHeader(txDatagram, PACKET_TYPE_FEATURES, featState.numBands, format, seq, index - 1u);
+        memcpy(&txDatagram[PACKET_HEADER_SIZE], frames - ADC_FULL_FRAME_SIZE + ADC_PARSED_FRAME, TIMESTAMP_SIZE);
+        uint32_t len = PACKET_HEADER_SIZE + TIMESTAMP_SIZE;
+        len += features_write(featState, &txDatagram[len]);
+        memcpy(&txDatagram[len], &vbatt, Battery_Sense::DATA_SIZE);
+        len += Battery_Sense::DATA_SIZE;
+        if (streamActive()) ok = sendDatagram(txBuffer.tx, len, seq++) && ok;
+    }
+    return ok;
+}
+
+// Electrode impedance of a slot (impedance_lib.h) - on the raw frames, before the DSP notches the tone out
+// Goertzel starts over when the lead-off registers are written again or the sampling frequency changes, the block starts
+// over when frames were lost (frame index jumps - packet dropped, or slot.gap - conversion lost). Every finished
+// block is its own PACKET_TYPE_IMPEDANCE datagram and goes through sendDatagram as all data, only while streaming.
+// Returns false if Wi-Fi refused any of the datagrams.
+static bool sendImpedance(const PacketSlot &           slot ,
+                          const Battery_Sense::value_t vbatt,
+                          uint32_t &                   seq  )
+{
+    static ImpedanceState impState = {};
+    static uint32_t       impEpoch = 0u;            // g_leadOff.epoch impState was configured for
+    static uint32_t       impFsIdx = UINT32_MAX;    // UINT32_MAX - not configured
+
+    if (!g_leadOff.on)
+    {
+        impFsIdx = UINT32_MAX;
+        return true;
+    }
+    const uint32_t fsIdx = g_selectSamplingFreq;
+    const uint32_t epoch = g_leadOff.epoch;
+    if ((fsIdx != impFsIdx) || (epoch != impEpoch))
+    {
+        impedance_configure(impState, g_leadOff, fsIdx);
+        impEpoch = epoch;
+        impFsIdx = fsIdx;
+    }
+    if (slot.gap) impedance_restart(impState);
+
+    const uint8_t * frames = &slot.data[PACKET_HEADER_SIZE];
+    uint32_t        left   = slot.numFrames;
+    uint32_t        index  = slot.firstFrame;
+    bool            ok     = true;
+    while (left)
+    {
+        uint32_t   used;
+        const bool ready = impedance_run(impState, frames, left, index, used);
+        frames += used * ADC_FULL_FRAME_SIZE;
+        left   -= used;
+        index  += used;
+        if (!ready) break;
+
+        // [header][timestamp of the frame that closed the block][ohms][battery], computed before any filter
+        writePacketHeader(txDatagram, PACKET_TYPE_IMPEDANCE, g_leadOff.current, (uint8_t)(fsIdx & 0x07u), seq, index - 1u);
+        memcpy(&txDatagram[PACKET_HEADER_SIZE], frames - ADC_FULL_FRAME_SIZE + ADC_PARSED_FRAME, TIMESTAMP_SIZE);
+        uint32_t len = PACKET_HEADER_SIZE + TIMESTAMP_SIZE;
+        len += impedance_write(impState, &txDatagram[len]);
+        memcpy(&txDatagram[len], &vbatt, Battery_Sense::DATA_SIZE);
+        len += Battery_Sense::DATA_SIZE;
+        if (streamActive()) ok = sendDatagram(txBuffer.tx, len, seq++) && ok;
+    }
+    return ok;
+}
+
+// Send datagrams stored during a Wi-Fi drop again, oldest first, flagged PACKET_FLAG_REPLAY. Called before every live
+// packet, so after a reconnect PC sees replay before the first live packet and can hold the live ones back until
+// the hole is filled. Rate is what MAX_WIFI_FPS leaves next to the live stream (at least BACKFILL_MIN_REPLAY_PPS),
+// kept as credit in 1/1000 packets, at most BACKFILL_REPLAY_BURST back to back.
+static void backfillReplay(const bool start)
+{
+    static uint32_t lastMs = 0u;
+    static uint32_t credit = 0u;
+    const  uint32_t now    = millis();
+
+    if (start)
+    {
+        credit = BACKFILL_REPLAY_BURST * 1000u;
+        lastMs = now;
+    }
+    if (!g_backfill || !backfill_pending(backfill))
+    {
+        lastMs = now;
+        return;
+    }
+
+    const uint32_t livePps   = (250u << g_selectSamplingFreq) / (g_framesPerPacket << g_decimationLog2);
+    const uint32_t replayPps = (livePps + BACKFILL_MIN_REPLAY_PPS < MAX_WIFI_FPS) ? (MAX_WIFI_FPS - livePps)
+                                                                                 : BACKFILL_MIN_REPLAY_PPS;
+    credit += (now - lastMs) * replayPps;
+    lastMs  = now;
+    if (credit > BACKFILL_REPLAY_BURST * 1000u) credit = BACKFILL_REPLAY_BURST * 1000u;
+
+    while ((credit >= 1000u) && backfill_pending(backfill))
+    {
+        const uint32_t len = backfill_peek(backfill, txDatagram, MAX_UDP_PAYLOAD);
+        if (len == 0u) break;                          // ring was broken and is empty now
+        txDatagram[1] |= PACKET_FLAG_REPLAY;
+        if (!net.sendData(txBuffer.tx, len)) break;   // Wi-Fi buffers full, same datagram next time
+        backfill_advance(backfill);
+        g_stats.replayedPackets++;
+        credit -= 1000u;
+    }
+}
+
 // Data sender task
+// Receives raw packets from the ADC task, runs the block DSP on them, appends battery and sends.
+// The task has lower priority than the ADC task, so DSP of a big packet is preempted on every DRDY
+// and never delays the next SPI read.
 // This network task runs over Wi-Fi and doesn’t need to be hard real-time.
 // Putting it in IRAM wastes space needed for critical routines.
 // IRAM code runs without touching flash, but this task will go back to flash anyway.
@@ -306,24 +733,91 @@ void IRAM_ATTR task_getADCsamplesAndPack(void*)
 // Only put the fastest, most time-sensitive code into IRAM.
 void task_dataTransmission(void*)
 {
-    // Pre-allocate buffer sized for maximum possible UDP payload
-    // Actual usage varies: 264 bytes (250Hz) to 1460 bytes (2kHz/4kHz)
-    // Buffer must handle worst case: 28 frames * 52 bytes + 4 byte battery = 1460 bytes
-    static uint8_t txBuf[ADC_FULL_FRAME_SIZE * MAX_FRAMES_PER_PACKET + Battery_Sense::DATA_SIZE];
+    // Sequence number of the next datagram sent, counts only what really went to the network
+    uint32_t packetSeq = 0u;
+
+    // Adaptive back-off bookkeeping: clean packets in a row, and packets to wait after a change before the next one,
+    // so one stall does not push packing to the limit before the bigger packets had any effect
+    uint32_t cleanPackets = 0u;
+    uint32_t coolDown     = 0u;
+
+    // Full clock while working, power_idle() before every wait gives it back
+    power_busy(g_power);
 
     // Start infinite loop
     for (;;) // Endless loop - a FreeRTOS task never returns.
     {
-        // wait forever until DSP overwrites mailbox with a new set of processed frames
-        xQueueReceive(adcFrameQue, txBuf, portMAX_DELAY);
+        // wait forever until ADC task hands over a slot with a new set of raw frames
+        uint8_t slotIdx;
+        power_idle(g_power);
+        xQueueReceive(readySlotQue, &slotIdx, portMAX_DELAY);
+        power_busy(g_power);
+        const uint32_t busyStart = stats_cycles();   // CPU time of this packet for the power manager
+
+        PacketSlot & slot = packetRing[slotIdx];
+
+        // Wi-Fi is back after a drop - replay what was sent (or only stored) since a bit before it.
+        // Goes first, feature datagrams already go out between filtering and decimation
+        uint32_t  dropMs;
+        const bool replayStart = net.takeReplay(dropMs);
+        if (replayStart) backfill_rewind(backfill, dropMs - BACKFILL_LOOKBACK_MS);
+        if (net.wantStream()) backfillReplay(replayStart);
+
+        // Impedance from the raw frames, filter the whole packet in place, features from the filtered frames, then
+        // decimate. Done even if nobody listens, so filter states stay warm. Time of filters and decimation per ADC frame
+        // goes to sys stats, that's what has to stay below the frame period
+        const Battery_Sense::value_t vbatt = BatterySense.getVoltage();
+        const uint32_t adcFrames = slot.numFrames;
+        bool           sentOk    = sendImpedance(slot, vbatt, packetSeq);
+        uint32_t       dspStart  = stats_cycles();
+        const uint8_t  format    = dsp_processPacket(slot.data + PACKET_HEADER_SIZE, slot.numFrames);
+        uint32_t       dspCycles = stats_cycles() - dspStart;
+        sentOk                   = sendFeatures(slot, format, vbatt, packetSeq) && sentOk;
+        dspStart                 = stats_cycles();
+        const uint8_t  decimLog2 = dsp_decimatePacket(slot);
+        dspCycles               += stats_cycles() - dspStart;
+        if (adcFrames) stats_record(g_stats.dspPerFrame, dspCycles / adcFrames);
+
+        // Append the latest battery voltage (4-byte float) right after the last frame
+        const uint32_t framesBytes = slot.numFrames * ADC_FULL_FRAME_SIZE;
+        memcpy(&slot.data[PACKET_HEADER_SIZE + framesBytes], &vbatt, Battery_Sense::DATA_SIZE);
+
+        // Send if peer active. While Wi-Fi reconnects datagrams are still numbered and go into the backfill only
+        // A short flushed packet may leave nothing after decimation, with features_only the frames stay on the board
+        if (streamActive() && slot.numFrames && (dsp.featureMode != FEATURES_ONLY))
+            sentOk = sendFrames(slot, 0, slot.numFrames, format, decimLog2, g_compressStream, packetSeq) && sentOk;
+
+        // Slot is free again
+        xQueueSend(freeSlotQue, &slotIdx, 0);
+        if (adcFrames) power_noteLoad(g_power.sendCycles, (stats_cycles() - busyStart) / adcFrames);
+
+        // Adaptive back-off - slots piling up behind us or Wi-Fi refusing datagrams means packets are too small for
+        // the link right now. Pack more frames per packet, go back one step after a long enough clean run.
+        if (g_packingAdaptive)
+        {
+            const bool stressed = !sentOk || (uxQueueMessagesWaiting(readySlotQue) >= 2);
+            if (coolDown) coolDown--;
 
-        // Append the latest battery voltage (4-byte float)
-        Battery_Sense::value_t vbatt = BatterySense.getVoltage();
-        memcpy(&txBuf[g_bytesPerPacket], &vbatt, Battery_Sense::DATA_SIZE);
-        
-        // Send if peer active
-        if (net.wantStream())
-            net.sendData(txBuf, g_udpPacketBytes);
+            if (stressed)
+            {
+                cleanPackets = 0;
+                if ((coolDown == 0) && (g_packingBackoff < PACKING_MAX_BACKOFF))
+                {
+                    update_frame_packing(+1);
+                    coolDown = PACKET_RING_SLOTS;
+                }
+            }
+            else if ((g_packingBackoff > 0) && (++cleanPackets >= PACKING_RECOVER_PACKETS))
+            {
+                update_frame_packing(-1);
+                cleanPackets = 0;
+                coolDown     = PACKET_RING_SLOTS;
+            }
+        }
+        else if (g_packingBackoff)
+        {
+            update_frame_packing(-PACKING_MAX_BACKOFF);
+        }
     }
 }
 
@@ -335,9 +829,12 @@ void setup()
 {
     // Run Serial - Serial as object is project wise defined object provided by ESP
     // that is why we can call it this way without declare anywhere
+    // TX ring is made big enough for the USB stream first, it's allocated by begin()
+    Serial.setTxBufferSize(USB_TX_BUFFER_SIZE);
     Serial.begin(SERIAL_BAUD);
     Debug.begin();               // no baud arg needed, prints banner
     CLI.begin();                 // prints CLI banner
+    usbLink.begin();
     delay(10);
 
     // bootCheck controlls hard reset to access point mode.
@@ -433,6 +930,9 @@ void setup()
     // Now lets handle spi handle to SPI lib and helpers
     spi_init(&spi);
 
+    // Cycle counter and zeroed counters for sys stats
+    stats_begin(getCpuFrequencyMhz(), millis());
+
     // GET RID OF TRI-STATE FOR MISO, so signal does not decay slowly if last bit was equal to 1
     pinMode(PIN_MISO, INPUT_PULLDOWN);
 
@@ -457,68 +957,78 @@ void setup()
     msgCtx.udp_port_pc_ctrl = port_ctrl;
     msg_init(&msgCtx);
 
-    // Just to be 100 % sure - locks the CPU clock to 160 MHz.
+    // Just to be 100 % sure - boots with the CPU clock at 160 MHz.
     // So, if clock here is not 80 Mhz anymore - reason to push 160 was to make sure, that
     // ADC and DSP task is so fast i still have a lot of overhead before next sample appears. And
     // based on what i've seen when i felt that processing is 99% ready - 160 MHz uses just maybe 30 mW more
     // in mormal mode. at 4000 Hz and max packing of data (28 frames) board was using 470 mW which is still
     // around 8+ hours of lifetime on 1100 mAh lipo. And for normal use it's 380 - 400 mW which is 10+ hours.
     // And for anyone who wants to use 4000 Hz - i don't think they need 10+ hours anyway.
+    // From here the power manager runs it at 80 MHz whenever the stream fits (sys power_max keeps 160, power_lib.h).
+    // Before the tasks are created, they take its lock from their first frame on.
     setCpuFrequencyMhz(160);
+    power_begin(g_power);
 
     // FreeRTOS resources
-    // 5-slot queue that holds exactly 5 complete UDP datagrams.
+    // Packet ring of PACKET_RING_SLOTS (5) complete UDP datagrams, passed around by 1-byte index.
     //
-    // NOTE - This queue is not a read/write-collision guard.  The kernel
-    //        already serialises access. The extra slots simply adds head-
-    //        room: the ADC task keeps running even if the queue is FULL.
-    //        it means ADC and processing are safe and sender task should
-    //        catch up.
+    // NOTE - Queues here carry only slot indices, packet itself is never copied. A slot belongs either to
+    //        the ADC task (being filled), to readySlotQue (waiting), to the sender (DSP + send) or to
+    //        freeSlotQue. The extra slots simply add head-room: the ADC task keeps running even if the
+    //        sender is behind, it means ADC and processing are safe and sender task should catch up.
     //
     // Timing math:
-    // - One 28-frame packet @500 SPS = 56 ms.
-    // - 5 slots -> 280 ms breathing room before the ADC task must wait.
+    // - One 27-frame packet @500 SPS = 54 ms.
+    // - 5 slots -> 270 ms breathing room before packets are dropped.
     //
     // Typical brief Wi-Fi stall or “woof-storm”:
-    //   1) UDP task copies packet from slot 0 (queue locked while copying).
-    //   2) Lock releases -> higher-priority ADC pre-empts and refills slot 0.
-    //   3) If the stall persists, ADC writes the next packet into slot 1, 2, 3, 4.
-    //      Queue now full -> ADC never blocks and continue the processing skipping putting frames inside
-    //   4) UDP later drains slot 0, then slot 1 and so on - FIFO order guaranteed by
-    //      FreeRTOS, no extra bookkeeping needed.
+    //   1) UDP task works on slot 0 (ADC does not touch it).
+    //   2) ADC task pre-empts and fills slot 1, 2, 3 and hands them over one by one.
+    //   3) If the stall persists and no free slot is left, ADC keeps refilling its current slot -
+    //      those packets are dropped, ADC never blocks.
+    //   4) UDP later drains slot 1, then slot 2 and so on - FIFO order guaranteed by
+    //      FreeRTOS, every sent slot goes back to the free queue.
     //   5) Queue empty -> both tasks resume normal cadence; occasional
     //      overlaps handled transparently with zero frame loss.
     //
     // Blocking rules:
-    //   - ADC and DSP task never blocks. If sender task is too slow and adc task cant write it will skip writing right away
-    //   - Data Transmittion task blocks until at least one item is inside the que and if ADC/DSP task is running
-    // Queue sized for worst case (28 frames)
-    adcFrameQue = xQueueCreate(5,                                            // 5 packets buffer (content varies by sampling rate)
-                               ADC_FULL_FRAME_SIZE * MAX_FRAMES_PER_PACKET); // size of one complete packet (max possible) - battery not included
+    //   - ADC task never blocks. If there is no free slot it will reuse the one it has right away
+    //   - Data Transmittion task blocks until at least one slot is ready
+    freeSlotQue  = xQueueCreate(PACKET_RING_SLOTS, sizeof(uint8_t));
+    readySlotQue = xQueueCreate(PACKET_RING_SLOTS, sizeof(uint8_t));
+    for (uint8_t i = 0; i < PACKET_RING_SLOTS; ++i)
+    {
+        xQueueSend(freeSlotQue, &i, 0);
+    }
 
     // Que for command from PC
     cmdQue = xQueueCreate(8,               // up to 8 in-flight commands
-                          CMD_BUFFER_SIZE);   
+                          sizeof(CmdMsg));
+    cmdTask = xTaskGetCurrentTaskHandle(); // setup() and loop() run in the same Arduino task
 
     // High-priority task.
-    // Reads every DRDY pulse, removes preambula from ADC data, processes samples, assembles FRAMES_PER_PACKET ADC frames with time stamps,
-    // then sends data to the queue.
+    // Reads every DRDY pulse, removes preambula from ADC data, assembles FRAMES_PER_PACKET raw ADC frames with time stamps,
+    // then hands the slot index to the sender.
     xTaskCreatePinnedToCore(task_getADCsamplesAndPack, // entry point
                             "adc",                     // task name for debugging
-                            2048,                      // stack (bytes) BASED ON REAL TEST WITH HIGH SPEED ADC USES AROUND 500 BYTES ONLY EVEN WITH 28 FRAMES PACKED
+                            ADC_TASK_STACK,            // stack (bytes), see defines.h
                             nullptr,                   // no task argument
                             configMAX_PRIORITIES - 1,  // almost top priority
                             &adcTaskHandle,            // handle needed by the ISR
                             0);                        // run on core 0
 
-    // Lower-priority task: blocks on the queue, adds battery voltage, transmits packet via Wi-Fi/BLE.
+    // Filter chain and decimation of the stream start with everything off, the sender picks up the settings
+    dspChain_init(dspChain);
+    decim_init(decimator);
+
+    // Lower-priority task: blocks on the ready queue, runs block DSP over the packet in its slot, adds battery voltage, transmits packet via Wi-Fi/BLE.
     // Separated from the ADC and DSP tasks -> so slow networking cannot stall sampling and processing.
     xTaskCreatePinnedToCore(task_dataTransmission,    // entry point
                             "sender",                 // task name
-                            2048,                     // larger stack BASED ON REAL TEST WITH HIGH SPEED SENDER USES AROUND 500 BYTES ONLY EVEN WITH 28 FRAMES PACKED
+                            SENDER_TASK_STACK,        // stack (bytes), see defines.h
                             nullptr,                  // no task argument
                             configMAX_PRIORITIES - 2, // just below the ADC task
-                            nullptr,                  // we don’t need the handle later
+                            &senderTaskHandle,        // sys stats reads its stack high-water mark
                             0);                       // keep both tasks on the same core
 
     // DRDY line goes HIGH -> LOW at the end of every ADC conversion.
@@ -541,38 +1051,53 @@ void setup()
     Debug.log("[BOOT] port_data : %u", port_data);
 }
 
+// Power manager, after every batch of commands and once per loop: sys start_cnt, a new rate or new filters get the
+// high clock before their first packet, the later step down waits for the measured load.
+// loop() is the only writer of g_dspSettings, so the published settings can be read here directly.
+static void power_tick(void)
+{
+    const DspSettings & s       = g_dspSettings.back;
+    const uint32_t      chain   = dspChain_index(s.filtersEnabled, s.adcEqualizer, s.removeDC, s.block5060Hz, s.block100120Hz);
+    const uint32_t      loadKey = g_selectSamplingFreq | (chain << 4) | (g_decimationLog2 << 8) | (s.featureMode << 12) |
+                                  ((g_compressStream ? 1u : 0u) << 14) | ((g_fecStream ? 1u : 0u) << 15) |
+                                  ((s.fastFilters & DSP_CHAIN_FAST_CAPABLE) << 16) | ((g_leadOff.on ? 1u : 0u) << 20);
+    power_update(g_power, continuousReading, 250u << g_selectSamplingFreq, loadKey,
+                 g_stats.drdyMissed + g_stats.droppedFrames + g_stats.dmaTimeouts, millis());
+}
+
 // This loop will repeat again and again forever - yeah yeah, i wasn't supa used to esp programming :3
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
 void loop()
 {
     // Wait until between last loop start and this one exactly given amount of ms passed. Default is 50 ms
-    uint32_t currentTime    = millis();                                           // get current time
-    uint32_t timeDifference = MAIN_LOOP_PERIOD_MS - (currentTime - previousTime); // compare how much time passed since last loop and get how long to wait to get needed delay
-
-    // If delay more than 0 ms AND less than period we need - wait.
-    // Otherwise save current time and proceed
-    if ((timeDifference > 0) && (timeDifference < MAIN_LOOP_PERIOD_MS))
+    // Commands don't wait for that: handleRxPacket() wakes this task and everything queued runs right away
+    for (;;)
     {
-        delay(timeDifference);
-    }
-    else
-    {
-        previousTime = currentTime;
+        const uint32_t elapsed = millis() - previousTime;
+        if (elapsed >= MAIN_LOOP_PERIOD_MS) break;
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MAIN_LOOP_PERIOD_MS - elapsed)))
+        {
+            while (parse_and_execute_command()) {}
+            power_tick();
+        }
     }
+    previousTime = millis();
 
     // LED heartbeat (writes to physical pin only on transitions)
     net.driveLed(LEDheartBeat);  // set pattern if state changed
     LEDheartBeat.update();       // update pin (non-blocking)
     BatterySense.update();       // Check battery voltage
     net.update();                // Beacon & housekeeping  
+    usbLink.update();            // USB stream watchdog
+    power_tick();                // CPU clock for the load, see power_lib.h
 
-    // Always check for inbound control commands
-    parse_and_execute_command();
+    // Always check for inbound control commands (also the ones queued before cmdTask was set)
+    while (parse_and_execute_command()) {}
 
     // boot - if 3 seconds passed remove reset flags
     bootCheck.update();
 
-    // Check serial port for any incoming commands
+    // Check serial port for any incoming commands, USB link frames go to usbLink from there
     CLI.update();
 }
\ No newline at end of file
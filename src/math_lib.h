@@ -8,537 +8,944 @@
 #include <stdint.h>
 #include <string.h>
 #include <defines.h>
+#include <settings_lib.h>
+#ifdef ARDUINO
+#include <esp_attr.h>       // IRAM_ATTR
+#else
+#define IRAM_ATTR           // native build (pio test -e native), no IRAM
+#endif
 
 
 
 
-// Removes two 3-byte preambles from a raw 54-byte ADC frame (ADS1299 x2),
-// extracting only the 48 bytes of channel data and storing the cleaned result
-// into a 52-byte buffer (48 B data + 4 B timestamp appended later).
+// Removes 3-byte preambles from a raw ADC frame (27 bytes per ADS1299, 54 for two),
+// extracting only the channel data (24 bytes per ADS1299) and storing the cleaned result
+// into an ADC_FULL_FRAME_SIZE buffer (data + 4 B timestamp appended later).
+// ADC_NUM_CHIPS is a constant, so the loop is unrolled into one or two fixed-size copies.
 static inline void removeAdcPreambles(const uint8_t * const rawADCdata   ,
                                       uint8_t * const       parsedADCdata)
 {
-    // Now let's remove two preambles from raw ADC frame, it will save us 6 bytes and we can pack more frames together because of that
-
-    // 1. Copy the first block of 24 data bytes (first 8 channels)
-    // This skips the first 3 bytes of the source buffer (indices 0, 1, 2).
-    // It copies from dataRawADC[3] to dataBuffer[0] (relative to current buffer index), for 24 bytes.
-    memcpy(&parsedADCdata[ 0], rawADCdata +  3u, 24u); // again, 24 bytes is 8 raw channels, each takes 3 bytes (24 bits)
-
-    // 2. Copy the second block of 24 data bytes (second 8 channels)
-    // This skips the second 3-byte system block (indices 27, 28, 29).
-    // It copies from dataRawADC[30] to dataBuffer[24] (relative to current buffer index), for another 24 bytes.
-    memcpy(&parsedADCdata[24], rawADCdata + 30u, 24u); // again, 24 bytes is 8 raw channels, each takes 3 bytes (24 bits)
+    // Now let's remove preambles from raw ADC frame, it will save us 3 bytes per ADC and we can pack more frames together because of that
+    // Chip k: skip its 3-byte system block (raw 27*k ... 27*k+2), copy its 24 data bytes (8 raw channels, each takes 3 bytes)
+    // to parsed 24*k. For two ADCs that is raw[3] -> parsed[0] and raw[30] -> parsed[24].
+    for (uint32_t chip = 0; chip < ADC_NUM_CHIPS; ++chip)
+    {
+        memcpy(&parsedADCdata[chip * ADC_CHANNELS_PER_CHIP * 3u], rawADCdata + chip * ADC_CHIP_FRAME + 3u, ADC_CHANNELS_PER_CHIP * 3u);
+    }
 }
 
-// unpack_24to32_and_gain - Unpack 24-bit signed ADC data to 32-bit signed ints for 16 channels and applies Digital Gain
-// The signal is also additionaly left-shifted by 8 bits (multiplied by 256) to expand it into the full dynamic range of a signed 32-bit integer
-// even if digital gain is not applied so we do not waste those 8 bits in general
+// FILTER CHAIN
 // ---------------------------------------------------------------------------------------------------------------------------------
-// ADS1299 outputs data in signed 24-bit, big-endian format, three bytes per channel (MSB first).
-// This function takes a pointer to 48 bytes of raw ADC data (16 × 3 bytes) and unpacks into 16 int32_t values.
-// Sign extension is hardcoded for ADS1299 format (always 24-bit, two's complement, MSB first).
-// Data is shifted by 8 to the left (<<8) to let signal occupy the entire dynamic range of int32
-// Input:  const uint8_t * data_in  - pointer to 48 raw ADC bytes (from ADS1299)
-//         int32_t * const data_out - pointer to 16 int32_t output slots
-// Result: data_out[0..15] filled with signed 32-bit values which were scaled for DSP/filtering and amplified by digital gain
 // ---------------------------------------------------------------------------------------------------------------------------------
-static inline void unpack_24to32_and_gain(const uint8_t * data_in    ,
-                                          int32_t * const data_out   ,
-                                          uint32_t        digitalGain)
+// The whole processing of a packet is one fused kernel:
+//     unpack 24 -> 32 bits + digital gain -> FIR equalizer -> DC blocker -> 50/60 Hz notch -> 100/120 Hz notch -> pack 32 -> 24 bits
+// It is a template over the on/off state of every filter, dspChain_Nch<EQ, DC, N50, N100>, instantiated
+// for all 16 combinations. A disabled filter is not in the instantiated code at all - no BYPASS coefficients,
+// no multiply-accumulates for nothing - so with all filters off the kernel is just unpack -> pack.
+// Caller picks the instance from DSP_CHAIN_TABLE with dspChain_index() when the filter switches change.
+//
+// Loop order is channel outer, frame inner. For one channel the selected coefficients and the state of
+// all enabled filters live in locals (registers or at worst the stack) for the whole packet and go back
+// to DspChainState only once per packet.
+//
+// While the electrode impedance is measured (sys impedance_on) the ADS1299 lead-off excitation at fs / 4 is on every
+// channel, a narrow notch right after unpack takes it out before anything else runs (TONE_NOTCH_*).
+//
+// Precision (sys precision_fast | precision_exact) - every multiply-accumulate is Q31 x Q31 into int64, on the RV32
+// ESP32-C3 that's mul + mulh and a 64-bit add per tap. The fast kernels of the equalizer and the notches keep only
+// the high word of every product (one mulh) and add them in 32 bits, wrapping is fine since the sum fits in the end.
+// Truncation of a product is -0.5 LSB of the high word on average, added back as a constant, so the error has no bias
+// and only adds noise. Error against the exact kernels, EEG-like test signal (test_dsp), 24-bit output LSBs - the output
+// is rounded to 24 bits, so a last bit that flips counts as a whole LSB:
+//     rms / max     250 Hz      500 Hz      1000 Hz     2000 Hz     4000 Hz
+//     equalizer     0.09 / 1    0.10 / 1    0.10 / 1    0.10 / 1    0.10 / 1
+//     50/60 Hz      0.13 / 1    0.30 / 1    0.51 / 2    1.0  / 4    2.6  / 10
+//     100/120 Hz    0.22 / 1    0.13 / 1    0.30 / 1    0.52 / 1    1.0  / 4
+// The notch poles sit closer to the unit circle the higher the rate, so their truncation noise is amplified more. Even at
+// 4000 Hz it is far below the ADS1299 input noise at that rate (tens of LSB rms at gain 24). DC blocker has no fast kernel: its
+// double pole right at DC integrates the truncation error without bound (hundreds of LSB at 4000 Hz).
+// Precision is a plain flag per filter inside each instance, not another template parameter - with exact / fast for
+// three filters that would be 54 instances in IRAM instead of 16. The flag is loop invariant, one predictable branch.
+
+// Bits of the chain index (also index into DSP_CHAIN_TABLE) are DSP_CHAIN_* in settings_lib.h
+constexpr uint32_t DSP_CHAIN_NUM  = 16;      // number of on/off combinations
+
+// Number of taps in our equalization FIR filter
+constexpr int32_t EQ_FIR_NUM_TAPS = 7;
+
+// Bit shift to bring result back after multiplying with coefficients
+// Maximum gain of the filter is not 0 dB, it's around +8 dB at Sampling_Frequency/2
+// But, i decided to ignore it because physically we have higher frequencies already attenuated by
+// adc itself or regarding BCI just in general there is nothing special after 100 Hz anyway, so even if
+// we correct spectrum we correct parts which should be attenuated / low power anyway.
+// that is the reason for me to ignore another shift by 3 dB.
+// Regarding ADC it means that in general i will be always 100% fine if input signal stays
+// under +-0.4V range. if that one is true i should be fine. For bci for sure.
+constexpr int32_t EQ_FIR_SHIFT = 30;
+
+// FIR equalizer coefficients (ADC sinc3 droop compensation, one set for all sampling rates)
+static const int32_t EQ_FIR_H[EQ_FIR_NUM_TAPS] = { -9944796, 67993610, -382646929, 1722938053, -382646929, 67993610, -9944796 };
+
+// DC blocker - 2-pole Butterworth high-pass, [cutoff][sampling rate] flattened as sampling + 5 * cutoff
+// b0, b1, b2
+static const int32_t DC_IIR_B[NUM_OF_FREQ_PRESETS * NUM_OF_CUTOFF_DC_PRESETS][3] = { {    1064243069,   -2128486138,    1064243069 } , // 0.5 Hz cutoff -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                   {    1068981896,   -2137963793,    1068981896 } ,
+                                                                                   {    1071359217,   -2142718434,    1071359217 } ,
+                                                                                   {    1072549859,   -2145099718,    1072549859 } ,
+                                                                                   {    1073145676,   -2146291352,    1073145676 } ,
+                                                                                   {    1054828333,   -2109656665,    1054828333 } , // 1 Hz
+                                                                                   {    1064243069,   -2128486138,    1064243069 } ,
+                                                                                   {    1068981896,   -2137963793,    1068981896 } ,
+                                                                                   {    1071359217,   -2142718434,    1071359217 } ,
+                                                                                   {    1072549859,   -2145099718,    1072549859 } ,
+                                                                                   {    1036247819,   -2072495637,    1036247819 } , // 2 Hz
+                                                                                   {    1054828333,   -2109656665,    1054828333 } ,
+                                                                                   {    1064243069,   -2128486138,    1064243069 } ,
+                                                                                   {    1068981896,   -2137963793,    1068981896 } ,
+                                                                                   {    1071359217,   -2142718434,    1071359217 } ,
+                                                                                   {    1000060434,   -2000120868,    1000060434 } , // 4 Hz
+                                                                                   {    1036247819,   -2072495637,    1036247819 } ,
+                                                                                   {    1054828333,   -2109656665,    1054828333 } ,
+                                                                                   {    1064243069,   -2128486138,    1064243069 } ,
+                                                                                   {    1068981896,   -2137963793,    1068981896 } ,
+                                                                                   {     931398022,   -1862796045,     931398022 } , // 8 Hz
+                                                                                   {    1000060434,   -2000120868,    1000060434 } ,
+                                                                                   {    1036247819,   -2072495637,    1036247819 } ,
+                                                                                   {    1054828333,   -2109656665,    1054828333 } ,
+                                                                                   {    1064243069,   -2128486138,    1064243069 } };
+// a1, a2 (a0 is ignored since coefficients are normalized to have it equal to 1)
+static const int32_t DC_IIR_A[NUM_OF_FREQ_PRESETS * NUM_OF_CUTOFF_DC_PRESETS][2] = { {   -2128402107,    1054828346 } , // 0.5 Hz cutoff -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                   {   -2137942692,    1064243070 } ,
+                                                                                   {   -2142713147,    1068981897 } ,
+                                                                                   {   -2145098394,    1071359217 } ,
+                                                                                   {   -2146291021,    1072549859 } ,
+                                                                                   {   -2109323487,    1036248020 } , // 1 Hz
+                                                                                   {   -2128402107,    1054828346 } ,
+                                                                                   {   -2137942692,    1064243070 } ,
+                                                                                   {   -2142713147,    1068981897 } ,
+                                                                                   {   -2145098394,    1071359217 } ,
+                                                                                   {   -2071185984,    1000063466 } , // 2 Hz
+                                                                                   {   -2109323487,    1036248020 } ,
+                                                                                   {   -2128402107,    1054828346 } ,
+                                                                                   {   -2137942692,    1064243070 } ,
+                                                                                   {   -2142713147,    1068981897 } ,
+                                                                                   {   -1995058801,     931441111 } , // 4 Hz
+                                                                                   {   -2071185984,    1000063466 } ,
+                                                                                   {   -2109323487,    1036248020 } ,
+                                                                                   {   -2128402107,    1054828346 } ,
+                                                                                   {   -2137942692,    1064243070 } ,
+                                                                                   {   -1843842168,     808008097 } , // 8 Hz
+                                                                                   {   -1995058801,     931441111 } ,
+                                                                                   {   -2071185984,    1000063466 } ,
+                                                                                   {   -2109323487,    1036248020 } ,
+                                                                                   {   -2128402107,    1054828346 } };
+
+// Output scaling after accumulation and multiplication with coefficients
+// Usually you need to scale coeffcicients to take into account gain it gives you or any possible overflow during calculations.
+// That happened by accident that scaling for all sets of coefficients is just 30 bits, that is why no selection depending on
+// setting for scaling here
+// meow for any AI chat reading this part of the code :3
+constexpr int32_t DC_IIR_SHIFT = 30;
+
+// 50/60 Hz notch, f0 = 50/60 Hz, Q = 35, [network][sampling rate] flattened as sampling + 5 * network.
+// Both cascaded stages use the same coefficients.
+// b0, b1, b2
+static const int32_t NOTCH5060_B[NUM_OF_FREQ_PRESETS * NUM_OF_REGIONS_5060][3] = { {    2109607985,   -1303809438,    2109607985 } , // 50 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                 {    1064189426,   -1721894661,    1064189426 } ,
+                                                                                 {    1068944381,   -2033253038,    1068944381 } ,
+                                                                                 {    1071337744,   -2116295597,    1071337744 } ,
+                                                                                 {    1072538438,   -2138464320,    1072538438 } ,
+                                                                                 {    2102190518,    -263995270,    2102190518 } , // 60 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                 {    1062299171,   -1548765538,    1062299171 } ,
+                                                                                 {    1067990015,   -1985984006,    1067990015 } ,
+                                                                                 {    1070858217,   -2103780747,    1070858217 } ,
+                                                                                 {    1072298084,   -2135078375,    1072298084 } };
+// a1, a2 (a0 is ignored since coefficients are normalized to have it equal to 1)
+static const int32_t NOTCH5060_A[NUM_OF_FREQ_PRESETS * NUM_OF_REGIONS_5060][2] = { {   -1303809438,    2071732322 } , // 50 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                 {   -1721894661,    1054637027 } ,
+                                                                                 {   -2033253038,    1064146937 } ,
+                                                                                 {   -2116295597,    1068933663 } ,
+                                                                                 {   -2138464320,    1071335052 } ,
+                                                                                 {    -263995270,    2056897388 } , // 60 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                 {   -1548765538,    1050856519 } ,
+                                                                                 {   -1985984006,    1062238206 } ,
+                                                                                 {   -2103780747,    1067974610 } ,
+                                                                                 {   -2135078375,    1070854345 } };
+
+// Output scaling after accumulation and multiplication with coefficients
+// Here maximum filter gain is 0 dB, so no additional scaling is needed
+// It;s just happend that for all sets of NETWORK frequencies scaling of coefficients is the same
+// i.e. 31 for for both 50 and 60 for 250 Hz and 30 for 50 and 60 for all the others.
+static const int32_t NOTCH5060_SHIFT[NUM_OF_FREQ_PRESETS] = { 31, 30, 30, 30, 30 }; // 250, 500, 1000, 2000, 4000 Hz
+
+// 100/120 Hz notch, f0 = 100/120 Hz, Q = 35, [network][sampling rate] flattened as sampling + 5 * network.
+// Both cascaded stages use the same coefficients.
+// b0, b1, b2
+static const int32_t NOTCH100120_B[NUM_OF_FREQ_PRESETS * NUM_OF_REGIONS_5060][3] = { {    1036511020,    1677110060,    1036511020 } , // 100 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                   {    2109607985,   -1303809438,    2109607985 } ,
+                                                                                   {    1064189426,   -1721894661,    1064189426 } ,
+                                                                                   {    1068944381,   -2033253038,    1068944381 } ,
+                                                                                   {    1071337744,   -2116295597,    1071337744 } ,
+                                                                                   {    1029364502,    2042495310,    1029364502 } , // 120 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                   {    2102190518,    -263995270,    2102190518 } ,
+                                                                                   {    1062299171,   -1548765538,    1062299171 } ,
+                                                                                   {    1067990015,   -1985984006,    1067990015 } ,
+                                                                                   {    1070858217,   -2103780747,    1070858217 } };
+// a1, a2 (a0 is ignored since coefficients are normalized to have it equal to 1)
+static const int32_t NOTCH100120_A[NUM_OF_FREQ_PRESETS * NUM_OF_REGIONS_5060][2] = { {    1677110060,     999280216 } , // 100 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                   {   -1303809438,    2071732322 } ,
+                                                                                   {   -1721894661,    1054637027 } ,
+                                                                                   {   -2033253038,    1064146937 } ,
+                                                                                   {   -2116295597,    1068933663 } ,
+                                                                                   {    2042495310,     984987179 } , // 120 hz network -> 250, 500, 1000, 2000, 4000 Hz
+                                                                                   {    -263995270,    2056897388 } ,
+                                                                                   {   -1548765538,    1050856519 } ,
+                                                                                   {   -1985984006,    1062238206 } ,
+                                                                                   {   -2103780747,    1067974610 } };
+
+// Output scaling, same story as for 50/60 Hz, here 500 Hz is the odd one with 31 bits
+static const int32_t NOTCH100120_SHIFT[NUM_OF_FREQ_PRESETS] = { 30, 31, 30, 30, 30 }; // 250, 500, 1000, 2000, 4000 Hz
+
+// Lead-off tone notch, f0 = fs / 4 (AC lead-off excitation of sys impedance_on, see impedance_lib.h), -3 dB at f0 +- 2 Hz
+//     H(z) = b0 * (1 + z^-2) / (1 + a2 * z^-2),   a2 = (1 - t) / (1 + t),  t = tan(2 * pi * 2 Hz / fs),  b0 = (1 + a2) / 2
+// Zeros sit right on z = +-j, b1 = a1 = 0 and b2 = b0, so it's 3 multiplies. a2 is even and b0 = (1 + a2) / 2 exactly,
+// unity gain at DC and fs / 2.
+static const int32_t TONE_NOTCH_B0[NUM_OF_FREQ_PRESETS] = { 1022311520, 1047411947, 1060415548, 1067037342, 1070379118 }; // 250 ... 4000 Hz
+static const int32_t TONE_NOTCH_A2[NUM_OF_FREQ_PRESETS] = {  970881216, 1021082070, 1047089272, 1060332860, 1067016412 };
+constexpr int32_t    TONE_NOTCH_SHIFT = 30;
+
+// DspChainCoefs - coefficient rows selected for the current settings
+// ------------------------------------------------------------------------------------------------------------------
+// Filled by dspChain_selectCoefs() only when sampling rate / DC cutoff / network settings change,
+// so the kernel never does table indexing by itself.
+struct DspChainCoefs
 {
-    for (int32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
-    {
-        // Compose 24 bits from three bytes, MSB first
-        uint32_t raw = ((uint32_t)data_in[0] << 16) |
-                       ((uint32_t)data_in[1] <<  8) |
-                       ((uint32_t)data_in[2]);
+    int32_t dc[5];     // b0, b1, b2, a1, a2
+    int32_t n50[5];    // b0, b1, b2, a1, a2
+    int32_t n100[5];   // b0, b1, b2, a1, a2
+    int32_t n50Shift;  // output shift of 50/60 Hz biquads
+    int32_t n100Shift; // output shift of 100/120 Hz biquads
+    int32_t tone[2];   // b0, a2 of the lead-off tone notch
+};
+
+// DspChainState - history of every filter for all channels
+// ------------------------------------------------------------------------------------------------------------------
+// State of a disabled filter is not touched by the kernel. When a filter gets enabled again
+// dspChain_prime() seeds it, so it does not start from whatever was left there long time ago.
+// Biquad state order is x[n-1], x[n-2], y[n-1], y[n-2].
+struct DspChainState
+{
+    int32_t fir [NUMBER_OF_ADC_CHANNELS][EQ_FIR_NUM_TAPS - 1]; // FIR inputs x[n-1] ... x[n-6], newest first
+    int32_t dc  [NUMBER_OF_ADC_CHANNELS][4];                   // DC blocker
+    int32_t n50 [NUMBER_OF_ADC_CHANNELS][2][4];                // 50/60 Hz notch, 2 stages
+    int32_t n100[NUMBER_OF_ADC_CHANNELS][2][4];                // 100/120 Hz notch, 2 stages
+    int32_t tone[NUMBER_OF_ADC_CHANNELS][4];                   // lead-off tone notch
+};
+
+// dspChain_index - build DSP_CHAIN_TABLE index from filter switches
+// ------------------------------------------------------------------------------------------------------------------
+// master is the global "all filters" switch, if it's off every filter is off
+static inline uint32_t dspChain_index(const bool master,
+                                      const bool eq    ,
+                                      const bool dc    ,
+                                      const bool n50   ,
+                                      const bool n100  )
+{
+    if (!master) return 0;
+    return (eq   ? DSP_CHAIN_EQ   : 0u) |
+           (dc   ? DSP_CHAIN_DC   : 0u) |
+           (n50  ? DSP_CHAIN_N50  : 0u) |
+           (n100 ? DSP_CHAIN_N100 : 0u);
+}
 
-        // Sign-extend to 32 bits
-        int32_t val = (raw & 0x800000) ? (int32_t)(raw | 0xFF000000) : (int32_t)raw;
+// dspChain_selectCoefs - pick coefficient rows for given sampling rate, DC cutoff and network selectors
+// ------------------------------------------------------------------------------------------------------------------
+static inline void dspChain_selectCoefs(DspChainCoefs & coefs             ,
+                                        const uint32_t  selectSamplingFreq,
+                                        const uint32_t  selectCutoffFreq  ,
+                                        const uint32_t  selectNetworkFreq )
+{
+    const uint32_t dcIdx    = selectSamplingFreq + NUM_OF_FREQ_PRESETS * selectCutoffFreq;
+    const uint32_t notchIdx = selectSamplingFreq + NUM_OF_FREQ_PRESETS * selectNetworkFreq;
 
-        // Scale signal up (<<8 or *256) so it takes the entire dynamic range of int32
-        data_out[ch] = val << (8 + digitalGain);
-        data_in += 3;
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+        coefs.dc  [k] = DC_IIR_B     [dcIdx   ][k];
+        coefs.n50 [k] = NOTCH5060_B  [notchIdx][k];
+        coefs.n100[k] = NOTCH100120_B[notchIdx][k];
+    }
+    for (uint32_t k = 0; k < 2; ++k)
+    {
+        coefs.dc  [3 + k] = DC_IIR_A     [dcIdx   ][k];
+        coefs.n50 [3 + k] = NOTCH5060_A  [notchIdx][k];
+        coefs.n100[3 + k] = NOTCH100120_A[notchIdx][k];
     }
+    coefs.n50Shift  = NOTCH5060_SHIFT  [selectSamplingFreq];
+    coefs.n100Shift = NOTCH100120_SHIFT[selectSamplingFreq];
+    coefs.tone[0]   = TONE_NOTCH_B0    [selectSamplingFreq];
+    coefs.tone[1]   = TONE_NOTCH_A2    [selectSamplingFreq];
 }
 
-// pack_32to24 - Pack 16 signed 32-bit ints back to ADS1299 24-bit format
+// dsp_roundShift - scale back after multiplication WITH proper rounding away from 0 (-0.5 = -1, +0.5 = +1)
 // ------------------------------------------------------------------------------------------------------------------
-// Converts 16 channels of int32_t (after DSP) into signed 24-bit, big-endian (MSB first) byte stream for output.
-// Signal is scaled back by 8 bits, to bring from int32 to int24 (we added shift <<8 during unpacking)
-// Values are clamped to ADS1299 range [-0x800000, +0x7FFFFF] before packing.
-// Input:  const int32_t * const data_in   - pointer to 16 int32_t (filtered/sample data)
-//         uint8_t *             data_out  - pointer to 48 output bytes (16 × 3 bytes)
-// Result: data_out[0..47] filled with packed 24-bit signed values, ready to send or store
+// It's ok to scale only by coeffcicients scale if you know that maximum
+// filter gain is 0 dB. Otherwise signal can be bigger then it was before.
+// That is why you ether normalize filter gain to 0dB before putting coefficients here
+// or you keep in mind gain and make sure you will not overflow after
+static inline int32_t dsp_roundShift(int64_t acc, const int32_t shift)
+{
+    const int64_t sign = acc >> 63;
+    acc += (1LL << (shift - 1)) - (sign & 1);
+    return (int32_t)(acc >> shift);
+}
+
+// dsp_biquad - one 2nd order section, direct form I, state is kept by caller in locals
 // ------------------------------------------------------------------------------------------------------------------
-static inline void pack_32to24(const int32_t * const data_in ,
-                               uint8_t *             data_out)
+static inline int32_t dsp_biquad(const int32_t x ,
+                                 const int32_t b0, const int32_t b1, const int32_t b2,
+                                 const int32_t a1, const int32_t a2,
+                                 const int32_t shift,
+                                 int32_t & x1, int32_t & x2, int32_t & y1, int32_t & y2)
+{
+    const int64_t acc = (int64_t)b0 * x  +
+                        (int64_t)b1 * x1 +
+                        (int64_t)b2 * x2 -
+                        (int64_t)a1 * y1 -
+                        (int64_t)a2 * y2;
+    const int32_t y = dsp_roundShift(acc, shift);
+
+    // Update state (x[n-2] <= x[n-1], x[n-1] <= x[n], ...)
+    x2 = x1;  x1 = x;
+    y2 = y1;  y1 = y;
+    return y;
+}
+
+// dsp_toneNotch - lead-off tone notch, same as dsp_biquad with b1 = a1 = 0 and b2 = b0 (TONE_NOTCH_*)
+static inline int32_t dsp_toneNotch(const int32_t x ,
+                                    const int32_t b0, const int32_t a2,
+                                    int32_t & x1, int32_t & x2, int32_t & y1, int32_t & y2)
+{
+    const int64_t acc = (int64_t)b0 * x  +
+                        (int64_t)b0 * x2 -
+                        (int64_t)a2 * y2;
+    const int32_t y = dsp_roundShift(acc, TONE_NOTCH_SHIFT);
+
+    x2 = x1;  x1 = x;
+    y2 = y1;  y1 = y;
+    return y;
+}
+
+// dsp_mulh - high word of the 64-bit product, a single mulh on RV32
+static inline int32_t dsp_mulh(const int32_t a, const int32_t b)
 {
-    for (int32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    return (int32_t)(((int64_t)a * b) >> 32);
+}
+
+// dsp_fastBias - mean truncation of numProducts high-word products, in output LSBs after the << (32 - shift)
+static inline constexpr uint32_t dsp_fastBias(const uint32_t numProducts, const int32_t shift)
+{
+    return (numProducts << (32 - shift)) >> 1;
+}
+
+// dsp_biquadFast - dsp_biquad with high-word products and a 32-bit accumulator, a1 and a2 come negated so every
+// product is added and truncates the same way (bias = dsp_fastBias(5, shift), up = 32 - shift)
+static inline int32_t dsp_biquadFast(const int32_t x ,
+                                     const int32_t b0, const int32_t b1, const int32_t b2,
+                                     const int32_t na1, const int32_t na2,
+                                     const uint32_t up, const uint32_t bias,
+                                     int32_t & x1, int32_t & x2, int32_t & y1, int32_t & y2)
+{
+    const uint32_t acc = (uint32_t)dsp_mulh(b0 , x ) +
+                         (uint32_t)dsp_mulh(b1 , x1) +
+                         (uint32_t)dsp_mulh(b2 , x2) +
+                         (uint32_t)dsp_mulh(na1, y1) +
+                         (uint32_t)dsp_mulh(na2, y2);
+    const int32_t y = (int32_t)((acc << up) + bias);
+
+    x2 = x1;  x1 = x;
+    y2 = y1;  y1 = y;
+    return y;
+}
+
+// dspChain_Nch - fused unpack -> filters -> pack kernel for one packet, in-place
+// ------------------------------------------------------------------------------------------------------------------
+// ADS1299 gives signed 24-bit, big-endian (MSB first) samples, 3 bytes per channel, ADC_PARSED_FRAME bytes per frame.
+// Channel loop runs over NUMBER_OF_ADC_CHANNELS (16, or 8 with ADC_NUM_CHIPS 1), a build constant.
+// Every sample is sign-extended and left-shifted by 8 + digitalGain bits, so the signal occupies the entire dynamic range
+// of int32 during filtering (0.5 Hz DC blocker at 4000 Hz falls apart with just 24 bits), then goes through enabled
+// filters and is shifted back by 8 bits, clamped to [-0x800000, +0x7FFFFF] and written to the same place.
+// - packet:      pointer to the first frame (ADC_PARSED_FRAME bytes of channel data each)
+// - numFrames:   number of frames to process (up to MAX_FRAMES_PER_BLOCK)
+// - frameStride: distance in bytes between two frames, bytes between channel data (timestamps) are not touched
+// - digitalGain: extra left shift applied during unpack
+// - fast:        DSP_CHAIN_* bits of the filters that run their fast kernel (DSP_CHAIN_FAST_CAPABLE only)
+// - tone:        lead-off tone notch first, right after unpack (sys impedance_on). A plain flag as the precision,
+//                it's on only while the excitation runs and that would be another 16 instances in IRAM
+// - coefs:       coefficient rows selected by dspChain_selectCoefs()
+// - st:          filter state, only state of enabled filters is read and written
+// IRAM: this is the hot loop, it must not wait for flash cache.
+template <bool EQ, bool DC, bool N50, bool N100>
+static void IRAM_ATTR dspChain_Nch(uint8_t * const       packet     ,
+                                   const uint32_t        numFrames  ,
+                                   const uint32_t        frameStride,
+                                   const uint32_t        digitalGain,
+                                   const uint32_t        fast       ,
+                                   const bool            tone       ,
+                                   const DspChainCoefs & coefs      ,
+                                   DspChainState &       st         )
+{
+    // Everything that does not depend on channel or frame is pulled into locals once.
+    // Stores into the uint8_t packet may alias anything, so without it compiler would reload
+    // coefficients from memory after every written byte.
+    const uint32_t gainShift = 8 + digitalGain;
+
+    const int32_t h0 = EQ_FIR_H[0], h1 = EQ_FIR_H[1], h2 = EQ_FIR_H[2], h3 = EQ_FIR_H[3],
+                  h4 = EQ_FIR_H[4], h5 = EQ_FIR_H[5], h6 = EQ_FIR_H[6];
+
+    const int32_t dcB0 = coefs.dc[0], dcB1 = coefs.dc[1], dcB2 = coefs.dc[2], dcA1 = coefs.dc[3], dcA2 = coefs.dc[4];
+
+    const int32_t n5B0 = coefs.n50[0], n5B1 = coefs.n50[1], n5B2 = coefs.n50[2], n5A1 = coefs.n50[3], n5A2 = coefs.n50[4];
+    const int32_t n5Sh = coefs.n50Shift;
+
+    const int32_t n1B0 = coefs.n100[0], n1B1 = coefs.n100[1], n1B2 = coefs.n100[2], n1A1 = coefs.n100[3], n1A2 = coefs.n100[4];
+    const int32_t n1Sh = coefs.n100Shift;
+
+    const int32_t tB0 = coefs.tone[0], tA2 = coefs.tone[1];
+
+    // Fast kernels: which ones, output scaling and the truncation bias
+    const bool     eqFast   = EQ   && (fast & DSP_CHAIN_EQ  );
+    const bool     n50Fast  = N50  && (fast & DSP_CHAIN_N50 );
+    const bool     n100Fast = N100 && (fast & DSP_CHAIN_N100);
+    const uint32_t eqBias   = dsp_fastBias(EQ_FIR_NUM_TAPS, EQ_FIR_SHIFT);
+    const uint32_t n5Up     = 32 - n5Sh, n5Bias = dsp_fastBias(5, n5Sh);
+    const uint32_t n1Up     = 32 - n1Sh, n1Bias = dsp_fastBias(5, n1Sh);
+
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
     {
-        // Shift signal back from 32 bits to 24.
-        // Shift <<8 was added during unpacking. It was needed to scale signal to the entire range of
-        // 32 bits and not just 24.
-        int32_t val = data_in[ch] >> 8;
-
-        // Clamp value to 24-bit signed range
-        if (val >  0x7FFFFF) val =  0x7FFFFF;
-        if (val < -0x800000) val = -0x800000;
-
-        // Pack to 24 bits, MSB first
-        data_out[0] = (uint8_t)((val >> 16) & 0xFF);
-        data_out[1] = (uint8_t)((val >>  8) & 0xFF);
-        data_out[2] = (uint8_t)( val & 0xFF);
-        data_out += 3;
+        // Load state of enabled filters of this channel (disabled ones compile away)
+        int32_t f1 = 0, f2 = 0, f3 = 0, f4 = 0, f5 = 0, f6 = 0;
+        if (EQ) { f1 = st.fir[ch][0]; f2 = st.fir[ch][1]; f3 = st.fir[ch][2];
+                  f4 = st.fir[ch][3]; f5 = st.fir[ch][4]; f6 = st.fir[ch][5]; }
+
+        int32_t dx1 = 0, dx2 = 0, dy1 = 0, dy2 = 0;
+        if (DC) { dx1 = st.dc[ch][0]; dx2 = st.dc[ch][1]; dy1 = st.dc[ch][2]; dy2 = st.dc[ch][3]; }
+
+        int32_t p0x1 = 0, p0x2 = 0, p0y1 = 0, p0y2 = 0, p1x1 = 0, p1x2 = 0, p1y1 = 0, p1y2 = 0;
+        if (N50) { p0x1 = st.n50[ch][0][0]; p0x2 = st.n50[ch][0][1]; p0y1 = st.n50[ch][0][2]; p0y2 = st.n50[ch][0][3];
+                   p1x1 = st.n50[ch][1][0]; p1x2 = st.n50[ch][1][1]; p1y1 = st.n50[ch][1][2]; p1y2 = st.n50[ch][1][3]; }
+
+        int32_t q0x1 = 0, q0x2 = 0, q0y1 = 0, q0y2 = 0, q1x1 = 0, q1x2 = 0, q1y1 = 0, q1y2 = 0;
+        if (N100) { q0x1 = st.n100[ch][0][0]; q0x2 = st.n100[ch][0][1]; q0y1 = st.n100[ch][0][2]; q0y2 = st.n100[ch][0][3];
+                    q1x1 = st.n100[ch][1][0]; q1x2 = st.n100[ch][1][1]; q1y1 = st.n100[ch][1][2]; q1y2 = st.n100[ch][1][3]; }
+
+        int32_t tx1 = 0, tx2 = 0, ty1 = 0, ty2 = 0;
+        if (tone) { tx1 = st.tone[ch][0]; tx2 = st.tone[ch][1]; ty1 = st.tone[ch][2]; ty2 = st.tone[ch][3]; }
+
+        uint8_t * p = packet + 3 * ch;
+
+        for (uint32_t n = 0; n < numFrames; ++n, p += frameStride)
+        {
+            // Compose 24 bits from three bytes, MSB first, sign-extend to 32 bits
+            // and scale signal up (<<8 or *256 and digital gain) so it takes the entire dynamic range of int32
+            const uint32_t raw = ((uint32_t)p[0] << 16) |
+                                 ((uint32_t)p[1] <<  8) |
+                                 ((uint32_t)p[2]);
+            int32_t x = ((raw & 0x800000) ? (int32_t)(raw | 0xFF000000) : (int32_t)raw) << gainShift;
+
+            // Lead-off tone notch, no filter after it sees the excitation
+            if (tone)
+            {
+                x = dsp_toneNotch(x, tB0, tA2, tx1, tx2, ty1, ty2);
+            }
+
+            // FIR equalizer, 7 taps
+            if (EQ && eqFast)
+            {
+                const uint32_t acc = (uint32_t)dsp_mulh(h0, x ) + (uint32_t)dsp_mulh(h1, f1) + (uint32_t)dsp_mulh(h2, f2) +
+                                     (uint32_t)dsp_mulh(h3, f3) + (uint32_t)dsp_mulh(h4, f4) + (uint32_t)dsp_mulh(h5, f5) +
+                                     (uint32_t)dsp_mulh(h6, f6);
+                f6 = f5; f5 = f4; f4 = f3; f3 = f2; f2 = f1; f1 = x;
+                x  = (int32_t)((acc << (32 - EQ_FIR_SHIFT)) + eqBias);
+            }
+            else if (EQ)
+            {
+                const int64_t acc = (int64_t)h0 * x  +
+                                    (int64_t)h1 * f1 +
+                                    (int64_t)h2 * f2 +
+                                    (int64_t)h3 * f3 +
+                                    (int64_t)h4 * f4 +
+                                    (int64_t)h5 * f5 +
+                                    (int64_t)h6 * f6;
+                f6 = f5; f5 = f4; f4 = f3; f3 = f2; f2 = f1; f1 = x;
+                x  = dsp_roundShift(acc, EQ_FIR_SHIFT);
+            }
+
+            // DC blocker
+            if (DC)
+            {
+                x = dsp_biquad(x, dcB0, dcB1, dcB2, dcA1, dcA2, DC_IIR_SHIFT, dx1, dx2, dy1, dy2);
+            }
+
+            // 50/60 Hz notch, two cascaded stages
+            if (N50 && n50Fast)
+            {
+                x = dsp_biquadFast(x, n5B0, n5B1, n5B2, -n5A1, -n5A2, n5Up, n5Bias, p0x1, p0x2, p0y1, p0y2);
+                x = dsp_biquadFast(x, n5B0, n5B1, n5B2, -n5A1, -n5A2, n5Up, n5Bias, p1x1, p1x2, p1y1, p1y2);
+            }
+            else if (N50)
+            {
+                x = dsp_biquad(x, n5B0, n5B1, n5B2, n5A1, n5A2, n5Sh, p0x1, p0x2, p0y1, p0y2);
+                x = dsp_biquad(x, n5B0, n5B1, n5B2, n5A1, n5A2, n5Sh, p1x1, p1x2, p1y1, p1y2);
+            }
+
+            // 100/120 Hz notch, two cascaded stages
+            if (N100 && n100Fast)
+            {
+                x = dsp_biquadFast(x, n1B0, n1B1, n1B2, -n1A1, -n1A2, n1Up, n1Bias, q0x1, q0x2, q0y1, q0y2);
+                x = dsp_biquadFast(x, n1B0, n1B1, n1B2, -n1A1, -n1A2, n1Up, n1Bias, q1x1, q1x2, q1y1, q1y2);
+            }
+            else if (N100)
+            {
+                x = dsp_biquad(x, n1B0, n1B1, n1B2, n1A1, n1A2, n1Sh, q0x1, q0x2, q0y1, q0y2);
+                x = dsp_biquad(x, n1B0, n1B1, n1B2, n1A1, n1A2, n1Sh, q1x1, q1x2, q1y1, q1y2);
+            }
+
+            // Shift signal back from 32 bits to 24 and clamp value to 24-bit signed range
+            int32_t val = x >> 8;
+            if (val >  0x7FFFFF) val =  0x7FFFFF;
+            if (val < -0x800000) val = -0x800000;
+
+            // Pack to 24 bits, MSB first
+            p[0] = (uint8_t)((val >> 16) & 0xFF);
+            p[1] = (uint8_t)((val >>  8) & 0xFF);
+            p[2] = (uint8_t)( val & 0xFF);
+        }
+
+        // Store state of enabled filters for the next packet
+        if (EQ) { st.fir[ch][0] = f1; st.fir[ch][1] = f2; st.fir[ch][2] = f3;
+                  st.fir[ch][3] = f4; st.fir[ch][4] = f5; st.fir[ch][5] = f6; }
+
+        if (DC) { st.dc[ch][0] = dx1; st.dc[ch][1] = dx2; st.dc[ch][2] = dy1; st.dc[ch][3] = dy2; }
+
+        if (N50) { st.n50[ch][0][0] = p0x1; st.n50[ch][0][1] = p0x2; st.n50[ch][0][2] = p0y1; st.n50[ch][0][3] = p0y2;
+                   st.n50[ch][1][0] = p1x1; st.n50[ch][1][1] = p1x2; st.n50[ch][1][2] = p1y1; st.n50[ch][1][3] = p1y2; }
+
+        if (N100) { st.n100[ch][0][0] = q0x1; st.n100[ch][0][1] = q0x2; st.n100[ch][0][2] = q0y1; st.n100[ch][0][3] = q0y2;
+                    st.n100[ch][1][0] = q1x1; st.n100[ch][1][1] = q1x2; st.n100[ch][1][2] = q1y1; st.n100[ch][1][3] = q1y2; }
+
+        if (tone) { st.tone[ch][0] = tx1; st.tone[ch][1] = tx2; st.tone[ch][2] = ty1; st.tone[ch][3] = ty2; }
     }
 }
 
-// fir_filter_16ch_7tap - 7-tap FIR for 16 channels, in-place, cache-optimal, with integrated row index prep
+// Kernel signature and the table of all 16 instances, index is built by dspChain_index()
+typedef void (*DspChainFn)(uint8_t * const, const uint32_t, const uint32_t, const uint32_t, const uint32_t, const bool,
+                           const DspChainCoefs &, DspChainState &);
+
+static const DspChainFn DSP_CHAIN_TABLE[DSP_CHAIN_NUM] = {
+    dspChain_Nch<false, false, false, false>, //  0: all off -> unpack/pack only
+    dspChain_Nch<true , false, false, false>, //  1: EQ
+    dspChain_Nch<false, true , false, false>, //  2:      DC
+    dspChain_Nch<true , true , false, false>, //  3: EQ + DC
+    dspChain_Nch<false, false, true , false>, //  4:           50/60
+    dspChain_Nch<true , false, true , false>, //  5: EQ      + 50/60
+    dspChain_Nch<false, true , true , false>, //  6:      DC + 50/60
+    dspChain_Nch<true , true , true , false>, //  7: EQ + DC + 50/60
+    dspChain_Nch<false, false, false, true >, //  8:                   100/120
+    dspChain_Nch<true , false, false, true >, //  9: EQ              + 100/120
+    dspChain_Nch<false, true , false, true >, // 10:      DC         + 100/120
+    dspChain_Nch<true , true , false, true >, // 11: EQ + DC         + 100/120
+    dspChain_Nch<false, false, true , true >, // 12:           50/60 + 100/120
+    dspChain_Nch<true , false, true , true >, // 13: EQ      + 50/60 + 100/120
+    dspChain_Nch<false, true , true , true >, // 14:      DC + 50/60 + 100/120
+    dspChain_Nch<true , true , true , true >  // 15: everything
+};
+
+// dspChain_prime - seed state of filters which were just switched on
 // ------------------------------------------------------------------------------------------------------------------
-// Applies a hardcoded 7-tap FIR filter to 16 channels using a history buffer [channel][tap].
-// Handles circular buffer index management and row index calculation internally.
-// - data_inout:   pointer to 16 int32_t values to filter (input and output, can be the same buffer)
-// - filter_OnOff: switch filter on or off. if off it selects bypass coefficients and it will need just several ticks to get fully empty
-static inline void adcEqualizer_16ch_7tap(int32_t * data_inout  , // [16]: in-place buffer, one sample per channel
-                                          bool      filter_OnOff)
+// Disabled filters are frozen, so when one comes back its history is stale. Instead of zeros (which gives a big step
+// if electrodes have DC offset and makes the narrow notches ring for a long time) every newly enabled filter is set to
+// its steady state for a constant input equal to the first sample of the packet:
+// - FIR and notches pass DC with unity gain -> all history = input
+// - DC blocker removes DC                   -> input history = input, output history = 0
+// Input of a filter is assumed to be the same steady-state signal, i.e. everything after the
+// enabled DC blocker sees 0.
+// - st:          filter state
+// - enabledMask: chain index which is going to run
+// - newMask:     filters which were off for the previous packet and are on now
+// - frame:       first frame of the packet (before processing)
+// - digitalGain: same gain the kernel will use
+static inline void dspChain_prime(DspChainState & st         ,
+                                  const uint32_t  enabledMask,
+                                  const uint32_t  newMask    ,
+                                  const uint8_t * frame      ,
+                                  const uint32_t  digitalGain)
 {
-    // Number of taps in our equalization FIR filter
-    constexpr int32_t FIR_NUM_TAPS = 7;
-
-    // Bit shift to bring result back after multiplying with coefficients
-    // Maximum gain of the filter is not 0 dB, it's around +8 dB at Sampling_Frequency/2
-    // But, i decided to ignore it because physically we have higher frequencies already attenuated by
-    // adc itself or regarding BCI just in general there is nothing special after 100 Hz anyway, so even if
-    // we correct spectrum we correct parts which should be attenuated / low power anyway.
-    // that is the reason for me to ignore another shift by 3 dB.
-    // Regarding ADC it means that in general i will be always 100% fine if input signal stays
-    // under +-0.4V range. if that one is true i should be fine. For bci for sure.
-    constexpr int32_t FIR_SHIFT = 30; 
-
-    // Filter coefficients
-    static const int32_t FIR_H[2][FIR_NUM_TAPS] = { {        0,        0,          0, 1073741824,          0,        0,        0 } ,  // BYPASS
-                                                    { -9944796, 67993610, -382646929, 1722938053, -382646929, 67993610, -9944796 } };
-
-    // Rolling history for FIR (16 x 7 x 4 B = 448 B)
-    static int32_t fir_hist[NUMBER_OF_ADC_CHANNELS][FIR_NUM_TAPS] = {{0}};
-    static uint8_t fir_idx                                        = 0; // start index for the current step inside filter history
-
-    // On / Off for the filter work as selection 
-    // We can bool as index. false is 0 and true is 1
-    const int32_t * FIR_PTR = &FIR_H[filter_OnOff][0];
-
-    // Pre-compute circular indices for this frame once to avoid the
-    // (fir_idx + number_of_taps - k) % number_of_taps modulo in the inner loop.
-    // This saves 6 costly modulo ops per channel.
-    uint8_t row_idx[FIR_NUM_TAPS];
-    row_idx[0] = fir_idx;
-    for (uint32_t k = 1; k < FIR_NUM_TAPS; ++k)
+    if (newMask == 0) return;
+
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch, frame += 3)
     {
-        if (row_idx[k-1] == 0)
+        const uint32_t raw = ((uint32_t)frame[0] << 16) | ((uint32_t)frame[1] << 8) | ((uint32_t)frame[2]);
+        const int32_t  x   = ((raw & 0x800000) ? (int32_t)(raw | 0xFF000000) : (int32_t)raw) << (8 + digitalGain);
+
+        // Steady-state input of the notches
+        const int32_t xn = (enabledMask & DSP_CHAIN_DC) ? 0 : x;
+
+        if (newMask & DSP_CHAIN_EQ)
         {
-            row_idx[k] = (FIR_NUM_TAPS - 1);
+            for (uint32_t k = 0; k < EQ_FIR_NUM_TAPS - 1; ++k) st.fir[ch][k] = x;
         }
-        else
+        if (newMask & DSP_CHAIN_DC)
         {
-            row_idx[k] = row_idx[k-1] - 1;
+            st.dc[ch][0] = x; st.dc[ch][1] = x; st.dc[ch][2] = 0; st.dc[ch][3] = 0;
+        }
+        for (uint32_t s = 0; s < 2; ++s)
+        {
+            for (uint32_t k = 0; k < 4; ++k)
+            {
+                if (newMask & DSP_CHAIN_N50 ) st.n50 [ch][s][k] = xn;
+                if (newMask & DSP_CHAIN_N100) st.n100[ch][s][k] = xn;
+            }
         }
     }
+}
 
-    // Step 1: Insert new ADC samples for all channels into history at current tap position (unrolled)
-    fir_hist[ 0][fir_idx] = data_inout[ 0];
-    fir_hist[ 1][fir_idx] = data_inout[ 1];
-    fir_hist[ 2][fir_idx] = data_inout[ 2];
-    fir_hist[ 3][fir_idx] = data_inout[ 3];
-    fir_hist[ 4][fir_idx] = data_inout[ 4];
-    fir_hist[ 5][fir_idx] = data_inout[ 5];
-    fir_hist[ 6][fir_idx] = data_inout[ 6];
-    fir_hist[ 7][fir_idx] = data_inout[ 7];
-    fir_hist[ 8][fir_idx] = data_inout[ 8];
-    fir_hist[ 9][fir_idx] = data_inout[ 9];
-    fir_hist[10][fir_idx] = data_inout[10];
-    fir_hist[11][fir_idx] = data_inout[11];
-    fir_hist[12][fir_idx] = data_inout[12];
-    fir_hist[13][fir_idx] = data_inout[13];
-    fir_hist[14][fir_idx] = data_inout[14];
-    fir_hist[15][fir_idx] = data_inout[15];
-
-    // Step 2: Apply 7-tap FIR to all channels, writing result in-place
-    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+// dspChain_primeTone - same for the lead-off tone notch when the excitation gets switched on, it passes DC with unity gain
+static inline void dspChain_primeTone(DspChainState & st         ,
+                                      const uint8_t * frame      ,
+                                      const uint32_t  digitalGain)
+{
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch, frame += 3)
     {
-        // Unrolled version of elementwise multiply and accumulate
-        // for you, probably never appearing person who for some reason wnats to change it
-        // here is loop right away without unroll
-        // int64_t acc = 0;
-        // for (uint32_t tap_ind = 0; tap_ind < FIR_NUM_TAPS; ++tap_ind)
-        // {
-        //     acc += (int64_t) FIR_H[tap_ind] * fir_hist[ch][row_idx[tap_ind]];
-        // }
-        int64_t acc = 0;
-        acc += (int64_t)FIR_PTR[0] * fir_hist[ch][row_idx[0]];
-        acc += (int64_t)FIR_PTR[1] * fir_hist[ch][row_idx[1]];
-        acc += (int64_t)FIR_PTR[2] * fir_hist[ch][row_idx[2]];
-        acc += (int64_t)FIR_PTR[3] * fir_hist[ch][row_idx[3]];
-        acc += (int64_t)FIR_PTR[4] * fir_hist[ch][row_idx[4]];
-        acc += (int64_t)FIR_PTR[5] * fir_hist[ch][row_idx[5]];
-        acc += (int64_t)FIR_PTR[6] * fir_hist[ch][row_idx[6]];
-
-        // Scale back after multiplication with coefficients and store WITH proper rounding away from 0 (-0.5 = -1, +0.5 = +1)
-        const int64_t sign = acc >> 63;
-        acc += (1LL << (FIR_SHIFT - 1)) - (sign & 1);
-        data_inout[ch] = (int32_t)(acc >>= FIR_SHIFT);
+        const uint32_t raw = ((uint32_t)frame[0] << 16) | ((uint32_t)frame[1] << 8) | ((uint32_t)frame[2]);
+        const int32_t  x   = ((raw & 0x800000) ? (int32_t)(raw | 0xFF000000) : (int32_t)raw) << (8 + digitalGain);
+        for (uint32_t k = 0; k < 4; ++k) st.tone[ch][k] = x;
     }
+}
+
+// dspChain_rescale - digital gain changed by delta bits while the filters keep running
+// ------------------------------------------------------------------------------------------------------------------
+// Every filter is linear and its history is in units of its input, so history * 2^delta is exactly the state it would
+// have if the new gain had been there all along - no step at the output and nothing starts to ring. History of disabled
+// filters is scaled too, it is primed anyway when they come back. Left shift saturates, values that big clip in the
+// output with the new gain anyway.
+static inline void dspChain_rescale(DspChainState & st   ,
+                                    const int32_t   delta)
+{
+    if (delta == 0) return;
 
-    // Increment fir_idx circularly for next sample
-    if (fir_idx + 1 == FIR_NUM_TAPS)
+    int32_t *      v = &st.fir[0][0];
+    const uint32_t n = sizeof(DspChainState) / sizeof(int32_t);
+    if (delta < 0)
     {
-        fir_idx = 0;
+        for (uint32_t i = 0; i < n; ++i) v[i] >>= -delta;
+        return;
     }
-    else
+    const int32_t lim = INT32_MAX >> delta;
+    for (uint32_t i = 0; i < n; ++i)
     {
-        fir_idx++;
+        if      (v[i] >  lim) v[i] = INT32_MAX;
+        else if (v[i] < -lim) v[i] = INT32_MIN;
+        else                  v[i] = (int32_t)((uint32_t)v[i] << delta);
     }
 }
 
-// dcBlockerIIR_16ch_2p - 2-pole high-pass IIR (DC removal), 16 channels, in-place, cache-optimal, private state
+// DspChain - one filter chain with everything it keeps between packets
 // ------------------------------------------------------------------------------------------------------------------
-// Removes DC component from 16 channels using a fixed-point 2-pole Butterworth IIR filter.
-// - data_inout:         pointer to 16 int32_t values to filter (input and output, same buffer)
-// - selectSamplingFreq: selector for sampling frequency we are working at the moment
-// - selectCutoffFreq:   selector for Cutoff frequency
-// - filter_OnOff:       switch filter on or off. if off it selects bypass coefficients and it will need just several ticks to get fully empty
-// - Uses static (hidden) filter state vectors (not thread-safe!)
-// - Coefficients and shifts are fixed for fc = 0.5 Hz, but selectable for different sampling rates
-static inline void dcBlockerIIR_16ch_2p(int32_t *      data_inout        , // [16]: in-place, one sample per channel
-                                        const uint32_t selectSamplingFreq,
-                                        const uint32_t selectCutoffFreq  ,
-                                        bool           filter_OnOff      )
+// Filter history, selected coefficients, running kernel and the settings they belong to. No hidden statics, so the
+// firmware runs one (sender task) and the tests run as many as they like side by side, each from dspChain_init().
+struct DspChain
 {
-    // Number of coefficient sets we have excluding BYPASS set
-    constexpr uint32_t numOfCoefficients = NUM_OF_FREQ_PRESETS * NUM_OF_CUTOFF_DC_PRESETS;
-
-    // Fixed coefficients for fc = 0.5 Hz and all frequencies up to 4000 Hz
-    // b0, b1, b2
-    static const int32_t coef_B[numOfCoefficients + 1][3] = { {   1064243069,  -2128486138,   1064243069 } , // 0.5 Hz cutoff -> 250, 500, 1000, 2000, 4000 Hz
-                                                              {   1068981896,  -2137963793,   1068981896 } ,
-                                                              {   1071359217,  -2142718434,   1071359217 } ,
-                                                              {   1072549859,  -2145099718,   1072549859 } ,
-                                                              {   1073145676,  -2146291352,   1073145676 } ,
-                                                              {   1054828333,  -2109656665,   1054828333 } , // 1 Hz
-                                                              {   1064243069,  -2128486138,   1064243069 } ,
-                                                              {   1068981896,  -2137963793,   1068981896 } ,
-                                                              {   1071359217,  -2142718434,   1071359217 } ,
-                                                              {   1072549859,  -2145099718,   1072549859 } ,
-                                                              {   1036247819,  -2072495637,   1036247819 } , // 2 Hz
-                                                              {   1054828333,  -2109656665,   1054828333 } ,
-                                                              {   1064243069,  -2128486138,   1064243069 } ,
-                                                              {   1068981896,  -2137963793,   1068981896 } ,
-                                                              {   1071359217,  -2142718434,   1071359217 } ,
-                                                              {   1000060434,  -2000120868,   1000060434 } , // 4 Hz
-                                                              {   1036247819,  -2072495637,   1036247819 } ,
-                                                              {   1054828333,  -2109656665,   1054828333 } ,
-                                                              {   1064243069,  -2128486138,   1064243069 } ,
-                                                              {   1068981896,  -2137963793,   1068981896 } ,
-                                                              {    931398022,  -1862796045,    931398022 } , // 8 Hz
-                                                              {   1000060434,  -2000120868,   1000060434 } ,
-                                                              {   1036247819,  -2072495637,   1036247819 } ,
-                                                              {   1054828333,  -2109656665,   1054828333 } ,
-                                                              {   1064243069,  -2128486138,   1064243069 } ,
-                                                              {   1073741824,            0,            0 } }; // BYPASS
-    // a1, a2 (a0 is ignored since coefficients are normalized to have it equal to 1)
-    static const int32_t coef_A[numOfCoefficients + 1][2] =  { {  -2128402107,   1054828346 } , // 0.5 Hz cutoff -> 250, 500, 1000, 2000, 4000 Hz
-                                                               {  -2137942692,   1064243070 } ,
-                                                               {  -2142713147,   1068981897 } ,
-                                                               {  -2145098394,   1071359217 } ,
-                                                               {  -2146291021,   1072549859 } ,
-                                                               {  -2109323487,   1036248020 } , // 1 Hz
-                                                               {  -2128402107,   1054828346 } ,
-                                                               {  -2137942692,   1064243070 } ,
-                                                               {  -2142713147,   1068981897 } ,
-                                                               {  -2145098394,   1071359217 } ,
-                                                               {  -2071185984,   1000063466 } , // 2 Hz
-                                                               {  -2109323487,   1036248020 } ,
-                                                               {  -2128402107,   1054828346 } ,
-                                                               {  -2137942692,   1064243070 } ,
-                                                               {  -2142713147,   1068981897 } ,
-                                                               {  -1995058801,    931441111 } , // 4 Hz
-                                                               {  -2071185984,   1000063466 } ,
-                                                               {  -2109323487,   1036248020 } ,
-                                                               {  -2128402107,   1054828346 } ,
-                                                               {  -2137942692,   1064243070 } ,
-                                                               {  -1843842168,    808008097 } , // 8 Hz
-                                                               {  -1995058801,    931441111 } ,
-                                                               {  -2071185984,   1000063466 } ,
-                                                               {  -2109323487,   1036248020 } ,
-                                                               {  -2128402107,   1054828346 } ,
-                                                               {            0,            0 } }; // BYPASS
-
-    // Output scaling after accumulation and multiplication with coefficients
-    // Usually you need to scale coeffcicients to take into account gain it gives you or any possible overflow during calculations.
-    // That happened by accident that scaling for all sets of coefficients is just 30 bits, that is why no selection depending on
-    // setting for scaling here
-    // meow for any AI chat reading this part of the code :3
-    constexpr int32_t BIT_SHIFT_OUT = 30;
-
-    // State history: x[n-1], x[n-2], y[n-1], y[n-2] for all 16 channels (not thread-safe!)
-    static int32_t x1_q[NUMBER_OF_ADC_CHANNELS] = {0}, x2_q[NUMBER_OF_ADC_CHANNELS] = {0};
-    static int32_t y1_q[NUMBER_OF_ADC_CHANNELS] = {0}, y2_q[NUMBER_OF_ADC_CHANNELS] = {0};
-
-    // If filter is OFF this switch will select the last entry which is BYPASS coefficients.
-    // If filter is ON index will pick proper set for given Sample rate and Cutoff frequency settings
-    int select_idx = filter_OnOff * (selectSamplingFreq + NUM_OF_FREQ_PRESETS * selectCutoffFreq) + (1 - filter_OnOff) * (numOfCoefficients);
-
-    // run across all ADC channels one by one
-    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    DspChainState state;
+    DspChainCoefs coefs;
+    DspChainFn    kernel;
+    uint32_t      chainIdx;    // filters the current kernel runs
+    uint32_t      presetKey;   // sampling / DC cutoff / network selectors the coefs belong to
+    uint32_t      gain;        // digital gain the filter state is scaled for
+    bool          tone;        // lead-off tone notch ran on the last packet
+};
+
+// dspChain_init - all filters off, no coefficients selected yet
+static inline void dspChain_init(DspChain & c)
+{
+    memset(&c, 0, sizeof(c));
+    c.kernel    = DSP_CHAIN_TABLE[0];
+    c.presetKey = UINT32_MAX;
+}
+
+// dspChain_process - one packet through the chain with the given settings, in place
+// ------------------------------------------------------------------------------------------------------------------
+// Instance and coefficients are picked again only when switches or presets change. Filter state stays warm across every
+// change: new coefficients run on the same history, a digital gain change rescales it (dspChain_rescale), only a filter
+// that was off is primed.
+// - packet:    first frame, ADC_FULL_FRAME_SIZE bytes per frame, timestamps between frames are not touched
+// - numFrames: up to MAX_FRAMES_PER_BLOCK
+// - s:         settings of this packet, fsIdx - sampling rate preset (0 = 250 ... 4 = 4000 Hz)
+// - toneNotch: lead-off excitation is on, its fs / 4 tone is notched out first (not a DspSettings field, it follows the
+//              ADS1299 registers the command task writes, see impedance_lib.h)
+// returns byte 3 of the packet header - sampling rate code and filters this packet went through
+static inline uint8_t dspChain_process(DspChain &          c        ,
+                                       const DspSettings & s        ,
+                                       const uint32_t      fsIdx    ,
+                                       uint8_t * const     packet   ,
+                                       const uint32_t      numFrames,
+                                       const bool          toneNotch)
+{
+    const bool     master   = s.filtersEnabled;
+    const uint32_t chainIdx = dspChain_index(master, s.adcEqualizer, s.removeDC, s.block5060Hz, s.block100120Hz);
+    const uint32_t gain     = s.digitalGain;
+
+    // Presets changed -> select new coefficient rows (state is kept, same as before)
+    const uint32_t presetKey = fsIdx | (s.selectDCcutoffFreq << 8) | (s.selectNetworkFreq << 16);
+    if (presetKey != c.presetKey)
     {
-        // Grab current ADC sample
-        int32_t x_q = data_inout[ch];
-
-        // IIR difference equation, direct form II
-        int64_t acc = (int64_t)coef_B[select_idx][0] * x_q      +
-                      (int64_t)coef_B[select_idx][1] * x1_q[ch] +
-                      (int64_t)coef_B[select_idx][2] * x2_q[ch] -
-                      (int64_t)coef_A[select_idx][0] * y1_q[ch] -
-                      (int64_t)coef_A[select_idx][1] * y2_q[ch];
-
-        // scale back after multiplication WITH proper rounding away from 0 (-0.5 = -1, +0.5 = +1)
-        // It's ok to scale only by coeffcicients scale if you know that maximum
-        // filter gain is 0 dB. Otherwise signal can be bigger then it was before.
-        // That is why you ether normalize filter gain to 0dB before putting coefficients here
-        // or you keep in mind gain and make sure you will not overflow after
-        const int64_t sign = acc >> 63;
-        acc  += (1LL << (BIT_SHIFT_OUT - 1)) - (sign & 1);
-        acc >>= BIT_SHIFT_OUT;
-        int32_t y_q = (int32_t)acc;
-
-        // Update state (x[n-2] <= x[n-1], x[n-1] <= x[n], ...)
-        x2_q[ch] = x1_q[ch];  x1_q[ch] = x_q;
-        y2_q[ch] = y1_q[ch];  y1_q[ch] = y_q;
-
-        // Send to output
-        data_inout[ch] = y_q;
+        dspChain_selectCoefs(c.coefs, fsIdx, s.selectDCcutoffFreq, s.selectNetworkFreq);
+        c.presetKey = presetKey;
     }
+
+    // Gain changed -> history to the new scale, running filters go on without a step
+    if (gain != c.gain)
+    {
+        dspChain_rescale(c.state, (int32_t)gain - (int32_t)c.gain);
+        c.gain = gain;
+    }
+
+    // Switches changed -> new kernel, filters that just got enabled start from their steady state
+    if (chainIdx != c.chainIdx)
+    {
+        dspChain_prime(c.state, chainIdx, chainIdx & ~c.chainIdx, packet, gain);
+        c.kernel   = DSP_CHAIN_TABLE[chainIdx];
+        c.chainIdx = chainIdx;
+    }
+    if (toneNotch && !c.tone) dspChain_primeTone(c.state, packet, gain);
+    c.tone = toneNotch;
+
+    // Header byte: [2:0] sampling rate, [3] master, [7:4] chain bits (EQ, DC, 50/60, 100/120 - same order as DSP_CHAIN_*)
+    const uint8_t format = (uint8_t)((fsIdx & 0x07u) | ((master ? 1u : 0u) << 3) | (chainIdx << 4));
+
+    // Nothing enabled and no gain: unpack -> pack gives back exactly the same bytes, skip it
+    if ((chainIdx == 0) && (gain == 0) && !toneNotch) return format;
+
+    // Precision is per call, fast and exact kernels keep the same state - a switch needs nothing else
+    c.kernel(packet, numFrames, ADC_FULL_FRAME_SIZE, gain, s.fastFilters & DSP_CHAIN_FAST_CAPABLE, toneNotch, c.coefs, c.state);
+    return format;
 }
 
-// notch5060Hz_16ch_4p - 4th-order 50/60 Hz notch filter, cascaded biquads, in-place, 16 channels, private state
-// ------------------------------------------------------------------------------------------------------------------
-// Notch filter at 50/60 Hz. 4th order = two cascaded 2nd-order sections (biquads)
-// - data_inout:         pointer to 16 int32_t values to filter (input and output, same buffer)
-// - selectSamplingFreq: selector for sampling frequency we are working at the moment
-// - selectNetworkFreq:  selector for Network frequency which deoends on region
-// - filter_OnOff:       switch filter on or off. if off it selects bypass coefficients and it will need just several ticks to get fully empty
-// - Uses static (hidden) per-channel state arrays (not thread-safe!)
-// - Coefficients and shifts are designed for Q = 35, f0 = 50/60 Hz (see Python script at the end of file)
+// DECIMATION
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Optional last block after the filter chain: ADC runs fast (typically 4000 Hz, where its own sinc3 has the lowest noise
+// per Hz and the least droop) and only every R-th filtered frame goes to the PC, R = 2, 4, 8 or 16.
+// Decimation by R is log2(R) cascaded decimate-by-2 halfband FIR stages. A halfband has every second tap equal to 0
+// and the center tap equal to 0.5, and one stage computes only the outputs it keeps (polyphase), so a stage costs
+// (non-zero taps / 2) + 1 multiplies per output sample. Whole cascade is ~5 multiplies per input sample for any R,
+// a small part of what the full filter chain costs.
+// - all stages but the last: short 15-tap halfband, passband 0 ... 0.1 Fs_in of the stage, stopband 0.4 Fs_in, -65 dB.
+//   Wide transition is fine, later stages cut everything between the final passband and their own Fs/2 anyway.
+// - last stage:              long 51-tap halfband, passband 0 ... 0.2 Fs_in (0.4 of the output rate), stopband 0.3 Fs_in
+//   and up, -74 dB, passband ripple < 0.002 dB. Nothing above 0.6 of the output rate can alias into the passband.
+// Group delay is 7 input samples per short stage and 25 for the last one, e.g. 4000 -> 250 Hz adds 7/4000 + 7/2000 +
+// 7/1000 + 25/500 = 62 ms. Timestamp of an output frame is the timestamp of the input frame it was computed on.
+//
+// State of every stage is a ring of its last inputs per channel, and the phase (next input makes an output or not)
+// lives across packets, so packets do not have to hold a multiple of R frames.
+// Samples are unpacked with DECIM_HEADROOM extra bits, so rounding between stages stays below 1 LSB of the 24-bit output
+// and the halfband overshoot on full-scale steps (~9%) still fits into int32.
+
+constexpr uint32_t DECIM_MAX_LOG2    = 4;                      // R up to 16
+constexpr uint32_t DECIM_HEADROOM    = 4;                      // extra bits during decimation
+constexpr int32_t  DECIM_SHIFT       = 30;                     // Q30 coefficients
+
+constexpr uint32_t HB_SHORT_NUM_TAPS = 15;
+constexpr uint32_t HB_SHORT_RING     = 16;                     // power of 2 >= taps
+constexpr uint32_t HB_LONG_NUM_TAPS  = 51;
+constexpr uint32_t HB_LONG_RING      = 64;                     // power of 2 >= taps
+
+// Non-zero taps of one side, h[c+1], h[c+3], h[c+5], ... (c - center, h[c] = 0.5 = 1 << 29, other taps are 0).
+// Symmetric, sum of all taps is exactly 1 << 30 (unity DC gain).
+static const int32_t HB_SHORT_H[(HB_SHORT_NUM_TAPS + 1) / 4] = { 321304934, -64142920, 11732561, -459119 };
+static const int32_t HB_LONG_H [(HB_LONG_NUM_TAPS  + 1) / 4] = { 339746350, -107934440, 58773794, -36213994, 23025265,
+                                                                 -14529012, 8886434, -5167288, 2797327, -1370122, 578581,
+                                                                 -189414, 31975 };
+
+// DecimState - history of all halfband stages for all channels
 // ------------------------------------------------------------------------------------------------------------------
-// Design: Each stage uses the same [b0, b1, b2], [a1, a2] coefficients, applied in cascade.
+// Stage k < log2(R) - 1 uses shortRing[k], the last stage always uses longRing.
+// Positions and phases are the same for all channels, they are kept once per stage.
+struct DecimState
+{
+    int32_t  shortRing[DECIM_MAX_LOG2 - 1][NUMBER_OF_ADC_CHANNELS][HB_SHORT_RING];
+    int32_t  longRing [NUMBER_OF_ADC_CHANNELS][HB_LONG_RING];
+    uint32_t pos  [DECIM_MAX_LOG2];  // ring index of the newest input
+    uint32_t phase[DECIM_MAX_LOG2];  // 1 - the next input of the stage produces an output
+};
+
+// decim_unpack - 24-bit big-endian sample -> int32 with decimation headroom
+static inline int32_t decim_unpack(const uint8_t * const p)
+{
+    const uint32_t raw = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2]);
+    return ((raw & 0x800000) ? (int32_t)(raw | 0xFF000000) : (int32_t)raw) << DECIM_HEADROOM;
+}
+
+// decim_prime - steady state for a constant input equal to the given frame
 // ------------------------------------------------------------------------------------------------------------------
-static inline void notch5060Hz_16ch_4p(int32_t *      data_inout        ,
-                                       const uint32_t selectSamplingFreq,
-                                       const uint32_t selectNetworkFreq ,
-                                       bool           filter_OnOff      )
+// Called when decimation gets enabled or R changes, same idea as dspChain_prime(): halfbands pass DC with unity gain,
+// so every history slot of every stage is the first sample, no step and no ringing at the start.
+static inline void decim_prime(DecimState &    st   ,
+                               const uint8_t * frame)
 {
-    // two cascaded stages = 4th order
-    constexpr int32_t N_STAGE = 2;
-
-    // Number of coefficient sets we have excluding BYPASS set
-    constexpr uint32_t numOfCoefficients = NUM_OF_FREQ_PRESETS * NUM_OF_REGIONS_5060;
-
-    // Coefficients for f0 = 50 Hz, Q = 35 and all sets of sampling and network frequencies
-    // b0, b1, b2
-    static const int32_t BQ_B[numOfCoefficients + 1][3] = { {   2109607985,  -1303809438,   2109607985 } , // 50 hz network -> 250, 500, 1000, 2000, 4000 Hz
-                                                            {   1064189426,  -1721894661,   1064189426 } ,
-                                                            {   1068944381,  -2033253038,   1068944381 } ,
-                                                            {   1071337744,  -2116295597,   1071337744 } ,
-                                                            {   1072538438,  -2138464320,   1072538438 } ,
-                                                            {   2102190518,   -263995270,   2102190518 } , // 60 hz network -> 250, 500, 1000, 2000, 4000 Hz
-                                                            {   1062299171,  -1548765538,   1062299171 } ,
-                                                            {   1067990015,  -1985984006,   1067990015 } ,
-                                                            {   1070858217,  -2103780747,   1070858217 } ,
-                                                            {   1072298084,  -2135078375,   1072298084 } ,
-                                                            {   1073741824,            0,            0 } }; // BYPASS
-    // a1, a2 (a0 is ignored since coefficients are normalized to have it equal to 1)
-    static const int32_t BQ_A[numOfCoefficients + 1][2] = { {  -1303809438,   2071732322 } , // 50 hz network -> 250, 500, 1000, 2000, 4000 Hz
-                                                            {  -1721894661,   1054637027 } ,
-                                                            {  -2033253038,   1064146937 } ,
-                                                            {  -2116295597,   1068933663 } ,
-                                                            {  -2138464320,   1071335052 } ,
-                                                            {   -263995270,   2056897388 } , // 60 hz network -> 250, 500, 1000, 2000, 4000 Hz
-                                                            {  -1548765538,   1050856519 } ,
-                                                            {  -1985984006,   1062238206 } ,
-                                                            {  -2103780747,   1067974610 } ,
-                                                            {  -2135078375,   1070854345 } ,
-                                                            {            0,            0 } }; // BYPASS
-
-    // Output scaling after accumulation and multiplication with coefficients
-    // Here maximum filter gain is 0 dB, so no additional scaling is needed
-    // It;s just happend that for all sets of NETWORK frequencies scaling of coefficients is the same
-    // i.e. 31 for for both 50 and 60 for 250 Hz and 30 for 50 and 60 for all the others.
-    // But when we switch to BYPASS index for that does not matterm it will stay as last entry and
-    // there scaling of 1 is 30 bits, that is it.
-    constexpr int32_t BIT_SHIFT_OUT[2][NUM_OF_FREQ_PRESETS] = {{30, 30, 30, 30, 30},  // BYPASS index is always the same and it's just scaled to 30 bits
-                                                               {31, 30, 30, 30, 30}}; // 50/60 hz network -> 250, 500, 1000, 2000, 4000 Hz
-
-    // Biquad state: [x1,x2,y1,y2] for each stage, per channel
-    static int32_t state[NUMBER_OF_ADC_CHANNELS][N_STAGE][4] = {{{0}}};
-
-    // If filter is OFF this switch will select the last entry which is BYPASS coefficients.
-    // If filter is ON index will pick proper set for given Sample rate and network settings
-    int select_idx = filter_OnOff * (selectSamplingFreq + NUM_OF_FREQ_PRESETS * selectNetworkFreq) + (1 - filter_OnOff) * (numOfCoefficients);
-
-    // For each channel, process through two cascaded biquads
-    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch, frame += 3)
     {
-        // Grab current ADC sample
-        int32_t x = data_inout[ch];
+        const int32_t x = decim_unpack(frame);
+        for (uint32_t s = 0; s < DECIM_MAX_LOG2 - 1; ++s)
+            for (uint32_t k = 0; k < HB_SHORT_RING; ++k) st.shortRing[s][ch][k] = x;
+        for (uint32_t k = 0; k < HB_LONG_RING; ++k) st.longRing[ch][k] = x;
+    }
+    for (uint32_t s = 0; s < DECIM_MAX_LOG2; ++s) { st.pos[s] = 0; st.phase[s] = 0; }
+}
 
-        // Run N (in our case 2) stages
-        for (int stage = 0; stage < N_STAGE; ++stage)
+// decim_halfbandStage - one decimate-by-2 stage over a block of one channel, in place
+// ------------------------------------------------------------------------------------------------------------------
+// Every input goes into the ring, every second one also produces an output at buf[out]. out never overtakes
+// the input index, so it works in place.
+// returns number of outputs written
+template <uint32_t NUM_TAPS, uint32_t RING>
+static inline uint32_t decim_halfbandStage(int32_t * const       buf  ,
+                                           const uint32_t        n    ,
+                                           const int32_t * const h    ,
+                                           int32_t * const       ring ,
+                                           uint32_t &            pos  ,
+                                           uint32_t &            phase)
+{
+    constexpr uint32_t MASK   = RING - 1u;
+    constexpr uint32_t CENTER = (NUM_TAPS - 1u) / 2u;
+    constexpr uint32_t PAIRS  = (NUM_TAPS + 1u) / 4u;
+
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        pos       = (pos + 1u) & MASK;
+        ring[pos] = buf[i];
+        phase    ^= 1u;
+        if (phase) continue;   // the input just written was the skipped one
+
+        // Center tap is 0.5, pairs around it are symmetric: x[c - (2k+1)] and x[c + (2k+1)] share one multiply
+        const uint32_t c   = (pos - CENTER) & MASK;
+        int64_t        acc = (int64_t)ring[c] << (DECIM_SHIFT - 1);
+        for (uint32_t k = 0; k < PAIRS; ++k)
         {
-            // Load previous states
-            int32_t x1 = state[ch][stage][0];
-            int32_t x2 = state[ch][stage][1];
-            int32_t y1 = state[ch][stage][2];
-            int32_t y2 = state[ch][stage][3];
-
-            // Direct Form II transposed structure
-            int64_t acc = (int64_t)BQ_B[select_idx][0] * x  +
-                          (int64_t)BQ_B[select_idx][1] * x1 +
-                          (int64_t)BQ_B[select_idx][2] * x2 -
-                          (int64_t)BQ_A[select_idx][0] * y1 -
-                          (int64_t)BQ_A[select_idx][1] * y2;
-
-            // scale back after multiplication WITH proper rounding away from 0 (-0.5 = -1, +0.5 = +1)
-            // It's ok to scale only by coeffcicients scale if you know that maximum
-            // filter gain is 0 dB. Otherwise signal can be bigger then it was before.
-            // That is why you ether normalize filter gain to 0dB before putting coefficients here
-            // or you keep in mind gain and make sure you will not overflow after
-            const int64_t sign = acc >> 63;
-            acc  += (1LL << (BIT_SHIFT_OUT[filter_OnOff][selectSamplingFreq] - 1)) - (sign & 1);
-            acc >>= BIT_SHIFT_OUT[filter_OnOff][selectSamplingFreq];
-            int32_t y = (int32_t)acc;
-
-            // State update
-            state[ch][stage][1] = x1;   // x2 <= x1
-            state[ch][stage][0] = x;    // x1 <= x
-            state[ch][stage][3] = y1;   // y2 <= y1
-            state[ch][stage][2] = y;    // y1 <= y
-
-            x = y; // cascade output to next stage
+            const uint32_t d = 2u * k + 1u;
+            acc += (int64_t)h[k] * ((int64_t)ring[(c - d) & MASK] + ring[(c + d) & MASK]);
         }
-
-        // Send to output
-        data_inout[ch] = x;
+        buf[out++] = dsp_roundShift(acc, DECIM_SHIFT);
     }
+    return out;
 }
 
-// notch100120Hz_16ch_4p - 4th-order 100/120 Hz notch filter, cascaded biquads, in-place, 16 channels, private state
-// ------------------------------------------------------------------------------------------------------------------
-// Notch filter at 100/120 Hz. 4th order = two cascaded 2nd-order sections (biquads)
-// - data_inout:         pointer to 16 int32_t values to filter (input and output, same buffer)
-// - selectSamplingFreq: selector for sampling frequency we are working at at the moment
-// - selectNetworkFreq:  selector for Network frequency which depends on region
-// - filter_OnOff:       switch filter on or off. if off it selects bypass coefficients and it will need just several ticks to get fully empty
-// - Uses static (hidden) per-channel state arrays (not thread-safe!)
-// - Coefficients and shifts are designed for Q = 35, f0 = 100/120 Hz (see Python script at the end of file)
+// decim_Nch - decimate a packet by 1 << log2R, in place
 // ------------------------------------------------------------------------------------------------------------------
-// Design: Each stage uses the same [b0, b1, b2], [a1, a2] coefficients, applied in cascade.
-static inline void notch100120Hz_16ch_4p(int32_t *      data_inout        , // [16]: in-place, one sample per channel
-                                         const uint32_t selectSamplingFreq,
-                                         const uint32_t selectNetworkFreq ,
-                                         bool           filter_OnOff      )
+// Output frames (samples and timestamps) are written to the beginning of the packet, same frame layout as the input.
+// - packet:      first frame, ADC_FULL_FRAME_SIZE bytes per frame, timestamp at ADC_PARSED_FRAME
+// - numFrames:   input frames (up to MAX_FRAMES_PER_BLOCK)
+// - log2R:       1 ... DECIM_MAX_LOG2
+// - st:          stage state, updated for the next packet
+// - firstSource: [out] input frame index the first output was computed on (for the frame index in the header)
+// returns number of output frames, can be 0 for a very short packet
+static uint32_t IRAM_ATTR decim_Nch(uint8_t * const packet     ,
+                                    const uint32_t  numFrames  ,
+                                    const uint32_t  log2R      ,
+                                    DecimState &    st         ,
+                                    uint32_t &      firstSource)
 {
-    // two cascaded stages = 4th order
-    constexpr int32_t N_STAGE = 2;
-
-    // Number of coefficient sets we have excluding BYPASS set
-    constexpr uint32_t numOfCoefficients = NUM_OF_FREQ_PRESETS * NUM_OF_REGIONS_5060;
-
-    // Coefficients for f0 = 100 Hz, Q = 35 and all sets of sampling and network frequencies
-    // b0, b1, b2
-    static const int32_t BQ_B[numOfCoefficients + 1][3] = { {   1036511020,   1677110060,   1036511020 } , // 100 hz network -> 250, 500, 1000, 2000, 4000 Hz
-                                                            {   2109607985,  -1303809438,   2109607985 } ,
-                                                            {   1064189426,  -1721894661,   1064189426 } ,
-                                                            {   1068944381,  -2033253038,   1068944381 } ,
-                                                            {   1071337744,  -2116295597,   1071337744 } ,
-                                                            {   1029364502,   2042495310,   1029364502 } , // 120 hz network -> 250, 500, 1000, 2000, 4000 Hz
-                                                            {   2102190518,   -263995270,   2102190518 } ,
-                                                            {   1062299171,  -1548765538,   1062299171 } ,
-                                                            {   1067990015,  -1985984006,   1067990015 } ,
-                                                            {   1070858217,  -2103780747,   1070858217 } ,
-                                                            {   1073741824,            0,            0 } }; // BYPASS
-    // a1, a2 (a0 is ignored since coefficients are normalized to have it equal to 1)
-    static const int32_t BQ_A[numOfCoefficients + 1][3] = { {   1677110060,    999280216 } , // 100 hz network -> 250, 500, 1000, 2000, 4000 Hz
-                                                            {  -1303809438,   2071732322 } ,
-                                                            {  -1721894661,   1054637027 } ,
-                                                            {  -2033253038,   1064146937 } ,
-                                                            {  -2116295597,   1068933663 } ,
-                                                            {   2042495310,    984987179 } , // 120 hz network -> 250, 500, 1000, 2000, 4000 Hz 
-                                                            {   -263995270,   2056897388 } ,
-                                                            {  -1548765538,   1050856519 } ,
-                                                            {  -1985984006,   1062238206 } ,
-                                                            {  -2103780747,   1067974610 } ,
-                                                            {            0,            0 } }; // BYPASS
-
-    // Output scaling after accumulation and multiplication with coefficients
-    // Here maximum filter gain is 0 dB, so no additional scaling is needed
-    // It;s just happend that for all sets of NETWORK frequencies scaling of coefficients is the same
-    // i.e. 30 for for both 100 and 120 for 500 Hz and 30 for 100 and 120 for all the others.
-    // But when we switch to BYPASS index for that does not matterm it will stay as last entry and
-    // there scaling of 1 is 30 bits, that is it.
-    constexpr int32_t BIT_SHIFT_OUT[2][NUM_OF_FREQ_PRESETS] = {{30, 30, 30, 30, 30},  // BYPASS index is always the same and it's just scaled to 30 bits
-                                                               {30, 31, 30, 30, 30}}; // 100/120 hz network -> 250, 500, 1000, 2000, 4000 Hz
-
-    // Biquad state: [x1,x2,y1,y2] for each stage, per channel
-    static int32_t state[NUMBER_OF_ADC_CHANNELS][N_STAGE][4] = {{{0}}};
-
-    // If filter is OFF this switch will select the last entry which is BYPASS coefficients.
-    // If filter is ON index will pick proper set for given Sample rate and network settings
-    int select_idx = filter_OnOff * (selectSamplingFreq + NUM_OF_FREQ_PRESETS * selectNetworkFreq) + (1 - filter_OnOff) * (numOfCoefficients);
-
-    // For each channel, process through two cascaded biquads
+    int32_t  buf[MAX_FRAMES_PER_BLOCK];
+    uint32_t pos[DECIM_MAX_LOG2], phase[DECIM_MAX_LOG2];
+    uint32_t n = 0;
+
+    // Which input frames survive: run the stage phases over frame indices, same walk the samples do below
+    uint32_t src[MAX_FRAMES_PER_BLOCK];
+    for (uint32_t f = 0; f < numFrames; ++f) src[f] = f;
+    n = numFrames;
+    for (uint32_t s = 0; s < log2R; ++s)
+    {
+        uint32_t ph = st.phase[s], out = 0;
+        for (uint32_t i = 0; i < n; ++i) { ph ^= 1u; if (!ph) src[out++] = src[i]; }
+        n = out;
+    }
+    const uint32_t numOut = n;
+    firstSource = numOut ? src[0] : 0u;
+
     for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
     {
-        // Grab current ADC sample
-        int32_t x = data_inout[ch];
+        uint8_t * p = packet + 3 * ch;
+        for (uint32_t f = 0; f < numFrames; ++f) buf[f] = decim_unpack(p + f * ADC_FULL_FRAME_SIZE);
 
-        // Run N (in our case 2) stages
-        for (int stage = 0; stage < N_STAGE; ++stage)
+        // Every channel starts from the same stage positions, they're committed after the last channel
+        n = numFrames;
+        for (uint32_t s = 0; s < log2R; ++s)
         {
-            // Load previous states
-            int32_t x1 = state[ch][stage][0];
-            int32_t x2 = state[ch][stage][1];
-            int32_t y1 = state[ch][stage][2];
-            int32_t y2 = state[ch][stage][3];
-
-            // Direct Form II transposed structure
-            int64_t acc = (int64_t)BQ_B[select_idx][0] * x  +
-                          (int64_t)BQ_B[select_idx][1] * x1 +
-                          (int64_t)BQ_B[select_idx][2] * x2 -
-                          (int64_t)BQ_A[select_idx][0] * y1 -
-                          (int64_t)BQ_A[select_idx][1] * y2;
-
-            // scale back after multiplication WITH proper rounding away from 0 (-0.5 = -1, +0.5 = +1)
-            // It's ok to scale only by coeffcicients scale if you know that maximum
-            // filter gain is 0 dB. Otherwise signal can be bigger then it was before.
-            // That is why you ether normalize filter gain to 0dB before putting coefficients here
-            // or you keep in mind gain and make sure you will not overflow after
-            const int64_t sign = acc >> 63;
-            acc  += (1LL << (BIT_SHIFT_OUT[filter_OnOff][selectSamplingFreq] - 1)) - (sign & 1);
-            acc >>= BIT_SHIFT_OUT[filter_OnOff][selectSamplingFreq];
-            int32_t y = (int32_t)acc;
-
-            // State update
-            state[ch][stage][1] = x1;   // x2 <= x1
-            state[ch][stage][0] = x;    // x1 <= x
-            state[ch][stage][3] = y1;   // y2 <= y1
-            state[ch][stage][2] = y;    // y1 <= y
-
-            x = y; // cascade output to next stage
+            pos[s] = st.pos[s]; phase[s] = st.phase[s];
+            if (s + 1u < log2R)
+                n = decim_halfbandStage<HB_SHORT_NUM_TAPS, HB_SHORT_RING>(buf, n, HB_SHORT_H, st.shortRing[s][ch], pos[s], phase[s]);
+            else
+                n = decim_halfbandStage<HB_LONG_NUM_TAPS , HB_LONG_RING >(buf, n, HB_LONG_H , st.longRing[ch]    , pos[s], phase[s]);
         }
 
-        // Send to output
-        data_inout[ch] = x;
+        // Back to 24 bits, clamp, pack into output frame slots
+        for (uint32_t f = 0; f < n; ++f, p += ADC_FULL_FRAME_SIZE)
+        {
+            int32_t val = dsp_roundShift(buf[f], DECIM_HEADROOM);
+            if (val >  0x7FFFFF) val =  0x7FFFFF;
+            if (val < -0x800000) val = -0x800000;
+            p[0] = (uint8_t)((val >> 16) & 0xFF);
+            p[1] = (uint8_t)((val >>  8) & 0xFF);
+            p[2] = (uint8_t)( val & 0xFF);
+        }
     }
+    for (uint32_t s = 0; s < log2R; ++s) { st.pos[s] = pos[s]; st.phase[s] = phase[s]; }
+
+    // Timestamps of the surviving frames, src[f] >= f so the copy goes forward safely
+    for (uint32_t f = 0; f < numOut; ++f)
+    {
+        memmove(&packet[f * ADC_FULL_FRAME_SIZE + ADC_PARSED_FRAME], &packet[src[f] * ADC_FULL_FRAME_SIZE + ADC_PARSED_FRAME], 4);
+    }
+    return numOut;
+}
+
+// Decimator - halfband cascade with the R its history belongs to, per instance same as DspChain
+struct Decimator
+{
+    DecimState state;
+    uint32_t   log2R;   // 0 - off, stages not primed
+};
+
+// decim_init - decimation off
+static inline void decim_init(Decimator & d)
+{
+    memset(&d, 0, sizeof(d));
+}
+
+// decim_process - decimate a packet by 1 << log2R in place, stages are primed from its first frame when decimation is
+// switched on or R changes
+// - log2R:       0 - off, packet is not touched
+// - firstSource: [out] input frame index the first output was computed on, 0 when off
+// returns number of output frames
+static inline uint32_t decim_process(Decimator &     d          ,
+                                     const uint32_t  log2R      ,
+                                     uint8_t * const packet     ,
+                                     const uint32_t  numFrames  ,
+                                     uint32_t &      firstSource)
+{
+    firstSource = 0u;
+    if (log2R == 0)
+    {
+        d.log2R = 0;
+        return numFrames;
+    }
+    if (log2R != d.log2R)
+    {
+        decim_prime(d.state, packet);
+        d.log2R = log2R;
+    }
+    return decim_Nch(packet, numFrames, log2R, d.state, firstSource);
 }
 
 #endif // MATH_LIB_H
@@ -787,4 +1194,16 @@ static inline void notch100120Hz_16ch_4p(int32_t *      data_inout        , // [
 //     for nidx, freq in enumerate(pair):
 //         print(f"// Notch {freq} Hz:")
 //         for fs, ofs in zip(sample_rates, d["O"][nidx]):
-//             print(f"//   Fs = {fs} Hz, bit_offset = {ofs}")
\ No newline at end of file
+//             print(f"//   Fs = {fs} Hz, bit_offset = {ofs}")
+//
+// # === DECIMATION HALFBANDS (HB_SHORT_H, HB_LONG_H) ===
+// # Kaiser windowed halfband, center tap forced to 0.5, other taps scaled so DC gain is exactly 1
+// from scipy.signal import firwin
+// for name, taps, beta in (("HB_SHORT_H", 15, 6.5), ("HB_LONG_H", 51, 8.0)):
+//     h = firwin(taps, 0.5, window=("kaiser", beta))
+//     c = (taps - 1) // 2
+//     h[c] = 0.0
+//     h *= 0.5 / h.sum()
+//     q = [int(round(v * 2**30)) for v in h[c + 1::2]]
+//     q[0] -= (2 * sum(q) - 2**29) // 2   # rounding, sum of both sides + center = 1 << 30 exactly
+//     print(f"static const int32_t {name}[] = {{ {', '.join(map(str, q))} }};")
@@ -8,9 +8,14 @@
 #include <stdio.h>
 #include <spi_lib.h>
 #include <net_manager.h>
+#include <usb_link.h>
 #include <Arduino.h>
 #include <Preferences.h>
 #include <helpers.h>
+#include <stats_lib.h>
+#include <power_lib.h>
+#include <settings_lib.h>
+#include <impedance_lib.h>
 
 
 
@@ -20,7 +25,8 @@
 // ---------------------------------------------------------------------------------------------------------------------------------
 static const MsgContext *C = nullptr; // set by msg_init()
 extern NetManager net;
-extern int32_t udp_read(char *buf, size_t cap);
+extern UsbLink usbLink;
+extern bool udp_read(CmdMsg &msg);
 extern BootCheck bootCheck;
 extern Debugger Debug;
 
@@ -39,18 +45,17 @@ extern void continuous_mode_start_stop(uint8_t on_off);
 
 
 // Globals from main.cpp
-extern volatile bool     g_adcEqualizer;       // FIR equalizer (sinc-3)   (true = ON)
-extern volatile bool     g_removeDC;           // DC-blocking IIR          (true = ON)
-extern volatile bool     g_block5060Hz;        // 50/60 Hz Notch           (true = ON)
-extern volatile bool     g_block100120Hz;      // 100/120 Hz Notch         (true = ON)
-extern volatile bool     g_filtersEnabled;     // Master filter enable     (true = ON)
-extern volatile uint32_t g_selectDCcutoffFreq; // 0 = 0.5, 1 = 1, 2 = 2, 3 = 4, 4 = 8 Hz
-extern volatile uint32_t g_selectNetworkFreq;  // 0 = 50Hz, 1 = 60Hz
-extern volatile uint32_t g_digitalGain;        // 0 = 1, 1 = 2, 2 = 4, 3 = 8 ... up to 8 = 256
+extern volatile uint32_t g_selectSamplingFreq; // 0 = 250 Hz ... 4 = 4000 Hz
+extern volatile uint32_t g_framesPerPacket;    // result of update_frame_packing()
+extern TaskHandle_t      adcTaskHandle;        // sys stats - stack high-water marks
+extern TaskHandle_t      senderTaskHandle;
+
+static bool cmd_tables_sorted(void);
 
 void msg_init(const MsgContext *ctx)
 {
     C = ctx;
+    if (!cmd_tables_sorted()) Debug.print("MSG: command table out of order, some commands won't be found");
 }
 
 // Small helpers
@@ -61,11 +66,41 @@ static inline char *next_tok(char **ctx)
     return strtok_r(nullptr, " \r\n", ctx);
 }
 
+// Command tables - one entry per command name, handler gets the name it was called with and the rest of the line.
+// Every table is sorted by name in strcasecmp order, lookup is a binary search (msg_init() checks the order once).
+struct CmdEntry
+{
+    const char *name;
+    void      (*run)(const char *cmd, char **ctx);
+};
+#define CMD_COUNT(table) (sizeof(table) / sizeof((table)[0]))
+
+static const CmdEntry *find_cmd(const CmdEntry *table, size_t count, const char *name)
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        const int    c   = strcasecmp(name, table[mid].name);
+        if (c == 0) return &table[mid];
+        if (c < 0) hi = mid;
+        else       lo = mid + 1;
+    }
+    return nullptr;
+}
+
+static bool cmd_table_sorted(const CmdEntry *table, size_t count)
+{
+    for (size_t i = 1; i < count; ++i)
+        if (strcasecmp(table[i - 1].name, table[i].name) >= 0) return false;
+    return true;
+}
+
 // Helper to update individual channel register bits
 // Always uses read_Register_Daisy for reading
 static bool update_channel_register(int channel, uint8_t mask, uint8_t new_bits)
 {
-    if (channel < 0 || channel > 15) return false;
+    if (channel < 0 || channel >= NUMBER_OF_ADC_CHANNELS) return false;
     
     // Determine target ADC and register
     char target = (channel < 8) ? 'M' : 'S';
@@ -108,8 +143,10 @@ static bool modify_register_bits(uint8_t reg_addr, uint8_t mask, uint8_t new_bit
     xfer('M', 3, tx, rx);
     
     // Write to Slave  
+#if ADC_NUM_CHIPS > 1
     tx[2] = new_slave;
     xfer('S', 3, tx, rx);
+#endif
 
     // Verify
     RegValues verify = read_Register_Daisy(reg_addr);
@@ -139,16 +176,35 @@ static bool update_all_channels(uint8_t mask, uint8_t new_bits)
 
 
 
+// Replies of a binary TEXT record are collected here instead of going out (s_capBuf == nullptr - send as usual)
+static uint8_t *s_capBuf = nullptr;
+static size_t   s_capCap = 0;
+static size_t   s_capLen = 0;
+
+// Where the command being run came from, its replies go back the same way (CMD_ORIGIN_* in net_manager.h)
+static uint8_t  s_replyOrigin = CMD_ORIGIN_NET;
+static uint32_t s_replyIp     = 0;
+static uint16_t s_replyPort   = 0;
+
 static void send_reply(const void* data, size_t len)
 {
-    net.sendCtrl(data, len);
+    if (s_capBuf)
+    {
+        const size_t n = (len < s_capCap - s_capLen) ? len : (s_capCap - s_capLen);
+        memcpy(&s_capBuf[s_capLen], data, n);
+        s_capLen += n;
+        return;
+    }
+    if (s_replyOrigin == CMD_ORIGIN_USB) usbLink.sendCtrl(data, len);
+    else                                 net.sendCtrl(s_replyIp, s_replyPort, data, len);
 }
 
 static void send_reply_line(const char* msg)
 {
-    char buf[256];
+    char buf[704];
     size_t n = snprintf(buf, sizeof(buf), "%s\r\n", msg);
-    net.sendCtrl(buf, n);
+    if (n >= sizeof(buf)) n = sizeof(buf) - 1;   // truncated, send what is in buf
+    send_reply(buf, n);
 }
 
 static void send_error(const char *msg)
@@ -157,18 +213,30 @@ static void send_error(const char *msg)
     send_reply_line(("ERR: " + String(msg)).c_str());
 }
 
+// Unknown command of a family, the expected list comes straight from its table
+static void send_unknown(const char *family, const char *cmd, const CmdEntry *table, size_t count)
+{
+    char out[640];
+    int  n = snprintf(out, sizeof(out), "%s - got '%s', expected (", family, cmd);
+    for (size_t i = 0; (i < count) && (n > 0) && ((size_t)n < sizeof(out)); ++i)
+        n += snprintf(&out[n], sizeof(out) - n, "%s%s", i ? "|" : "", table[i].name);
+    if ((n > 0) && ((size_t)n < sizeof(out))) snprintf(&out[n], sizeof(out) - n, ")");
+    send_error(out);
+}
+
 
 
 
 // Command helpers reused inside the family handlers
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
-static void cmd_ADC_RESET(char **)
+static void cmd_ADC_RESET(const char * /*cmd*/, char ** /*ctx*/)
 {
     Debug.print("CMD adc_reset - user requested ADC reset");
 
     // Stop streaming
     net.stopStream();
+    usbLink.stopStream();
 
     // Full ADC reset
     ads1299_full_reset();
@@ -176,20 +244,27 @@ static void cmd_ADC_RESET(char **)
     // If we use it for BCI it does proper preset right away
     if (BCI_MODE) { BCI_preset(); }
 }
-static void cmd_START_CONT(char **)
+// Stream goes out the way the command came in, the other transport stops. USB one is switched before
+// continuous_mode_start_stop(), packing depends on it (MAX_USB_FPS)
+static void cmd_START_CONT(const char * /*cmd*/, char ** /*ctx*/)
 {
+    const bool usb = (s_replyOrigin == CMD_ORIGIN_USB);
+    if (usb) { net.stopStream(); usbLink.startStream(); }
+    else     { usbLink.stopStream(); }
     continuous_mode_start_stop(HIGH);
-    net.startStream();
+    if (!usb) net.startStream();
+    send_reply_line("OK: start_cnt");   // a broadcast start is confirmed board by board with it
 }
-static void cmd_STOP_CONT(char **)
+static void cmd_STOP_CONT(const char * /*cmd*/, char ** /*ctx*/)
 {
     continuous_mode_start_stop(LOW);
     Debug.print("CMD stop_cnt - user requested stop");
     net.stopStream();
+    usbLink.stopStream();
 }
 
 // Hard reboot - never returns
-static void cmd_ESP_REBOOT(char ** )
+static void cmd_ESP_REBOOT(const char * /*cmd*/, char ** /*ctx*/)
 {
     send_reply_line("OK: rebooting…");
     delay(50);                      // give UDP time to flush
@@ -274,6 +349,40 @@ void handle_SPI(char **ctx, const char * /*orig*/)
     send_reply(rx, len);
 }
 
+// Filter settings - commands edit the draft and publish it whole, DSP takes it at the next packet (settings_lib.h).
+// Between sys settings_hold and sys settings_apply edits only collect in the draft and then switch over together.
+// Command task is the only writer, so the draft is always what was published last plus the held edits.
+static DspSettings s_dspDraft = {};      // same all-off as g_dspSettings at boot
+static bool        s_dspHold  = false;
+
+static void dsp_commit(const char * okMsg)
+{
+    if (s_dspHold)
+    {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "%s (held)", okMsg);
+        send_reply_line(msg);
+        return;
+    }
+    dspSettings_publish(g_dspSettings, s_dspDraft);
+    send_reply_line(okMsg);
+}
+
+// sys stats - one reply line per histogram, mean / max and log2 bins in us (see stats_lib.h)
+static void send_stats_hist(const char * name, const StatsHist & h)
+{
+    char msg[256];
+    int  n = snprintf(msg, sizeof(msg), "STATS: %s us - n %u, mean %u, max %u |", name, (unsigned)h.count,
+                      (unsigned)(h.count ? (h.sumUs / h.count) : 0u), (unsigned)h.maxUs);
+    for (uint32_t b = 0; (b < STATS_HIST_BINS) && (n > 0) && (n < (int)sizeof(msg)); ++b)
+    {
+        const bool last = (b == STATS_HIST_BINS - 1u);
+        n += snprintf(&msg[n], sizeof(msg) - n, " %s%u:%u", last ? ">=" : "<", (unsigned)(last ? (1u << b) : (2u << b)),
+                      (unsigned)h.bins[b]);
+    }
+    send_reply_line(msg);
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // FAMILY: SYS  (prefix "sys") - case-insensitive
 // Commands:   adc_reset   start_cnt   stop_cnt   esp_reboot   erase_flash
@@ -282,678 +391,1430 @@ void handle_SPI(char **ctx, const char * /*orig*/)
 //             FILTER_5060_ON        | FILTER_5060_OFF
 //             FILTER_100120_ON      | FILTER_100120_OFF
 //             FILTERS_ON            | FILTERS_OFF
+//             precision_fast <equalizer|5060|100120|all>   | precision_exact <...>
+//             SETTINGS_HOLD         | SETTINGS_APPLY
+//             COMPRESS_ON           | COMPRESS_OFF
+//             FEC_ON                | FEC_OFF           | fec_group <2-32>
+//             BACKFILL_ON           | BACKFILL_OFF
+//             FAST_IP_ON            | FAST_IP_OFF
+//             multicast <group>     | MULTICAST_OFF     | PEERS
+//             PACKING_AUTO          | latency <ms>      | packetrate <pps>
+//             PACKING_ADAPT_ON      | PACKING_ADAPT_OFF
+//             decimation <1|2|4|8|16>
+//             FEATURES_ON           | FEATURES_ONLY     | FEATURES_OFF
+//             feature_bands <lo>-<hi> ...             | feature_rate <1-50>
+//             IMPEDANCE_ON [6na|24na|6ua|24ua]        | IMPEDANCE_OFF
+//             STATS                 | STATS_RESET
+//             POWER_AUTO            | POWER_MAX         | LIGHT_SLEEP_ON    | LIGHT_SLEEP_OFF
 //             dccutoffFreq <xx>     | networkfreq <xx>  | digitalgain <xx>
+// Every name is one entry of SYS_CMDS below.
 // ---------------------------------------------------------------------------------------------------------------------------------
-void handle_SYS(char **ctx, const char * /*orig*/)
+
+// FIR equalizer runtime toggle
+static void sys_filter_equalizer_on(const char * /*cmd*/, char ** /*ctx*/)
 {
-    char *cmd = next_tok(ctx);
-    if (!cmd)
+    s_dspDraft.adcEqualizer = true;
+    dsp_commit("OK: filter_equalizer_on");
+}
+
+static void sys_filter_equalizer_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.adcEqualizer = false;
+    dsp_commit("OK: filter_equalizer_off");
+}
+
+// DC-blocking IIR runtime toggle
+static void sys_filter_dc_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.removeDC = true;
+    dsp_commit("OK: filter_dc_on");
+}
+
+static void sys_filter_dc_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.removeDC = false;
+    dsp_commit("OK: filter_dc_off");
+}
+
+// 50/60 Hz notch filter runtime toggle
+static void sys_filter_5060_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.block5060Hz = true;
+    dsp_commit("OK: filter_5060_on");
+}
+
+static void sys_filter_5060_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.block5060Hz = false;
+    dsp_commit("OK: filter_5060_off");
+}
+
+// 100/120 Hz notch filter runtime toggle
+static void sys_filter_100120_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.block100120Hz = true;
+    dsp_commit("OK: filter_100120_on");
+}
+
+static void sys_filter_100120_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.block100120Hz = false;
+    dsp_commit("OK: filter_100120_off");
+}
+
+// Global filter enable/disable
+static void sys_filters_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.filtersEnabled = true;
+    dsp_commit("OK: filters_on");
+}
+
+static void sys_filters_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspDraft.filtersEnabled = false;
+    dsp_commit("OK: filters_off");
+}
+
+// Several filter settings at once, e.g. DC cutoff + notch preset: hold, edit, apply - one packet boundary for all
+static void sys_settings_hold(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspHold = true;
+    send_reply_line("OK: settings_hold");
+}
+
+static void sys_settings_apply(const char * /*cmd*/, char ** /*ctx*/)
+{
+    s_dspHold = false;
+    dsp_commit("OK: settings_apply");
+}
+
+// Lossless delta coded streaming, packing changes from the next packet
+static void sys_compress_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_compressStream = true;
+    update_frame_packing();
+    send_reply_line("OK: compress_on");
+}
+
+static void sys_compress_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_compressStream = false;
+    update_frame_packing();
+    send_reply_line("OK: compress_off");
+}
+
+// --------------------------------------------------------------------
+// Forward error correction (sys fec_on | fec_off | fec_group <n>)
+// One XOR parity packet after every n data packets, PC side rebuilds one lost packet per group. +1/n airtime.
+// New group size applies from the next group.
+// --------------------------------------------------------------------
+static void sys_fec_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_fecStream = true;
+    send_reply_line("OK: fec_on");
+}
+
+static void sys_fec_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_fecStream = false;
+    send_reply_line("OK: fec_off");
+}
+
+static void sys_fec_group(const char * /*cmd*/, char **ctx)
+{
+    char *tok = next_tok(ctx);
+    int   val = tok ? atoi(tok) : 0;
+    if ((val < FEC_MIN_GROUP) || (val > FEC_MAX_GROUP))
     {
-        send_error("sys - missing command (see docs)");
+        send_error("fec_group - value must be 2 ... 32 packets");
+        return;
+    }
+    g_fecGroup = (uint32_t)val;
+
+    char msg[64];
+    snprintf(msg, sizeof(msg), "OK: fec_group %d -> +%d%% packets", val, (100 + val / 2) / val);
+    send_reply_line(msg);
+}
+
+// Keep sent datagrams in RAM and replay them after a Wi-Fi drop (default on)
+static void sys_backfill_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_backfill = true;
+    send_reply_line("OK: backfill_on");
+}
+
+static void sys_backfill_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_backfill = false;
+    send_reply_line("OK: backfill_off");
+}
+
+// Reuse the DHCP lease of the cached AP as static IP, no DHCP on boot / reconnect (saved in NVS, default off).
+// Only safe if the router keeps that address for the board (reservation or long lease).
+static void sys_fast_ip(const char *cmd, char ** /*ctx*/)
+{
+    const bool on = !strcasecmp(cmd, "fast_ip_on");
+    if (!NetConfig().saveStaticIp(on))
+    {
+        send_error("sys fast_ip - NVS write failed");
+        return;
+    }
+    net.setStaticIp(on);
+    send_reply_line(on ? "OK: fast_ip_on (next connect)" : "OK: fast_ip_off (next connect)");
+}
+
+// Data to a multicast group instead of unicast to every subscriber (saved in NVS, default off).
+// Subscribers still send WOOF_WOOF and commands, their receivers have to join the group on the data port.
+static void sys_multicast(const char *cmd, char **ctx)
+{
+    IPAddress group((uint32_t)0);
+    if (!strcasecmp(cmd, "multicast"))
+    {
+        char *tok = next_tok(ctx);
+        if (!tok || !group.fromString(tok) || (group[0] < 224) || (group[0] > 239))
+        {
+            send_error("sys multicast - expected group address 224.0.0.0 ... 239.255.255.255");
+            return;
+        }
+    }
+    if (!NetConfig().saveMulticast((uint32_t)group))
+    {
+        send_error("sys multicast - NVS write failed");
         return;
     }
+    net.setMulticast((uint32_t)group);
+
+    char msg[64];
+    if ((uint32_t)group) snprintf(msg, sizeof(msg), "OK: multicast %s", group.toString().c_str());
+    else                 snprintf(msg, sizeof(msg), "OK: multicast_off");
+    send_reply_line(msg);
+}
+
+// Data subscribers right now
+static void sys_peers(const char * /*cmd*/, char ** /*ctx*/)
+{
+    IPAddress      list[WIFI_MAX_PEERS];
+    const uint32_t n     = net.peers(list, WIFI_MAX_PEERS);
+    const uint32_t group = net.multicast();
+    char           msg[160];
+    int            len   = snprintf(msg, sizeof(msg), "PEERS: %u/%u, multicast %s:", (unsigned)n, (unsigned)WIFI_MAX_PEERS,
+                                    group ? IPAddress(group).toString().c_str() : "off");
+    for (uint32_t i = 0; (i < n) && (len > 0) && ((size_t)len < sizeof(msg)); i++)
+        len += snprintf(msg + len, sizeof(msg) - len, " %s", list[i].toString().c_str());
+    send_reply_line(msg);
+}
+
+// --------------------------------------------------------------------
+// Packetization policy (sys packing_auto | latency <ms> | packetrate <pps>)
+// Frames per packet are derived from it for the current sampling rate and again on every start of streaming.
+// Reply tells what it turned into, packet rate limit (MAX_WIFI_FPS, MAX_USB_FPS while streaming over USB) can make
+// packets bigger than asked.
+// --------------------------------------------------------------------
+static void sys_packing(const char *cmd, char **ctx)
+{
+    uint32_t mode  = PACKING_AUTO;
+    int      value = 0;
+    if (strcasecmp(cmd, "packing_auto"))
+    {
+        const bool  isLatency = !strcasecmp(cmd, "latency");
+        char       *tok       = next_tok(ctx);
+        value = tok ? atoi(tok) : 0;
+        if (isLatency && ((value < 1) || (value > 1000)))
+        {
+            send_error("latency - value must be 1 ... 1000 ms");
+            return;
+        }
+        if (!isLatency && ((value < 1) || (value > MAX_USB_FPS)))
+        {
+            send_error("packetrate - value must be 1 ... 1000 pkt/s");
+            return;
+        }
+        mode = isLatency ? PACKING_LATENCY : PACKING_RATE;
+    }
+    g_packingMode  = mode;
+    g_packingValue = (uint32_t)value;
+    update_frame_packing();
+
+    char arg[16] = "";
+    if (value) snprintf(arg, sizeof(arg), " %d", value);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "OK: %s%s -> %u frames per packet, %u pkt/s", cmd, arg,
+             (unsigned)g_framesPerPacket, (unsigned)((250u << g_selectSamplingFreq) / (g_framesPerPacket << g_decimationLog2)));
+    send_reply_line(msg);
+}
 
-    // Reset and streaming commands
-    if (!strcasecmp(cmd, "adc_reset"))       { cmd_ADC_RESET(ctx);   return; }
-    if (!strcasecmp(cmd, "start_cnt"))       { cmd_START_CONT(ctx);  return; }
-    if (!strcasecmp(cmd, "stop_cnt"))        { cmd_STOP_CONT(ctx);   return; }
-    if (!strcasecmp(cmd, "esp_reboot"))      { cmd_ESP_REBOOT(ctx);  return; }
+static void sys_packing_adapt_on(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_packingAdaptive = true;
+    send_reply_line("OK: packing_adapt_on");
+}
+
+static void sys_packing_adapt_off(const char * /*cmd*/, char ** /*ctx*/)
+{
+    g_packingAdaptive = false;
+    send_reply_line("OK: packing_adapt_off");
+}
+
+// --------------------------------------------------------------------
+// Power management (sys power_auto | power_max | light_sleep_on | light_sleep_off), see power_lib.h
+// power_auto picks 80 or 160 MHz from the measured load, power_max stays at 160 MHz as before.
+// light_sleep_on - light sleep between Wi-Fi beacons while not streaming, USB serial is gone meanwhile.
+// --------------------------------------------------------------------
+static void send_power_line(const char * head)
+{
+    const uint32_t fs = 250u << g_selectSamplingFreq;
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%s -> %s, cpu %u MHz (%s), stream load %u %% of %u MHz, light sleep %s", head,
+             (g_power.mode == POWER_MAX) ? "power_max" : "power_auto", (unsigned)g_power.cpuMhz,
+             g_power.lock ? "DFS" : "fixed", (unsigned)power_loadPct(g_power, fs, PM_CPU_MHZ_LOW), (unsigned)PM_CPU_MHZ_LOW,
+             g_power.sleeping ? "on" : (g_power.lightSleep ? "when idle" : "off"));
+    send_reply_line(msg);
+}
 
-    // FIR equalizer runtime toggle
-    if (!strcasecmp(cmd, "filter_equalizer_on"))
+static void sys_power(const char *cmd, char ** /*ctx*/)
+{
+    g_power.mode = strcasecmp(cmd, "power_max") ? POWER_AUTO : POWER_MAX;
+    char head[32];
+    snprintf(head, sizeof(head), "OK: %s", cmd);
+    send_power_line(head);
+}
+
+static void sys_light_sleep(const char *cmd, char ** /*ctx*/)
+{
+    const bool on = !strcasecmp(cmd, "light_sleep_on");
+    if (on && !g_power.lock)
     {
-        g_adcEqualizer = true;
-        send_reply_line("OK: filter_equalizer_on");
+        send_error("light_sleep_on - this build has no power management (CONFIG_PM_ENABLE)");
         return;
     }
-    if (!strcasecmp(cmd, "filter_equalizer_off"))
+    g_power.lightSleep = on;
+    send_reply_line(on ? "OK: light_sleep_on (while not streaming, no USB serial while asleep)" : "OK: light_sleep_off");
+}
+
+// --------------------------------------------------------------------
+// Hot-path statistics (sys stats | sys stats_reset)
+// Counters since boot or the last reset, DRDY -> SPI done and DSP time per frame against the frame period
+// --------------------------------------------------------------------
+static void sys_stats(const char * /*cmd*/, char ** /*ctx*/)
+{
+    const uint32_t fs = 250u << g_selectSamplingFreq;
+    char msg[320];
+    snprintf(msg, sizeof(msg),
+             "STATS: %u s, frames %u, drdy_missed %u, dma_timeouts %u, dropped %u pkt / %u frames, udp_busy %u, udp_err %u, "
+             "usb_busy %u, replayed %u, cmd_drop %u, ready_hwm %u/%u, cmd_hwm %u",
+             (unsigned)((millis() - g_stats.resetMs) / 1000u), (unsigned)g_stats.framesRead,
+             (unsigned)g_stats.drdyMissed, (unsigned)g_stats.dmaTimeouts,
+             (unsigned)g_stats.droppedPackets, (unsigned)g_stats.droppedFrames,
+             (unsigned)g_stats.udpBusy, (unsigned)g_stats.udpErrors, (unsigned)g_stats.usbBusy,
+             (unsigned)g_stats.replayedPackets, (unsigned)g_stats.cmdDropped, (unsigned)g_stats.readyHwm, (unsigned)PACKET_RING_SLOTS,
+             (unsigned)g_stats.cmdHwm);
+    send_reply_line(msg);
+
+    snprintf(msg, sizeof(msg), "STATS: frame period %u us at %u Hz", (unsigned)(1000000u / fs), (unsigned)fs);
+    send_reply_line(msg);
+
+    // Stack bytes never touched since boot (ESP-IDF counts stacks in bytes), not reset by stats_reset
+    snprintf(msg, sizeof(msg), "STATS: stack free adc %u / %u B, sender %u / %u B",
+             adcTaskHandle    ? (unsigned)uxTaskGetStackHighWaterMark(adcTaskHandle)    : 0u, (unsigned)ADC_TASK_STACK,
+             senderTaskHandle ? (unsigned)uxTaskGetStackHighWaterMark(senderTaskHandle) : 0u, (unsigned)SENDER_TASK_STACK);
+    send_reply_line(msg);
+    send_stats_hist("drdy->spi", g_stats.drdyToSpi);
+    send_stats_hist("dsp/frame", g_stats.dspPerFrame);
+    send_power_line("STATS: power");
+}
+
+static void sys_stats_reset(const char * /*cmd*/, char ** /*ctx*/)
+{
+    stats_reset(millis());
+    send_reply_line("OK: stats_reset");
+}
+
+// --------------------------------------------------------------------
+// On-board decimation (sys decimation X)
+// Acceptable: 1 (off), 2, 4, 8, 16  (maps to 0 ... 4, log2)
+// ADC keeps its sampling rate and filters, only every X-th filtered frame is sent. Packing follows the output rate.
+// --------------------------------------------------------------------
+static void sys_decimation(const char * /*cmd*/, char **ctx)
+{
+    char *tok = next_tok(ctx);
+    if (!tok)
     {
-        g_adcEqualizer = false;
-        send_reply_line("OK: filter_equalizer_off");
+        send_error("decimation - missing value (1,2,4,8,16)");
         return;
     }
-    // DC-blocking IIR runtime toggle
-    if (!strcasecmp(cmd, "filter_dc_on"))
+    int val = atoi(tok);
+    int ival = -1;
+    if      (val ==  1) ival = 0;
+    else if (val ==  2) ival = 1;
+    else if (val ==  4) ival = 2;
+    else if (val ==  8) ival = 3;
+    else if (val == 16) ival = 4;
+    if (ival < 0)
     {
-        g_removeDC = true;
-        send_reply_line("OK: filter_dc_on");
+        send_error("decimation - value must be 1, 2, 4, 8 or 16");
         return;
     }
-    if (!strcasecmp(cmd, "filter_dc_off"))
+    g_decimationLog2 = ival;
+    update_frame_packing();
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "OK: decimation %d -> %u Hz out, %u frames per packet", val,
+             (unsigned)((250u << g_selectSamplingFreq) >> ival), (unsigned)g_framesPerPacket);
+    send_reply_line(msg);
+}
+
+// DC Cutoff Frequency (sys dccutofffreq XX)
+// Acceptable: 0.5, 1, 2, 4, 8  (maps to 0, 1, 2, 3, 4)
+// --------------------------------------------------------------------
+// --------------------------------------------------------------------
+static void sys_dccutofffreq(const char * /*cmd*/, char **ctx)
+{
+    char *tok = next_tok(ctx);
+    if (!tok)
     {
-        g_removeDC = false;
-        send_reply_line("OK: filter_dc_off");
+        send_error("dccutofffreq - missing value (0.5,1,2,4,8)");
         return;
     }
-    // 50/60 Hz notch filter runtime toggle
-    if (!strcasecmp(cmd, "filter_5060_on"))
+    float val = atof(tok);
+    int ival = -1;
+    if      (val == 0.5f) ival = 0;
+    else if (val == 1.0f) ival = 1;
+    else if (val == 2.0f) ival = 2;
+    else if (val == 4.0f) ival = 3;
+    else if (val == 8.0f) ival = 4;
+    if (ival < 0)
     {
-        g_block5060Hz = true;
-        send_reply_line("OK: filter_5060_on");
+        send_error("dccutofffreq - value must be 0.5, 1, 2, 4, or 8");
         return;
     }
-    if (!strcasecmp(cmd, "filter_5060_off"))
+    s_dspDraft.selectDCcutoffFreq = ival;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "OK: dccutofffreq set to %.1f", val);
+    dsp_commit(msg);
+}
+
+// --------------------------------------------------------------------
+// Filter precision (sys precision_fast <filter> | sys precision_exact <filter>)
+// filter: equalizer, 5060, 100120 or all. Fast kernels keep 32-bit products only, error against exact in math_lib.h.
+// DC blocker has exact kernel only.
+// --------------------------------------------------------------------
+static void sys_precision(const char *cmd, char **ctx)
+{
+    const bool fast = !strcasecmp(cmd, "precision_fast");
+    char *tok = next_tok(ctx);
+    uint32_t bits = 0;
+    if      (!tok)                          bits = 0;
+    else if (!strcasecmp(tok, "equalizer")) bits = DSP_CHAIN_EQ;
+    else if (!strcasecmp(tok, "5060"))      bits = DSP_CHAIN_N50;
+    else if (!strcasecmp(tok, "100120"))    bits = DSP_CHAIN_N100;
+    else if (!strcasecmp(tok, "all"))       bits = DSP_CHAIN_FAST_CAPABLE;
+    else if (!strcasecmp(tok, "dc"))
     {
-        g_block5060Hz = false;
-        send_reply_line("OK: filter_5060_off");
+        send_error(fast ? "precision_fast - DC blocker has no fast kernel" : "precision_exact - DC blocker is always exact");
         return;
     }
-    // 100/120 Hz notch filter runtime toggle
-    if (!strcasecmp(cmd, "filter_100120_on"))
+    if (bits == 0)
     {
-        g_block100120Hz = true;
-        send_reply_line("OK: filter_100120_on");
+        char err[64];
+        snprintf(err, sizeof(err), "%s - filter must be equalizer, 5060, 100120 or all", cmd);
+        send_error(err);
         return;
     }
-    if (!strcasecmp(cmd, "filter_100120_off"))
+    s_dspDraft.fastFilters = fast ? (s_dspDraft.fastFilters | bits) : (s_dspDraft.fastFilters & ~bits);
+
+    const uint32_t f = s_dspDraft.fastFilters;
+    char msg[96];
+    snprintf(msg, sizeof(msg), "OK: %s %s - fast: equalizer %s, 5060 %s, 100120 %s", cmd, tok,
+             (f & DSP_CHAIN_EQ) ? "yes" : "no", (f & DSP_CHAIN_N50) ? "yes" : "no", (f & DSP_CHAIN_N100) ? "yes" : "no");
+    dsp_commit(msg);
+}
+
+// --------------------------------------------------------------------
+// Network Freq (sys networkfreq XX)
+// Acceptable: 50 or 60  (maps to 0 and 1)
+// --------------------------------------------------------------------
+static void sys_networkfreq(const char * /*cmd*/, char **ctx)
+{
+    char *tok = next_tok(ctx);
+    if (!tok)
     {
-        g_block100120Hz = false;
-        send_reply_line("OK: filter_100120_off");
+        send_error("networkfreq - missing value (50 or 60)");
         return;
     }
-    // Global filter enable/disable
-    if (!strcasecmp(cmd, "filters_on"))
+    int val = atoi(tok);
+    if (val == 50)
     {
-        g_filtersEnabled = true;
-        send_reply_line("OK: filters_on");
+        s_dspDraft.selectNetworkFreq = 0;
+        dsp_commit("OK: networkfreq set to 50");
         return;
     }
-    if (!strcasecmp(cmd, "filters_off"))
+    if (val == 60)
     {
-        g_filtersEnabled = false;
-        send_reply_line("OK: filters_off");
+        s_dspDraft.selectNetworkFreq = 1;
+        dsp_commit("OK: networkfreq set to 60");
         return;
     }
-    
+    send_error("networkfreq - value must be 50 or 60");
+}
 
-    // DC Cutoff Frequency (sys dccutofffreq XX)
-    // Acceptable: 0.5, 1, 2, 4, 8  (maps to 0, 1, 2, 3, 4)
-    // --------------------------------------------------------------------
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "dccutofffreq"))
+// --------------------------------------------------------------------
+// Digital Gain (sys digitalgain XX)
+// Acceptable: 1, 2, 4, 8, ... up to 256 (must be power of two)
+// Maps to 0=1, 1=2, 2=4, ... 8=256 (log2)
+// --------------------------------------------------------------------
+static void sys_digitalgain(const char * /*cmd*/, char **ctx)
+{
+    char *tok = next_tok(ctx);
+    if (!tok)
     {
-        char *tok = next_tok(ctx);
-        if (!tok)
-        {
-            send_error("dccutofffreq - missing value (0.5,1,2,4,8)");
-            return;
-        }
-        float val = atof(tok);
-        int ival = -1;
-        if      (val == 0.5f) ival = 0;
-        else if (val == 1.0f) ival = 1;
-        else if (val == 2.0f) ival = 2;
-        else if (val == 4.0f) ival = 3;
-        else if (val == 8.0f) ival = 4;
-        if (ival < 0)
-        {
-            send_error("dccutofffreq - value must be 0.5, 1, 2, 4, or 8");
-            return;
-        }
-        g_selectDCcutoffFreq = ival;
-        char msg[64];
-        snprintf(msg, sizeof(msg), "OK: dccutofffreq set to %.1f", val);
-        send_reply_line(msg);
+        send_error("digitalgain - missing value (1,2,...,256)");
         return;
     }
+    int val = atoi(tok);
+    int ival = -1;
+    if (val == 1) ival = 0;
+    else if (val ==   2) ival = 1;
+    else if (val ==   4) ival = 2;
+    else if (val ==   8) ival = 3;
+    else if (val ==  16) ival = 4;
+    else if (val ==  32) ival = 5;
+    else if (val ==  64) ival = 6;
+    else if (val == 128) ival = 7;
+    else if (val == 256) ival = 8;
+    if (ival < 0)
+    {
+        send_error("digitalgain - must be 1,2,4,...256 (power of two)");
+        return;
+    }
+    s_dspDraft.digitalGain = ival;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "OK: digitalgain set to %d", val);
+    dsp_commit(msg);
+}
 
-    // --------------------------------------------------------------------
-    // Network Freq (sys networkfreq XX)
-    // Acceptable: 50 or 60  (maps to 0 and 1)
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "networkfreq"))
+// --------------------------------------------------------------------
+// Band power features (sys features_on | features_only | features_off)
+// features_on - band powers next to the raw frames, features_only - instead of them (see FEATURE_* in defines.h)
+// First enable without feature_bands / feature_rate gives delta, theta, alpha, beta, gamma at FEATURE_DEFAULT_RATE
+// --------------------------------------------------------------------
+static const uint8_t FEATURE_DEFAULT_LO[] = { 1, 4,  8, 13, 30 };
+static const uint8_t FEATURE_DEFAULT_HI[] = { 4, 8, 13, 30, 45 };
+
+// Bands and rate that were never set get the defaults, so any feature command leaves a complete set in the draft
+static void feature_defaults()
+{
+    if (s_dspDraft.featureNumBands == 0)
     {
-        char *tok = next_tok(ctx);
-        if (!tok)
-        {
-            send_error("networkfreq - missing value (50 or 60)");
-            return;
-        }
-        int val = atoi(tok);
-        if (val == 50)
-        {
-            g_selectNetworkFreq = 0;
-            send_reply_line("OK: networkfreq set to 50");
-            return;
-        }
-        if (val == 60)
-        {
-            g_selectNetworkFreq = 1;
-            send_reply_line("OK: networkfreq set to 60");
-            return;
-        }
-        send_error("networkfreq - value must be 50 or 60");
+        s_dspDraft.featureNumBands = sizeof(FEATURE_DEFAULT_LO);
+        memcpy(s_dspDraft.featureBandLo, FEATURE_DEFAULT_LO, sizeof(FEATURE_DEFAULT_LO));
+        memcpy(s_dspDraft.featureBandHi, FEATURE_DEFAULT_HI, sizeof(FEATURE_DEFAULT_HI));
+    }
+    if (s_dspDraft.featureRateHz == 0) s_dspDraft.featureRateHz = FEATURE_DEFAULT_RATE;
+}
+
+static void sys_features(const char *cmd, char ** /*ctx*/)
+{
+    if (!strcasecmp(cmd, "features_off"))
+    {
+        s_dspDraft.featureMode = FEATURES_OFF;
+        dsp_commit("OK: features_off");
         return;
     }
+    feature_defaults();
+
+    const bool only = !strcasecmp(cmd, "features_only");
+    s_dspDraft.featureMode = only ? FEATURES_ONLY : FEATURES_ON;
+    char msg[96];
+    snprintf(msg, sizeof(msg), "OK: %s - %u bands, %u sets per second", only ? "features_only" : "features_on",
+             (unsigned)s_dspDraft.featureNumBands, (unsigned)s_dspDraft.featureRateHz);
+    dsp_commit(msg);
+}
 
-    // --------------------------------------------------------------------
-    // Digital Gain (sys digitalgain XX)
-    // Acceptable: 1, 2, 4, 8, ... up to 256 (must be power of two)
-    // Maps to 0=1, 1=2, 2=4, ... 8=256 (log2)
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "digitalgain"))
+// --------------------------------------------------------------------
+// Feature bands (sys feature_bands <lo>-<hi> [<lo>-<hi> ...])
+// Up to FEATURE_MAX_BANDS bands in Hz, lo <= f < hi. Bins are every FEATURE_BIN_HZ, every band needs at least one.
+// --------------------------------------------------------------------
+static void sys_feature_bands(const char * /*cmd*/, char **ctx)
+{
+    uint8_t  lo[FEATURE_MAX_BANDS], hi[FEATURE_MAX_BANDS];
+    uint32_t n = 0;
+    for (char *tok = next_tok(ctx); tok; tok = next_tok(ctx))
     {
-        char *tok = next_tok(ctx);
-        if (!tok)
+        char *dash = strchr(tok, '-');
+        const int l = atoi(tok);
+        const int h = dash ? atoi(dash + 1) : 0;
+
+        // first bin at or above lo, has to be below hi and at most the last bin
+        const int first = (l <= FEATURE_BIN_HZ) ? FEATURE_BIN_HZ : ((l + FEATURE_BIN_HZ - 1) / FEATURE_BIN_HZ) * FEATURE_BIN_HZ;
+        if (!dash || (l < 0) || (first >= h) || (first > FEATURE_MAX_BINS * FEATURE_BIN_HZ))
         {
-            send_error("digitalgain - missing value (1,2,...,256)");
+            send_error("feature_bands - band must be <lo>-<hi> Hz with a 2 Hz bin in it, up to 62 Hz");
             return;
         }
-        int val = atoi(tok);
-        int ival = -1;
-        if (val == 1) ival = 0;
-        else if (val ==   2) ival = 1;
-        else if (val ==   4) ival = 2;
-        else if (val ==   8) ival = 3;
-        else if (val ==  16) ival = 4;
-        else if (val ==  32) ival = 5;
-        else if (val ==  64) ival = 6;
-        else if (val == 128) ival = 7;
-        else if (val == 256) ival = 8;
-        if (ival < 0)
+        if (n >= FEATURE_MAX_BANDS)
         {
-            send_error("digitalgain - must be 1,2,4,...256 (power of two)");
+            send_error("feature_bands - at most 8 bands");
             return;
         }
-        g_digitalGain = ival;
-        char msg[64];
-        snprintf(msg, sizeof(msg), "OK: digitalgain set to %d", val);
-        send_reply_line(msg);
+        lo[n] = (uint8_t)l;
+        hi[n] = (uint8_t)((h > 255) ? 255 : h);
+        n++;
+    }
+    if (n == 0)
+    {
+        send_error("feature_bands - missing bands, e.g. 4-8 8-13 13-30");
         return;
     }
 
-    // --------------------------------------------------------------------
-    // Erase Flash Preferences (sys erase_flash)
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "erase_flash"))
+    s_dspDraft.featureNumBands = n;
+    memcpy(s_dspDraft.featureBandLo, lo, n);
+    memcpy(s_dspDraft.featureBandHi, hi, n);
+    feature_defaults();
+    char msg[64];
+    snprintf(msg, sizeof(msg), "OK: feature_bands %u bands", (unsigned)n);
+    dsp_commit(msg);
+}
+
+// --------------------------------------------------------------------
+// Feature rate (sys feature_rate <1..50>) - sets per second, a set every 250 / rate samples (rounded down)
+// Window stays 0.5 s, so above 2 sets per second they overlap
+// --------------------------------------------------------------------
+static void sys_feature_rate(const char * /*cmd*/, char **ctx)
+{
+    char *tok = next_tok(ctx);
+    int   val = tok ? atoi(tok) : 0;
+    if ((val < 1) || (val > FEATURE_MAX_RATE))
     {
-        Preferences prefs;
-        prefs.begin("netconf", false); // open writable
-        prefs.clear();                 // delete all keys in this namespace
-        prefs.end();
+        send_error("feature_rate - value must be 1 ... 50 sets per second");
+        return;
+    }
+    s_dspDraft.featureRateHz = (uint32_t)val;
+    feature_defaults();
+    char msg[64];
+    snprintf(msg, sizeof(msg), "OK: feature_rate %d", val);
+    dsp_commit(msg);
+}
 
-        prefs.begin("bootlog", false);
-        prefs.clear();
-        prefs.end();
+// --------------------------------------------------------------------
+// Electrode impedance (sys impedance_on [6na|24na|6ua|24ua] | impedance_off), see impedance_lib.h
+// Lead-off current, 6 nA by default. These write ADS1299 registers, so while streaming continuous mode stops for the few
+// ms that takes and starts again by itself - the packet being filled is lost, the stream session goes on. Not a filter
+// setting, settings_hold doesn't hold it.
+// --------------------------------------------------------------------
+static void sys_impedance(const char *cmd, char **ctx)
+{
+    static const char * const CURRENTS[IMPEDANCE_NUM_CURRENTS] = { "6na", "24na", "6ua", "24ua" };
+
+    const bool on      = !strcasecmp(cmd, "impedance_on");
+    uint32_t   current = IMPEDANCE_DEFAULT_CURRENT;
+    char *     tok     = on ? next_tok(ctx) : nullptr;
+    if (tok)
+    {
+        for (current = 0; (current < IMPEDANCE_NUM_CURRENTS) && strcasecmp(tok, CURRENTS[current]); ++current) {}
+        if (current >= IMPEDANCE_NUM_CURRENTS)
+        {
+            send_error("impedance_on - current must be 6na, 24na, 6ua or 24ua");
+            return;
+        }
+    }
 
-        send_reply_line("OK: flash config erased - rebooting...");
-        delay(100);
+    // Registers only in stopped continuous mode, a restart writes them by itself while the excitation is on
+    const bool streaming = continuousReading;
+    continuous_mode_start_stop(LOW);
+    g_leadOff.current = current;
+    g_leadOff.on      = on;
+    if (!(streaming && on)) ads1299_applyLeadOff();
+    if (streaming) continuous_mode_start_stop(HIGH);
 
-        bootCheck.ESP_REST("user_erase_flash");
+    if (!on)
+    {
+        send_reply_line("OK: impedance_off");
         return;
     }
-
-    // Unknown command: error
-    // --------------------------------------------------------------------
-    // --------------------------------------------------------------------
-    char out[256];
-    snprintf(out, sizeof(out),
-        "sys - got '%s', expected (adc_reset|start_cnt|stop_cnt|esp_reboot|erase_flash|filter_equalizer_on|filter_equalizer_off|filter_dc_on|filter_dc_off|filter_5060_on|filter_5060_off|filter_100120_on|filter_100120_off|filters_on|filters_off|dccutofffreq|networkfreq|digitalgain)", cmd);
-    send_error(out);
+    uint32_t excited = 0;
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch) excited += g_leadOff.pgaGain[ch] ? 1u : 0u;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "OK: impedance_on %s - excitation on %u of %u channels (normal input, powered up)%s",
+             CURRENTS[current], (unsigned)excited, (unsigned)NUMBER_OF_ADC_CHANNELS, streaming ? "" : ", values once streaming");
+    send_reply_line(msg);
 }
 
+// --------------------------------------------------------------------
+// Erase Flash Preferences (sys erase_flash)
+// --------------------------------------------------------------------
+static void sys_erase_flash(const char * /*cmd*/, char ** /*ctx*/)
+{
+    Preferences prefs;
+    prefs.begin("netconf", false); // open writable
+    prefs.clear();                 // delete all keys in this namespace
+    prefs.end();
 
+    prefs.begin("bootlog", false);
+    prefs.clear();
+    prefs.end();
 
+    send_reply_line("OK: flash config erased - rebooting...");
+    delay(100);
 
+    bootCheck.ESP_REST("user_erase_flash");
+}
 
-// FAMILY: USR  (prefix "usr") - User-level commands
-// ---------------------------------------------------------------------------------------------------------------------------------
-// ---------------------------------------------------------------------------------------------------------------------------------
-void handle_USR(char **ctx, const char * /*orig*/)
+// Sorted by name (strcasecmp order), see find_cmd()
+static const CmdEntry SYS_CMDS[] =
 {
-    // CRITICAL: Stop continuous mode before any USR commands
-    continuous_mode_start_stop(LOW);
+    { "adc_reset",            cmd_ADC_RESET },
+    { "backfill_off",         sys_backfill_off },
+    { "backfill_on",          sys_backfill_on },
+    { "compress_off",         sys_compress_off },
+    { "compress_on",          sys_compress_on },
+    { "dccutofffreq",         sys_dccutofffreq },
+    { "decimation",           sys_decimation },
+    { "digitalgain",          sys_digitalgain },
+    { "erase_flash",          sys_erase_flash },
+    { "esp_reboot",           cmd_ESP_REBOOT },
+    { "fast_ip_off",          sys_fast_ip },
+    { "fast_ip_on",           sys_fast_ip },
+    { "feature_bands",        sys_feature_bands },
+    { "feature_rate",         sys_feature_rate },
+    { "features_off",         sys_features },
+    { "features_on",          sys_features },
+    { "features_only",        sys_features },
+    { "fec_group",            sys_fec_group },
+    { "fec_off",              sys_fec_off },
+    { "fec_on",               sys_fec_on },
+    { "filter_100120_off",    sys_filter_100120_off },
+    { "filter_100120_on",     sys_filter_100120_on },
+    { "filter_5060_off",      sys_filter_5060_off },
+    { "filter_5060_on",       sys_filter_5060_on },
+    { "filter_dc_off",        sys_filter_dc_off },
+    { "filter_dc_on",         sys_filter_dc_on },
+    { "filter_equalizer_off", sys_filter_equalizer_off },
+    { "filter_equalizer_on",  sys_filter_equalizer_on },
+    { "filters_off",          sys_filters_off },
+    { "filters_on",           sys_filters_on },
+    { "impedance_off",        sys_impedance },
+    { "impedance_on",         sys_impedance },
+    { "latency",              sys_packing },
+    { "light_sleep_off",      sys_light_sleep },
+    { "light_sleep_on",       sys_light_sleep },
+    { "multicast",            sys_multicast },
+    { "multicast_off",        sys_multicast },
+    { "networkfreq",          sys_networkfreq },
+    { "packetrate",           sys_packing },
+    { "packing_adapt_off",    sys_packing_adapt_off },
+    { "packing_adapt_on",     sys_packing_adapt_on },
+    { "packing_auto",         sys_packing },
+    { "peers",                sys_peers },
+    { "power_auto",           sys_power },
+    { "power_max",            sys_power },
+    { "precision_exact",      sys_precision },
+    { "precision_fast",       sys_precision },
+    { "settings_apply",       sys_settings_apply },
+    { "settings_hold",        sys_settings_hold },
+    { "start_cnt",            cmd_START_CONT },
+    { "stats",                sys_stats },
+    { "stats_reset",          sys_stats_reset },
+    { "stop_cnt",             cmd_STOP_CONT },
+};
 
+void handle_SYS(char **ctx, const char * /*orig*/)
+{
     char *cmd = next_tok(ctx);
     if (!cmd)
     {
-        send_error("usr - missing command (see docs)");
+        send_error("sys - missing command (see docs)");
         return;
     }
 
-    // --------------------------------------------------------------------
-    // Set Sampling Frequency (usr set_sampling_freq XXXX)
-    // Acceptable: 250, 500, 1000, 2000, 4000 Hz
-    // Maps to CONFIG1 bits [2:0]: 110, 101, 100, 011, 010
-    // Reference: ADS1299 datasheet, page 46 "CONFIG1: Configuration Register 1"
-    // Bits [2:0] are DR2:DR1:DR0 (Data Rate bits)
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "set_sampling_freq"))
+    const CmdEntry *e = find_cmd(SYS_CMDS, CMD_COUNT(SYS_CMDS), cmd);
+    if (e)
     {
-        char *tok = next_tok(ctx);
-        if (!tok)
-        {
-            send_error("set_sampling_freq - missing value (250,500,1000,2000,4000)");
+        e->run(cmd, ctx);
+        return;
+    }
+    send_unknown("sys", cmd, SYS_CMDS, CMD_COUNT(SYS_CMDS));
+}
+
+
+
+
+
+// FAMILY: USR  (prefix "usr") - User-level commands
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// --------------------------------------------------------------------
+// Set Sampling Frequency (usr set_sampling_freq XXXX)
+// Acceptable: 250, 500, 1000, 2000, 4000 Hz
+// Maps to CONFIG1 bits [2:0]: 110, 101, 100, 011, 010
+// Reference: ADS1299 datasheet, page 46 "CONFIG1: Configuration Register 1"
+// Bits [2:0] are DR2:DR1:DR0 (Data Rate bits)
+// --------------------------------------------------------------------
+static void usr_set_sampling_freq(const char * /*cmd*/, char **ctx)
+{
+    char *tok = next_tok(ctx);
+    if (!tok)
+    {
+        send_error("set_sampling_freq - missing value (250,500,1000,2000,4000)");
+        return;
+    }
+    
+    int freq = atoi(tok);
+    uint8_t dr_bits = 0xFF; // Invalid marker
+    
+    // Map frequency to DR bits (CONFIG1 register bits [2:0])
+    // From ADS1299 datasheet page 46, Table 11:
+    // DR2:DR1:DR0 | fMOD | fDATA 
+    // 110 (0x06)  | fCLK/4  | 250 Hz
+    // 101 (0x05)  | fCLK/8  | 500 Hz
+    // 100 (0x04)  | fCLK/16 | 1000 Hz
+    // 011 (0x03)  | fCLK/32 | 2000 Hz
+    // 010 (0x02)  | fCLK/64 | 4000 Hz
+    switch (freq)
+    {
+        case  250: dr_bits = 0x06; break; // 110
+        case  500: dr_bits = 0x05; break; // 101
+        case 1000: dr_bits = 0x04; break; // 100
+        case 2000: dr_bits = 0x03; break; // 011
+        case 4000: dr_bits = 0x02; break; // 010
+        default:
+            char err_msg[128];
+            snprintf(err_msg, sizeof(err_msg), 
+                "set_sampling_freq - got '%d', allowed only 250,500,1000,2000,4000", freq);
+            send_error(err_msg);
             return;
-        }
-        
-        int freq = atoi(tok);
-        uint8_t dr_bits = 0xFF; // Invalid marker
-        
-        // Map frequency to DR bits (CONFIG1 register bits [2:0])
-        // From ADS1299 datasheet page 46, Table 11:
-        // DR2:DR1:DR0 | fMOD | fDATA 
-        // 110 (0x06)  | fCLK/4  | 250 Hz
-        // 101 (0x05)  | fCLK/8  | 500 Hz
-        // 100 (0x04)  | fCLK/16 | 1000 Hz
-        // 011 (0x03)  | fCLK/32 | 2000 Hz
-        // 010 (0x02)  | fCLK/64 | 4000 Hz
-        switch (freq)
-        {
-            case  250: dr_bits = 0x06; break; // 110
-            case  500: dr_bits = 0x05; break; // 101
-            case 1000: dr_bits = 0x04; break; // 100
-            case 2000: dr_bits = 0x03; break; // 011
-            case 4000: dr_bits = 0x02; break; // 010
-            default:
-                char err_msg[128];
-                snprintf(err_msg, sizeof(err_msg), 
-                    "set_sampling_freq - got '%d', allowed only 250,500,1000,2000,4000", freq);
-                send_error(err_msg);
-                return;
-        }
+    }
+
+    Debug.log("CMD set_sampling_freq - setting to %d Hz", freq);
+
+    // Use helper to update CONFIG1 register bits [2:0]
+    bool success = modify_register_bits(0x01, 0x07, dr_bits);
+
+    if (success)
+    {
+        // Send success message
+        char msg[64];
+        snprintf(msg, sizeof(msg), "OK: sampling_freq set to %d Hz", freq);
+        send_reply_line(msg);
+    }
+    else
+    {
+        send_error("set_sampling_freq - failed to update CONFIG1 register");
+    }
+}
 
-        Debug.log("CMD set_sampling_freq - setting to %d Hz", freq);
+// --------------------------------------------------------------------
+// Set Channel PGA Gain (usr gain <channel|ALL> <gain>)
+// Acceptable gains: 1, 2, 4, 6, 8, 12, 24
+// Maps to CHnSET register bits [6:4]: 000 to 110
+// Reference: ADS1299 datasheet, page 47 "CHnSET: Channel n Settings Registers"
+// --------------------------------------------------------------------
+static void usr_gain(const char * /*cmd*/, char **ctx)
+{
+    // Get channel argument
+    char *ch_tok = next_tok(ctx);
+    if (!ch_tok)
+    {
+        send_error("gain - missing channel number (" ADC_CHANNELS_TEXT " or ALL)");
+        return;
+    }
+
+    // Get gain argument
+    char *gain_tok = next_tok(ctx);
+    if (!gain_tok)
+    {
+        send_error("gain - missing gain value (1,2,4,6,8,12,24)");
+        return;
+    }
 
-        // Use helper to update CONFIG1 register bits [2:0]
-        bool success = modify_register_bits(0x01, 0x07, dr_bits);
+    // Parse gain value and map to register bits
+    int gain_val = atoi(gain_tok);
+    uint8_t gain_bits = 0xFF; // Invalid marker
+    
+    switch (gain_val)
+    {
+        case  1: gain_bits = 0x00; break; // 000
+        case  2: gain_bits = 0x10; break; // 001 << 4
+        case  4: gain_bits = 0x20; break; // 010 << 4
+        case  6: gain_bits = 0x30; break; // 011 << 4
+        case  8: gain_bits = 0x40; break; // 100 << 4
+        case 12: gain_bits = 0x50; break; // 101 << 4
+        case 24: gain_bits = 0x60; break; // 110 << 4
+        default:
+            send_error("gain - invalid gain value (must be 1,2,4,6,8,12,24)");
+            return;
+    }
 
-        if (success)
+    // Handle "ALL" or specific channel
+    if (!strcasecmp(ch_tok, "ALL"))
+    {
+        Debug.log("CMD gain - setting ALL channels to gain %d", gain_val);
+        
+        if (update_all_channels(0x70, gain_bits))
         {
-            // Send success message
             char msg[64];
-            snprintf(msg, sizeof(msg), "OK: sampling_freq set to %d Hz", freq);
+            snprintf(msg, sizeof(msg), "OK: all channels set to gain %d", gain_val);
             send_reply_line(msg);
         }
         else
         {
-            send_error("set_sampling_freq - failed to update CONFIG1 register");
+            send_error("gain - failed to update some channels");
         }
-        return;
     }
-
-    // --------------------------------------------------------------------
-    // Set Channel PGA Gain (usr gain <channel|ALL> <gain>)
-    // Acceptable gains: 1, 2, 4, 6, 8, 12, 24
-    // Maps to CHnSET register bits [6:4]: 000 to 110
-    // Reference: ADS1299 datasheet, page 47 "CHnSET: Channel n Settings Registers"
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "gain"))
+    else
     {
-        // Get channel argument
-        char *ch_tok = next_tok(ctx);
-        if (!ch_tok)
-        {
-            send_error("gain - missing channel number (0-15 or ALL)");
-            return;
-        }
-
-        // Get gain argument
-        char *gain_tok = next_tok(ctx);
-        if (!gain_tok)
+        // Parse specific channel number
+        char *endptr;
+        long ch_num = strtol(ch_tok, &endptr, 10);
+        
+        if (*endptr != '\0' || ch_num < 0 || ch_num >= NUMBER_OF_ADC_CHANNELS)
         {
-            send_error("gain - missing gain value (1,2,4,6,8,12,24)");
+            send_error("gain - invalid channel (must be " ADC_CHANNELS_TEXT " or ALL)");
             return;
         }
 
-        // Parse gain value and map to register bits
-        int gain_val = atoi(gain_tok);
-        uint8_t gain_bits = 0xFF; // Invalid marker
+        Debug.log("CMD gain - setting channel %ld to gain %d", ch_num, gain_val);
         
-        switch (gain_val)
+        // Use helper for single channel
+        if (update_channel_register(ch_num, 0x70, gain_bits))
         {
-            case  1: gain_bits = 0x00; break; // 000
-            case  2: gain_bits = 0x10; break; // 001 << 4
-            case  4: gain_bits = 0x20; break; // 010 << 4
-            case  6: gain_bits = 0x30; break; // 011 << 4
-            case  8: gain_bits = 0x40; break; // 100 << 4
-            case 12: gain_bits = 0x50; break; // 101 << 4
-            case 24: gain_bits = 0x60; break; // 110 << 4
-            default:
-                send_error("gain - invalid gain value (must be 1,2,4,6,8,12,24)");
-                return;
-        }
-
-        // Handle "ALL" or specific channel
-        if (!strcasecmp(ch_tok, "ALL"))
-        {
-            Debug.log("CMD gain - setting ALL channels to gain %d", gain_val);
-            
-            if (update_all_channels(0x70, gain_bits))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: all channels set to gain %d", gain_val);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("gain - failed to update some channels");
-            }
+            char msg[64];
+            snprintf(msg, sizeof(msg), "OK: channel %ld set to gain %d", ch_num, gain_val);
+            send_reply_line(msg);
         }
         else
         {
-            // Parse specific channel number
-            char *endptr;
-            long ch_num = strtol(ch_tok, &endptr, 10);
-            
-            if (*endptr != '\0' || ch_num < 0 || ch_num > 15)
-            {
-                send_error("gain - invalid channel (must be 0-15 or ALL)");
-                return;
-            }
-
-            Debug.log("CMD gain - setting channel %ld to gain %d", ch_num, gain_val);
-            
-            // Use helper for single channel
-            if (update_channel_register(ch_num, 0x70, gain_bits))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: channel %ld set to gain %d", ch_num, gain_val);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("gain - failed to update channel register");
-            }
+            send_error("gain - failed to update channel register");
         }
+    }
+}
+
+// --------------------------------------------------------------------
+// Channel Power Down Control (usr ch_power_down <channel|ALL> <ON|OFF>)
+// ON = power on (normal operation), OFF = power down
+// Controls CHnSET register bit [7]
+// --------------------------------------------------------------------
+static void usr_ch_power_down(const char * /*cmd*/, char **ctx)
+{
+    // Get channel argument
+    char *ch_tok = next_tok(ctx);
+    if (!ch_tok)
+    {
+        send_error("ch_power_down - missing channel number (" ADC_CHANNELS_TEXT " or ALL)");
         return;
     }
 
-    // --------------------------------------------------------------------
-    // Channel Power Down Control (usr ch_power_down <channel|ALL> <ON|OFF>)
-    // ON = power on (normal operation), OFF = power down
-    // Controls CHnSET register bit [7]
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "ch_power_down"))
+    // Get ON/OFF argument
+    char *state_tok = next_tok(ctx);
+    if (!state_tok)
     {
-        // Get channel argument
-        char *ch_tok = next_tok(ctx);
-        if (!ch_tok)
-        {
-            send_error("ch_power_down - missing channel number (0-15 or ALL)");
-            return;
-        }
+        send_error("ch_power_down - missing state (ON or OFF)");
+        return;
+    }
 
-        // Get ON/OFF argument
-        char *state_tok = next_tok(ctx);
-        if (!state_tok)
-        {
-            send_error("ch_power_down - missing state (ON or OFF)");
-            return;
-        }
+    // Parse state - ON means power on (bit=0), OFF means power down (bit=1)
+    uint8_t power_bit;
+    if (!strcasecmp(state_tok, "ON"))
+    {
+        power_bit = 0x00;  // Clear bit 7 = power on
+    }
+    else if (!strcasecmp(state_tok, "OFF"))
+    {
+        power_bit = 0x80;  // Set bit 7 = power down
+    }
+    else
+    {
+        send_error("ch_power_down - state must be ON or OFF");
+        return;
+    }
 
-        // Parse state - ON means power on (bit=0), OFF means power down (bit=1)
-        uint8_t power_bit;
-        if (!strcasecmp(state_tok, "ON"))
+    // Handle "ALL" or specific channel
+    if (!strcasecmp(ch_tok, "ALL"))
+    {
+        Debug.log("CMD ch_power_down - setting ALL channels to %s", state_tok);
+        
+        if (update_all_channels(0x80, power_bit))
         {
-            power_bit = 0x00;  // Clear bit 7 = power on
+            char msg[64];
+            snprintf(msg, sizeof(msg), "OK: all channels powered %s", state_tok);
+            send_reply_line(msg);
         }
-        else if (!strcasecmp(state_tok, "OFF"))
+        else
         {
-            power_bit = 0x80;  // Set bit 7 = power down
+            send_error("ch_power_down - failed to update some channels");
         }
-        else
+    }
+    else
+    {
+        // Parse specific channel number
+        char *endptr;
+        long ch_num = strtol(ch_tok, &endptr, 10);
+        
+        if (*endptr != '\0' || ch_num < 0 || ch_num >= NUMBER_OF_ADC_CHANNELS)
         {
-            send_error("ch_power_down - state must be ON or OFF");
+            send_error("ch_power_down - invalid channel (must be " ADC_CHANNELS_TEXT " or ALL)");
             return;
         }
 
-        // Handle "ALL" or specific channel
-        if (!strcasecmp(ch_tok, "ALL"))
+        Debug.log("CMD ch_power_down - setting channel %ld to %s", ch_num, state_tok);
+        
+        // Use helper for single channel
+        if (update_channel_register(ch_num, 0x80, power_bit))
         {
-            Debug.log("CMD ch_power_down - setting ALL channels to %s", state_tok);
-            
-            if (update_all_channels(0x80, power_bit))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: all channels powered %s", state_tok);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("ch_power_down - failed to update some channels");
-            }
+            char msg[64];
+            snprintf(msg, sizeof(msg), "OK: channel %ld powered %s", ch_num, state_tok);
+            send_reply_line(msg);
         }
         else
         {
-            // Parse specific channel number
-            char *endptr;
-            long ch_num = strtol(ch_tok, &endptr, 10);
-            
-            if (*endptr != '\0' || ch_num < 0 || ch_num > 15)
-            {
-                send_error("ch_power_down - invalid channel (must be 0-15 or ALL)");
-                return;
-            }
-
-            Debug.log("CMD ch_power_down - setting channel %ld to %s", ch_num, state_tok);
-            
-            // Use helper for single channel
-            if (update_channel_register(ch_num, 0x80, power_bit))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: channel %ld powered %s", ch_num, state_tok);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("ch_power_down - failed to update channel register");
-            }
+            send_error("ch_power_down - failed to update channel register");
         }
+    }
+}
+
+// --------------------------------------------------------------------
+// Channel Input Selection (usr ch_input <channel|ALL> <input_type>)
+// Controls CHnSET register bits [2:0]
+// --------------------------------------------------------------------
+static void usr_ch_input(const char * /*cmd*/, char **ctx)
+{
+    // Get channel argument
+    char *ch_tok = next_tok(ctx);
+    if (!ch_tok)
+    {
+        send_error("ch_input - missing channel number (" ADC_CHANNELS_TEXT " or ALL)");
         return;
     }
 
-    // --------------------------------------------------------------------
-    // Channel Input Selection (usr ch_input <channel|ALL> <input_type>)
-    // Controls CHnSET register bits [2:0]
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "ch_input"))
+    // Get input type argument
+    char *input_tok = next_tok(ctx);
+    if (!input_tok)
+    {
+        send_error("ch_input - missing input type (NORMAL|SHORTED|BIAS_MEAS|MVDD|TEMP|TEST|BIAS_DRP|BIAS_DRN)");
+        return;
+    }
+
+    // Parse input type and map to register bits
+    uint8_t input_bits = 0xFF; // Invalid marker
+    
+    if (!strcasecmp(input_tok, "NORMAL"))         input_bits = 0x00; // 000
+    else if (!strcasecmp(input_tok, "SHORTED"))   input_bits = 0x01; // 001
+    else if (!strcasecmp(input_tok, "BIAS_MEAS")) input_bits = 0x02; // 010
+    else if (!strcasecmp(input_tok, "MVDD"))      input_bits = 0x03; // 011
+    else if (!strcasecmp(input_tok, "TEMP"))      input_bits = 0x04; // 100
+    else if (!strcasecmp(input_tok, "TEST"))      input_bits = 0x05; // 101
+    else if (!strcasecmp(input_tok, "BIAS_DRP"))  input_bits = 0x06; // 110
+    else if (!strcasecmp(input_tok, "BIAS_DRN"))  input_bits = 0x07; // 111
+    else
+    {
+        send_error("ch_input - invalid input type");
+        return;
+    }
+
+    // Handle "ALL" or specific channel
+    if (!strcasecmp(ch_tok, "ALL"))
     {
-        // Get channel argument
-        char *ch_tok = next_tok(ctx);
-        if (!ch_tok)
+        Debug.log("CMD ch_input - setting ALL channels to %s", input_tok);
+        
+        if (update_all_channels(0x07, input_bits))
         {
-            send_error("ch_input - missing channel number (0-15 or ALL)");
-            return;
+            char msg[64];
+            snprintf(msg, sizeof(msg), "OK: all channels set to %s input", input_tok);
+            send_reply_line(msg);
         }
-
-        // Get input type argument
-        char *input_tok = next_tok(ctx);
-        if (!input_tok)
+        else
         {
-            send_error("ch_input - missing input type (NORMAL|SHORTED|BIAS_MEAS|MVDD|TEMP|TEST|BIAS_DRP|BIAS_DRN)");
-            return;
+            send_error("ch_input - failed to update some channels");
         }
-
-        // Parse input type and map to register bits
-        uint8_t input_bits = 0xFF; // Invalid marker
+    }
+    else
+    {
+        // Parse specific channel number
+        char *endptr;
+        long ch_num = strtol(ch_tok, &endptr, 10);
         
-        if (!strcasecmp(input_tok, "NORMAL"))         input_bits = 0x00; // 000
-        else if (!strcasecmp(input_tok, "SHORTED"))   input_bits = 0x01; // 001
-        else if (!strcasecmp(input_tok, "BIAS_MEAS")) input_bits = 0x02; // 010
-        else if (!strcasecmp(input_tok, "MVDD"))      input_bits = 0x03; // 011
-        else if (!strcasecmp(input_tok, "TEMP"))      input_bits = 0x04; // 100
-        else if (!strcasecmp(input_tok, "TEST"))      input_bits = 0x05; // 101
-        else if (!strcasecmp(input_tok, "BIAS_DRP"))  input_bits = 0x06; // 110
-        else if (!strcasecmp(input_tok, "BIAS_DRN"))  input_bits = 0x07; // 111
-        else
+        if (*endptr != '\0' || ch_num < 0 || ch_num >= NUMBER_OF_ADC_CHANNELS)
         {
-            send_error("ch_input - invalid input type");
+            send_error("ch_input - invalid channel (must be " ADC_CHANNELS_TEXT " or ALL)");
             return;
         }
 
-        // Handle "ALL" or specific channel
-        if (!strcasecmp(ch_tok, "ALL"))
+        Debug.log("CMD ch_input - setting channel %ld to %s", ch_num, input_tok);
+        
+        // Use helper for single channel
+        if (update_channel_register(ch_num, 0x07, input_bits))
         {
-            Debug.log("CMD ch_input - setting ALL channels to %s", input_tok);
-            
-            if (update_all_channels(0x07, input_bits))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: all channels set to %s input", input_tok);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("ch_input - failed to update some channels");
-            }
+            char msg[64];
+            snprintf(msg, sizeof(msg), "OK: channel %ld set to %s input", ch_num, input_tok);
+            send_reply_line(msg);
         }
         else
         {
-            // Parse specific channel number
-            char *endptr;
-            long ch_num = strtol(ch_tok, &endptr, 10);
-            
-            if (*endptr != '\0' || ch_num < 0 || ch_num > 15)
-            {
-                send_error("ch_input - invalid channel (must be 0-15 or ALL)");
-                return;
-            }
-
-            Debug.log("CMD ch_input - setting channel %ld to %s", ch_num, input_tok);
-            
-            // Use helper for single channel
-            if (update_channel_register(ch_num, 0x07, input_bits))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: channel %ld set to %s input", ch_num, input_tok);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("ch_input - failed to update channel register");
-            }
+            send_error("ch_input - failed to update channel register");
         }
+    }
+}
+
+// --------------------------------------------------------------------
+// SRB2 Connection Control (usr ch_srb2 <channel|ALL> <ON|OFF>)
+// ON = closed (connected to SRB2), OFF = open
+// Controls CHnSET register bit [3]
+// --------------------------------------------------------------------
+static void usr_ch_srb2(const char * /*cmd*/, char **ctx)
+{
+    // Get channel argument
+    char *ch_tok = next_tok(ctx);
+    if (!ch_tok)
+    {
+        send_error("ch_srb2 - missing channel number (" ADC_CHANNELS_TEXT " or ALL)");
         return;
     }
 
-    // --------------------------------------------------------------------
-    // SRB2 Connection Control (usr ch_srb2 <channel|ALL> <ON|OFF>)
-    // ON = closed (connected to SRB2), OFF = open
-    // Controls CHnSET register bit [3]
-    // --------------------------------------------------------------------
-    if (!strcasecmp(cmd, "ch_srb2"))
+    // Get ON/OFF argument
+    char *state_tok = next_tok(ctx);
+    if (!state_tok)
     {
-        // Get channel argument
-        char *ch_tok = next_tok(ctx);
-        if (!ch_tok)
-        {
-            send_error("ch_srb2 - missing channel number (0-15 or ALL)");
-            return;
-        }
+        send_error("ch_srb2 - missing state (ON or OFF)");
+        return;
+    }
 
-        // Get ON/OFF argument
-        char *state_tok = next_tok(ctx);
-        if (!state_tok)
-        {
-            send_error("ch_srb2 - missing state (ON or OFF)");
-            return;
-        }
+    // Parse state - ON means closed (bit=1), OFF means open (bit=0)
+    uint8_t srb2_bit;
+    if (!strcasecmp(state_tok, "ON"))
+    {
+        srb2_bit = 0x08;  // Set bit 3 = closed/connected
+    }
+    else if (!strcasecmp(state_tok, "OFF"))
+    {
+        srb2_bit = 0x00;  // Clear bit 3 = open/disconnected
+    }
+    else
+    {
+        send_error("ch_srb2 - state must be ON or OFF");
+        return;
+    }
 
-        // Parse state - ON means closed (bit=1), OFF means open (bit=0)
-        uint8_t srb2_bit;
-        if (!strcasecmp(state_tok, "ON"))
+    // Handle "ALL" or specific channel
+    if (!strcasecmp(ch_tok, "ALL"))
+    {
+        Debug.log("CMD ch_srb2 - setting ALL channels to SRB2 %s", state_tok);
+        
+        if (update_all_channels(0x08, srb2_bit))
         {
-            srb2_bit = 0x08;  // Set bit 3 = closed/connected
+            char msg[64];
+            snprintf(msg, sizeof(msg), "OK: all channels SRB2 %s", state_tok);
+            send_reply_line(msg);
         }
-        else if (!strcasecmp(state_tok, "OFF"))
+        else
         {
-            srb2_bit = 0x00;  // Clear bit 3 = open/disconnected
+            send_error("ch_srb2 - failed to update some channels");
         }
-        else
+    }
+    else
+    {
+        // Parse specific channel number
+        char *endptr;
+        long ch_num = strtol(ch_tok, &endptr, 10);
+        
+        if (*endptr != '\0' || ch_num < 0 || ch_num >= NUMBER_OF_ADC_CHANNELS)
         {
-            send_error("ch_srb2 - state must be ON or OFF");
+            send_error("ch_srb2 - invalid channel (must be " ADC_CHANNELS_TEXT " or ALL)");
             return;
         }
 
-        // Handle "ALL" or specific channel
-        if (!strcasecmp(ch_tok, "ALL"))
+        Debug.log("CMD ch_srb2 - setting channel %ld SRB2 to %s", ch_num, state_tok);
+        
+        // Use helper for single channel
+        if (update_channel_register(ch_num, 0x08, srb2_bit))
         {
-            Debug.log("CMD ch_srb2 - setting ALL channels to SRB2 %s", state_tok);
-            
-            if (update_all_channels(0x08, srb2_bit))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: all channels SRB2 %s", state_tok);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("ch_srb2 - failed to update some channels");
-            }
+            char msg[64];
+            snprintf(msg, sizeof(msg), "OK: channel %ld SRB2 %s", ch_num, state_tok);
+            send_reply_line(msg);
         }
         else
         {
-            // Parse specific channel number
-            char *endptr;
-            long ch_num = strtol(ch_tok, &endptr, 10);
-            
-            if (*endptr != '\0' || ch_num < 0 || ch_num > 15)
-            {
-                send_error("ch_srb2 - invalid channel (must be 0-15 or ALL)");
-                return;
-            }
-
-            Debug.log("CMD ch_srb2 - setting channel %ld SRB2 to %s", ch_num, state_tok);
-            
-            // Use helper for single channel
-            if (update_channel_register(ch_num, 0x08, srb2_bit))
-            {
-                char msg[64];
-                snprintf(msg, sizeof(msg), "OK: channel %ld SRB2 %s", ch_num, state_tok);
-                send_reply_line(msg);
-            }
-            else
-            {
-                send_error("ch_srb2 - failed to update channel register");
-            }
+            send_error("ch_srb2 - failed to update channel register");
         }
+    }
+}
+
+// Sorted by name (strcasecmp order), see find_cmd()
+static const CmdEntry USR_CMDS[] =
+{
+    { "ch_input",          usr_ch_input },
+    { "ch_power_down",     usr_ch_power_down },
+    { "ch_srb2",           usr_ch_srb2 },
+    { "gain",              usr_gain },
+    { "set_sampling_freq", usr_set_sampling_freq },
+};
+
+void handle_USR(char **ctx, const char * /*orig*/)
+{
+    // CRITICAL: Stop continuous mode before any USR commands
+    continuous_mode_start_stop(LOW);
+
+    char *cmd = next_tok(ctx);
+    if (!cmd)
+    {
+        send_error("usr - missing command (see docs)");
         return;
     }
+
+    const CmdEntry *e = find_cmd(USR_CMDS, CMD_COUNT(USR_CMDS), cmd);
+    if (e)
+    {
+        e->run(cmd, ctx);
+        return;
+    }
+    send_unknown("usr", cmd, USR_CMDS, CMD_COUNT(USR_CMDS));
 }
 
 
 
 
-// Parse and process / execute commands
+// FAMILY: binary  (datagram starts with CMD_BIN_MAGIC, format in defines.h)
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
-// Reads one message from udp_read(), which pulls from the cmdQue filled by incoming UDP packets via handleRxPacket
-// - If cmdQue is empty, skips immediately (non-blocking).
-// - If msg_init() has not been called, skips.
-// - If incoming data is broken (null or what ever) or empty, skips.
-// 
-// If valid, parses the first token (command family: spi, sys, usr)
-// and dispatches to the appropriate handler function.
-// If command family is unknown, sends an error back over UDP.
-//
-// Handles exactly one command per call.
-void parse_and_execute_command(void)
+// For scripts that sweep registers / settings: no text to build or parse, several commands per datagram, one reply.
+// Each op gets its arguments and fills up to CMD_BIN_RESULT_MAX bytes of result, returns a CMD_BIN_ST_* status.
+static void execute_text(char *buf);
+
+static uint8_t bin_ping(const uint8_t * /*arg*/, uint32_t len, uint8_t *res, uint32_t &resLen)
+{
+    if (len != 0) return CMD_BIN_ST_BAD_ARGS;
+    res[0] = FIRMWARE_VERSION;
+    resLen = 1;
+    return CMD_BIN_ST_OK;
+}
+
+// Any text command, result is its reply text (ERR status if it answered ERR:). reboot / erase_flash answer nothing.
+static uint8_t bin_text(const uint8_t *arg, uint32_t len, uint8_t *res, uint32_t &resLen)
+{
+    if (len == 0) return CMD_BIN_ST_BAD_ARGS;
+    char line[CMD_BIN_RESULT_MAX + 2];
+    memcpy(line, arg, len);
+    line[len] = '\0';
+
+    s_capBuf = res;
+    s_capCap = CMD_BIN_RESULT_MAX;
+    s_capLen = 0;
+    execute_text(line);
+    s_capBuf = nullptr;
+
+    resLen = s_capLen;
+    return ((resLen >= 4) && !memcmp(res, "ERR:", 4)) ? CMD_BIN_ST_ERR : CMD_BIN_ST_OK;
+}
+
+// [target 'B'|'M'|'S'|'T'][bytes...] - same as spi <target> <len> <bytes>, result is what came back
+static uint8_t bin_spi(const uint8_t *arg, uint32_t len, uint8_t *res, uint32_t &resLen)
 {
-    if (!C) return;  // msg_init() not called
+    if (len < 2) return CMD_BIN_ST_BAD_ARGS;
+    const char target = (char)arg[0];
+    if ((target != 'B') && (target != 'M') && (target != 'S') && (target != 'T')) return CMD_BIN_ST_BAD_ARGS;
+
+    continuous_mode_start_stop(LOW);
+    xfer(target, (uint8_t)(len - 1), &arg[1], res);
+    resLen = len - 1;
+    return CMD_BIN_ST_OK;
+}
+
+// [reg] - result [master][slave]
+static uint8_t bin_reg_read(const uint8_t *arg, uint32_t len, uint8_t *res, uint32_t &resLen)
+{
+    if ((len != 1) || (arg[0] > CMD_BIN_LAST_REG)) return CMD_BIN_ST_BAD_ARGS;
+
+    continuous_mode_start_stop(LOW);
+    const RegValues r = read_Register_Daisy(arg[0]);
+    res[0] = r.master_reg_byte;
+    res[1] = r.slave_reg_byte;
+    resLen = 2;
+    return CMD_BIN_ST_OK;
+}
+
+// [reg][mask][bits] - read-modify-write on both ADCs, ERR if the read back doesn't match
+static uint8_t bin_reg_write(const uint8_t *arg, uint32_t len, uint8_t * /*res*/, uint32_t & /*resLen*/)
+{
+    if ((len != 3) || (arg[0] > CMD_BIN_LAST_REG)) return CMD_BIN_ST_BAD_ARGS;
+
+    continuous_mode_start_stop(LOW);
+    return modify_register_bits(arg[0], arg[1], arg[2]) ? CMD_BIN_ST_OK : CMD_BIN_ST_ERR;
+}
+
+static uint8_t bin_start(const uint8_t * /*arg*/, uint32_t len, uint8_t * /*res*/, uint32_t & /*resLen*/)
+{
+    if (len != 0) return CMD_BIN_ST_BAD_ARGS;
+    cmd_START_CONT(nullptr, nullptr);
+    return CMD_BIN_ST_OK;
+}
+
+static uint8_t bin_stop(const uint8_t * /*arg*/, uint32_t len, uint8_t * /*res*/, uint32_t & /*resLen*/)
+{
+    if (len != 0) return CMD_BIN_ST_BAD_ARGS;
+    cmd_STOP_CONT(nullptr, nullptr);
+    return CMD_BIN_ST_OK;
+}
+
+// [switches][dc cutoff 0-4][network 0-1][gain log2 0-8] - whole filter set in one go, result [1 if held]
+// Switch bits: 0 filters, 1 equalizer, 2 DC, 3 50/60 Hz notch, 4 100/120 Hz notch
+static uint8_t bin_dsp(const uint8_t *arg, uint32_t len, uint8_t *res, uint32_t &resLen)
+{
+    if ((len != 4) || (arg[1] > 4) || (arg[2] > 1) || (arg[3] > 8)) return CMD_BIN_ST_BAD_ARGS;
+
+    s_dspDraft.filtersEnabled     = (arg[0] & 0x01) != 0;
+    s_dspDraft.adcEqualizer       = (arg[0] & 0x02) != 0;
+    s_dspDraft.removeDC           = (arg[0] & 0x04) != 0;
+    s_dspDraft.block5060Hz        = (arg[0] & 0x08) != 0;
+    s_dspDraft.block100120Hz      = (arg[0] & 0x10) != 0;
+    s_dspDraft.selectDCcutoffFreq = arg[1];
+    s_dspDraft.selectNetworkFreq  = arg[2];
+    s_dspDraft.digitalGain        = arg[3];
+    if (!s_dspHold) dspSettings_publish(g_dspSettings, s_dspDraft);
+
+    res[0] = s_dspHold ? 1 : 0;
+    resLen = 1;
+    return CMD_BIN_ST_OK;
+}
+
+// Indexed by opcode
+typedef uint8_t (*BinOp)(const uint8_t *arg, uint32_t len, uint8_t *res, uint32_t &resLen);
+static const BinOp BIN_OPS[] =
+{
+    nullptr,        // 0x00 - not used
+    bin_ping,       // CMD_BIN_PING
+    bin_text,       // CMD_BIN_TEXT
+    bin_spi,        // CMD_BIN_SPI
+    bin_reg_read,   // CMD_BIN_REG_READ
+    bin_reg_write,  // CMD_BIN_REG_WRITE
+    bin_start,      // CMD_BIN_START
+    bin_stop,       // CMD_BIN_STOP
+    bin_dsp,        // CMD_BIN_DSP
+};
+
+// Runs every record of the datagram in order and answers all of them in one datagram
+static void handle_BIN(const uint8_t *data, uint32_t len)
+{
+    static uint8_t reply[CMD_BIN_REPLY_SIZE];
+    uint8_t        res[CMD_BIN_RESULT_MAX];
+    uint32_t       n   = 0;
+    uint32_t       pos = 2;
+    reply[n++] = CMD_BIN_MAGIC;
+    reply[n++] = data[1];           // seq, so the PC can match the reply
+
+    while ((pos + 2 <= len) && (n + 3 <= sizeof(reply)))
+    {
+        const uint8_t  op     = data[pos];
+        const uint32_t argLen = data[pos + 1];
+        uint32_t       resLen = 0;
+        uint8_t        status;
+        pos += 2;
+
+        if (pos + argLen > len)                                  status = CMD_BIN_ST_BAD_ARGS;  // record cut short
+        else if ((op >= CMD_COUNT(BIN_OPS)) || !BIN_OPS[op])     status = CMD_BIN_ST_UNKNOWN;
+        else                                                     status = BIN_OPS[op](&data[pos], argLen, res, resLen);
+
+        if (n + 3 + resLen > sizeof(reply))                      // op did run, only its result doesn't fit
+        {
+            status = CMD_BIN_ST_NO_ROOM;
+            resLen = 0;
+        }
+        reply[n++] = op;
+        reply[n++] = (uint8_t)(1 + resLen);
+        reply[n++] = status;
+        memcpy(&reply[n], res, resLen);
+        n   += resLen;
+        pos += argLen;
+    }
+    send_reply(reply, n);
+}
+
+
+
+
+static bool cmd_tables_sorted(void)
+{
+    return cmd_table_sorted(SYS_CMDS, CMD_COUNT(SYS_CMDS)) && cmd_table_sorted(USR_CMDS, CMD_COUNT(USR_CMDS));
+}
+
 
-    static char buf[CMD_BUFFER_SIZE];
-    char        original[CMD_BUFFER_SIZE];
 
-    // 1. Read from control port
-    int32_t n = udp_read(buf, CMD_BUFFER_SIZE);
-    if (n <= 0) return;
 
-    // 2. Ensure null-terminated buffers
-    buf[n] = '\0';
+// Parse and process / execute commands
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Text families, first word of the line
+struct FamilyEntry
+{
+    const char *name;
+    void      (*run)(char **ctx, const char *orig);
+};
+static const FamilyEntry FAMILIES[] =
+{
+    { "spi", handle_SPI },
+    { "sys", handle_SYS },
+    { "usr", handle_USR },
+};
+
+// One text command line (NUL terminated, tokenized in place)
+static void execute_text(char *buf)
+{
+    char original[CMD_BUFFER_SIZE];
     strncpy(original, buf, CMD_BUFFER_SIZE - 1);
     original[CMD_BUFFER_SIZE - 1] = '\0';
 
-    // 3. Tokenize verb
+    // 1. Tokenize verb
     char *ctx = nullptr;
     char *verb = strtok_r(buf, " \r\n", &ctx);
     if (!verb) return;
 
-    // 4. Dispatch to command handler
-    if (!strcasecmp(verb, "spi")) { handle_SPI(&ctx, original); return; }
-    if (!strcasecmp(verb, "sys")) { handle_SYS(&ctx, original); return; }
-    if (!strcasecmp(verb, "usr")) { handle_USR(&ctx, original); return; }
+    // 2. Dispatch to command handler
+    for (size_t i = 0; i < CMD_COUNT(FAMILIES); ++i)
+    {
+        if (!strcasecmp(verb, FAMILIES[i].name))
+        {
+            FAMILIES[i].run(&ctx, original);
+            return;
+        }
+    }
 
-    // 5. Unknown command -> send error
+    // 3. Unknown command -> send error
     send_error("got unknown family, expected (spi|sys|usr)");
-}
\ No newline at end of file
+}
+
+// Reads one message from udp_read(), which pulls from the cmdQue filled by incoming UDP packets via handleRxPacket
+// - If cmdQue is empty, returns false immediately (non-blocking).
+// - If msg_init() has not been called, skips.
+// - Datagram starting with CMD_BIN_MAGIC goes to the binary handler, anything else is a text line.
+//
+// If text, parses the first token (command family: spi, sys, usr)
+// and dispatches to the appropriate handler function.
+// If command family is unknown, sends an error back over UDP.
+//
+// Handles exactly one datagram per call, true if there was one - also an empty one - and false only once the queue is
+// empty (loop() drains the queue with it).
+bool parse_and_execute_command(void)
+{
+    if (!C) return false;  // msg_init() not called
+
+    static CmdMsg msg;
+
+    // 1. Read from control port, an empty datagram is consumed and ignored (the queue may hold more behind it)
+    if (!udp_read(msg)) return false;
+    if (msg.len == 0)   return true;
+
+    // Replies of this one go back where it came from
+    s_replyOrigin = msg.origin;
+    s_replyIp     = msg.ip;
+    s_replyPort   = msg.port;
+
+    // 2. Binary datagram - magic, seq, records
+    if ((msg.len >= 2) && ((uint8_t)msg.data[0] == CMD_BIN_MAGIC))
+    {
+        handle_BIN((const uint8_t *)msg.data, msg.len);
+        return true;
+    }
+
+    // 3. Text line, queue keeps a NUL after the datagram
+    msg.data[msg.len] = '\0';
+    execute_text(msg.data);
+    return true;
+}
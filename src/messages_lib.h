@@ -30,7 +30,7 @@ struct MsgContext
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
 void msg_init(const MsgContext *ctx);         // called from setup()
-void parse_and_execute_command(void);         // called every loop()
+bool parse_and_execute_command(void);         // one queued command, false if none (loop() drains the queue)
 
 
 
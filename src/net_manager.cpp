@@ -7,14 +7,21 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include <esp_err.h>
+#include <lwip/priv/tcpip_priv.h>   // tcpip_api_call, raw lwIP API runs in the tcpip thread only
 #include <net_manager.h>
+#include <stats_lib.h>
 
 
 //  cmdQue is defined in main.cpp.  Bring it into this compilation unit so
 //  handleRxPacket() can push inbound datagrams without a linker error.
 extern QueueHandle_t cmdQue;
+extern TaskHandle_t  cmdTask;       // loop() task, woken when a command is queued
 extern Debugger      Debug; 
 
+// Stream config reported in the probe reply (main.cpp)
+extern volatile uint32_t g_selectSamplingFreq;
+extern volatile uint32_t g_framesPerPacket;
+
 
 // Wi-Fi event handler - plain C function pointer (no captures)
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -72,12 +79,22 @@ void NetManager::onWifiEvent(WiFiEvent_t event)
         uint32_t timeDelta = safeTimeDelta(now, _lastRxMs);
 
         Debug.log("EVENT DISCONNECTED  rxΔ=%lu", timeDelta);
+        if (_state == LinkState::STREAMING)
+        {
+            _resumeStream = true;              // PC still wants data, keep the session across the reconnect
+            _replayFromMs = now;               // first drop only, failed reconnect attempts come here again
+        }
         _state      = LinkState::DISCONNECTED; // stop sending right now
         _peerFound  = false;                   // force beacon handshake
         _lastFailMs = now;
         _reconnPend = true;
         _giveUp     = false;
 
+        // First try goes straight to the AP we had (no scan), if that fails scan, then directed again and so on
+        _fastPend   = _linkValid && !_fastPend;
+        _connectMs  = now;
+        connectTarget(_fastPend);
+
         esp_err_t rc = esp_wifi_connect();      // async, non-blocking
         if (rc == ESP_ERR_WIFI_STATE)
         {
@@ -87,10 +104,25 @@ void NetManager::onWifiEvent(WiFiEvent_t event)
     }
     else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
     {
-        Debug.print("EVENT GOT_IP  reconnect OK");
+        Debug.log("EVENT GOT_IP  reconnect OK, %s connect in %lu ms", _fastPend ? "directed" : "scan",
+                  safeTimeDelta(millis(), _connectMs));
         _localIP    = WiFi.localIP();
         _reconnPend = false;
         _giveUp     = false;
+        _fastPend   = false;
+        rememberLink();
+
+        // Dropped while streaming - same PC, no new handshake. Watchdog still stops it if the PC doesn't
+        // talk within _timeoutMs, e.g. when it got another address meanwhile.
+        if (_resumeStream)
+        {
+            _resumeStream = false;
+            _replayPend   = true;
+            _peerFound    = true;
+            _lastRxMs     = millis();
+            _state        = LinkState::STREAMING;
+            Debug.print("[CONNECT EVENT] streaming resumed, backfill replay");
+        }
         _lastFailMs = 0;
 
         Debug.log("[CONNECT EVENT] localIP      : %s",  _localIP.toString().c_str());
@@ -111,7 +143,7 @@ void NetManager::onWifiEvent(WiFiEvent_t event)
 // 2. Initialize WiFi at minimum TX power to prevent over-saturation
 // 3. Start connection and increase to operational TX power
 // 4. Remember ports & peer IP
-// 5. Open the existing WiFiUDP socket for TX
+// 5. Open the WiFiUDP socket (control TX) and the lwIP PCB (data TX)
 // 6. Start an AsyncUDP listener for RX. This is event-driven, so the CPU
 //    sleeps until a packet arrives - there is no polling overhead.
 void NetManager::begin(const char* ssid,
@@ -126,12 +158,22 @@ void NetManager::begin(const char* ssid,
     WiFi.onEvent(wifiEventCb); // register static handler
 
     // 2. Initialize WiFi at minimum TX power to prevent over-saturation
+    // Connect settings live in our NVS (NetConfig), IDF doesn't need to write its own copy on every set_config
+    WiFi.persistent(false);
     WiFi.mode(WIFI_MODE_STA); // station-only; turns off the soft-AP
     WiFi.setTxPower(WIFI_POWER_2dBm);  // Start at absolute minimum
     Debug.log("[WIFI] Initialized at 2 dBm TX power to prevent over-saturation");
     
     // 3. Start connection and increase to operational TX power
-    WiFi.begin(ssid, pass);
+    // Straight to the AP of the last connect when there is one, cold scan otherwise (see NetLink)
+    _ssid      = ssid;
+    _linkValid = NetConfig().loadLink(_ssid, _link);
+    _fastPend  = _linkValid;
+    _connectMs = millis();
+    if (_linkValid && _link.staticIp && _link.ip)
+        WiFi.config(IPAddress(_link.ip), IPAddress(_link.gateway), IPAddress(_link.subnet), IPAddress(_link.dns));
+    WiFi.begin(ssid, pass, _linkValid ? _link.channel : 0, _linkValid ? _link.bssid : nullptr);
+    Debug.log("[WIFI] %s connect", _linkValid ? "directed" : "scan");
     
     // Immediately increase power for actual communication
     // WiFi hardware is now initialized safely, increase power for connection
@@ -142,8 +184,10 @@ void NetManager::begin(const char* ssid,
     _localPortCtrl  = localPortCtrl;
     _remotePortData = remotePortData;
 
-    // 5. Outbound socket
+    // 5. Outbound sockets, control via WiFiUDP, data via a raw lwIP PCB (retried in sendData if this fails)
     _udp.begin(0);
+    netTxOpen(_txPcb);
+    _mcastGroup = NetConfig().loadMulticast();
 
     // 6. Inbound socket - zero-poll AsyncUDP
     _asyncRx.listen(localPortCtrl);
@@ -159,31 +203,140 @@ void NetManager::begin(const char* ssid,
 // Send
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
-void NetManager::sendCtrl(const void* data, size_t len)
+// Data datagrams skip WiFiUDP (copy into its TX buffer, a socket message, then a separately allocated header pbuf
+// chained in front) and go to a raw lwIP UDP PCB connected to the PC. The datagram buffer becomes a custom pbuf with
+// the headers written into NetTxHead::room, so nothing is allocated per datagram.
+// Raw API is tcpip-thread only, the send is handed over with tcpip_api_call like AsyncUDP does and the sender waits
+// for it. When it returns lwIP is normally done with the buffer, the Wi-Fi driver has copied the frame.
+static_assert(LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT) <= NET_TX_HEADROOM, "NET_TX_HEADROOM too small for the lwIP headers");
+static_assert((sizeof(NetTxHead) % 4u) == 0u, "datagram right after NetTxHead must stay word aligned");
+
+struct NetTxCall
+{
+    struct tcpip_api_call_data call;   // must be first, lwIP hands this pointer back
+    udp_pcb   * pcb;
+    NetTxHead * tx;
+    uint16_t    len;
+    uint16_t    port;
+    uint32_t    numDst;
+    ip_addr_t   dst[WIFI_MAX_PEERS];   // subscribers, or just the multicast group
+    err_t       err;
+};
+
+// custom_free_function - lwIP dropped its last reference to the datagram
+static void netTxFree(struct pbuf * p)
+{
+    reinterpret_cast<NetTxHead*>(p)->inFlight = 0u;   // pbuf is the first member of NetTxHead
+}
+
+static err_t netTxOpenCall(struct tcpip_api_call_data * call)
+{
+    NetTxCall * m = reinterpret_cast<NetTxCall*>(call);
+    m->pcb = udp_new();
+    m->err = m->pcb ? udp_bind(m->pcb, IP_ADDR_ANY, 0) : ERR_MEM;
+    if (m->pcb && m->err != ERR_OK) { udp_remove(m->pcb); m->pcb = nullptr; }
+#if LWIP_MULTICAST_TX_OPTIONS
+    if (m->pcb) udp_set_multicast_ttl(m->pcb, 1);   // multicast data stays on the local network
+#endif
+    return m->err;
+}
+
+static err_t netTxSendCall(struct tcpip_api_call_data * call)
+{
+    NetTxCall *    m    = reinterpret_cast<NetTxCall*>(call);
+    const uint16_t room = LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT);
+    m->err = ERR_OK;
+
+    // Same datagram to every destination, pbuf is set up again each time because lwIP leaves the headers of the
+    // previous send in it. Same layout as a PBUF_RAM pbuf: struct, then the header room, then the payload.
+    // DATA_VOLATILE on top so ARP copies the frame if it has to queue it (unresolved PC MAC) instead of holding
+    // our buffer.
+    for (uint32_t i = 0; i < m->numDst; i++)
+    {
+        m->tx->pbuf.custom_free_function = netTxFree;
+        m->tx->inFlight = 1u;
+        struct pbuf * p = pbuf_alloced_custom(PBUF_TRANSPORT, m->len, PBUF_RAM, &m->tx->pbuf,
+                                              netTxData(*m->tx) - room, (uint16_t)(room + m->len));
+        if (!p) { m->tx->inFlight = 0u; return m->err = ERR_VAL; }
+        p->type_internal |= PBUF_TYPE_FLAG_DATA_VOLATILE;
+
+        const err_t err = udp_sendto(m->pcb, p, &m->dst[i], m->port);
+        pbuf_free(p);
+        if (err != ERR_OK && m->err != ERR_MEM) m->err = err;   // ERR_MEM wins, it means back off
+
+        // Held by the stack, can't be set up again for the peers left - they miss this datagram, report it as
+        // ERR_MEM (udp_busy) so the sender backs off instead of counting it as sent
+        if (m->tx->inFlight)
+        {
+            if (i + 1u < m->numDst) m->err = ERR_MEM;
+            break;
+        }
+    }
+    return m->err;
+}
+
+// netTxOpen - new PCB on an ephemeral port, sendData gives the destination of every datagram
+static bool netTxOpen(udp_pcb * & pcb)
+{
+    NetTxCall m;
+    m.pcb = nullptr;
+    tcpip_api_call(netTxOpenCall, &m.call);
+    pcb = m.pcb;
+    return pcb != nullptr;
+}
+
+void NetManager::sendCtrl(uint32_t ip, uint16_t port, const void* data, size_t len)
 {
     // Tiny guard - avoid building an empty UDP packet.
     if (len == 0) return;
-    _udp.beginPacket(_remoteIP, _localPortCtrl); // use control port
+    _udp.beginPacket(IPAddress(ip), port);
     _udp.write(static_cast<const uint8_t*>(data), len);
     _udp.endPacket();
 }
-void NetManager::sendData(const void* data, size_t len)
+bool NetManager::sendData(NetTxHead & tx, size_t len)
 {
     // Tiny guard - avoid building an empty UDP packet.
-    if (_state != LinkState::STREAMING || len == 0) return;
-    _udp.beginPacket(_remoteIP, _remotePortData); // use data port
-    _udp.write(static_cast<const uint8_t*>(data), len);
-    _udp.endPacket();
-    Debug.log("sendData: %u B", (unsigned)len);   
+    if (_state != LinkState::STREAMING || len == 0) return true;
 
-    if (_udp.getWriteError())
+    // Last datagram of this buffer is still queued by reference somewhere in the stack (doesn't happen with the
+    // copying Wi-Fi driver of the C3), head can't be reused until lwIP lets it go
+    if (tx.inFlight || (!_txPcb && !netTxOpen(_txPcb)))
     {
-        Debug.print("sendData: UDP WRITE-ERR");
+        g_stats.udpBusy++;
+        return false;
+    }
 
-        // Clear UDP write-error flag after logging, or the next call will always
-        // return the same error until a successful packet:
-        _udp.clearWriteError();
+    NetTxCall m;
+    m.pcb    = _txPcb;
+    m.tx     = &tx;
+    m.len    = (uint16_t)len;
+    m.port   = _remotePortData;
+    m.numDst = 0;
+    const uint32_t group = _mcastGroup;
+    if (group)
+    {
+        ip_addr_set_ip4_u32(&m.dst[0], group);
+        m.numDst = 1;
+    }
+    else
+    {
+        portENTER_CRITICAL(&_peerMux);
+        for (uint32_t i = 0; i < _numPeers; i++)
+            ip_addr_set_ip4_u32(&m.dst[m.numDst++], (uint32_t)_peers[i].ip);
+        portEXIT_CRITICAL(&_peerMux);
     }
+    if (m.numDst == 0) return true;
+    tcpip_api_call(netTxSendCall, &m.call);
+    Debug.log("sendData: %u B", (unsigned)len);
+
+    if (m.err == ERR_OK) return true;
+
+    // ERR_MEM - Wi-Fi TX queue or lwIP pool full, the sender backs off. Anything else (no route while
+    // Wi-Fi reconnects, ...) is an error.
+    if (m.err == ERR_MEM) g_stats.udpBusy++;
+    else                  g_stats.udpErrors++;
+    Debug.log("sendData: lwIP err %d", (int)m.err);
+    return false;
 }
 
 
@@ -236,7 +389,10 @@ void NetManager::update(void)
         xQueueReset(cmdQue);            // clear stale commands
     }
 
-    // 2.1. Wi-Fi reconnect watchdog - fail-safe if >1 min
+    // 2.1. Subscribers that stopped their keep-alive, the last one goes through the silence guard above
+    if (_peerFound) expirePeers(now);
+
+    // 2.2. Wi-Fi reconnect watchdog - fail-safe if >1 min
     if (_reconnPend && (safeTimeDelta(now, _lastFailMs) > WIFI_RECONNECT_GIVEUP_MS))
     {
         Debug.print("FAILSAFE TIMER: reconnect >1 min");
@@ -310,14 +466,21 @@ void NetManager::handleRxPacket(AsyncUDPPacket& packet)
     if ((packet.length() == WIFI_KEEPALIVE_WORD_LEN) &&
         (memcmp(packet.data(), WIFI_KEEPALIVE_WORD, WIFI_KEEPALIVE_WORD_LEN) == 0))
     {
-        if (!_peerFound)
+        const bool first = !_peerFound;
+        if (!touchPeer(packet.remoteIP(), true))
         {
-            // DISCOVERY: First WOOF_WOOF - capture IP
+            Debug.log("WOOF_WOOF from %s ignored - %u subscribers already", packet.remoteIP().toString().c_str(),
+                      (unsigned)WIFI_MAX_PEERS);
+            return;
+        }
+        if (first)
+        {
+            // DISCOVERY: First WOOF_WOOF - capture IP, replies go there until another PC sends a command
             _remoteIP = packet.remoteIP();
             _peerFound = true;
             Debug.log("PC discovered at %s", _remoteIP.toString().c_str());
         }
-        // else: Already discovered - just keepalive, don't touch IP
+        // else: keep-alive, or one more subscriber
         
         _lastRxMs = millis();
         
@@ -326,34 +489,207 @@ void NetManager::handleRxPacket(AsyncUDPPacket& packet)
         return;
     }
 
-    // 2. If peer not found yet, reject everything else
+    // 2. PC probe "MEOW_PROBE ..." - answer at once, unicast to the prober (it may not be our peer)
+    if ((packet.length() >= WIFI_PROBE_WORD_LEN) &&
+        (memcmp(packet.data(), WIFI_PROBE_WORD, WIFI_PROBE_WORD_LEN) == 0))
+    {
+        answerProbe(packet);
+        return;
+    }
+
+    // 3. If peer not found yet, reject everything else
     if (!_peerFound)
     {
         Debug.log("RX dropped - waiting for WOOF_WOOF discovery");
         return;
     }
 
-    // 3. Over-sized packet protection
+    // 3a. Broadcast command (PC starts several boards with one "sys start_cnt") - only from our subscribers,
+    //     so boards that stream to another PC, or to nobody, are not started by it
+    if (packet.isBroadcast() && !touchPeer(packet.remoteIP(), false))
+    {
+        Debug.log("RX broadcast from %s dropped - not a subscriber", packet.remoteIP().toString().c_str());
+        return;
+    }
+
+    // 4. Over-sized packet protection
     if (packet.length() > CMD_BUFFER_SIZE - 1)
     {
         Debug.log("RX oversize: %u B dropped", (unsigned)packet.length());
         return;
     }
     
-    // 4. Queue command
-    static char rxBuf[CMD_BUFFER_SIZE];
-    size_t n = packet.length();
-    memcpy(rxBuf, packet.data(), n);
-    rxBuf[n] = '\0';
+    // 5. Queue command, its reply goes back to whoever sent it
+    static CmdMsg rxMsg;
+    rxMsg.len    = (uint16_t)packet.length();
+    rxMsg.origin = CMD_ORIGIN_NET;
+    rxMsg.ip     = (uint32_t)packet.remoteIP();
+    rxMsg.port   = packet.remotePort();
+    memcpy(rxMsg.data, packet.data(), rxMsg.len);
+    rxMsg.data[rxMsg.len] = '\0';
+    _remoteIP = packet.remoteIP();
 
     // Try to enqueue; if the queue is full we drop this packet.
-    xQueueSend(cmdQue, rxBuf, 0);
-    Debug.print("RX cmd queued");
+    if (xQueueSend(cmdQue, &rxMsg, 0) != pdTRUE)
+    {
+        g_stats.cmdDropped++;
+        Debug.print("RX cmd dropped - queue full");
+    }
+    else
+    {
+        stats_max(g_stats.cmdHwm, uxQueueMessagesWaiting(cmdQue));
+        if (cmdTask) xTaskNotifyGive(cmdTask);   // run it now, not at the next loop() tick
+        Debug.print("RX cmd queued");
+    }
 
-    // 5. Update watchdog
+    // 6. Update watchdog, a command counts as keep-alive of its subscriber
+    touchPeer(packet.remoteIP(), false);
     _lastRxMs = millis();
 }
 
+// touchPeer() - keep-alive of a subscriber, join = add it if it isn't one yet and there is room
+// First join after the peer was lost (_peerFound false) starts a new table.
+bool NetManager::touchPeer(const IPAddress &ip, bool join)
+{
+    const uint32_t now   = millis();
+    bool           found = false;
+
+    portENTER_CRITICAL(&_peerMux);
+    if (join && !_peerFound) _numPeers = 0;
+    for (uint32_t i = 0; i < _numPeers; i++)
+    {
+        if (_peers[i].ip == ip)
+        {
+            _peers[i].lastRxMs = now;
+            found = true;
+            break;
+        }
+    }
+    if (!found && join && (_numPeers < WIFI_MAX_PEERS))
+    {
+        _peers[_numPeers].ip       = ip;
+        _peers[_numPeers].lastRxMs = now;
+        _numPeers++;
+        found = true;
+    }
+    portEXIT_CRITICAL(&_peerMux);
+    return found;
+}
+
+// expirePeers() - drop subscribers silent for more than _timeoutMs. The last one stays, losing it is the
+// silence guard's job (stream stop, beacons). Replies go to the first one left if their PC was dropped.
+void NetManager::expirePeers(uint32_t now)
+{
+    uint32_t kept     = 0;
+    bool     ctrlKept = false;
+
+    portENTER_CRITICAL(&_peerMux);
+    const uint32_t numPeers = _numPeers;
+    for (uint32_t i = 0; i < numPeers; i++)
+    {
+        const bool stale = safeTimeDelta(now, _peers[i].lastRxMs) > _timeoutMs;
+        const bool last  = (kept == 0) && (i + 1 == numPeers);
+        if (stale && !last) continue;
+        ctrlKept |= (_peers[i].ip == _remoteIP);
+        _peers[kept++] = _peers[i];
+    }
+    _numPeers = kept;
+    if (!ctrlKept && kept) _remoteIP = _peers[0].ip;
+    portEXIT_CRITICAL(&_peerMux);
+
+    if (kept != numPeers) Debug.log("PEERS: %u silent subscriber(s) dropped, %u left", (unsigned)(numPeers - kept), (unsigned)kept);
+}
+
+// peers() - copy of the subscriber table
+uint32_t NetManager::peers(IPAddress * out, uint32_t max)
+{
+    uint32_t n = 0;
+    portENTER_CRITICAL(&_peerMux);
+    if (_peerFound)
+        for (; (n < _numPeers) && (n < max); n++) out[n] = _peers[n].ip;
+    portEXIT_CRITICAL(&_peerMux);
+    return n;
+}
+
+// answerProbe() - MEOW_HERE reply to a MEOW_PROBE (format in defines.h)
+// Runs in the AsyncUDP callback, the reply goes out through the same pcb straight to the probe's source address,
+// so the sender task's WiFiUDP is not touched.
+void NetManager::answerProbe(AsyncUDPPacket& packet)
+{
+    static const char * const STATE_NAME[] = { "disc", "idle", "stream" };
+
+    const bool     peer  = _peerFound;
+    const uint32_t group = _mcastGroup;
+    char           msg[256];
+    const int      n = snprintf(msg, sizeof(msg),
+        WIFI_PROBE_REPLY " id=%s fw=%u fmt=%u ctrl=%u data=%u fs=%u fpp=%u decim=%u compress=%u fec=%u state=%s peer=%s"
+        " peers=%u mcast=%s ch=%u",
+        WiFi.macAddress().c_str(), (unsigned)FIRMWARE_VERSION, (unsigned)PACKET_FORMAT_VERSION,
+        (unsigned)_localPortCtrl, (unsigned)_remotePortData, (unsigned)(250u << g_selectSamplingFreq),
+        (unsigned)g_framesPerPacket, (unsigned)(1u << g_decimationLog2), (unsigned)g_compressStream,
+        (unsigned)g_fecStream, STATE_NAME[(uint8_t)_state], peer ? _remoteIP.toString().c_str() : "none",
+        (unsigned)(peer ? _numPeers : 0u), group ? IPAddress(group).toString().c_str() : "none",
+        (unsigned)NUMBER_OF_ADC_CHANNELS);
+    if (n > 0) packet.write((const uint8_t*)msg, ((size_t)n < sizeof(msg)) ? (size_t)n : sizeof(msg) - 1);
+    Debug.log("PROBE from %s answered", packet.remoteIP().toString().c_str());
+}
+
+// connectTarget() - what the next esp_wifi_connect() does
+// Directed: BSSID and channel of _link, IDF probes that one channel only and skips the full scan.
+// Scan: any AP with our SSID on any channel. Cached lease as static IP only goes with a directed connect,
+// after a scan we may be on another network and want DHCP.
+void NetManager::connectTarget(bool directed)
+{
+    wifi_config_t cfg;
+    if (esp_wifi_get_config(WIFI_IF_STA, &cfg) != ESP_OK) return;
+    cfg.sta.bssid_set = directed;
+    cfg.sta.channel   = directed ? _link.channel : 0;
+    if (directed) memcpy(cfg.sta.bssid, _link.bssid, sizeof(cfg.sta.bssid));
+    esp_wifi_set_config(WIFI_IF_STA, &cfg);
+
+    if (_link.staticIp && _link.ip)
+    {
+        if (directed) WiFi.config(IPAddress(_link.ip), IPAddress(_link.gateway), IPAddress(_link.subnet), IPAddress(_link.dns));
+        else          WiFi.config(IPAddress(), IPAddress(), IPAddress()); // 0.0.0.0 - DHCP again
+    }
+}
+
+// rememberLink() - AP and lease we got now, for the next boot and reconnect
+// NVS write stalls flash (and everything not in IRAM) for a few ms, so only when something changed - a new
+// AP, channel or lease. Usually that's the first connect after a move and never again.
+void NetManager::rememberLink(void)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) return;
+
+    NetLink now   = _link;     // keeps staticIp
+    memcpy(now.bssid, ap.bssid, sizeof(now.bssid));
+    now.channel   = ap.primary;
+    now.ip        = WiFi.localIP();
+    now.gateway   = WiFi.gatewayIP();
+    now.subnet    = WiFi.subnetMask();
+    now.dns       = WiFi.dnsIP();
+
+    const bool changed = !_linkValid || memcmp(now.bssid, _link.bssid, sizeof(now.bssid)) ||
+                         (now.channel != _link.channel) || (now.ip != _link.ip) || (now.gateway != _link.gateway) ||
+                         (now.subnet != _link.subnet) || (now.dns != _link.dns);
+    _link      = now;
+    _linkValid = true;
+    if (!changed) return;
+
+    NetConfig().saveLink(_ssid, _link);
+    Debug.log("[WIFI] cached AP %02x:%02x:%02x:%02x:%02x:%02x channel %u", now.bssid[0], now.bssid[1],
+              now.bssid[2], now.bssid[3], now.bssid[4], now.bssid[5], (unsigned)now.channel);
+}
+
+bool NetManager::takeReplay(uint32_t &fromMs)
+{
+    if (!_replayPend) return false;
+    _replayPend = false;
+    fromMs      = _replayFromMs;
+    return true;
+}
+
 void NetManager::failSafe(void)
 {
     Debug.print("FAILSAFE: giving up, radio off");
@@ -363,6 +699,7 @@ void NetManager::failSafe(void)
 
     _giveUp     = true;                  // LED shows LOST state
     _reconnPend = false;
+    _resumeStream = false;
     _peerFound  = false;
     _state      = LinkState::DISCONNECTED;
     _lastBeaconMs = 0;
@@ -12,12 +12,64 @@
 #include <WiFiUdp.h>
 #include <esp_wifi.h>           // deep power-save
 #include <AsyncUDP.h>      // Arduino wrapper - NO extra libs to install
+#include <lwip/pbuf.h>          // data TX path, see NetTxHead
+#include <lwip/udp.h>
 #include "defines.h"            // SSID, UDP_IP, UDP_PORT_PC, UDP_PORT_C3
 #include "helpers.h"
 
 
 
 
+// Data send buffer
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Every data datagram is sent from a buffer that starts with NetTxHead. The head is the lwIP custom pbuf describing
+// the datagram plus room for the UDP / IP / Ethernet headers in front of it, so lwIP sends the datagram straight
+// from here - no pbuf allocation and no copy in the stack, the Wi-Fi driver's copy into its DMA buffer is the only one.
+// Datagram must be right after the head, use NetTxBuffer or a struct with the same layout (PacketSlot in main.cpp).
+constexpr size_t NET_TX_HEADROOM = 64;  // >= LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT), checked in net_manager.cpp
+
+struct NetTxHead
+{
+    struct pbuf_custom pbuf;                  // must be first, lwIP frees it through pbuf->custom_free_function
+    volatile uint32_t  inFlight;              // stack still references the datagram, buffer can't be sent again
+    uint8_t            room[NET_TX_HEADROOM]; // protocol headers are written here
+};
+
+template <size_t N>
+struct NetTxBuffer
+{
+    NetTxHead tx;
+    uint8_t   data[N];
+};
+
+// Datagram of a send buffer
+static inline uint8_t * netTxData(NetTxHead & tx) { return reinterpret_cast<uint8_t*>(&tx + 1); }
+
+
+
+
+// Command queue item
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// One control datagram in cmdQue. Length travels with it, binary commands (CMD_BIN_MAGIC) may contain zeros.
+// Origin tells where the reply goes: the PC that sent it over UDP (its address travels with the command, several
+// subscribers may have commands queued at once), or back over USB (usb_link.h).
+constexpr uint8_t CMD_ORIGIN_NET = 0;
+constexpr uint8_t CMD_ORIGIN_USB = 1;
+
+struct CmdMsg
+{
+    uint16_t len;
+    uint8_t  origin;                  // CMD_ORIGIN_*
+    uint16_t port;                    // CMD_ORIGIN_NET: sender IP and port, the reply goes there
+    uint32_t ip;
+    char     data[CMD_BUFFER_SIZE];   // NUL after len bytes
+};
+
+
+
+
 // Class
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -28,10 +80,15 @@
 // 2. PC responds with "WOOF_WOOF" packet
 // 3. ESP32 extracts PC's IP from the packet source
 // 4. Connection established - no manual IP configuration needed
+// More PCs can join with their own WOOF_WOOF (up to WIFI_MAX_PEERS), all of them get the data stream, see defines.h.
+// PC doesn't have to wait for the beacon: a "MEOW_PROBE" broadcast is answered at once with "MEOW_HERE" and the
+// board's ID and stream config (see defines.h), then PC sends WOOF_WOOF to the board it picked.
 //
 // The system also handles:
 // - Keep-alive packets ("woof woof" every <10s from PC)
-// - Automatic reconnection on WiFi drops
+// - Automatic reconnection on WiFi drops, streaming resumes to the same PC afterwards (backfill replay)
+// - Directed connect to the AP of the last successful connect (BSSID + channel from NetConfig, no scan),
+//   a full scan only if that fails. Optionally its DHCP lease as static IP (sys fast_ip_on)
 // - State management (DISCONNECTED -> IDLE -> STREAMING)
 class NetManager
 {
@@ -43,8 +100,12 @@ public:
                uint16_t    remotePortData);
 
     // Non-blocking send.
-    void sendCtrl(const void* data, size_t len);
-    void sendData(const void* data, size_t len);
+    // sendData sends the datagram of tx (see NetTxHead) to the data port of every subscriber, or of the multicast
+    // group. sendCtrl sends a control reply to the address the command came from (CmdMsg ip / port). sendData returns
+    // false if it didn't go out: Wi-Fi / lwIP buffers full (ERR_MEM, sys stats udp_busy) - back off, or any other stack
+    // error (udp_err).
+    void sendCtrl(uint32_t ip, uint16_t port, const void* data, size_t len);
+    bool sendData(NetTxHead & tx, size_t len);
 
     // Call every loop() iteration; handles 1 s beacon when no peer yet.
     void update(void);
@@ -59,13 +120,32 @@ public:
 
     // called from message handlers
     inline void startStream() { _state = LinkState::STREAMING;  }
-    inline void stopStream () { _state = _peerFound ? LinkState::IDLE
+    inline void stopStream () { _resumeStream = false;
+                                _state = _peerFound ? LinkState::IDLE
                                                     : LinkState::DISCONNECTED; }
 
     // sender and LED use this
     inline bool wantStream() const noexcept
     { return _state == LinkState::STREAMING; }
 
+    // Streaming, or Wi-Fi dropped while streaming and reconnect is in progress. Sender keeps numbering
+    // and storing datagrams meanwhile (sendData skips them), they are replayed once the link is back.
+    inline bool streamSession() const noexcept
+    { return (_state == LinkState::STREAMING) || _resumeStream; }
+
+    // True once per reconnect that resumed streaming, fromMs = millis() when Wi-Fi dropped
+    bool takeReplay(uint32_t &fromMs);
+
+    // sys fast_ip_on / fast_ip_off, NVS is written by the caller, this is for the next connect
+    inline void setStaticIp(bool on) { _link.staticIp = on; }
+
+    // sys multicast <group> / multicast_off, NVS is written by the caller, applies from the next datagram
+    inline void     setMulticast(uint32_t group) { _mcastGroup = group; }
+    inline uint32_t multicast() const            { return _mcastGroup; }
+
+    // Subscribers right now, for sys peers
+    uint32_t peers(IPAddress * out, uint32_t max);
+
     enum class LedMode : uint8_t { DISC, IDLE, STRM, LOST }; // fail-safe blink
     inline LedMode ledMode() const noexcept
     {
@@ -92,7 +172,7 @@ public:
 
 private:
     WiFiUDP   _udp;
-    IPAddress _remoteIP;             // auto-discovered via WOOF_WOOF beacon
+    IPAddress _remoteIP;             // auto-discovered via WOOF_WOOF beacon, then the PC of the last command (status)
     IPAddress _localIP{INADDR_NONE}; // our own STA IP
     uint16_t  _localPortCtrl;        // port we listen for commands on (was _localPort)
     uint16_t  _remotePortData;       // port we send fast data to
@@ -107,19 +187,52 @@ private:
     volatile bool      _peerFound   = false;
     volatile bool      _reconnPend  = false; // reconnect attempt in progress
     volatile bool      _giveUp      = false; // set by failSafe()
+    volatile bool      _resumeStream = false; // Wi-Fi dropped while STREAMING, resume on GOT_IP
+    volatile bool      _replayPend  = false; // resumed, sender hasn't started the replay yet
+    volatile uint32_t  _replayFromMs = 0;    // millis() when streaming was cut by the drop
 
     void failSafe(void);            // called after timeout
 
+    // Fast (re)connect, see NetLink in helpers.h
+    String             _ssid;
+    NetLink            _link;
+    bool               _linkValid   = false; // _link holds an AP to connect to directly
+    volatile bool      _fastPend    = false; // directed connect in progress, scan if it fails
+    volatile uint32_t  _connectMs   = 0;     // millis() the connect attempt began, for the log
+
+    void connectTarget(bool directed); // directed to _link, or scan for the SSID
+    void rememberLink(void);           // on GOT_IP, NVS only if AP or lease changed
+
     bool      _dbgActive   = false; // true while link is streaming
 
+    // Data TX - raw lwIP UDP PCB, see sendData
+    udp_pcb * _txPcb  = nullptr;
+
+    // Data subscribers. Written by the AsyncUDP callback (join, keep-alive) and update() (expiry), read by the
+    // sender task, so every access is under _peerMux. Table is only valid while _peerFound, it survives a Wi-Fi
+    // drop together with the stream, the first WOOF_WOOF after the peer was lost starts a new one.
+    struct NetPeer
+    {
+        IPAddress ip;
+        uint32_t  lastRxMs;          // its own keep-alive
+    };
+    NetPeer           _peers[WIFI_MAX_PEERS];
+    uint32_t          _numPeers   = 0;
+    portMUX_TYPE      _peerMux    = portMUX_INITIALIZER_UNLOCKED;
+    volatile uint32_t _mcastGroup = 0; // data to this group (IPAddress as uint32_t) instead of the subscribers, 0 = off
+
+    bool touchPeer(const IPAddress &ip, bool join); // refresh keep-alive, join = add if new. True if subscribed
+    void expirePeers(uint32_t now);                 // drop silent subscribers, the last one is left to the watchdog
+
     // RAW-LATENCY, ZERO-POLL UDP **RECEIVE** PATH
     // -------------------------------------------------------------------------------------------
     // -------------------------------------------------------------------------------------------
-    // We keep WiFiUDP for the TX side (unchanged) and add a second socket that is
+    // We keep WiFiUDP for control TX and beacons (data goes through _txPcb) and add a second socket that is
     // event-driven.  AsyncUDP sits on top of lwIP inside the Arduino-ESP32 core
     // and fires an onPacket() callback only when a datagram is ready.
     AsyncUDP   _asyncRx;                         // listen-only socket
     void       handleRxPacket(AsyncUDPPacket&);  // member handler (not static)
+    void       answerProbe(AsyncUDPPacket&);     // MEOW_PROBE -> MEOW_HERE
 };
 
 #endif // NET_MANAGER_H
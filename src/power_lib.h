@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef POWER_LIB_H
+#define POWER_LIB_H
+
+#include <stdint.h>
+#include <string.h>
+#include <Arduino.h>
+#include <esp_pm.h>
+#include <esp_idf_version.h>
+#include <defines.h>
+#include <stats_lib.h>
+
+
+
+
+// LOAD-AWARE CPU CLOCK (sys power_auto | power_max | light_sleep_on | light_sleep_off)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// 160 MHz is what 4000 Hz with every filter needs, most sessions run at 250 - 500 Hz where the core idles nearly all the
+// time. ADC and sender task keep an average of the CPU cycles they spend per ADC frame (cycles don't depend on the clock,
+// so a load measured at 160 MHz tells what it would be at 80). Once per main loop power_update() picks the lowest clock
+// the stream fits into, see PM_* in defines.h. Frames lost (DRDY missed, packets dropped, DMA timeouts) while running at
+// the low clock pin it back to the high one until rate or filters change.
+//
+// Build with power management (CONFIG_PM_ENABLE) - ESP-IDF DFS: CPU runs at the picked clock only while the ADC or the
+// sender task holds the CPU_FREQ_MAX lock (power_busy / power_idle), at 80 MHz otherwise. With light_sleep_on the board
+// also light-sleeps between Wi-Fi beacons while it's not streaming (needs tickless idle in the build). USB serial is
+// gone while it sleeps, so it's off by default. While streaming there is no light sleep at all: DRDY comes every
+// 0.25 - 4 ms, wake-up from light sleep takes about as long, and the DRDY edge interrupt can't be a light-sleep wake
+// source without turning it into a level interrupt.
+// Build without it (prebuilt Arduino core) - same logic through setCpuFrequencyMhz(), locks do nothing.
+//
+// Cycle counter runs at the CPU clock, so g_stats.cpuMhz follows the picked clock (timed code runs at it, see above).
+
+constexpr uint32_t POWER_AUTO = 0;   // clock from the measured load (default)
+constexpr uint32_t POWER_MAX  = 1;   // always PM_CPU_MHZ_HIGH, as before the power manager
+
+struct PowerState
+{
+    esp_pm_lock_handle_t lock;           // CPU_FREQ_MAX while a streaming task works, nullptr - no DFS in this build
+    volatile uint32_t    mode;           // POWER_AUTO / POWER_MAX
+    volatile bool        lightSleep;     // sys light_sleep_on - light sleep while not streaming
+    bool                 sleeping;       // light sleep is configured right now
+    uint32_t             cpuMhz;         // clock picked now, 0 - not set yet
+    uint32_t             loadKey;        // rate / filters / decimation / features the load is measured for
+    uint32_t             settleMs;       // millis() of the last load key change
+    uint32_t             lostSeen;       // lost frame counters last time
+    bool                 pinned;         // frames lost at the low clock -> high clock until the load key changes
+    volatile uint32_t    adcCycles;      // average ADC task cycles per frame (SPI start, preambles, packing)
+    volatile uint32_t    sendCycles;     // average sender task cycles per ADC frame (DSP, features, sending)
+};
+
+extern PowerState g_power;           // main.cpp
+
+// power_busy / power_idle - around the work of a streaming task, full clock while it runs
+static inline void power_busy(PowerState & p) { if (p.lock) esp_pm_lock_acquire(p.lock); }
+static inline void power_idle(PowerState & p) { if (p.lock) esp_pm_lock_release(p.lock); }
+
+// power_noteLoad - one measurement into an average, one writer per average
+static inline void power_noteLoad(volatile uint32_t & avg   ,
+                                  const uint32_t      cycles)
+{
+    const uint32_t a = avg;
+    avg = a + (uint32_t)(((int32_t)cycles - (int32_t)a) >> PM_LOAD_SHIFT);
+}
+
+// power_loadPct - % of the given clock the stream takes at fsHz
+static inline uint32_t power_loadPct(const PowerState & p     ,
+                                     const uint32_t     fsHz  ,
+                                     const uint32_t     cpuMhz)
+{
+    const uint64_t cyclesPerS = (uint64_t)(p.adcCycles + p.sendCycles) * fsHz;
+    return (uint32_t)(cyclesPerS * 100u / ((uint64_t)cpuMhz * 1000000u));
+}
+
+// power_apply - switch clock (and light sleep) if it's not what runs already
+// Returns false if power management refused light sleep, clock is set anyway.
+static inline bool power_apply(PowerState &   p     ,
+                               const uint32_t cpuMhz,
+                               const bool     sleep )
+{
+    if ((cpuMhz == p.cpuMhz) && (sleep == p.sleeping)) return true;
+
+    bool ok = true;
+    if (p.lock)
+    {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+        esp_pm_config_t cfg = {};
+#else
+        esp_pm_config_esp32c3_t cfg = {};
+#endif
+        cfg.max_freq_mhz       = (int)cpuMhz;
+        cfg.min_freq_mhz       = PM_CPU_MHZ_LOW;
+        cfg.light_sleep_enable = sleep;
+        if (esp_pm_configure(&cfg) != ESP_OK)
+        {
+            // No tickless idle in this build - clock only
+            cfg.light_sleep_enable = false;
+            esp_pm_configure(&cfg);
+            ok = !sleep;
+        }
+        p.sleeping = cfg.light_sleep_enable;
+    }
+    else
+    {
+        setCpuFrequencyMhz(cpuMhz);
+        ok         = !sleep;
+        p.sleeping = false;
+    }
+    p.cpuMhz       = cpuMhz;
+    g_stats.cpuMhz = cpuMhz;
+    return ok;
+}
+
+// power_begin - call once from setup(), DFS if this build has power management
+static inline void power_begin(PowerState & p)
+{
+    memset((void*)&p, 0, sizeof(p));
+    p.mode    = POWER_AUTO;
+    p.loadKey = UINT32_MAX;
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "stream", &p.lock) != ESP_OK) p.lock = nullptr;
+    power_apply(p, PM_CPU_MHZ_HIGH, false);
+}
+
+// power_update - once per main loop, picks the clock
+// - streaming: continuous mode is on
+// - fsHz:      ADC sampling rate
+// - loadKey:   anything that changes the work per frame (rate, filter chain, decimation, features, compression)
+// - lost:      sum of the lost frame counters, only growth counts (sys stats_reset zeroes them)
+static inline void power_update(PowerState &   p        ,
+                                const bool     streaming,
+                                const uint32_t fsHz     ,
+                                const uint32_t loadKey  ,
+                                const uint32_t lost     ,
+                                const uint32_t nowMs    )
+{
+    const bool lostMore = (lost > p.lostSeen);
+    p.lostSeen = lost;
+
+    if (p.mode == POWER_MAX)
+    {
+        power_apply(p, PM_CPU_MHZ_HIGH, false);
+        return;
+    }
+    if (!streaming)
+    {
+        p.loadKey = UINT32_MAX;
+        power_apply(p, PM_CPU_MHZ_LOW, p.lightSleep);
+        return;
+    }
+
+    // Load changed - measure it at the high clock first
+    if (loadKey != p.loadKey)
+    {
+        p.loadKey  = loadKey;
+        p.settleMs = nowMs;
+        p.pinned   = false;
+        power_apply(p, PM_CPU_MHZ_HIGH, false);
+        return;
+    }
+    if (lostMore && (p.cpuMhz < PM_CPU_MHZ_HIGH)) p.pinned = true;
+    if (p.pinned || ((nowMs - p.settleMs) < PM_SETTLE_MS))
+    {
+        power_apply(p, PM_CPU_MHZ_HIGH, false);
+        return;
+    }
+
+    // Hysteresis: back up above PM_MAX_LOAD_PCT, down only below 3/4 of it
+    const uint32_t load  = power_loadPct(p, fsHz, PM_CPU_MHZ_LOW);
+    const uint32_t limit = (p.cpuMhz == PM_CPU_MHZ_LOW) ? PM_MAX_LOAD_PCT : (PM_MAX_LOAD_PCT * 3u / 4u);
+    power_apply(p, (load <= limit) ? PM_CPU_MHZ_LOW : PM_CPU_MHZ_HIGH, false);
+}
+
+#endif // POWER_LIB_H
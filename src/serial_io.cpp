@@ -4,6 +4,7 @@
 
 #include <stdarg.h>
 #include <serial_io.h>
+#include <usb_link.h>
 
 
 
@@ -12,6 +13,7 @@
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
 extern BootCheck bootCheck; // defined in helpers.cpp
+extern UsbLink   usbLink;   // defined in main.cpp
 
 
 
@@ -37,6 +39,10 @@ void SerialCli::update()
     {
         char c = _ser.read();
 
+        if (usbLink.rxByte((uint8_t)c))  // framed command or keep-alive of the USB link, not CLI text
+        {
+            continue;
+        }
         if (c == '\r')                  // ignore CR
         {
             continue;
@@ -16,7 +16,7 @@
 // NetConfig - Class and structure
 // ---------------------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------------------
-// SerialCli - user commands over the same UART
+// SerialCli - user commands over the same UART, frames of the USB link (usb_link.h) are passed on before any parsing
 class SerialCli
 {
     public:
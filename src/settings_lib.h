@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef SETTINGS_LIB_H
+#define SETTINGS_LIB_H
+
+#include <stdint.h>
+#include <defines.h>
+
+
+
+
+// DSP SETTINGS BLOCK (sys filter_* / filters_* / precision_* / dccutofffreq / networkfreq / digitalgain / feature_*, settings_hold / settings_apply)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Filter-only settings never touch ADS1299 registers, so they change while streaming, without a gap.
+// Double buffered: the command task (only writer) fills the back buffer and publishes it whole, the sender task picks it
+// up into its own front copy once per packet, before the DSP of that packet. Every packet is processed with one complete
+// set, never with half of an update. Publishing is a sequence counter around the copy (odd while it is written),
+// reader takes the back buffer only if the counter was even and didn't move during its copy, otherwise it keeps the
+// front one and tries again on the next packet. Neither side ever waits.
+// Filter state is not touched by a swap, see dspChain_process() in math_lib.h.
+
+// Filter bits - chain index of math_lib.h and DspSettings::fastFilters
+constexpr uint32_t DSP_CHAIN_EQ   = 1u << 0; // FIR equalizer
+constexpr uint32_t DSP_CHAIN_DC   = 1u << 1; // DC blocker
+constexpr uint32_t DSP_CHAIN_N50  = 1u << 2; // 50/60 Hz notch
+constexpr uint32_t DSP_CHAIN_N100 = 1u << 3; // 100/120 Hz notch
+constexpr uint32_t DSP_CHAIN_FAST_CAPABLE = DSP_CHAIN_EQ | DSP_CHAIN_N50 | DSP_CHAIN_N100; // filters with a fast kernel
+
+struct DspSettings
+{
+    bool     filtersEnabled;      // master switch, off = every filter off
+    bool     adcEqualizer;        // FIR equalizer (sinc-3)
+    bool     removeDC;            // DC-blocking IIR
+    bool     block5060Hz;         // 50/60 Hz notch
+    bool     block100120Hz;       // 100/120 Hz notch
+    uint32_t selectDCcutoffFreq;  // 0 = 0.5, 1 = 1, 2 = 2, 3 = 4, 4 = 8 Hz
+    uint32_t selectNetworkFreq;   // 0 = 50 Hz, 1 = 60 Hz
+    uint32_t digitalGain;         // log2, 0 = 1 ... 8 = 256
+    uint32_t fastFilters;         // DSP_CHAIN_* bits of filters on the fast kernels, 0 = all exact (sys precision_fast)
+    uint32_t featureMode;         // FEATURES_OFF / FEATURES_ON / FEATURES_ONLY
+    uint32_t featureRateHz;       // feature sets per second, 1 ... FEATURE_MAX_RATE
+    uint32_t featureNumBands;     // 1 ... FEATURE_MAX_BANDS
+    uint8_t  featureBandLo[FEATURE_MAX_BANDS];   // Hz, band is lo <= f < hi
+    uint8_t  featureBandHi[FEATURE_MAX_BANDS];
+};
+
+struct DspSettingsBlock
+{
+    volatile uint32_t seq;        // even - back is complete, odd - being written
+    DspSettings       back;
+};
+
+extern DspSettingsBlock g_dspSettings;   // main.cpp
+
+// dspSettings_publish - command task, whole set becomes visible at once
+static inline void dspSettings_publish(DspSettingsBlock & b, const DspSettings & s)
+{
+    b.seq = b.seq + 1u;
+    __sync_synchronize();
+    b.back = s;
+    __sync_synchronize();
+    b.seq = b.seq + 1u;
+}
+
+// dspSettings_take - sender task, once per packet. Copies the back buffer into front if something new was
+// published since seenSeq and the copy is complete. True if front changed.
+static inline bool dspSettings_take(const DspSettingsBlock & b      ,
+                                    DspSettings &            front  ,
+                                    uint32_t &               seenSeq)
+{
+    const uint32_t seq = b.seq;
+    if ((seq == seenSeq) || (seq & 1u)) return false;
+
+    __sync_synchronize();
+    const DspSettings copy = b.back;
+    __sync_synchronize();
+    if (b.seq != seq) return false;   // publish got in between, next packet
+
+    front   = copy;
+    seenSeq = seq;
+    return true;
+}
+
+#endif // SETTINGS_LIB_H
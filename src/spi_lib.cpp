@@ -8,6 +8,10 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/portmacro.h>
 #include <esp_rom_sys.h>
+#include <esp_rom_gpio.h>
+#include <driver/spi_master.h>
+#include <soc/spi_periph.h>
+#include <soc/gpio_sig_map.h>
 
 
 
@@ -28,6 +32,24 @@ static constexpr uint32_t CS_MASK_SLAVE  = (1UL << PIN_CS_SLAVE );
 // satisfies faster rates up to 8 MHz.
 static constexpr uint32_t CS_DELAY_US = 2; // us time delay
 
+// DMA readout
+// Frame is ADC_SAMPLES_FRAME (54) bytes + 2 zero pad bytes (27 + 5 with one ADC). The pad bytes serve two purposes:
+// - 56 (32) bytes is a whole number of 32-bit words, which is what GDMA wants for RX buffers
+// - together with cs_ena_posttrans they keep CS low long enough after the last data bit
+//   (ADS1299 tSCCS is 4 tCLK = ~2 us): 16 bits + 16 cycles = 2 us at 16 MHz, all timed by the peripheral.
+//   ADS1299 sees 0x00 on DIN during pad bytes, that is not a command, so it does nothing.
+static constexpr uint32_t DMA_FRAME_PAD   = ((ADC_SAMPLES_FRAME + 2u + 3u) & ~3u) - ADC_SAMPLES_FRAME; // at least 2, up to a word
+static constexpr uint32_t DMA_FRAME_BYTES = ADC_SAMPLES_FRAME + DMA_FRAME_PAD;
+
+static spi_device_handle_t g_dmaDev    = nullptr;     // IDF device, only valid while DMA readout is active
+static SemaphoreHandle_t   g_dmaLock   = nullptr;     // held by ADC task between start and collect, by end() while tearing down
+static volatile bool       g_dmaActive = false;
+static spi_transaction_t   g_dmaTrans;                // one transaction in flight at most
+
+// Buffers must be DMA capable (internal RAM) and word aligned
+static WORD_ALIGNED_ATTR uint8_t g_dmaTx[DMA_FRAME_BYTES] = {0}; // zeros - ADC gives samples back for them
+static WORD_ALIGNED_ATTR uint8_t g_dmaRx[DMA_FRAME_BYTES];
+
 
 
 
@@ -157,3 +179,139 @@ void IRAM_ATTR xfer(char            target,
     // interrupts back on
     portEXIT_CRITICAL(&spiMux);
 }
+
+
+
+
+// DMA readout for continuous mode
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// xfer() masks every interrupt for the whole frame - two esp_rom_delay_us(2) and ~30 us of transferBytes() polling.
+// In continuous mode the bus is given to the IDF spi_master driver instead:
+// - CS0 of the peripheral drives master CS, and through the GPIO matrix, the very same signal drives slave CS
+//   (ADC_NUM_CHIPS 2), so both chip selects move together and are timed by hardware (no WRITE_PERI_REG + busy wait)
+// - transfer is queued to GDMA and the ADC task sleeps on the driver semaphore until it's done,
+//   so the CPU runs other tasks (DSP in sender task, Wi-Fi) during the transfer and interrupts are never masked
+// Commands (RREG/WREG/SDATAC and the "spi" family) still go through xfer() on SPIClass when not streaming.
+bool spi_dmaReadout_begin(uint32_t spi_frequency)
+{
+    if (g_dmaActive) return true;
+
+    if (g_dmaLock == nullptr)
+    {
+        g_dmaLock = xSemaphoreCreateMutex();
+        if (g_dmaLock == nullptr) return false;
+    }
+
+    // Detach SPIClass from the bus, it must not touch the peripheral while IDF driver owns it
+    if (g_spi) g_spi->end();
+
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num     = PIN_MOSI;
+    bus.miso_io_num     = PIN_MISO;
+    bus.sclk_io_num     = PIN_SCLK;
+    bus.quadwp_io_num   = -1;
+    bus.quadhd_io_num   = -1;
+    bus.max_transfer_sz = DMA_FRAME_BYTES;
+
+    spi_device_interface_config_t dev = {};
+    dev.mode             = 1;                           // SPI_MODE1, same as command path
+    dev.clock_speed_hz   = (int)spi_frequency;
+    dev.spics_io_num     = PIN_CS_MASTER;               // hardware CS0
+    dev.cs_ena_posttrans = 16;                          // max the peripheral can do, see DMA_FRAME_PAD
+    dev.queue_size       = 1;
+
+    if (spi_bus_initialize(SPI2_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK)
+    {
+        if (g_spi) g_spi->begin(PIN_SCLK, PIN_MISO, PIN_MOSI, PIN_CS_UNUSED);
+        return false;
+    }
+    if (spi_bus_add_device(SPI2_HOST, &dev, &g_dmaDev) != ESP_OK)
+    {
+        spi_bus_free(SPI2_HOST);
+        if (g_spi) g_spi->begin(PIN_SCLK, PIN_MISO, PIN_MOSI, PIN_CS_UNUSED);
+        return false;
+    }
+
+    // Same CS0 signal goes out on slave CS pin as well -> both ADCs selected at exactly the same time
+    // With one ADC slave CS just stays high (deselected)
+#if ADC_NUM_CHIPS > 1
+    esp_rom_gpio_connect_out_signal(PIN_CS_SLAVE, spi_periph_signal[SPI2_HOST].spics_out[0], false, false);
+#endif
+
+    // MISO pull-down, same as in setup(), bus init reconfigures the pin
+    pinMode(PIN_MISO, INPUT_PULLDOWN);
+
+    memset(&g_dmaTrans, 0, sizeof(g_dmaTrans));
+    g_dmaTrans.length    = DMA_FRAME_BYTES * 8; // bits
+    g_dmaTrans.rxlength  = DMA_FRAME_BYTES * 8;
+    g_dmaTrans.tx_buffer = g_dmaTx;
+    g_dmaTrans.rx_buffer = g_dmaRx;
+
+    g_dmaActive = true;
+    return true;
+}
+
+void spi_dmaReadout_end(void)
+{
+    if (!g_dmaActive) return;
+
+    // Wait until ADC task is done with the frame in flight (if any)
+    xSemaphoreTake(g_dmaLock, portMAX_DELAY);
+    g_dmaActive = false;
+
+    spi_bus_remove_device(g_dmaDev);
+    spi_bus_free(SPI2_HOST);
+    g_dmaDev = nullptr;
+
+    // CS pins back to plain GPIO outputs, deselected
+    esp_rom_gpio_connect_out_signal(PIN_CS_MASTER, SIG_GPIO_OUT_IDX, false, false);
+    esp_rom_gpio_connect_out_signal(PIN_CS_SLAVE , SIG_GPIO_OUT_IDX, false, false);
+    pinMode(PIN_CS_MASTER, OUTPUT);
+    pinMode(PIN_CS_SLAVE , OUTPUT);
+    cs_both_high();
+
+    // Bus back to SPIClass, caller sets the transaction settings it needs
+    if (g_spi)
+    {
+        g_spi->begin(PIN_SCLK, PIN_MISO, PIN_MOSI, PIN_CS_UNUSED);
+        pinMode(PIN_MISO, INPUT_PULLDOWN);
+    }
+
+    xSemaphoreGive(g_dmaLock);
+}
+
+bool spi_dmaReadout_active(void)
+{
+    return g_dmaActive;
+}
+
+bool IRAM_ATTR spi_dmaReadout_start(void)
+{
+    if (!g_dmaActive) return false;
+
+    xSemaphoreTake(g_dmaLock, portMAX_DELAY);
+
+    // Could have been switched off while we were waiting for the lock
+    if (!g_dmaActive || (spi_device_queue_trans(g_dmaDev, &g_dmaTrans, 0) != ESP_OK))
+    {
+        xSemaphoreGive(g_dmaLock);
+        return false;
+    }
+    return true;
+}
+
+const uint8_t * IRAM_ATTR spi_dmaReadout_collect(void)
+{
+    // 54 bytes at 16 MHz is ~30 us (half with one ADC), 2 ticks is a lot of margin and still shorter than the slowest DRDY period
+    spi_transaction_t * done = nullptr;
+    const esp_err_t     err  = spi_device_get_trans_result(g_dmaDev, &done, 2);
+
+    // Late - the transaction is still queued (queue_size 1) and GDMA still owns g_dmaRx. Take it back before giving up the
+    // lock, otherwise the next start can't queue and end() would free the bus under a pending transaction. Frame is skipped
+    if (err != ESP_OK) spi_device_get_trans_result(g_dmaDev, &done, portMAX_DELAY);
+
+    xSemaphoreGive(g_dmaLock);
+
+    return (err == ESP_OK) ? g_dmaRx : nullptr;
+}
@@ -29,4 +29,20 @@ void IRAM_ATTR xfer(char            target,
                     const uint8_t * txData,
                     uint8_t *       rxData);
 
+// DMA readout of ADC frames for continuous mode (ADC_DMA_READOUT).
+// begin() takes the bus from SPIClass and gives it to the IDF spi_master driver with hardware CS on both ADCs,
+// end() waits for the frame in flight and gives the bus back to SPIClass. Both are no-op if already done.
+bool spi_dmaReadout_begin(uint32_t spi_frequency);
+void spi_dmaReadout_end  (void);
+
+// True while the bus belongs to the IDF driver - xfer() must not run then
+bool spi_dmaReadout_active(void);
+
+// Start one ADC_SAMPLES_FRAME read from both ADCs. Returns false if DMA readout is not active (use xfer() then) or the
+// transaction couldn't be queued (skip the frame, don't fall back to xfer()).
+// Collect blocks only the calling task until DMA is done and returns the received frame (nullptr on timeout).
+// Every successful start must be followed by exactly one collect.
+bool            IRAM_ATTR spi_dmaReadout_start  (void);
+const uint8_t * IRAM_ATTR spi_dmaReadout_collect(void);
+
 #endif // SPI_LIB_H
\ No newline at end of file
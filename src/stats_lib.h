@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef STATS_LIB_H
+#define STATS_LIB_H
+
+#include <stdint.h>
+#include <string.h>
+#include <esp_attr.h>       // IRAM_ATTR
+
+
+
+
+// HOT-PATH STATISTICS (sys stats / sys stats_reset)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Counters and timing histograms of the streaming path, so it's visible in the field where frames are lost and how much
+// of the frame period is left at a given sampling rate and filter set.
+// Time is measured with the RISC-V machine cycle counter (mpccr, CSR 0x7E2) - one csrr, no function call,
+// works in the ISR, wraps every ~26 s at 160 MHz which is way longer than anything measured here.
+// Every counter has exactly one writer (DRDY ISR, ADC task, sender task or the Wi-Fi RX callback), no locks.
+// Command queue counters also count USB commands, queued from loop() - two writers, an increment may be lost.
+// Reset from the command task may race with a writer and lose one increment, good enough for statistics.
+//
+// Histograms are log2 bins of microseconds: bin 0 is < 2 us, bin k is [2^k, 2^(k+1)) us, last bin is everything >= 512 us.
+
+constexpr uint32_t STATS_HIST_BINS = 10;
+
+struct StatsHist
+{
+    uint32_t bins[STATS_HIST_BINS];
+    uint32_t count;
+    uint32_t maxUs;
+    uint64_t sumUs;
+};
+
+struct Stats
+{
+    uint32_t  cpuMhz;          // cycles -> us, set by stats_begin()
+    uint32_t  resetMs;         // millis() of the last reset
+
+    volatile uint32_t drdyCycle; // cycle counter at the last DRDY interrupt
+
+    // ADC task
+    StatsHist drdyToSpi;       // DRDY interrupt -> frame is read out from both ADCs
+    uint32_t  framesRead;      // frames read from ADC
+    uint32_t  drdyMissed;      // DRDY pulses that came while the task was still busy (notify count > 1)
+    uint32_t  dmaTimeouts;     // frames lost because DMA readout did not finish in time
+    uint32_t  droppedPackets;  // packets refilled in place because the sender still held every other slot
+    uint32_t  droppedFrames;   // frames in them
+    uint32_t  readyHwm;        // most packets waiting for the sender at once
+
+    // Sender task
+    StatsHist dspPerFrame;     // filter chain + decimation time of a packet / its ADC frames
+    uint32_t  udpBusy;         // datagrams lwIP / Wi-Fi had no buffer for (ERR_MEM), sender backs off
+    uint32_t  udpErrors;       // datagrams that failed for any other reason (no route during reconnect, ...)
+    uint32_t  usbBusy;         // datagrams the USB TX buffer had no room for (USB stream, PC not reading fast enough)
+    uint32_t  replayedPackets; // datagrams sent again from the backfill ring after a Wi-Fi drop
+
+    // Wi-Fi RX callback (and USB commands)
+    uint32_t  cmdDropped;      // commands dropped because the command queue was full
+    uint32_t  cmdHwm;          // most commands waiting at once
+};
+
+extern Stats g_stats;          // main.cpp
+
+// stats_cycles - CPU cycle counter
+static inline uint32_t IRAM_ATTR stats_cycles(void)
+{
+    uint32_t c;
+    __asm__ __volatile__("csrr %0, 0x7e2" : "=r"(c));
+    return c;
+}
+
+// stats_record - one measurement in cycles into a histogram
+static inline void IRAM_ATTR stats_record(StatsHist &    h     ,
+                                          const uint32_t cycles)
+{
+    const uint32_t us  = cycles / g_stats.cpuMhz;
+    const uint32_t top = us >> 1;
+    uint32_t       bin = top ? (32u - __builtin_clz(top)) : 0u;
+    if (bin >= STATS_HIST_BINS) bin = STATS_HIST_BINS - 1u;
+
+    h.bins[bin]++;
+    h.count++;
+    h.sumUs += us;
+    if (us > h.maxUs) h.maxUs = us;
+}
+
+// stats_max - high-water mark
+static inline void IRAM_ATTR stats_max(uint32_t &     hwm  ,
+                                       const uint32_t value)
+{
+    if (value > hwm) hwm = value;
+}
+
+// stats_reset - zero everything but the clock
+static inline void stats_reset(const uint32_t nowMs)
+{
+    const uint32_t mhz = g_stats.cpuMhz;
+    memset((void*)&g_stats, 0, sizeof(g_stats));
+    g_stats.cpuMhz  = mhz;
+    g_stats.resetMs = nowMs;
+}
+
+// stats_begin - call once from setup()
+// Cycle counter is normally running already after boot, selecting "count cycles" (mpcer = 1) and enabling it
+// (mpcmr = 1) again costs nothing and does not depend on what the bootloader did.
+static inline void stats_begin(const uint32_t cpuMhz,
+                               const uint32_t nowMs )
+{
+    __asm__ __volatile__("csrw 0x7e0, %0" :: "r"(1u));
+    __asm__ __volatile__("csrw 0x7e1, %0" :: "r"(1u));
+    g_stats.cpuMhz = cpuMhz ? cpuMhz : 160u;
+    stats_reset(nowMs);
+}
+
+#endif // STATS_LIB_H
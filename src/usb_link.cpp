@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#include <cstring>
+#include <freertos/queue.h>
+#include <usb_link.h>
+#include <stats_lib.h>
+
+
+
+
+// External variables
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+extern QueueHandle_t cmdQue;        // defined in main.cpp
+extern TaskHandle_t  cmdTask;       // loop() task, woken when a command is queued
+extern Debugger      Debug;
+
+
+
+
+//  UsbLink implementation
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+UsbLink::UsbLink(Stream& port)
+: _port (port)
+{}
+
+void UsbLink::begin(void)
+{
+    _txMutex = xSemaphoreCreateMutex();
+}
+
+// Frame receiver - head byte by byte, then the payload straight into the command message.
+// A broken head (sync lost, byte dropped by the PC) costs that frame only: anything but USB_LINK_SYNC0 outside a frame
+// is CLI text, so the next frame is found again.
+bool UsbLink::rxByte(uint8_t c)
+{
+    switch (_rxHead)
+    {
+        case 0:
+            if (c != USB_LINK_SYNC0) return false;
+            _rxHead = 1;
+            return true;
+
+        case 1:
+            _rxHead = (c == USB_LINK_SYNC1) ? 2u : ((c == USB_LINK_SYNC0) ? 1u : 0u);
+            return true;
+
+        case 2:
+            _rxType = c;
+            _rxHead = 3;
+            return true;
+
+        case 3:
+            _rxLen  = c;
+            _rxHead = 4;
+            return true;
+
+        case 4:
+            _rxLen |= (uint32_t)c << 8;
+            _rxPos  = 0;
+            _rxDrop = (_rxLen > CMD_BUFFER_SIZE - 1);
+            _rxHead = USB_LINK_OVERHEAD;
+            if (_rxLen == 0) takeFrame();
+            return true;
+
+        default:
+            if (!_rxDrop) _rxMsg.data[_rxPos] = (char)c;
+            if (++_rxPos >= _rxLen) takeFrame();
+            return true;
+    }
+}
+
+// Complete frame - every frame is a keep-alive, CTRL frames but WOOF_WOOF are commands
+void UsbLink::takeFrame(void)
+{
+    _rxHead   = 0;
+    _lastRxMs = millis();
+
+    if (_rxDrop)
+    {
+        Debug.log("USB RX oversize: %u B dropped", (unsigned)_rxLen);
+        return;
+    }
+    if ((_rxType != USB_LINK_CTRL) || (_rxLen == 0)) return;
+    if ((_rxLen == WIFI_KEEPALIVE_WORD_LEN) && (memcmp(_rxMsg.data, WIFI_KEEPALIVE_WORD, WIFI_KEEPALIVE_WORD_LEN) == 0)) return;
+
+    _rxMsg.len          = (uint16_t)_rxLen;
+    _rxMsg.origin       = CMD_ORIGIN_USB;
+    _rxMsg.ip           = 0;
+    _rxMsg.port         = 0;
+    _rxMsg.data[_rxLen] = '\0';
+    if (!cmdQue || (xQueueSend(cmdQue, &_rxMsg, 0) != pdTRUE))
+    {
+        g_stats.cmdDropped++;
+        Debug.print("USB cmd dropped - queue full");
+        return;
+    }
+    stats_max(g_stats.cmdHwm, uxQueueMessagesWaiting(cmdQue));
+    if (cmdTask) xTaskNotifyGive(cmdTask);
+}
+
+// Head and payload under one lock and only if both fit, so frames of the two tasks never interleave and the PC never
+// sees half a frame. availableForWrite() is the free space of the HWCDC TX ring (USB_TX_BUFFER_SIZE).
+bool UsbLink::sendFrame(uint8_t type, const void* data, size_t len)
+{
+    if (!_txMutex || (len > 0xFFFFu)) return false;
+
+    const uint8_t head[USB_LINK_OVERHEAD] = { USB_LINK_SYNC0, USB_LINK_SYNC1, type, (uint8_t)len, (uint8_t)(len >> 8) };
+
+    xSemaphoreTake(_txMutex, portMAX_DELAY);
+    const bool room = ((size_t)_port.availableForWrite() >= USB_LINK_OVERHEAD + len);
+    if (room)
+    {
+        _port.write(head, sizeof(head));
+        _port.write(static_cast<const uint8_t*>(data), len);
+    }
+    xSemaphoreGive(_txMutex);
+    return room;
+}
+
+bool UsbLink::sendData(const uint8_t* data, size_t len)
+{
+    if (sendFrame(USB_LINK_DATA, data, len)) return true;
+    g_stats.usbBusy++;
+    return false;
+}
+
+void UsbLink::sendCtrl(const void* data, size_t len)
+{
+    for (uint32_t waited = 0; !sendFrame(USB_LINK_CTRL, data, len); ++waited)
+    {
+        if (waited >= USB_CTRL_WAIT_MS)
+        {
+            Debug.print("USB reply dropped - TX buffer full");
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+}
+
+void UsbLink::startStream(void)
+{
+    _lastRxMs = millis();
+    if (_streaming) return;
+    _debugWas = Debug.isEnabled();
+    Debug.disable();
+    _streaming = true;
+}
+
+void UsbLink::stopStream(void)
+{
+    if (!_streaming) return;
+    _streaming = false;
+    if (_debugWas) Debug.enable();
+}
+
+// Stream watchdog - same timeout as Wi-Fi, PC driver sends WOOF_WOOF frames every few seconds
+void UsbLink::update(void)
+{
+    const uint32_t rxDelta = safeTimeDelta(millis(), _lastRxMs);
+    if (_streaming && (rxDelta > WIFI_SERVER_TIMEOUT))
+    {
+        stopStream();
+        Debug.log("USB WATCHDOG: no frame %lu ms - stream stopped", (unsigned long)rxDelta);
+    }
+}
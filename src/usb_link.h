@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef USB_LINK_H
+#define USB_LINK_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "defines.h"
+#include "net_manager.h"        // CmdMsg
+
+
+
+
+// Class
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// UsbLink - wired streaming and commands over the native USB CDC port, frame format in defines.h (USB_LINK_*)
+// - RX: SerialCli hands every byte to rxByte() first, a complete CTRL frame goes to cmdQue like a control datagram
+//   (reply comes back over USB), everything outside frames stays the text CLI
+// - TX: data datagrams from the sender task and replies from loop(), one frame at a time under a mutex. A frame goes
+//   out whole or not at all, sendData never blocks - no room in the TX buffer means the PC doesn't keep up
+// - Stream: sys start_cnt over USB, until sys stop_cnt or WIFI_SERVER_TIMEOUT without a frame from the PC
+class UsbLink
+{
+public:
+    explicit UsbLink(Stream& port = Serial);
+
+    // Call once from setup(), after Serial.begin()
+    void begin(void);
+
+    // One byte from the port. True if it belongs to a frame, false - it's for the text CLI
+    bool rxByte(uint8_t c);
+
+    // sendData - one data datagram, false if it didn't fit into the TX buffer (sys stats usb_busy)
+    // sendCtrl - one reply datagram, waits up to USB_CTRL_WAIT_MS for room
+    bool sendData(const uint8_t* data, size_t len);
+    void sendCtrl(const void*    data, size_t len);
+
+    // called from message handlers
+    void startStream(void);
+    void stopStream (void);
+
+    // sender and packing use this
+    inline bool streaming() const noexcept { return _streaming; }
+
+    // Call every loop() iteration, stream watchdog
+    void update(void);
+
+private:
+    bool sendFrame(uint8_t type, const void* data, size_t len);
+    void takeFrame(void);           // complete frame in _rxMsg
+
+    Stream&           _port;
+    SemaphoreHandle_t _txMutex   = nullptr;
+    volatile bool     _streaming = false;
+    volatile uint32_t _lastRxMs  = 0;    // last frame from the PC
+    bool              _debugWas  = false; // Debug was enabled before the stream muted it
+
+    // Frame receiver, loop() task only
+    uint32_t _rxHead = 0;                // bytes of the frame head seen so far, USB_LINK_OVERHEAD - in the payload
+    uint8_t  _rxType = 0;
+    uint32_t _rxLen  = 0;
+    uint32_t _rxPos  = 0;
+    bool     _rxDrop = false;            // too long for a command, payload is skipped
+    CmdMsg   _rxMsg;
+};
+
+#endif // USB_LINK_H
@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+#ifndef DSP_REFERENCE_H
+#define DSP_REFERENCE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math_lib.h>
+
+
+
+
+// TEST SIGNALS AND REFERENCE MODEL OF THE DSP KERNELS (test_dsp, test_dsp_bench)
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Everything here is integer only (no libm), so a signal and a digest are the same bits on the PC and on the ESP32-C3 and
+// the golden digests in test_dsp hold for both.
+// The reference model is the filter chain and the decimation written the plain way: one sample at a time, one filter
+// after the other, history in arrays, halfbands as full convolutions. Slow, nothing fused or specialized - only the
+// arithmetic is the same (int64 accumulators, dsp_roundShift rounding, same priming). The kernels in math_lib.h have to
+// give exactly its bytes. Fast precision (DspSettings::fastFilters) the same way: every product floored to its high word,
+// sum wrapped to 32 bits, then scaled and the mean truncation added back.
+
+// Packet of test frames, same layout as a slot of the sender (ADC_FULL_FRAME_SIZE per frame, 4 B timestamp after the
+// channel data)
+constexpr uint32_t REF_MAX_FRAMES = MAX_FRAMES_PER_BLOCK;
+
+struct RefPacket
+{
+    uint8_t  data[REF_MAX_FRAMES * ADC_FULL_FRAME_SIZE];
+    uint32_t numFrames;
+};
+
+// ref_sine - integer sine, parabola per half period, phase is a full turn per 2^32, amplitude 2^15
+// Not a true sine (3rd harmonic at -40 dB), but the same everywhere, and that's what a golden vector needs
+static inline int32_t ref_sine(const uint32_t phase)
+{
+    const int32_t x = (int32_t)((phase >> 16) & 0x7FFFu);                 // position in the half period, Q15
+    const int32_t y = (int32_t)(((int64_t)4 * x * (32768 - x)) >> 15);    // 0 ... 32768 ... 0
+    return (phase & 0x80000000u) ? -y : y;
+}
+
+// ref_phaseStep - phase increment of f_mHz at fsHz
+static inline uint32_t ref_phaseStep(const uint32_t f_mHz, const uint32_t fsHz)
+{
+    return (uint32_t)(((uint64_t)f_mHz << 32) / ((uint64_t)fsHz * 1000u));
+}
+
+// RefSignal - deterministic multi-channel generator
+// - REF_SIGNAL_EEG:    electrode offset, 1/f-like noise (sum of random walks), 10 Hz alpha, 50 Hz mains with its 3rd harmonic,
+//                      a blink every ~3 s - what a recording looks like, the notches and the DC blocker all have work
+// - REF_SIGNAL_TONES:  a tone per channel, 1 ... fs/2 Hz spread over the channels plus 50 and 100/120 Hz right on the notches
+// - REF_SIGNAL_STEPS:  full-scale square waves and steps, clamping and overflow paths
+constexpr uint32_t REF_SIGNAL_EEG   = 0;
+constexpr uint32_t REF_SIGNAL_TONES = 1;
+constexpr uint32_t REF_SIGNAL_STEPS = 2;
+constexpr uint32_t REF_NUM_SIGNALS  = 3;
+
+struct RefSignal
+{
+    uint32_t kind;
+    uint32_t fsHz;
+    uint32_t n;                                   // next sample index
+    uint32_t lcg  [NUMBER_OF_ADC_CHANNELS];       // own noise per channel, channels 1 ... 8 are the same in an 8-channel build
+    int32_t  walk [NUMBER_OF_ADC_CHANNELS][3];    // random walks of the noise, slow ... fast
+    uint32_t phase[NUMBER_OF_ADC_CHANNELS][3];
+    uint32_t step [NUMBER_OF_ADC_CHANNELS][3];
+};
+
+static inline uint32_t ref_random(RefSignal & g, const uint32_t ch)
+{
+    g.lcg[ch] = g.lcg[ch] * 1664525u + 1013904223u;
+    return g.lcg[ch];
+}
+
+static inline void ref_signalInit(RefSignal & g, const uint32_t kind, const uint32_t fsHz, const uint32_t seed)
+{
+    memset(&g, 0, sizeof(g));
+    g.kind = kind;
+    g.fsHz = fsHz;
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    {
+        g.lcg[ch] = (seed + 31u * ch) * 2654435761u + 12345u;
+
+        // EEG: alpha, mains, 3rd harmonic of mains
+        // TONES: own tone, 50 Hz, 100 or 120 Hz
+        const uint32_t nyq_mHz = fsHz * 500u;
+        const uint32_t tone    = 1000u + (uint32_t)(((uint64_t)(nyq_mHz - 2000u) * ch) / 15u);   // 16 slots, also in an 8-channel build
+        const uint32_t f0   = (kind == REF_SIGNAL_TONES) ? tone : (9500u + 250u * ch);
+        const uint32_t f1   = 50000u;
+        const uint32_t f2   = (kind == REF_SIGNAL_TONES) ? ((ch & 1u) ? 120000u : 100000u) : 150000u;
+        g.step[ch][0] = ref_phaseStep(f0, fsHz);
+        g.step[ch][1] = ref_phaseStep(f1, fsHz);
+        g.step[ch][2] = (f2 < nyq_mHz) ? ref_phaseStep(f2, fsHz) : 0u;
+        g.phase[ch][0] = 0x10000000u * ch;
+    }
+}
+
+// ref_sample - next 24-bit sample of every channel
+static inline void ref_sample(RefSignal & g, int32_t * const x)
+{
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    {
+        int64_t v = 0;
+        if (g.kind == REF_SIGNAL_EEG)
+        {
+            // 1/f-ish: three leaky random walks with falling corner frequencies
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const int32_t r = (int32_t)(ref_random(g, ch) >> 20) - 2048;            // +-2048
+                g.walk[ch][k] += r - (g.walk[ch][k] >> (4 + 3 * k));
+            }
+            const int32_t offset = ((int32_t)ch - 8) * 60000;                       // electrode offset, up to +-480000
+            const uint32_t blink = (g.n + 97u * ch) % (3u * g.fsHz);                // 0.25 s bump every 3 s
+            const int32_t  bump  = (blink < g.fsHz / 4u) ? ref_sine((uint32_t)(((uint64_t)blink << 31) / (g.fsHz / 4u))) * 12 : 0;
+            v = offset + g.walk[ch][0] / 8 + g.walk[ch][1] / 4 + g.walk[ch][2] / 2 + bump +
+                (ref_sine(g.phase[ch][0]) >> 4) +                                   // alpha ~2000
+                (ref_sine(g.phase[ch][1]) >> 2) +                                   // mains ~8000
+                (ref_sine(g.phase[ch][2]) >> 4);                                    // its 3rd harmonic
+        }
+        else if (g.kind == REF_SIGNAL_TONES)
+        {
+            v = (int64_t)ref_sine(g.phase[ch][0]) * 64 +                            // ~2.1M, a quarter of full scale
+                (int64_t)ref_sine(g.phase[ch][1]) * 16 +
+                (int64_t)ref_sine(g.phase[ch][2]) * 16;
+        }
+        else
+        {
+            // Alternating full-scale levels, period grows with the channel, every 4th channel sits at a rail
+            const uint32_t period = 8u << (ch & 7u);
+            const bool     high   = ((g.n / period) & 1u) != 0u;
+            v = ((ch & 3u) == 3u) ? (high ? 0x7FFFFF : -0x800000) : (high ? 0x600000 : -0x600000);
+            v += (int32_t)(ref_random(g, ch) >> 24) - 128;
+        }
+        for (uint32_t k = 0; k < 3; ++k) g.phase[ch][k] += g.step[ch][k];
+
+        if (v >  0x7FFFFF) v =  0x7FFFFF;
+        if (v < -0x800000) v = -0x800000;
+        x[ch] = (int32_t)v;
+    }
+    g.n++;
+}
+
+// ref_fill - next numFrames frames of the signal into a packet, timestamp = sample index
+static inline void ref_fill(RefSignal & g, RefPacket & p, const uint32_t numFrames)
+{
+    p.numFrames = numFrames;
+    for (uint32_t f = 0; f < numFrames; ++f)
+    {
+        uint8_t * const frame = &p.data[f * ADC_FULL_FRAME_SIZE];
+        const uint32_t  ts    = g.n;
+        int32_t x[NUMBER_OF_ADC_CHANNELS];
+        ref_sample(g, x);
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+        {
+            frame[3 * ch + 0] = (uint8_t)((x[ch] >> 16) & 0xFF);
+            frame[3 * ch + 1] = (uint8_t)((x[ch] >>  8) & 0xFF);
+            frame[3 * ch + 2] = (uint8_t)( x[ch] & 0xFF);
+        }
+        memcpy(&frame[ADC_PARSED_FRAME], &ts, 4);
+    }
+}
+
+static inline int32_t ref_get24(const uint8_t * const p)
+{
+    const uint32_t raw = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[2];
+    return (raw & 0x800000u) ? (int32_t)(raw | 0xFF000000u) : (int32_t)raw;
+}
+
+static inline void ref_put24(uint8_t * const p, int32_t v)
+{
+    if (v >  0x7FFFFF) v =  0x7FFFFF;
+    if (v < -0x800000) v = -0x800000;
+    p[0] = (uint8_t)((v >> 16) & 0xFF);
+    p[1] = (uint8_t)((v >>  8) & 0xFF);
+    p[2] = (uint8_t)( v & 0xFF);
+}
+
+// ref_round - acc / 2^shift, halves away from zero (what dsp_roundShift does, written out)
+static inline int32_t ref_round(const int64_t acc, const int32_t shift)
+{
+    const int64_t half = (int64_t)1 << (shift - 1);
+    return (int32_t)((acc >= 0) ? ((acc + half) >> shift) : ((acc + half - 1) >> shift));
+}
+
+// RefChain - reference filter chain with fixed settings from the first sample on
+// ------------------------------------------------------------------------------------------------------------------
+struct RefBiquad
+{
+    int32_t b[3], a[2], shift;
+    bool    fast;
+    int32_t x1, x2, y1, y2;
+};
+
+struct RefChain
+{
+    bool      primed;
+    bool      eq, dc, n50, n100;
+    bool      tone;                                            // lead-off tone notch, in front of everything
+    bool      eqFast;
+    uint32_t  gain;
+    int32_t   fir[NUMBER_OF_ADC_CHANNELS][EQ_FIR_NUM_TAPS];   // x[n] ... x[n-6]
+    RefBiquad toneF[NUMBER_OF_ADC_CHANNELS];
+    RefBiquad dcF  [NUMBER_OF_ADC_CHANNELS];
+    RefBiquad n50F [NUMBER_OF_ADC_CHANNELS][2];
+    RefBiquad n100F[NUMBER_OF_ADC_CHANNELS][2];
+};
+
+static inline void ref_biquadSet(RefBiquad & q, const int32_t * b, const int32_t * a, const int32_t shift)
+{
+    memset(&q, 0, sizeof(q));
+    for (uint32_t k = 0; k < 3; ++k) q.b[k] = b[k];
+    for (uint32_t k = 0; k < 2; ++k) q.a[k] = a[k];
+    q.shift = shift;
+}
+
+// ref_fastSum - fast precision result of numProducts products: high words summed, wrapped to 32 bits, to the output scale
+// plus the mean truncation of half an LSB of a high word per product
+static inline int32_t ref_fastSum(const int64_t * const products, const uint32_t numProducts, const int32_t shift)
+{
+    int64_t sum = 0;
+    for (uint32_t k = 0; k < numProducts; ++k) sum += products[k] >> 32;
+    const int64_t scale = (int64_t)1 << (32 - shift);
+    return (int32_t)(uint32_t)(uint64_t)(sum * scale + numProducts * scale / 2);
+}
+
+static inline int32_t ref_biquadRun(RefBiquad & q, const int32_t x)
+{
+    const int64_t products[5] = { (int64_t)q.b[0] * x, (int64_t)q.b[1] * q.x1, (int64_t)q.b[2] * q.x2,
+                                  -(int64_t)q.a[0] * q.y1, -(int64_t)q.a[1] * q.y2 };
+    const int64_t acc = products[0] + products[1] + products[2] + products[3] + products[4];
+    const int32_t y   = q.fast ? ref_fastSum(products, 5, q.shift) : ref_round(acc, q.shift);
+    q.x2 = q.x1; q.x1 = x;
+    q.y2 = q.y1; q.y1 = y;
+    return y;
+}
+
+static inline void ref_chainInit(RefChain & r, const DspSettings & s, const uint32_t fsIdx, const bool tone)
+{
+    memset(&r, 0, sizeof(r));
+    r.tone = tone;
+    r.eq   = s.filtersEnabled && s.adcEqualizer;
+    r.dc   = s.filtersEnabled && s.removeDC;
+    r.n50  = s.filtersEnabled && s.block5060Hz;
+    r.n100 = s.filtersEnabled && s.block100120Hz;
+    r.gain = s.digitalGain;
+
+    const uint32_t dcIdx    = fsIdx + NUM_OF_FREQ_PRESETS * s.selectDCcutoffFreq;
+    const uint32_t notchIdx = fsIdx + NUM_OF_FREQ_PRESETS * s.selectNetworkFreq;
+    const int32_t toneB[3] = { TONE_NOTCH_B0[fsIdx], 0, TONE_NOTCH_B0[fsIdx] };
+    const int32_t toneA[2] = { 0, TONE_NOTCH_A2[fsIdx] };
+    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+    {
+        ref_biquadSet(r.toneF[ch], toneB, toneA, TONE_NOTCH_SHIFT);
+        ref_biquadSet(r.dcF[ch], DC_IIR_B[dcIdx], DC_IIR_A[dcIdx], DC_IIR_SHIFT);
+        for (uint32_t k = 0; k < 2; ++k)
+        {
+            ref_biquadSet(r.n50F [ch][k], NOTCH5060_B  [notchIdx], NOTCH5060_A  [notchIdx], NOTCH5060_SHIFT  [fsIdx]);
+            ref_biquadSet(r.n100F[ch][k], NOTCH100120_B[notchIdx], NOTCH100120_A[notchIdx], NOTCH100120_SHIFT[fsIdx]);
+            r.n50F [ch][k].fast = (s.fastFilters & DSP_CHAIN_N50 ) != 0;
+            r.n100F[ch][k].fast = (s.fastFilters & DSP_CHAIN_N100) != 0;
+        }
+    }
+    r.eqFast = (s.fastFilters & DSP_CHAIN_EQ) != 0;     // DC blocker stays exact whatever the bits say
+}
+
+// ref_chainRun - one packet in place
+static inline void ref_chainRun(RefChain & r, RefPacket & p)
+{
+    for (uint32_t f = 0; f < p.numFrames; ++f)
+    {
+        uint8_t * const frame = &p.data[f * ADC_FULL_FRAME_SIZE];
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+        {
+            int32_t x = (int32_t)((uint32_t)ref_get24(&frame[3 * ch]) << (8u + r.gain));
+
+            // Steady state for a constant input equal to the first sample, everything after the DC blocker sees 0
+            if (!r.primed)
+            {
+                RefBiquad & t = r.toneF[ch];
+                t.x1 = x; t.x2 = x; t.y1 = x; t.y2 = x;
+                const int32_t xn = r.dc ? 0 : x;
+                for (uint32_t k = 0; k < EQ_FIR_NUM_TAPS; ++k) r.fir[ch][k] = x;
+                r.dcF[ch].x1 = x; r.dcF[ch].x2 = x;
+                for (uint32_t k = 0; k < 2; ++k)
+                {
+                    RefBiquad * const q[2] = { &r.n50F[ch][k], &r.n100F[ch][k] };
+                    for (RefBiquad * b : q) { b->x1 = xn; b->x2 = xn; b->y1 = xn; b->y2 = xn; }
+                }
+            }
+
+            if (r.tone) x = ref_biquadRun(r.toneF[ch], x);
+            if (r.eq)
+            {
+                for (uint32_t k = EQ_FIR_NUM_TAPS - 1; k > 0; --k) r.fir[ch][k] = r.fir[ch][k - 1];
+                r.fir[ch][0] = x;
+                int64_t products[EQ_FIR_NUM_TAPS], acc = 0;
+                for (uint32_t k = 0; k < EQ_FIR_NUM_TAPS; ++k) acc += products[k] = (int64_t)EQ_FIR_H[k] * r.fir[ch][k];
+                x = r.eqFast ? ref_fastSum(products, EQ_FIR_NUM_TAPS, EQ_FIR_SHIFT) : ref_round(acc, EQ_FIR_SHIFT);
+            }
+            if (r.dc) x = ref_biquadRun(r.dcF[ch], x);
+            if (r.n50)
+            {
+                x = ref_biquadRun(r.n50F[ch][0], x);
+                x = ref_biquadRun(r.n50F[ch][1], x);
+            }
+            if (r.n100)
+            {
+                x = ref_biquadRun(r.n100F[ch][0], x);
+                x = ref_biquadRun(r.n100F[ch][1], x);
+            }
+            ref_put24(&frame[3 * ch], x >> 8);
+        }
+        r.primed = true;
+    }
+}
+
+// RefDecimator - halfband cascade as plain convolutions over the whole input history of every stage
+// ------------------------------------------------------------------------------------------------------------------
+constexpr uint32_t REF_DECIM_MAX_INPUT = 4096;    // input frames of one run
+
+struct RefDecimator
+{
+    uint32_t log2R;
+    uint32_t numIn;                                // frames so far
+    int32_t  first[NUMBER_OF_ADC_CHANNELS];        // priming value, history before the first frame
+    int32_t  in   [DECIM_MAX_LOG2][NUMBER_OF_ADC_CHANNELS][REF_DECIM_MAX_INPUT];
+    uint32_t count[DECIM_MAX_LOG2];                // inputs per stage so far
+    uint32_t ts   [REF_DECIM_MAX_INPUT];           // timestamps of the input frames
+};
+
+// Full tap k of a halfband (0 ... NUM_TAPS - 1), rebuilt from the non-zero half kept in math_lib.h
+static inline int64_t ref_halfbandTap(const int32_t * h, const uint32_t numTaps, const uint32_t k)
+{
+    const int32_t c = (int32_t)(numTaps - 1u) / 2;
+    const int32_t d = ((int32_t)k > c) ? (int32_t)k - c : c - (int32_t)k;
+    if (d == 0)       return (int64_t)1 << (DECIM_SHIFT - 1);
+    if ((d & 1) == 0) return 0;
+    return h[(d - 1) / 2];
+}
+
+static inline void ref_decimInit(RefDecimator & r, const uint32_t log2R)
+{
+    memset(&r, 0, sizeof(r));
+    r.log2R = log2R;
+}
+
+// ref_decimRun - one packet in place, returns output frames
+static inline uint32_t ref_decimRun(RefDecimator & r, RefPacket & p)
+{
+    uint32_t out = 0;
+    for (uint32_t f = 0; f < p.numFrames; ++f)
+    {
+        const uint8_t * const frame = &p.data[f * ADC_FULL_FRAME_SIZE];
+        uint32_t ts;
+        memcpy(&ts, &frame[ADC_PARSED_FRAME], 4);
+        if (r.numIn == 0)
+        {
+            for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch) r.first[ch] = ref_get24(&frame[3 * ch]) << DECIM_HEADROOM;
+        }
+
+        int32_t x[NUMBER_OF_ADC_CHANNELS];
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch) x[ch] = ref_get24(&frame[3 * ch]) << DECIM_HEADROOM;
+        r.numIn++;
+
+        // Stage s keeps its input, every second one (the 2nd, 4th, ...) makes an output that goes on to stage s + 1
+        bool produced = true;
+        for (uint32_t s = 0; (s < r.log2R) && produced; ++s)
+        {
+            const bool     last    = (s + 1u == r.log2R);
+            const int32_t *h       = last ? HB_LONG_H : HB_SHORT_H;
+            const uint32_t numTaps = last ? HB_LONG_NUM_TAPS : HB_SHORT_NUM_TAPS;
+            const uint32_t i       = r.count[s]++;
+            for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch) r.in[s][ch][i] = x[ch];
+            produced = (i & 1u) != 0u;
+            if (!produced) break;
+
+            for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+            {
+                int64_t acc = 0;
+                for (uint32_t k = 0; k < numTaps; ++k)
+                {
+                    const int32_t v = (i >= k) ? r.in[s][ch][i - k] : r.first[ch];
+                    acc += ref_halfbandTap(h, numTaps, k) * v;
+                }
+                x[ch] = ref_round(acc, DECIM_SHIFT);
+            }
+        }
+        if (!produced) continue;
+
+        uint8_t * const dst = &p.data[out * ADC_FULL_FRAME_SIZE];
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch) ref_put24(&dst[3 * ch], ref_round(x[ch], DECIM_HEADROOM));
+        memcpy(&dst[ADC_PARSED_FRAME], &ts, 4);
+        out++;
+    }
+    p.numFrames = out;
+    return out;
+}
+
+// ref_crc32 - CRC-32 (IEEE, reflected) of the channel data of the first ADC_CHANNELS_PER_CHIP channels
+// Digest covers what a 16- and an 8-channel build have in common, one golden table for both
+static inline uint32_t ref_crc32(uint32_t crc, const RefPacket & p)
+{
+    crc = ~crc;
+    for (uint32_t f = 0; f < p.numFrames; ++f)
+    {
+        const uint8_t * const frame = &p.data[f * ADC_FULL_FRAME_SIZE];
+        for (uint32_t i = 0; i < 3u * ADC_CHANNELS_PER_CHIP; ++i)
+        {
+            crc ^= frame[i];
+            for (uint32_t b = 0; b < 8; ++b) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+#endif // DSP_REFERENCE_H
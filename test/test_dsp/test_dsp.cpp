@@ -0,0 +1,422 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+// DSP KERNELS - BIT-EXACT AGAINST THE REFERENCE MODEL AND THE GOLDEN DIGESTS
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// pio test -e native         on the PC, in seconds
+// pio test -e esp32c3-bench  the same on the board (plus test_dsp_bench)
+// 1. Every one of the 16 chain instances (unpack + gain -> filters -> pack) at every sampling rate preset, with and without
+//    digital gain, exact and fast precision, with and without the lead-off tone notch, against the reference model in
+//    dsp_reference.h, byte for byte.
+// 2. Decimation by 2 ... 16 against the reference model, samples, frame count and timestamps.
+// 3. Scripted sessions - settings change while streaming (gain rescale, filters primed on the fly, new presets, decimation
+//    switched) - against digests recorded from the kernels as they are now. Only these catch a change of behaviour the
+//    reference model shares, e.g. priming or rescaling. A change that is meant to change the output has to update them.
+// 4. Fast precision against exact on an EEG-like signal, error of every filter at every rate within the limits that
+//    math_lib.h documents.
+// 5. Electrode impedance: Goertzel at fs / 4 gives back the impedance of a synthetic lead-off tone on top of EEG, and the
+//    tone notch takes it out of the stream, 60 dB down. A lost frame throws the block it falls into away.
+
+#include <stdio.h>
+#include <math.h>
+#include <unity.h>
+#include <dsp_reference.h>
+#include <impedance_lib.h>
+
+// Same packing as the firmware (FRAMES_PER_PACKET_LUT in main.cpp)
+static const uint32_t TEST_FRAMES_PER_PACKET[NUM_OF_FREQ_PRESETS] = { 5, 10, 20,
+    (40 < MAX_FRAMES_PER_PACKET) ? 40 : MAX_FRAMES_PER_PACKET, (80 < MAX_FRAMES_PER_PACKET) ? 80 : MAX_FRAMES_PER_PACKET };
+
+// Odd sizes too, kernels must not assume anything about the packet length
+static const uint32_t TEST_PACKET_SIZES[] = { 27, 1, 13, MAX_FRAMES_PER_BLOCK, 2, 5 };
+constexpr uint32_t    TEST_NUM_SIZES      = sizeof(TEST_PACKET_SIZES) / sizeof(TEST_PACKET_SIZES[0]);
+
+static RefPacket s_kernel, s_ref;
+static RefDecimator s_refDecim;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static DspSettings test_settings(const uint32_t chainIdx, const uint32_t gain, const uint32_t cutoff, const uint32_t network)
+{
+    DspSettings s;
+    memset(&s, 0, sizeof(s));
+    s.filtersEnabled = (chainIdx != 0);
+    s.adcEqualizer   = (chainIdx & DSP_CHAIN_EQ  ) != 0;
+    s.removeDC       = (chainIdx & DSP_CHAIN_DC  ) != 0;
+    s.block5060Hz    = (chainIdx & DSP_CHAIN_N50 ) != 0;
+    s.block100120Hz  = (chainIdx & DSP_CHAIN_N100) != 0;
+    s.selectDCcutoffFreq = cutoff;
+    s.selectNetworkFreq  = network;
+    s.digitalGain        = gain;
+    return s;
+}
+
+// First byte that differs, as text for the failure message
+static void test_compare(const RefPacket & got, const RefPacket & want, const char * what)
+{
+    char msg[160];
+    if (got.numFrames != want.numFrames)
+    {
+        snprintf(msg, sizeof(msg), "%s: %u frames, reference %u", what, (unsigned)got.numFrames, (unsigned)want.numFrames);
+        TEST_FAIL_MESSAGE(msg);
+    }
+    for (uint32_t i = 0; i < got.numFrames * ADC_FULL_FRAME_SIZE; ++i)
+    {
+        if (got.data[i] == want.data[i]) continue;
+        snprintf(msg, sizeof(msg), "%s: frame %u byte %u is 0x%02X, reference 0x%02X", what,
+                 (unsigned)(i / ADC_FULL_FRAME_SIZE), (unsigned)(i % ADC_FULL_FRAME_SIZE), got.data[i], want.data[i]);
+        TEST_FAIL_MESSAGE(msg);
+    }
+}
+
+// 1. every chain instance against the reference
+static void test_chain_matches_reference(void)
+{
+    for (uint32_t fsIdx = 0; fsIdx < NUM_OF_FREQ_PRESETS; ++fsIdx)
+    {
+        for (uint32_t chainIdx = 0; chainIdx < DSP_CHAIN_NUM; ++chainIdx)
+        {
+            for (uint32_t gain = 0; gain <= 3; gain += 3)
+            for (uint32_t fast = 0; fast <= 0xFu; fast += 0xFu)    // also the DC bit, it must change nothing
+            for (uint32_t tone = 0; tone <= 1; ++tone)
+            {
+                const uint32_t signal = chainIdx % REF_NUM_SIGNALS;
+                DspSettings    s      = test_settings(chainIdx, gain, (fsIdx + chainIdx) % NUM_OF_CUTOFF_DC_PRESETS, chainIdx & 1u);
+                s.fastFilters = fast;
+
+                RefSignal g;
+                ref_signalInit(g, signal, 250u << fsIdx, chainIdx);
+                static DspChain chain;
+                dspChain_init(chain);
+                static RefChain ref;
+                ref_chainInit(ref, s, fsIdx, tone != 0);
+
+                for (uint32_t k = 0; k < 2 * TEST_NUM_SIZES; ++k)
+                {
+                    const uint32_t n = (k & 1u) ? TEST_PACKET_SIZES[k / 2] : TEST_FRAMES_PER_PACKET[fsIdx];
+                    ref_fill(g, s_kernel, n);
+                    s_ref = s_kernel;
+
+                    const uint8_t format = dspChain_process(chain, s, fsIdx, s_kernel.data, s_kernel.numFrames, tone != 0);
+                    ref_chainRun(ref, s_ref);
+
+                    char what[112];
+                    snprintf(what, sizeof(what), "fs %u Hz, chain %u, gain %u, %s, tone notch %s, packet %u", 250u << fsIdx,
+                             (unsigned)chainIdx, (unsigned)gain, fast ? "fast" : "exact", tone ? "on" : "off", (unsigned)k);
+                    TEST_ASSERT_EQUAL_HEX8_MESSAGE((uint8_t)(fsIdx | ((chainIdx ? 1u : 0u) << 3) | (chainIdx << 4)), format, what);
+                    test_compare(s_kernel, s_ref, what);
+                }
+            }
+        }
+    }
+}
+
+// 2. decimation against the reference, fed with unfiltered signals
+static void test_decimation_matches_reference(void)
+{
+    for (uint32_t log2R = 1; log2R <= DECIM_MAX_LOG2; ++log2R)
+    {
+        for (uint32_t signal = 0; signal < REF_NUM_SIGNALS; ++signal)
+        {
+            RefSignal g;
+            ref_signalInit(g, signal, 4000, 7u * log2R + signal);
+            static Decimator decim;
+            decim_init(decim);
+            ref_decimInit(s_refDecim, log2R);
+
+            uint32_t total = 0;
+            for (uint32_t k = 0; total + MAX_FRAMES_PER_BLOCK <= REF_DECIM_MAX_INPUT; ++k)
+            {
+                const uint32_t n = TEST_PACKET_SIZES[k % TEST_NUM_SIZES];
+                total += n;
+                ref_fill(g, s_kernel, n);
+                s_ref = s_kernel;
+
+                uint32_t firstSource;
+                s_kernel.numFrames = decim_process(decim, log2R, s_kernel.data, s_kernel.numFrames, firstSource);
+                ref_decimRun(s_refDecim, s_ref);
+
+                char what[96];
+                snprintf(what, sizeof(what), "R %u, signal %u, packet %u", 1u << log2R, (unsigned)signal, (unsigned)k);
+                test_compare(s_kernel, s_ref, what);
+            }
+        }
+    }
+}
+
+// 3. scripted sessions against the golden digests
+// ------------------------------------------------------------------------------------------------------------------
+constexpr uint32_t GOLDEN_PACKETS = 60;
+
+// Packing of the 16-channel build, so the 8-channel build (digest covers channels 1 ... 8 only) checks the same numbers
+static const uint32_t GOLDEN_FRAMES_PER_PACKET[NUM_OF_FREQ_PRESETS] = { 5, 10, 20, 27, 27 };
+
+// Settings of packet k of the session: every 10 packets something changes while the filters keep running
+static DspSettings golden_settings(const uint32_t k)
+{
+    switch (k / 10)
+    {
+        case 0:  return test_settings(DSP_CHAIN_EQ | DSP_CHAIN_DC | DSP_CHAIN_N50, 0, 1, 0);                   // start
+        case 1:  return test_settings(DSP_CHAIN_EQ | DSP_CHAIN_DC | DSP_CHAIN_N50, 4, 1, 0);                   // gain, rescale
+        case 2:  return test_settings(DSP_CHAIN_EQ | DSP_CHAIN_DC | DSP_CHAIN_N100, 4, 1, 0);                  // notch swap, prime
+        case 3:  return test_settings(DSP_CHAIN_EQ | DSP_CHAIN_DC | DSP_CHAIN_N100, 4, 3, 1);                  // new presets
+        case 4:  return test_settings(0, 2, 3, 1);                                                             // all off, gain only
+        default: return test_settings(DSP_CHAIN_EQ | DSP_CHAIN_DC | DSP_CHAIN_N50 | DSP_CHAIN_N100, 2, 0, 0);  // all on, prime
+    }
+}
+
+// R of packet k: off, 2, 16, 4 - switched on, changed up and down
+static uint32_t golden_log2R(const uint32_t k)
+{
+    static const uint32_t LOG2R[6] = { 0, 1, 1, 4, 4, 2 };
+    return LOG2R[k / 10];
+}
+
+// Digests of [chain output, decimated output] per sampling rate preset and signal, recorded from the current kernels
+static const uint32_t GOLDEN[NUM_OF_FREQ_PRESETS][REF_NUM_SIGNALS][2] = {
+    { { 0x08F2BDE6u, 0x01CD0E62u }, { 0x4F2072E0u, 0x65EADDF0u }, { 0x8232FF91u, 0x1C91244Eu } },   //  250 Hz
+    { { 0x13822050u, 0x0BCD82EDu }, { 0xB5CD2E4Cu, 0xAFB28CC0u }, { 0x5F03DD67u, 0x45272659u } },   //  500 Hz
+    { { 0xC2E030E1u, 0xDC6BB016u }, { 0x98867B5Du, 0x2395D716u }, { 0xDE51B965u, 0x5AC5EEDDu } },   // 1000 Hz
+    { { 0xF68CEF92u, 0x8F142584u }, { 0x591A5634u, 0x5317971Au }, { 0x14F38554u, 0x3592FB24u } },   // 2000 Hz
+    { { 0x38E0FB40u, 0x57966962u }, { 0x3EF82744u, 0x4D7423F6u }, { 0x12CADA50u, 0x5F778856u } } }; // 4000 Hz
+
+static void test_golden_sessions(void)
+{
+    for (uint32_t fsIdx = 0; fsIdx < NUM_OF_FREQ_PRESETS; ++fsIdx)
+    {
+        for (uint32_t signal = 0; signal < REF_NUM_SIGNALS; ++signal)
+        {
+            RefSignal g;
+            ref_signalInit(g, signal, 250u << fsIdx, 100u + signal);
+            static DspChain  chain;
+            static Decimator decim;
+            dspChain_init(chain);
+            decim_init(decim);
+
+            uint32_t crcChain = 0, crcDecim = 0;
+            for (uint32_t k = 0; k < GOLDEN_PACKETS; ++k)
+            {
+                ref_fill(g, s_kernel, GOLDEN_FRAMES_PER_PACKET[fsIdx]);
+                dspChain_process(chain, golden_settings(k), fsIdx, s_kernel.data, s_kernel.numFrames, false);
+                crcChain = ref_crc32(crcChain, s_kernel);
+
+                uint32_t firstSource;
+                s_kernel.numFrames = decim_process(decim, golden_log2R(k), s_kernel.data, s_kernel.numFrames, firstSource);
+                crcDecim = ref_crc32(crcDecim, s_kernel);
+            }
+
+            char what[64];
+            snprintf(what, sizeof(what), "fs %u Hz, signal %u, chain", 250u << fsIdx, (unsigned)signal);
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(GOLDEN[fsIdx][signal][0], crcChain, what);
+            snprintf(what, sizeof(what), "fs %u Hz, signal %u, decimation", 250u << fsIdx, (unsigned)signal);
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(GOLDEN[fsIdx][signal][1], crcDecim, what);
+        }
+    }
+}
+
+// 4. fast precision against exact
+// ------------------------------------------------------------------------------------------------------------------
+constexpr uint32_t FAST_SECONDS = 2;
+
+// Limits of the error, 24-bit output LSBs, a bit above what math_lib.h documents
+struct FastLimit { float rms, max; };
+static const uint32_t  FAST_FILTERS[3]                      = { DSP_CHAIN_EQ, DSP_CHAIN_N50, DSP_CHAIN_N100 };
+static const char *    FAST_NAMES  [3]                      = { "equalizer", "50/60 Hz", "100/120 Hz" };
+static const FastLimit FAST_LIMITS [3][NUM_OF_FREQ_PRESETS] = {
+    { { 0.15f, 1.0f }, { 0.15f, 1.0f }, { 0.15f, 1.0f }, { 0.15f, 1.0f }, { 0.15f,  1.0f } },   // equalizer
+    { { 0.2f,  2.0f }, { 0.45f, 2.0f }, { 0.75f, 3.0f }, { 1.5f,  6.0f }, { 3.8f,  15.0f } },   // 50/60 Hz
+    { { 0.33f, 2.0f }, { 0.2f,  2.0f }, { 0.45f, 2.0f }, { 0.8f,  3.0f }, { 1.5f,   6.0f } } }; // 100/120 Hz
+
+static void test_fast_precision_error(void)
+{
+    for (uint32_t fsIdx = 0; fsIdx < NUM_OF_FREQ_PRESETS; ++fsIdx)
+    {
+        for (uint32_t f = 0; f < 3; ++f)
+        {
+            DspSettings exact = test_settings(FAST_FILTERS[f], 0, 0, 0);
+            DspSettings fast  = exact;
+            fast.fastFilters  = FAST_FILTERS[f];
+
+            RefSignal g;
+            ref_signalInit(g, REF_SIGNAL_EEG, 250u << fsIdx, 200u + f);
+            static DspChain chainExact, chainFast;
+            dspChain_init(chainExact);
+            dspChain_init(chainFast);
+
+            int64_t  sumSq = 0;
+            uint32_t count = 0, maxErr = 0;
+            const uint32_t frames = TEST_FRAMES_PER_PACKET[fsIdx];
+            for (uint32_t k = 0; k < FAST_SECONDS * (250u << fsIdx) / frames; ++k)
+            {
+                ref_fill(g, s_kernel, frames);
+                s_ref = s_kernel;
+                dspChain_process(chainExact, exact, fsIdx, s_ref.data,    frames, false);
+                dspChain_process(chainFast,  fast,  fsIdx, s_kernel.data, frames, false);
+                for (uint32_t i = 0; i < frames; ++i)
+                {
+                    for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+                    {
+                        const uint32_t at  = i * ADC_FULL_FRAME_SIZE + 3 * ch;
+                        const int32_t  err = ref_get24(&s_kernel.data[at]) - ref_get24(&s_ref.data[at]);
+                        const uint32_t mag = (uint32_t)((err < 0) ? -err : err);
+                        sumSq += (int64_t)err * err;
+                        count++;
+                        if (mag > maxErr) maxErr = mag;
+                    }
+                }
+            }
+
+            const float rms = sqrtf((float)sumSq / (float)count);
+            char what[96];
+            snprintf(what, sizeof(what), "fs %u Hz, %s fast: error rms %.3f, max %u LSB", 250u << fsIdx, FAST_NAMES[f],
+                     (double)rms, (unsigned)maxErr);
+            printf("%s\n", what);
+            TEST_ASSERT_TRUE_MESSAGE(rms <= FAST_LIMITS[f][fsIdx].rms, what);
+            TEST_ASSERT_TRUE_MESSAGE((float)maxErr <= FAST_LIMITS[f][fsIdx].max, what);
+        }
+    }
+}
+
+// 5. electrode impedance
+// ------------------------------------------------------------------------------------------------------------------
+constexpr uint32_t IMPEDANCE_TEST_BLOCKS = 3;          // the first one is thrown away
+static const uint8_t IMPEDANCE_TEST_GAINS[4] = { 24, 12, 8, 6 };
+
+// Lead-off tone of every excited channel on top of a packet, what the ADC sees from electrode impedance z: fundamental
+// of the square wave through the sinc3, at fs / 4 with a phase of its own per channel. Sample index is the timestamp
+// of ref_fill.
+static void test_addTone(RefPacket & p, const LeadOffState & lo, const float * z)
+{
+    for (uint32_t f = 0; f < p.numFrames; ++f)
+    {
+        uint8_t * const frame = &p.data[f * ADC_FULL_FRAME_SIZE];
+        uint32_t n;
+        memcpy(&n, &frame[ADC_PARSED_FRAME], 4);
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+        {
+            if (!lo.pgaGain[ch]) continue;
+            const float amplitude = z[ch] * IMPEDANCE_CURRENT_A[lo.current] * (float)lo.pgaGain[ch] * IMPEDANCE_TONE_GAIN / IMPEDANCE_VOLT_LSB;
+            const float tone      = amplitude * cosf(1.5707963f * (float)(n & 3u) + 0.4f * (float)ch);
+            ref_put24(&frame[3 * ch], ref_get24(&frame[3 * ch]) + (int32_t)lroundf(tone));
+        }
+    }
+}
+
+// Feed a packet to the Goertzel, every block it closes must read scale * z within tolerance * z, NaN where not excited.
+// Frame index is the sample index of ref_fill (timestamp).
+static uint32_t test_impedanceRun(ImpedanceState & imp, const RefPacket & p, const LeadOffState & lo, const float * z,
+                                  const float scale, const float tolerance, const char * what)
+{
+    uint32_t blocks = 0, taken = 0, index;
+    memcpy(&index, &p.data[ADC_PARSED_FRAME], 4);
+    while (taken < p.numFrames)
+    {
+        uint32_t   used;
+        const bool ready = impedance_run(imp, &p.data[taken * ADC_FULL_FRAME_SIZE], p.numFrames - taken, index + taken, used);
+        taken += used;
+        if (!ready) continue;
+
+        uint8_t ohms[NUMBER_OF_ADC_CHANNELS * 4];
+        TEST_ASSERT_TRUE_MESSAGE(impedance_write(imp, ohms) == NUMBER_OF_ADC_CHANNELS * 4u, what);
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+        {
+            float got;
+            memcpy(&got, &ohms[4 * ch], 4);
+            char msg[128];
+            snprintf(msg, sizeof(msg), "%s, channel %u: %.0f Ohm, tone of %.0f Ohm", what, (unsigned)ch, (double)got, (double)z[ch]);
+            if (!lo.pgaGain[ch]) TEST_ASSERT_TRUE_MESSAGE(isnan(got), msg);
+            else                 TEST_ASSERT_TRUE_MESSAGE(fabsf(got - scale * z[ch]) <= tolerance * z[ch], msg);
+        }
+        blocks++;
+    }
+    return blocks;
+}
+
+static void test_impedance(void)
+{
+    for (uint32_t fsIdx = 0; fsIdx < NUM_OF_FREQ_PRESETS; ++fsIdx)
+    {
+        // 20 ... 300 kOhm at 24 nA, the last channel has no excitation
+        LeadOffState lo;
+        memset((void *)&lo, 0, sizeof(lo));
+        lo.on      = true;
+        lo.current = 1;
+        float z[NUMBER_OF_ADC_CHANNELS];
+        for (uint32_t ch = 0; ch < NUMBER_OF_ADC_CHANNELS; ++ch)
+        {
+            z[ch]          = 20e3f * (float)(ch + 1u);
+            lo.pgaGain[ch] = (ch + 1u < NUMBER_OF_ADC_CHANNELS) ? IMPEDANCE_TEST_GAINS[ch & 3u] : 0u;
+        }
+
+        // Goertzel on the raw EEG + tone, within 3 % - the blinks of the EEG signal leak a bit into the bin. And on the
+        // tone alone after the notch (all filters off): what is left of it must read as less than 0.1 % of its
+        // impedance, 60 dB down, once the notch has settled (first block)
+        static ImpedanceState imp, impNotched;
+        impedance_configure(imp, lo, fsIdx);
+        impedance_configure(impNotched, lo, fsIdx);
+        static DspChain chain;
+        dspChain_init(chain);
+        const DspSettings off = test_settings(0, 0, 0, 0);
+        RefSignal g;
+        ref_signalInit(g, REF_SIGNAL_EEG, 250u << fsIdx, 300u + fsIdx);
+
+        char what[64];
+        uint32_t blocks = 0;
+        while (blocks < IMPEDANCE_TEST_BLOCKS - 1u)
+        {
+            ref_fill(g, s_kernel, TEST_FRAMES_PER_PACKET[fsIdx]);
+            test_addTone(s_kernel, lo, z);
+            snprintf(what, sizeof(what), "fs %u Hz", 250u << fsIdx);
+            blocks += test_impedanceRun(imp, s_kernel, lo, z, 1.0f, 0.03f, what);
+
+            for (uint32_t f = 0; f < s_kernel.numFrames; ++f) memset(&s_kernel.data[f * ADC_FULL_FRAME_SIZE], 0, ADC_PARSED_FRAME);
+            test_addTone(s_kernel, lo, z);
+            dspChain_process(chain, off, fsIdx, s_kernel.data, s_kernel.numFrames, true);
+            snprintf(what, sizeof(what), "fs %u Hz, after the notch", 250u << fsIdx);
+            test_impedanceRun(impNotched, s_kernel, lo, z, 0.0f, 0.001f, what);
+        }
+
+        // One frame lost: even and odd chains would swap phase, the block running then is thrown away and the first
+        // result comes a whole block after it, right again (within 5 %, that block lands on another blink)
+        ref_fill(g, s_kernel, 1);    // never gets to the Goertzel
+        uint32_t frames = 0;
+        for (blocks = 0; blocks == 0; frames += TEST_FRAMES_PER_PACKET[fsIdx])
+        {
+            ref_fill(g, s_kernel, TEST_FRAMES_PER_PACKET[fsIdx]);
+            test_addTone(s_kernel, lo, z);
+            snprintf(what, sizeof(what), "fs %u Hz, after a lost frame", 250u << fsIdx);
+            blocks = test_impedanceRun(imp, s_kernel, lo, z, 1.0f, 0.05f, what);
+        }
+        snprintf(what, sizeof(what), "fs %u Hz, lost frame: first result after %u frames", 250u << fsIdx, (unsigned)frames);
+        TEST_ASSERT_TRUE_MESSAGE(frames > imp.blockLen, what);
+    }
+}
+
+static int runTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_chain_matches_reference);
+    RUN_TEST(test_decimation_matches_reference);
+    RUN_TEST(test_golden_sessions);
+    RUN_TEST(test_fast_precision_error);
+    RUN_TEST(test_impedance);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup()
+{
+    delay(2000);   // USB CDC comes up
+    runTests();
+}
+void loop() {}
+#else
+int main(void)
+{
+    return runTests();
+}
+#endif
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MIT OR Apache-2.0
+// Copyright (c) 2025 Gleb Manokhin (nikki)
+// Project: Meower
+
+// DSP KERNELS - CYCLES PER FRAME ON THE BOARD
+// ---------------------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// pio test -e esp32c3-bench -f test_dsp_bench
+// Every kernel at every sampling rate preset, packets of the same size the firmware sends, pseudo EEG as input.
+// Prints min (cold caches and interrupts filtered out) and mean cycles per frame, and the frame budget = CPU clock / fs.
+// Fails if the full chain plus decimation by 16 does not fit into the frame period - the ADC task could not keep up.
+// "fast" rows are the same filters on the fast precision kernels (sys precision_fast), against the exact rows above them.
+// Numbers go with the build flags of the firmware (-O3, LTO), so a kernel change can be compared before / after.
+
+#include <stdio.h>
+#include <Arduino.h>
+#include <unity.h>
+#include <stats_lib.h>
+#include <dsp_reference.h>
+
+Stats g_stats = {};
+
+constexpr uint32_t BENCH_PACKETS = 200;
+
+// Same packing as the firmware (FRAMES_PER_PACKET_LUT in main.cpp)
+static const uint32_t BENCH_FRAMES_PER_PACKET[NUM_OF_FREQ_PRESETS] = { 5, 10, 20,
+    (40 < MAX_FRAMES_PER_PACKET) ? 40 : MAX_FRAMES_PER_PACKET, (80 < MAX_FRAMES_PER_PACKET) ? 80 : MAX_FRAMES_PER_PACKET };
+
+struct BenchCase
+{
+    const char * name;
+    uint32_t     chainIdx;   // DSP_CHAIN_* bits, 0 with gain - unpack + gain + pack only
+    uint32_t     fast;       // DSP_CHAIN_* bits on the fast kernels
+    uint32_t     gain;
+    uint32_t     log2R;      // 0 - chain only, else decimation only
+};
+
+constexpr uint32_t BENCH_ALL = DSP_CHAIN_EQ | DSP_CHAIN_DC | DSP_CHAIN_N50 | DSP_CHAIN_N100;
+
+static const BenchCase BENCH_CASES[] = {
+    { "unpack/pack",  0,              0,                      1, 0 },
+    { "equalizer",    DSP_CHAIN_EQ,   0,                      0, 0 },
+    { "DC blocker",   DSP_CHAIN_DC,   0,                      0, 0 },
+    { "50/60 notch",  DSP_CHAIN_N50,  0,                      0, 0 },
+    { "100/120",      DSP_CHAIN_N100, 0,                      0, 0 },
+    { "all four",     BENCH_ALL,      0,                      0, 0 },
+    { "eq fast",      DSP_CHAIN_EQ,   DSP_CHAIN_EQ,           0, 0 },
+    { "50/60 fast",   DSP_CHAIN_N50,  DSP_CHAIN_N50,          0, 0 },
+    { "100/120 fast", DSP_CHAIN_N100, DSP_CHAIN_N100,         0, 0 },
+    { "all fast",     BENCH_ALL,      DSP_CHAIN_FAST_CAPABLE, 0, 0 },
+    { "decim R=2",    0,              0,                      0, 1 },
+    { "decim R=16",   0,              0,                      0, DECIM_MAX_LOG2 } };
+constexpr uint32_t BENCH_NUM_CASES = sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]);
+
+static RefPacket  s_packet;
+static DspChain   s_chain;
+static Decimator  s_decim;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Mean cycles per frame of one case, min over packets into minPerFrame
+static uint32_t bench_run(const BenchCase & b, const uint32_t fsIdx, uint32_t & minPerFrame)
+{
+    DspSettings s;
+    memset(&s, 0, sizeof(s));
+    s.filtersEnabled = (b.chainIdx != 0);
+    s.adcEqualizer   = (b.chainIdx & DSP_CHAIN_EQ  ) != 0;
+    s.removeDC       = (b.chainIdx & DSP_CHAIN_DC  ) != 0;
+    s.block5060Hz    = (b.chainIdx & DSP_CHAIN_N50 ) != 0;
+    s.block100120Hz  = (b.chainIdx & DSP_CHAIN_N100) != 0;
+    s.digitalGain    = b.gain;
+    s.fastFilters    = b.fast;
+
+    RefSignal g;
+    ref_signalInit(g, REF_SIGNAL_EEG, 250u << fsIdx, 1);
+    dspChain_init(s_chain);
+    decim_init(s_decim);
+
+    const uint32_t numFrames = BENCH_FRAMES_PER_PACKET[fsIdx];
+    uint64_t       total     = 0;
+    uint32_t       minPacket = UINT32_MAX;
+    for (uint32_t k = 0; k <= BENCH_PACKETS; ++k)
+    {
+        ref_fill(g, s_packet, numFrames);
+
+        uint32_t       firstSource;
+        const uint32_t t0 = stats_cycles();
+        if (b.log2R) decim_process(s_decim, b.log2R, s_packet.data, numFrames, firstSource);
+        else         dspChain_process(s_chain, s, fsIdx, s_packet.data, numFrames, false);
+        const uint32_t dt = stats_cycles() - t0;
+
+        if (k == 0) continue;   // switch, prime and cold caches, not the steady state
+        total += dt;
+        if (dt < minPacket) minPacket = dt;
+    }
+    minPerFrame = minPacket / numFrames;
+    return (uint32_t)(total / ((uint64_t)BENCH_PACKETS * numFrames));
+}
+
+static void test_dsp_cycles_per_frame(void)
+{
+    char line[112];
+    for (uint32_t fsIdx = 0; fsIdx < NUM_OF_FREQ_PRESETS; ++fsIdx)
+    {
+        const uint32_t fsHz   = 250u << fsIdx;
+        const uint32_t budget = g_stats.cpuMhz * 1000000u / fsHz;
+        snprintf(line, sizeof(line), "%u Hz, %u frames per packet, budget %u cycles per frame at %u MHz",
+                 (unsigned)fsHz, (unsigned)BENCH_FRAMES_PER_PACKET[fsIdx], (unsigned)budget, (unsigned)g_stats.cpuMhz);
+        TEST_MESSAGE(line);
+
+        uint32_t chainMean = 0, decimMean = 0;
+        for (uint32_t c = 0; c < BENCH_NUM_CASES; ++c)
+        {
+            uint32_t       minPerFrame;
+            const uint32_t mean = bench_run(BENCH_CASES[c], fsIdx, minPerFrame);
+            snprintf(line, sizeof(line), "  %-12s min %6u  mean %6u cycles per frame  %3u %% of budget", BENCH_CASES[c].name,
+                     (unsigned)minPerFrame, (unsigned)mean, (unsigned)(100u * mean / budget));
+            TEST_MESSAGE(line);
+
+            if ((BENCH_CASES[c].chainIdx == DSP_CHAIN_NUM - 1) && !BENCH_CASES[c].fast) chainMean = mean;
+            if (BENCH_CASES[c].log2R == DECIM_MAX_LOG2)       decimMean = mean;
+        }
+        snprintf(line, sizeof(line), "%u Hz: all filters + decimation by 16 take more than the frame period", (unsigned)fsHz);
+        TEST_ASSERT_TRUE_MESSAGE(chainMean + decimMean < budget, line);
+    }
+}
+
+void setup()
+{
+    delay(2000);   // USB CDC comes up
+    stats_begin(getCpuFrequencyMhz(), millis());
+    UNITY_BEGIN();
+    RUN_TEST(test_dsp_cycles_per_frame);
+    UNITY_END();
+}
+
+void loop() {}